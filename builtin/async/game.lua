@@ -0,0 +1,18 @@
+
+core.log("info", "Initializing asynchronous environment (game)")
+
+local function pack2(...)
+	return {n = select("#", ...), ...}
+end
+
+-- Entrypoint to run async jobs, called by C++
+function core.job_processor(func, serialized_params)
+	local params = core.deserialize(serialized_params, true)
+	local retval = pack2(func(unpack(params, 1, params.n)))
+
+	return core.serialize(retval)
+end
+
+local commonpath = core.get_builtin_path() .. "common" .. DIR_DELIM
+
+dofile(commonpath .. "vector.lua")
@@ -0,0 +1,40 @@
+core.log("info", "Initializing mapgen environment")
+
+local builtinpath = core.get_builtin_path()
+
+dofile(builtinpath .. "common" .. DIR_DELIM .. "vector.lua")
+dofile(builtinpath .. "game" .. DIR_DELIM .. "voxelarea.lua")
+
+--
+-- Callback registration
+--
+
+core.callback_origins = {}
+
+-- Only RUN_CALLBACKS_MODE_FIRST is used in this environment
+function core.run_callbacks(callbacks, mode, ...)
+	assert(type(callbacks) == "table")
+	local ret
+	for i = 1, #callbacks do
+		local origin = core.callback_origins[callbacks[i]]
+		if origin then
+			core.set_last_run_mod(origin.mod)
+		end
+		local cb_ret = callbacks[i](...)
+		if i == 1 then
+			ret = cb_ret
+		end
+	end
+	return ret
+end
+
+core.registered_on_generateds = {}
+
+function core.register_on_generated(func)
+	local t = core.registered_on_generateds
+	t[#t + 1] = func
+	core.callback_origins[func] = {
+		mod = core.get_current_modname() or "??",
+		name = "register_on_generated"
+	}
+end
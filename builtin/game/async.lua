@@ -0,0 +1,26 @@
+core.async_jobs = {}
+
+function core.async_event_handler(jobid, serialized_retval)
+	local callback = core.async_jobs[jobid]
+	assert(type(callback) == "function")
+	core.async_jobs[jobid] = nil
+
+	local retval = core.deserialize(serialized_retval, true)
+	if type(retval) ~= "table" then
+		core.log("error", "Async job " .. jobid .. " did not return a result")
+		return
+	end
+	callback(unpack(retval, 1, retval.n))
+end
+
+function core.handle_async(func, callback, ...)
+	assert(type(func) == "function" and type(callback) == "function",
+		"Invalid core.handle_async invocation")
+	local args = {n = select("#", ...), ...}
+	local mod_origin = core.get_last_run_mod()
+
+	local jobid = core.do_async_callback(func, core.serialize(args), mod_origin)
+	core.async_jobs[jobid] = callback
+
+	return true
+end
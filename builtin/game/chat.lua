@@ -926,6 +926,40 @@ core.register_chatcommand("status", {
 	end,
 })
 
+core.register_chatcommand("modusage", {
+	params = "[<mod>]",
+	description = "Show the time spent in Lua and the memory allocated by mods since the server started",
+	privs = {server=true},
+	func = function(name, param)
+		local usage = core.get_mod_usage()
+		if not usage then
+			return false, "Per-mod accounting is disabled (mod_accounting)"
+		end
+
+		local mods = {}
+		for mod, u in pairs(usage) do
+			if param == "" or param == mod then
+				u.mod = mod
+				mods[#mods + 1] = u
+			end
+		end
+		if #mods == 0 then
+			return false, "No usage of mod " .. param
+		end
+		table.sort(mods, function(a, b) return a.time > b.time end)
+
+		local uptime = core.get_server_uptime()
+		local lines = {}
+		for i = 1, math.min(#mods, 10) do
+			local u = mods[i]
+			lines[i] = ("%s: %.2f s (%.1f%% of uptime), %d calls, %.1f MiB allocated"):format(
+				u.mod, u.time, u.time / math.max(uptime, 1) * 100, u.calls,
+				u.allocated / 1048576)
+		end
+		return true, table.concat(lines, "\n")
+	end,
+})
+
 core.register_chatcommand("time", {
 	params = "[<0..23>:<0..59> | <0..24000>]",
 	description = "Show or set time of day",
@@ -33,6 +33,7 @@ dofile(gamepath .. "forceloading.lua")
 dofile(gamepath .. "statbars.lua")
 dofile(gamepath .. "knockback.lua")
 dofile(gamepath .. "sscsm" .. DIR_DELIM .. "init.lua")
+dofile(gamepath .. "async.lua")
 
 profiler = nil
 string.dump = nil -- luacheck: ignore
@@ -311,3 +311,25 @@ function core.dynamic_add_media(filepath, callback)
 	end
 	return true
 end
+
+
+-- Callback handling for find_path_async
+
+local find_path_async_raw = core.find_path_async_raw
+core.find_path_async_raw = nil
+local path_callbacks = {}
+
+function core.find_path_async(pos1, pos2, searchdistance, max_jump, max_drop,
+		algorithm, callback)
+	assert(type(callback) == "function",
+		"Invalid core.find_path_async invocation")
+	local id = find_path_async_raw(pos1, pos2, searchdistance, max_jump,
+		max_drop, algorithm, core.get_last_run_mod())
+	path_callbacks[id] = callback
+end
+
+function core.path_event_handler(id, path)
+	local callback = path_callbacks[id]
+	path_callbacks[id] = nil
+	callback(path)
+end
@@ -79,7 +79,8 @@ end
 
 function core.register_abm(spec)
 	-- Add to core.registered_abms
-	assert(type(spec.action) == "function", "Required field 'action' of type function")
+	assert(type(spec.action) == "function" or type(spec.action_batch) == "function",
+		"Required field 'action' or 'action_batch' of type function")
 	core.registered_abms[#core.registered_abms + 1] = spec
 	spec.mod_origin = core.get_current_modname() or "??"
 end
@@ -70,6 +70,10 @@ elseif INIT == "mainmenu" then
 	end
 elseif INIT == "async" then
 	dofile(asyncpath .. "init.lua")
+elseif INIT == "async_game" then
+	dofile(asyncpath .. "game.lua")
+elseif INIT == "emerge" then
+	dofile(scriptdir .. "emerge" .. DIR_DELIM .. "init.lua")
 elseif INIT == "client" then
 	dofile(clientpath .. "init.lua")
 else
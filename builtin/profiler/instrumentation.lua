@@ -186,8 +186,9 @@ local function init()
 		-- Wrap register_abm() to automatically instrument abms.
 		local orig_register_abm = core.register_abm
 		core.register_abm = function(spec)
-			spec.action = instrument {
-				func = spec.action,
+			local field = spec.action_batch and "action_batch" or "action"
+			spec[field] = instrument {
+				func = spec[field],
 				class = "ABM",
 				label = spec.label,
 			}
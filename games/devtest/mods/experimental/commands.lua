@@ -86,6 +86,58 @@ minetest.register_chatcommand("bench_bulk_set_node", {
 	end,
 })
 
+minetest.register_chatcommand("bench_get_node", {
+	params = "",
+	description = "Benchmark: Get 50×50×50 nodes with get_node and get_node_raw, swap them with swap_node",
+	func = function(name, param)
+		local player = minetest.get_player_by_name(name)
+		if not player then
+			return false, "No player."
+		end
+		local ppos = vector.round(player:get_pos())
+		local pos_list = {}
+		local i = 1
+		for x=1,50 do
+			for y=1,50 do
+				for z=1,50 do
+					pos_list[i] = {x=ppos.x + x,y = ppos.y + y,z = ppos.z + z}
+					i = i + 1
+				end
+			end
+		end
+
+		local get_node, get_node_raw = minetest.get_node, minetest.get_node_raw
+		local swap_node = minetest.swap_node
+		-- warm up, this also emerges the area as far as it is loaded
+		local nodes = {}
+		for i=1,#pos_list do
+			nodes[i] = get_node(pos_list[i])
+		end
+
+		local start_time = minetest.get_us_time()
+		for i=1,#pos_list do
+			get_node(pos_list[i])
+		end
+		local middle_time = minetest.get_us_time()
+		for i=1,#pos_list do
+			local p = pos_list[i]
+			get_node_raw(p.x, p.y, p.z)
+		end
+		local raw_end_time = minetest.get_us_time()
+		-- swap every node with itself, this reads the node tables
+		for i=1,#pos_list do
+			swap_node(pos_list[i], nodes[i])
+		end
+		local end_time = minetest.get_us_time()
+		local msg = string.format("Benchmark results: minetest.get_node loop: %.2f ms; minetest.get_node_raw loop: %.2f ms; minetest.swap_node loop: %.2f ms",
+			((middle_time - start_time)) / 1000,
+			((raw_end_time - middle_time)) / 1000,
+			((end_time - raw_end_time)) / 1000
+		)
+		return true, msg
+	end,
+})
+
 local function advance_pos(pos, start_pos, advance_z)
 	if advance_z then
 		pos.z = pos.z + 2
@@ -0,0 +1,203 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "activeobjectstate.h"
+#include "activeobject.h"
+#include "util/numeric.h"
+#include "util/serialize.h"
+#include <cmath>
+#include <sstream>
+
+bool ObjectPosition::deSerializeCommand(const std::string &data)
+{
+	// command, 4 * v3f, 2 * u8, f32
+	if (data.size() < 55 || data[0] != AO_CMD_UPDATE_POSITION)
+		return false;
+
+	const u8 *p = (const u8 *)data.c_str() + 1;
+	position = readV3F32(p);
+	velocity = readV3F32(p + 12);
+	acceleration = readV3F32(p + 24);
+	rotation = readV3F32(p + 36);
+	do_interpolate = p[48];
+	is_movement_end = p[49];
+	update_interval = readF32(p + 50);
+	return true;
+}
+
+std::string ObjectPosition::serializeCommand() const
+{
+	std::ostringstream os(std::ios::binary);
+	writeU8(os, AO_CMD_UPDATE_POSITION);
+	writeV3F32(os, position);
+	writeV3F32(os, velocity);
+	writeV3F32(os, acceleration);
+	writeV3F32(os, rotation);
+	writeU8(os, do_interpolate);
+	writeU8(os, is_movement_end);
+	writeF32(os, update_interval);
+	return os.str();
+}
+
+// Returns false if the vector doesn't fit
+static bool quantise(const v3f &v, v3s16 &result)
+{
+	v3f q = v / AOS_POSITION_STEP;
+	if (std::fabs(q.X) > 32767.0f || std::fabs(q.Y) > 32767.0f ||
+			std::fabs(q.Z) > 32767.0f)
+		return false;
+	result = v3s16(std::lround(q.X), std::lround(q.Y), std::lround(q.Z));
+	return true;
+}
+
+static u16 quantise_angle(f32 degrees)
+{
+	return (u16)((u32)std::lround(wrapDegrees_0_360(degrees) * 65536.0f / 360.0f));
+}
+
+static void append_v3s16(std::string &buffer, const v3s16 &v)
+{
+	char buf[6];
+	writeV3S16((u8 *)buf, v);
+	buffer.append(buf, sizeof(buf));
+}
+
+void ObjectSyncState::write(u16 id, const ObjectPosition &pos,
+		std::string &reliable, std::string &unreliable)
+{
+	u8 flags = (pos.do_interpolate ? AOS_INTERPOLATE : 0) |
+			(pos.is_movement_end ? AOS_MOVEMENT_END : 0);
+	v3s16 offset, velocity, acceleration, baseline_velocity, baseline_acceleration;
+	bool fits = has_baseline &&
+			quantise(pos.position - baseline.position, offset) &&
+			quantise(pos.velocity, velocity) &&
+			quantise(pos.acceleration, acceleration) &&
+			quantise(baseline.velocity, baseline_velocity) &&
+			quantise(baseline.acceleration, baseline_acceleration);
+
+	const u16 rotation[3] = {
+		quantise_angle(pos.rotation.X),
+		quantise_angle(pos.rotation.Y),
+		quantise_angle(pos.rotation.Z)
+	};
+	if (fits) {
+		if (velocity != baseline_velocity)
+			flags |= AOS_VELOCITY;
+		if (acceleration != baseline_acceleration)
+			flags |= AOS_ACCELERATION;
+		if (rotation[0] != quantise_angle(baseline.rotation.X) ||
+				rotation[1] != quantise_angle(baseline.rotation.Y) ||
+				rotation[2] != quantise_angle(baseline.rotation.Z))
+			flags |= AOS_ROTATION;
+	} else {
+		flags |= AOS_BASELINE;
+		if (has_baseline)
+			baseline_id++;
+		baseline = pos;
+		has_baseline = true;
+	}
+
+	std::string &buffer = (flags & AOS_BASELINE) ? reliable : unreliable;
+	char buf[48];
+	writeU16((u8 *)buf, id);
+	writeU8((u8 *)buf + 2, flags);
+	writeU8((u8 *)buf + 3, baseline_id);
+	buffer.append(buf, 4);
+
+	if (flags & AOS_BASELINE) {
+		writeV3F32((u8 *)buf, pos.position);
+		writeV3F32((u8 *)buf + 12, pos.velocity);
+		writeV3F32((u8 *)buf + 24, pos.acceleration);
+		writeV3F32((u8 *)buf + 36, pos.rotation);
+		buffer.append(buf, 48);
+	} else {
+		append_v3s16(buffer, offset);
+		if (flags & AOS_VELOCITY)
+			append_v3s16(buffer, velocity);
+		if (flags & AOS_ACCELERATION)
+			append_v3s16(buffer, acceleration);
+		if (flags & AOS_ROTATION) {
+			for (u16 angle : rotation) {
+				writeU16((u8 *)buf, angle);
+				buffer.append(buf, 2);
+			}
+		}
+	}
+
+	// In hundredths of a second
+	buffer.push_back((char)rangelim(std::lround(pos.update_interval * 100.0f), 0, 255));
+}
+
+bool readObjectState(std::istream &is,
+		std::unordered_map<u16, ObjectSyncState> &states,
+		u16 &id, ObjectPosition &pos)
+{
+	id = readU16(is);
+	u8 flags = readU8(is);
+	u8 baseline_id = readU8(is);
+
+	if (flags & AOS_BASELINE) {
+		pos.position = readV3F32(is);
+		pos.velocity = readV3F32(is);
+		pos.acceleration = readV3F32(is);
+		pos.rotation = readV3F32(is);
+	} else {
+		v3s16 offset = readV3S16(is);
+		v3s16 velocity = (flags & AOS_VELOCITY) ? readV3S16(is) : v3s16();
+		v3s16 acceleration = (flags & AOS_ACCELERATION) ? readV3S16(is) : v3s16();
+		v3f rotation;
+		if (flags & AOS_ROTATION) {
+			rotation.X = readU16(is) * 360.0f / 65536.0f;
+			rotation.Y = readU16(is) * 360.0f / 65536.0f;
+			rotation.Z = readU16(is) * 360.0f / 65536.0f;
+		}
+
+		auto it = states.find(id);
+		if (it == states.end() || !it->second.has_baseline ||
+				it->second.baseline_id != baseline_id) {
+			readU8(is);
+			return false;
+		}
+
+		const ObjectPosition &baseline = it->second.baseline;
+		pos.position = baseline.position +
+				v3f(offset.X, offset.Y, offset.Z) * AOS_POSITION_STEP;
+		pos.velocity = (flags & AOS_VELOCITY) ?
+				v3f(velocity.X, velocity.Y, velocity.Z) * AOS_POSITION_STEP :
+				baseline.velocity;
+		pos.acceleration = (flags & AOS_ACCELERATION) ?
+				v3f(acceleration.X, acceleration.Y, acceleration.Z) * AOS_POSITION_STEP :
+				baseline.acceleration;
+		pos.rotation = (flags & AOS_ROTATION) ? rotation : baseline.rotation;
+	}
+
+	pos.do_interpolate = flags & AOS_INTERPOLATE;
+	pos.is_movement_end = flags & AOS_MOVEMENT_END;
+	pos.update_interval = readU8(is) / 100.0f;
+	if (is.fail())
+		return false;
+
+	if (flags & AOS_BASELINE) {
+		ObjectSyncState &state = states[id];
+		state.baseline = pos;
+		state.baseline_id = baseline_id;
+		state.has_baseline = true;
+	}
+	return true;
+}
@@ -0,0 +1,96 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes_bloated.h"
+#include "constants.h"
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+/*
+	Position updates of active objects in TOCLIENT_ACTIVE_OBJECT_STATES.
+
+	Every object has a baseline that is sent reliably with full precision.
+	Updates are sent unreliably relative to it: the position as a quantised
+	offset, velocity, acceleration and rotation only when they differ from
+	the baseline. Updates referring to a baseline the client doesn't have
+	(yet) are dropped. A new baseline is made when an update can't be
+	expressed relative to the current one.
+*/
+
+// Flags of an entry
+#define AOS_BASELINE     0x01
+#define AOS_VELOCITY     0x02
+#define AOS_ACCELERATION 0x04
+#define AOS_ROTATION     0x08
+#define AOS_INTERPOLATE  0x10
+#define AOS_MOVEMENT_END 0x20
+
+// Quantisation of positions (per node), velocities and accelerations
+#define AOS_POSITION_STEP (BS / 64.0f)
+
+// Updates of objects further away than this are sent less often, the
+// interval grows by a second over the next OBJECT_STATE_SLOWDOWN_DISTANCE
+#define OBJECT_STATE_FULL_RATE_DISTANCE (16 * BS)
+#define OBJECT_STATE_SLOWDOWN_DISTANCE (64 * BS)
+
+// The contents of AO_CMD_UPDATE_POSITION
+struct ObjectPosition
+{
+	v3f position;
+	v3f velocity;
+	v3f acceleration;
+	v3f rotation;
+	bool do_interpolate = false;
+	bool is_movement_end = false;
+	f32 update_interval = 0.0f;
+
+	// Includes the command byte, returns false if the message is not one
+	bool deSerializeCommand(const std::string &data);
+	std::string serializeCommand() const;
+};
+
+// What the client knows of the position of an object
+struct ObjectSyncState
+{
+	ObjectPosition baseline;
+	u8 baseline_id = 0;
+	bool has_baseline = false;
+
+	// Server only: update held back by rate limiting
+	ObjectPosition pending;
+	bool has_pending = false;
+	// Server uptime when the last update was sent
+	double last_sent = 0.0;
+
+	// Appends an entry for the update to reliable if it makes a new
+	// baseline, to unreliable otherwise
+	void write(u16 id, const ObjectPosition &pos, std::string &reliable,
+			std::string &unreliable);
+};
+
+/*
+	Reads an entry. Returns false if it can't be applied, or if the stream
+	ended; check is.fail() to tell apart.
+*/
+bool readObjectState(std::istream &is,
+		std::unordered_map<u16, ObjectSyncState> &states,
+		u16 &id, ObjectPosition &pos);
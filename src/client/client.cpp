@@ -51,6 +51,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "clientmap.h"
 #include "clientmedia.h"
 #include "version.h"
+#include "database/database-files.h"
 #if USE_SQLITE
 #include "database/database-sqlite3.h"
 #endif
@@ -92,7 +93,11 @@ static bool mayBeCompressed(ToClientCommand command)
 	case TOCLIENT_INVENTORY:
 	case TOCLIENT_ACTIVE_OBJECT_REMOVE_ADD:
 	case TOCLIENT_ACTIVE_OBJECT_MESSAGES:
+	case TOCLIENT_ACTIVE_OBJECT_STATES:
 	case TOCLIENT_ANNOUNCE_MEDIA:
+	case TOCLIENT_MEDIA:
+	case TOCLIENT_NODES_CHANGED:
+	case TOCLIENT_INVENTORY_DELTA:
 		return true;
 	default:
 		return false;
@@ -158,6 +163,8 @@ Client::Client(
 	m_media_downloader(new ClientMediaDownloader()),
 	m_state(LC_Created),
 	m_game_ui(game_ui),
+	m_mod_storage_database(new ModMetadataDatabaseFiles(
+		porting::path_user + DIR_DELIM + "client")),
 	m_modchannel_mgr(new ModChannelMgr())
 {
 	// Add local player
@@ -693,13 +700,15 @@ void Client::step(float dtime)
 	if (m_mod_storage_save_timer <= 0.0f) {
 		m_mod_storage_save_timer = g_settings->getFloat("server_map_save_interval");
 		int n = 0;
+		m_mod_storage_database->beginSave();
 		for (std::unordered_map<std::string, ModMetadata *>::const_iterator
 				it = m_mod_storages.begin(); it != m_mod_storages.end(); ++it) {
 			if (it->second->isModified()) {
-				it->second->save(getModStoragePath());
+				it->second->save(m_mod_storage_database.get());
 				n++;
 			}
 		}
+		m_mod_storage_database->endSave();
 		if (n > 0)
 			infostream << "Saved " << n << " modified mod storages." << std::endl;
 	}
@@ -2143,7 +2152,9 @@ void Client::unregisterModStorage(const std::string &name)
 		m_mod_storages.find(name);
 	if (it != m_mod_storages.end()) {
 		// Save unconditionaly on unregistration
-		it->second->save(getModStoragePath());
+		m_mod_storage_database->beginSave();
+		it->second->save(m_mod_storage_database.get());
+		m_mod_storage_database->endSave();
 		m_mod_storages.erase(name);
 	}
 }
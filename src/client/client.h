@@ -27,6 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <vector>
 #include <unordered_set>
 #include "clientobject.h"
+#include "activeobjectstate.h"
 #include "gamedef.h"
 #include "inventorymanager.h"
 #include "localplayer.h"
@@ -57,6 +58,7 @@ class ModChannelMgr;
 class MtEventManager;
 struct PointedThing;
 class MapDatabase;
+class ModMetadataDatabase;
 class Minimap;
 struct MinimapMapblock;
 class Camera;
@@ -175,6 +177,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void handleCommand_AccessDenied(NetworkPacket* pkt);
 	void handleCommand_RemoveNode(NetworkPacket* pkt);
 	void handleCommand_AddNode(NetworkPacket* pkt);
+	void handleCommand_NodesChanged(NetworkPacket* pkt);
 	void handleCommand_NodemetaChanged(NetworkPacket *pkt);
 	void handleCommand_BlockData(NetworkPacket* pkt);
 	void handleCommand_Inventory(NetworkPacket* pkt);
@@ -183,6 +186,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void handleCommand_ChatMessage(NetworkPacket *pkt);
 	void handleCommand_ActiveObjectRemoveAdd(NetworkPacket* pkt);
 	void handleCommand_ActiveObjectMessages(NetworkPacket* pkt);
+	void handleCommand_ActiveObjectStates(NetworkPacket* pkt);
 	void handleCommand_Movement(NetworkPacket* pkt);
 	void handleCommand_Fov(NetworkPacket *pkt);
 	void handleCommand_HP(NetworkPacket* pkt);
@@ -199,6 +203,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void handleCommand_Privileges(NetworkPacket* pkt);
 	void handleCommand_InventoryFormSpec(NetworkPacket* pkt);
 	void handleCommand_DetachedInventory(NetworkPacket* pkt);
+	void handleCommand_InventoryDelta(NetworkPacket* pkt);
 	void handleCommand_ShowFormSpec(NetworkPacket* pkt);
 	void handleCommand_SpawnParticle(NetworkPacket* pkt);
 	void handleCommand_AddParticleSpawner(NetworkPacket* pkt);
@@ -379,6 +384,8 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	const std::string* getModFile(std::string filename);
 
 	std::string getModStoragePath() const override;
+	ModMetadataDatabase *getModStorageDatabase() override
+	{ return m_mod_storage_database.get(); }
 	bool registerModStorage(ModMetadata *meta) override;
 	void unregisterModStorage(const std::string &name) override;
 
@@ -572,6 +579,9 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	// key = name
 	std::unordered_map<std::string, Inventory*> m_detached_inventories;
 
+	// Baselines of TOCLIENT_ACTIVE_OBJECT_STATES
+	std::unordered_map<u16, ObjectSyncState> m_object_states;
+
 	// Storage for mesh data for creating multiple instances of the same mesh
 	StringMap m_mesh_data;
 
@@ -588,6 +598,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	// Client modding
 	ClientScripting *m_script = nullptr;
 	std::unordered_map<std::string, ModMetadata *> m_mod_storages;
+	std::unique_ptr<ModMetadataDatabase> m_mod_storage_database;
 	float m_mod_storage_save_timer = 10.0f;
 	std::vector<ModSpec> m_mods;
 	StringMap m_mod_vfs;
@@ -153,6 +153,8 @@ void ClientEnvironment::step(float dtime)
 	/* Step time of day */
 	stepTimeOfDay(dtime);
 
+	m_map->getCollisionCache().step();
+
 	// Get some settings
 	bool fly_allowed = m_client->checkLocalPrivilege("fly");
 	bool free_move = fly_allowed && g_settings->getBool("free_move");
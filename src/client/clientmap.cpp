@@ -148,7 +148,7 @@ void ClientMap::getBlocksInViewRange(v3s16 cam_pos_nodes,
 
 void ClientMap::updateDrawList()
 {
-	ScopeProfiler sp(g_profiler, "CM::updateDrawList()", SPT_AVG);
+	PROFILE_ZONE("CM::updateDrawList()", SPT_AVG);
 
 	for (auto const &i : m_drawlist) {
 		MapBlock *block = i.block;
@@ -523,7 +523,7 @@ static bool getVisibleBrightness(Map *map, const v3f &p0, v3f dir, float step,
 int ClientMap::getBackgroundBrightness(float max_d, u32 daylight_factor,
 		int oldvalue, bool *sunlight_seen_result)
 {
-	ScopeProfiler sp(g_profiler, "CM::getBackgroundBrightness", SPT_AVG);
+	PROFILE_ZONE("CM::getBackgroundBrightness", SPT_AVG);
 	static v3f z_directions[50] = {
 		v3f(-100, 0, 0)
 	};
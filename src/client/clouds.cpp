@@ -114,7 +114,7 @@ void Clouds::render()
 	//if(SceneManager->getSceneNodeRenderPass() != scene::ESNRP_SOLID)
 		return;
 
-	ScopeProfiler sp(g_profiler, "Clouds::render()", SPT_AVG);
+	PROFILE_ZONE("Clouds::render()", SPT_AVG);
 
 	m_material.setFlag(video::EMF_BACK_FACE_CULLING, m_enable_3d);
 
@@ -285,7 +285,7 @@ void MeshUpdateThread::doUpdate()
 	while ((q = m_queue_in.pop())) {
 		if (m_generation_interval)
 			sleep_ms(m_generation_interval);
-		ScopeProfiler sp(g_profiler, "Client: Mesh making (sum)");
+		PROFILE_ZONE("Client: Mesh making (sum)", SPT_ADD);
 
 #if defined(__ANDROID__) || defined(__APPLE__)
 		MapBlockMesh *mesh_new;
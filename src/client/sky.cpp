@@ -168,7 +168,7 @@ void Sky::render()
 	if (!camera || !driver)
 		return;
 
-	ScopeProfiler sp(g_profiler, "Sky::render()", SPT_AVG);
+	PROFILE_ZONE("Sky::render()", SPT_AVG);
 
 	// Draw perspective skybox
 
@@ -17,6 +17,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <algorithm>
 #include <sstream>
 #include "clientiface.h"
 #include "network/mt_connection.h"
@@ -30,6 +31,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "server/luaentity_sao.h"
 #include "server/player_sao.h"
 #include "log.h"
+#include "threading/mutex_auto_lock.h"
 #include "util/srp.h"
 #include "face_position_cache.h"
 
@@ -53,7 +55,39 @@ std::string ClientInterface::state2Name(ClientState state)
 	return statenames[state];
 }
 
-RemoteClient::RemoteClient() :
+void BlockSubscribers::add(v3s16 blockpos, session_t peer_id)
+{
+	MutexAutoLock lock(m_mutex);
+	m_subscribers[blockpos].push_back(peer_id);
+}
+
+void BlockSubscribers::remove(v3s16 blockpos, session_t peer_id)
+{
+	MutexAutoLock lock(m_mutex);
+	auto it = m_subscribers.find(blockpos);
+	if (it == m_subscribers.end())
+		return;
+
+	std::vector<session_t> &peers = it->second;
+	auto peer = std::find(peers.begin(), peers.end(), peer_id);
+	if (peer != peers.end()) {
+		*peer = peers.back();
+		peers.pop_back();
+	}
+	if (peers.empty())
+		m_subscribers.erase(it);
+}
+
+void BlockSubscribers::get(v3s16 blockpos, std::vector<session_t> &result)
+{
+	MutexAutoLock lock(m_mutex);
+	auto it = m_subscribers.find(blockpos);
+	if (it != m_subscribers.end())
+		result.insert(result.end(), it->second.begin(), it->second.end());
+}
+
+RemoteClient::RemoteClient(BlockSubscribers *subscribers) :
+	m_subscribers(subscribers),
 	m_max_simul_sends(g_settings->getU16("max_simultaneous_block_sends_per_client")),
 	m_min_time_from_building(
 		g_settings->getFloat("full_block_send_enable_min_time_from_building")),
@@ -64,6 +98,16 @@ RemoteClient::RemoteClient() :
 {
 }
 
+RemoteClient::~RemoteClient()
+{
+	if (m_subscribers) {
+		for (v3s16 p : m_blocks_sent)
+			m_subscribers->remove(p, peer_id);
+		for (auto &it : m_blocks_sending)
+			m_subscribers->remove(it.first, peer_id);
+	}
+}
+
 void RemoteClient::ResendBlockIfOnWire(v3s16 p)
 {
 	// if this block is on wire, mark it for sending again as soon as possible
@@ -401,6 +445,7 @@ void RemoteClient::GotBlock(v3s16 p)
 		m_blocks_sending.erase(p);
 		// only add to sent blocks if it actually was sending
 		// (it might have been modified since)
+		// The client stays subscribed, that started with SentBlock
 		m_blocks_sent.insert(p);
 	} else {
 		m_excess_gotblocks++;
@@ -409,9 +454,13 @@ void RemoteClient::GotBlock(v3s16 p)
 
 void RemoteClient::SentBlock(v3s16 p)
 {
-	if (m_blocks_sending.find(p) == m_blocks_sending.end())
+	if (m_blocks_sending.find(p) == m_blocks_sending.end()) {
 		m_blocks_sending[p] = 0.0f;
-	else
+		// Changes made while the block is on the wire must reach the
+		// client too, see Server::sendNodeChange
+		if (m_blocks_sent.find(p) == m_blocks_sent.end() && m_subscribers)
+			m_subscribers->add(p, peer_id);
+	} else
 		infostream<<"RemoteClient::SentBlock(): Sent block"
 				" already in m_blocks_sending"<<std::endl;
 }
@@ -422,7 +471,7 @@ void RemoteClient::SetBlockNotSent(v3s16 p)
 
 	// remove the block from sending and sent sets,
 	// and mark as modified if found
-	if (m_blocks_sending.erase(p) + m_blocks_sent.erase(p) > 0)
+	if (eraseBlock(p))
 		m_blocks_modified.insert(p);
 }
 
@@ -434,11 +483,19 @@ void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
 		v3s16 p = block.first;
 		// remove the block from sending and sent sets,
 		// and mark as modified if found
-		if (m_blocks_sending.erase(p) + m_blocks_sent.erase(p) > 0)
+		if (eraseBlock(p))
 			m_blocks_modified.insert(p);
 	}
 }
 
+bool RemoteClient::eraseBlock(v3s16 p)
+{
+	bool erased = m_blocks_sending.erase(p) + m_blocks_sent.erase(p) > 0;
+	if (erased && m_subscribers)
+		m_subscribers->remove(p, peer_id);
+	return erased;
+}
+
 void RemoteClient::notifyEvent(ClientStateEvent event)
 {
 	std::ostringstream myerror;
@@ -831,7 +888,7 @@ void ClientInterface::CreateClient(session_t peer_id)
 	if (n != m_clients.end()) return;
 
 	// Create client
-	RemoteClient *client = new RemoteClient();
+	RemoteClient *client = new RemoteClient(&m_block_subscribers);
 	client->peer_id = peer_id;
 	m_clients[client->peer_id] = client;
 }
@@ -20,8 +20,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include "irr_v3d.h"                   // for irrlicht datatypes
+#include "activeobjectstate.h"
 
 #include "constants.h"
+#include "mapnode.h"
 #include "serialization.h"             // for SER_FMT_VER_INVALID
 #include "network/networkpacket.h"
 #include "network/networkprotocol.h"
@@ -221,6 +223,26 @@ struct PrioritySortedBlockTransfer
 	session_t peer_id;
 };
 
+/*
+	Which clients have which blocks, so that changes of a block only have
+	to be looked at for the clients that have it. Kept up to date by the
+	RemoteClients when blocks are sent and set not sent. Blocks that are
+	still on the wire count, a change to them has the block sent again.
+*/
+class BlockSubscribers
+{
+public:
+	void add(v3s16 blockpos, session_t peer_id);
+	void remove(v3s16 blockpos, session_t peer_id);
+
+	// Appends the clients that have the block to result
+	void get(v3s16 blockpos, std::vector<session_t> &result);
+
+private:
+	std::mutex m_mutex;
+	std::map<v3s16, std::vector<session_t>> m_subscribers;
+};
+
 class RemoteClient
 {
 public:
@@ -249,8 +271,8 @@ class RemoteClient
 	bool isMechAllowed(AuthMechanism mech)
 	{ return allowed_auth_mechs & mech; }
 
-	RemoteClient();
-	~RemoteClient() = default;
+	RemoteClient(BlockSubscribers *subscribers = nullptr);
+	~RemoteClient();
 
 	/*
 		Finds block that should be sent next to the client.
@@ -305,6 +327,14 @@ class RemoteClient
 		List of active objects that the client knows of.
 	*/
 	std::set<u16> m_known_objects;
+	// Position updates of known objects, see activeobjectstate.h
+	std::unordered_map<u16, ObjectSyncState> m_object_states;
+
+	/*
+		Node changes to send in one TOCLIENT_NODES_CHANGED at the end of
+		the step. Value: the node, whether its metadata is removed
+	*/
+	std::map<v3s16, std::pair<MapNode, bool>> m_node_changes;
 
 	ClientState getState() const { return m_state; }
 
@@ -363,6 +393,10 @@ class RemoteClient
 	const Address &getAddress() const { return m_addr; }
 
 private:
+	// Removes p from m_blocks_sending and m_blocks_sent, returns true if
+	// it was in either
+	bool eraseBlock(v3s16 p);
+
 	// Version is stored in here after INIT before INIT2
 	u8 m_pending_serialization_version = SER_FMT_VER_INVALID;
 
@@ -385,6 +419,7 @@ class RemoteClient
 		No MapBlock* is stored here because the blocks can get deleted.
 	*/
 	std::set<v3s16> m_blocks_sent;
+	BlockSubscribers *m_subscribers;
 	s16 m_nearest_unsent_d = 0;
 	v3s16 m_last_center;
 	v3f m_last_camera_dir;
@@ -473,6 +508,10 @@ class ClientInterface {
 	/* mark block as not sent to active client sessions */
 	void markBlockposAsNotSent(const v3s16 &pos);
 
+	/* get clients the block was sent to, appended to result */
+	void getBlockSubscribers(v3s16 blockpos, std::vector<session_t> &result)
+	{ m_block_subscribers.get(blockpos, result); }
+
 	/* verify is server user limit was reached */
 	bool isUserLimitReached();
 
@@ -542,6 +581,7 @@ class ClientInterface {
 	// Connected clients (behind the con mutex)
 	RemoteClientMap m_clients;
 	std::vector<std::string> m_clients_names; //for announcing masterserver
+	BlockSubscribers m_block_subscribers;
 
 	// Environment
 	ServerEnvironment *m_env;
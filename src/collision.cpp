@@ -29,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #endif
 #include "serverenvironment.h"
 #include "server/serveractiveobject.h"
+#include "util/directiontables.h"
 #include "util/timetaker.h"
 #include "profiler.h"
 
@@ -36,36 +37,6 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 //#warning "-ffast-math is known to cause bugs in collision code, do not use!"
 //#endif
 
-struct NearbyCollisionInfo {
-	// node
-	NearbyCollisionInfo(bool is_ul, int bouncy, const v3s16 &pos,
-			const aabb3f &box) :
-		is_unloaded(is_ul),
-		obj(nullptr),
-		bouncy(bouncy),
-		position(pos),
-		box(box)
-	{}
-
-	// object
-	NearbyCollisionInfo(ActiveObject *obj, int bouncy,
-			const aabb3f &box) :
-		is_unloaded(false),
-		obj(obj),
-		bouncy(bouncy),
-		box(box)
-	{}
-
-	inline bool isObject() const { return obj != nullptr; }
-
-	bool is_unloaded;
-	bool is_step_up = false;
-	ActiveObject *obj;
-	int bouncy;
-	v3s16 position;
-	aabb3f box;
-};
-
 // Helper functions:
 // Truncate floating point numbers to specified number of decimal places
 // in order to move all the floating point error to one side of the correct value
@@ -222,6 +193,189 @@ static inline void getNeighborConnectingFace(const v3s16 &p,
 		*neighbors |= v;
 }
 
+void CollisionBoxCache::step()
+{
+	MutexAutoLock lock(m_mutex);
+	m_step++;
+	for (auto it = m_blocks.begin(); it != m_blocks.end();) {
+		if (m_step - it->second->step > 1)
+			it = m_blocks.erase(it);
+		else
+			++it;
+	}
+}
+
+void CollisionBoxCache::invalidateNode(v3s16 p)
+{
+	MutexAutoLock lock(m_mutex);
+	m_generation++;
+	static const v3s16 dirs[7] = {
+		v3s16(0, 0, 0),
+		v3s16(0, 1, 0), v3s16(0, -1, 0),
+		v3s16(1, 0, 0), v3s16(-1, 0, 0),
+		v3s16(0, 0, 1), v3s16(0, 0, -1),
+	};
+
+	for (const v3s16 &dir : dirs) {
+		v3s16 p2 = p + dir;
+		v3s16 blockpos = getNodeBlockPos(p2);
+		auto it = m_blocks.find(blockpos);
+		if (it == m_blocks.end())
+			continue;
+
+		v3s16 rel = p2 - blockpos * MAP_BLOCKSIZE;
+		it->second->nodes[rel.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+				rel.Y * MAP_BLOCKSIZE + rel.X].state = NODE_UNRESOLVED;
+	}
+}
+
+void CollisionBoxCache::invalidateBlock(v3s16 blockpos)
+{
+	MutexAutoLock lock(m_mutex);
+	m_generation++;
+	// Connected node boxes at the edges of the neighbours depend on it
+	m_blocks.erase(blockpos);
+	for (const v3s16 &dir : g_6dirs)
+		m_blocks.erase(blockpos + dir);
+}
+
+void CollisionBoxCache::clear()
+{
+	MutexAutoLock lock(m_mutex);
+	m_generation++;
+	m_blocks.clear();
+}
+
+CollisionBoxCache::Block *CollisionBoxCache::getBlock(v3s16 blockpos)
+{
+	std::unique_ptr<Block> &block = m_blocks[blockpos];
+	if (!block) {
+		block.reset(new Block());
+		block->step = m_step;
+		return block.get();
+	}
+
+	if (block->step != m_step) {
+		for (CachedNode &node : block->nodes)
+			node.state = NODE_UNRESOLVED;
+		block->boxes.clear();
+		block->step = m_step;
+	}
+	return block.get();
+}
+
+void CollisionBoxCache::resolve(Map *map, v3s16 p, Block *block,
+		CachedNode &node)
+{
+	bool is_position_valid;
+	MapNode n = map->getNode(p, &is_position_valid);
+
+	if (!is_position_valid || n.getContent() == CONTENT_IGNORE) {
+		node.state = NODE_UNLOADED;
+		return;
+	}
+
+	const NodeDefManager *nodedef = map->getNodeDefManager();
+	const ContentFeatures &f = nodedef->get(n);
+	if (!f.walkable) {
+		node.state = NODE_EMPTY;
+		return;
+	}
+
+	int n_bouncy_value = itemgroup_get(f.groups, "bouncy");
+
+	int neighbors = 0;
+	if (f.drawtype == NDT_NODEBOX &&
+		f.node_box.type == NODEBOX_CONNECTED) {
+		v3s16 p2 = p;
+
+		p2.Y++;
+		getNeighborConnectingFace(p2, nodedef, map, n, 1, &neighbors);
+
+		p2 = p;
+		p2.Y--;
+		getNeighborConnectingFace(p2, nodedef, map, n, 2, &neighbors);
+
+		p2 = p;
+		p2.Z--;
+		getNeighborConnectingFace(p2, nodedef, map, n, 4, &neighbors);
+
+		p2 = p;
+		p2.X--;
+		getNeighborConnectingFace(p2, nodedef, map, n, 8, &neighbors);
+
+		p2 = p;
+		p2.Z++;
+		getNeighborConnectingFace(p2, nodedef, map, n, 16, &neighbors);
+
+		p2 = p;
+		p2.X++;
+		getNeighborConnectingFace(p2, nodedef, map, n, 32, &neighbors);
+	}
+	std::vector<aabb3f> nodeboxes;
+	n.getCollisionBoxes(nodedef, &nodeboxes, neighbors);
+
+	node.state = NODE_BOXES;
+	node.first_box = block->boxes.size();
+	node.box_count = nodeboxes.size();
+
+	// Calculate float position only once
+	v3f posf = intToFloat(p, BS);
+	for (auto box : nodeboxes) {
+		box.MinEdge += posf;
+		box.MaxEdge += posf;
+		block->boxes.push_back({box, n_bouncy_value});
+	}
+}
+
+bool CollisionBoxCache::collectBoxes(Map *map, v3s16 min, v3s16 max,
+		std::vector<NearbyCollisionInfo> &cinfo)
+{
+	MutexAutoLock lock(m_mutex);
+	bool any_position_valid = false;
+
+	Block *block = nullptr;
+	v3s16 blockpos;
+
+	v3s16 p;
+	for (p.X = min.X; p.X <= max.X; p.X++)
+	for (p.Y = min.Y; p.Y <= max.Y; p.Y++)
+	for (p.Z = min.Z; p.Z <= max.Z; p.Z++) {
+		v3s16 bp = getNodeBlockPos(p);
+		if (!block || bp != blockpos) {
+			block = getBlock(bp);
+			blockpos = bp;
+		}
+
+		v3s16 rel = p - blockpos * MAP_BLOCKSIZE;
+		CachedNode &node = block->nodes[rel.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+				rel.Y * MAP_BLOCKSIZE + rel.X];
+		if (node.state == NODE_UNRESOLVED)
+			resolve(map, p, block, node);
+
+		switch (node.state) {
+		case NODE_UNLOADED:
+			// Collide with unloaded nodes (position invalid) and loaded
+			// CONTENT_IGNORE nodes (position valid)
+			cinfo.emplace_back(true, 0, p, getNodeBox(p, BS));
+			break;
+		case NODE_BOXES:
+			for (u32 i = node.first_box; i < node.first_box + node.box_count; i++)
+				cinfo.emplace_back(false, block->boxes[i].bouncy, p,
+						block->boxes[i].box);
+			// fall through
+		case NODE_EMPTY:
+			// Object collides into walkable nodes
+			any_position_valid = true;
+			break;
+		default:
+			break;
+		}
+	}
+
+	return any_position_valid;
+}
+
 collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		f32 pos_max_d, const aabb3f &box_0,
 		f32 stepheight, f32 dtime,
@@ -229,10 +383,10 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		v3f accel_f, ActiveObject *self,
 		bool collideWithObjects)
 {
-	static bool time_notification_done = false;
+	static thread_local bool time_notification_done = false;
 	Map *map = &env->getMap();
 
-	ScopeProfiler sp(g_profiler, "collisionMoveSimple()", SPT_AVG);
+	PROFILE_ZONE("collisionMoveSimple()", SPT_AVG);
 
 	collisionMoveResult result;
 
@@ -268,7 +422,7 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 	std::vector<NearbyCollisionInfo> cinfo;
 	{
 	//TimeTaker tt2("collisionMoveSimple collect boxes");
-	ScopeProfiler sp2(g_profiler, "collisionMoveSimple(): collect boxes", SPT_AVG);
+	PROFILE_ZONE("collisionMoveSimple(): collect boxes", SPT_AVG);
 
 	v3f newpos_f = *pos_f + *speed_f * dtime;
 	v3f minpos_f(
@@ -284,72 +438,8 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 	v3s16 min = floatToInt(minpos_f + box_0.MinEdge, BS) - v3s16(1, 1, 1);
 	v3s16 max = floatToInt(maxpos_f + box_0.MaxEdge, BS) + v3s16(1, 1, 1);
 
-	bool any_position_valid = false;
-
-	v3s16 p;
-	for (p.X = min.X; p.X <= max.X; p.X++)
-	for (p.Y = min.Y; p.Y <= max.Y; p.Y++)
-	for (p.Z = min.Z; p.Z <= max.Z; p.Z++) {
-		bool is_position_valid;
-		MapNode n = map->getNode(p, &is_position_valid);
-
-		if (is_position_valid && n.getContent() != CONTENT_IGNORE) {
-			// Object collides into walkable nodes
-
-			any_position_valid = true;
-			const NodeDefManager *nodedef = gamedef->getNodeDefManager();
-			const ContentFeatures &f = nodedef->get(n);
-
-			if (!f.walkable)
-				continue;
-
-			int n_bouncy_value = itemgroup_get(f.groups, "bouncy");
-
-			int neighbors = 0;
-			if (f.drawtype == NDT_NODEBOX &&
-				f.node_box.type == NODEBOX_CONNECTED) {
-				v3s16 p2 = p;
-
-				p2.Y++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 1, &neighbors);
-
-				p2 = p;
-				p2.Y--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 2, &neighbors);
-
-				p2 = p;
-				p2.Z--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 4, &neighbors);
-
-				p2 = p;
-				p2.X--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 8, &neighbors);
-
-				p2 = p;
-				p2.Z++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 16, &neighbors);
-
-				p2 = p;
-				p2.X++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 32, &neighbors);
-			}
-			std::vector<aabb3f> nodeboxes;
-			n.getCollisionBoxes(gamedef->ndef(), &nodeboxes, neighbors);
-
-			// Calculate float position only once
-			v3f posf = intToFloat(p, BS);
-			for (auto box : nodeboxes) {
-				box.MinEdge += posf;
-				box.MaxEdge += posf;
-				cinfo.emplace_back(false, n_bouncy_value, p, box);
-			}
-		} else {
-			// Collide with unloaded nodes (position invalid) and loaded
-			// CONTENT_IGNORE nodes (position valid)
-			aabb3f box = getNodeBox(p, BS);
-			cinfo.emplace_back(true, 0, p, box);
-		}
-	}
+	bool any_position_valid = map->getCollisionCache().collectBoxes(
+			map, min, max, cinfo);
 
 	// Do not move if world has not loaded yet, since custom node boxes
 	// are not available for collision detection.
@@ -20,6 +20,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include "irrlichttypes_bloated.h"
+#include "constants.h"
+#include "threading/mutex_auto_lock.h"
+#include <atomic>
+#include <map>
+#include <memory>
 #include <vector>
 
 class Map;
@@ -54,6 +59,110 @@ struct CollisionInfo
 	int plane = -1;
 };
 
+struct NearbyCollisionInfo {
+	// node
+	NearbyCollisionInfo(bool is_ul, int bouncy, const v3s16 &pos,
+			const aabb3f &box) :
+		is_unloaded(is_ul),
+		obj(nullptr),
+		bouncy(bouncy),
+		position(pos),
+		box(box)
+	{}
+
+	// object
+	NearbyCollisionInfo(ActiveObject *obj, int bouncy,
+			const aabb3f &box) :
+		is_unloaded(false),
+		obj(obj),
+		bouncy(bouncy),
+		box(box)
+	{}
+
+	inline bool isObject() const { return obj != nullptr; }
+
+	bool is_unloaded;
+	bool is_step_up = false;
+	ActiveObject *obj;
+	int bouncy;
+	v3s16 position;
+	aabb3f box;
+};
+
+/*
+	Collision boxes of nodes, kept for the duration of an environment step
+	so that objects close to each other don't look up the same nodes again.
+
+	Nodes are resolved when they are first asked for; resolving whole blocks
+	up front would cost more than it saves for objects that are on their
+	own. The entries of a block are reset when it is first used in a step
+	and blocks that were not used in the previous step are dropped.
+
+	Objects may be moved on several threads at once, see
+	ServerActiveObject::stepMovement.
+*/
+class CollisionBoxCache
+{
+public:
+	// Starts a new step, called by the environment before moving objects
+	void step();
+
+	// Forget the boxes of a node (and of its neighbours, which may
+	// connect to it) or of a whole block
+	void invalidateNode(v3s16 p);
+	void invalidateBlock(v3s16 blockpos);
+	void clear();
+
+	// Changes whenever something is invalidated
+	u32 getGeneration() const { return m_generation; }
+
+	/*
+		Appends the boxes of the nodes in the area to cinfo, unloaded and
+		CONTENT_IGNORE nodes as unloaded full node boxes.
+		Returns false if none of the positions is loaded.
+	*/
+	bool collectBoxes(Map *map, v3s16 min, v3s16 max,
+			std::vector<NearbyCollisionInfo> &cinfo);
+
+private:
+	enum NodeState : u8
+	{
+		NODE_UNRESOLVED,
+		NODE_UNLOADED,
+		NODE_EMPTY,
+		NODE_BOXES,
+	};
+
+	struct CachedNode
+	{
+		u32 first_box;
+		u16 box_count;
+		NodeState state;
+	};
+
+	struct CachedBox
+	{
+		aabb3f box;
+		int bouncy;
+	};
+
+	struct Block
+	{
+		u32 step;
+		CachedNode nodes[MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE];
+		std::vector<CachedBox> boxes;
+	};
+
+	// Returns the entry of the block, reset if it is from an earlier step
+	Block *getBlock(v3s16 blockpos);
+	void resolve(Map *map, v3s16 p, Block *block, CachedNode &node);
+
+	std::mutex m_mutex;
+	std::map<v3s16, std::unique_ptr<Block>> m_blocks;
+	u32 m_step = 0;
+	std::atomic<u32> m_generation{0};
+};
+
 struct collisionMoveResult
 {
 	collisionMoveResult() = default;
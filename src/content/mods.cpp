@@ -28,7 +28,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "settings.h"
 #include "porting.h"
 #include "filesys.h"
-#include "convert_json.h"
+#include "database/database.h"
 
 bool ModSpec::isTrusted() const
 {
@@ -441,76 +441,55 @@ ModMetadata::ModMetadata(const std::string &mod_name) : m_mod_name(mod_name)
 void ModMetadata::clear()
 {
 	Metadata::clear();
+	m_modified_keys.clear();
+	m_cleared = true;
 	m_modified = true;
 }
 
-bool ModMetadata::save(const std::string &root_path)
+bool ModMetadata::save(ModMetadataDatabase *database)
 {
-	Json::Value json;
-	for (StringMap::const_iterator it = m_stringvars.begin();
-			it != m_stringvars.end(); ++it) {
-		json[it->first] = it->second;
-	}
+	bool ok = true;
 
-	if (!fs::PathExists(root_path)) {
-		if (!fs::CreateAllDirs(root_path)) {
-			errorstream << "ModMetadata[" << m_mod_name
-				    << "]: Unable to save. '" << root_path
-				    << "' tree cannot be created." << std::endl;
-			return false;
-		}
-	} else if (!fs::IsDir(root_path)) {
-		errorstream << "ModMetadata[" << m_mod_name << "]: Unable to save. '"
-			    << root_path << "' is not a directory." << std::endl;
-		return false;
-	}
+	if (m_cleared)
+		ok = database->removeModEntries(m_mod_name);
 
-	bool w_ok = fs::safeWriteToFile(
-			root_path + DIR_DELIM + m_mod_name, fastWriteJson(json));
+	// Only the keys touched since the last save are written
+	for (const std::string &key : m_modified_keys) {
+		const auto it = m_stringvars.find(key);
+		if (it != m_stringvars.end())
+			ok &= database->setModEntry(m_mod_name, key, it->second);
+		else
+			ok &= database->removeModEntry(m_mod_name, key);
+	}
 
-	if (w_ok) {
+	// A failed save has to start over with removing the old entries
+	if (ok) {
+		m_cleared = false;
+		m_modified_keys.clear();
 		m_modified = false;
 	} else {
-		errorstream << "ModMetadata[" << m_mod_name << "]: failed write file."
+		errorstream << "ModMetadata[" << m_mod_name << "]: failed to save."
 			    << std::endl;
 	}
-	return w_ok;
+	return ok;
 }
 
-bool ModMetadata::load(const std::string &root_path)
+bool ModMetadata::load(ModMetadataDatabase *database)
 {
 	m_stringvars.clear();
+	m_modified_keys.clear();
+	m_cleared = false;
+	m_modified = false;
 
-	std::ifstream is((root_path + DIR_DELIM + m_mod_name).c_str(),
-			std::ios_base::binary);
-	if (!is.good()) {
-		return false;
-	}
-
-	Json::Value root;
-	Json::CharReaderBuilder builder;
-	builder.settings_["collectComments"] = false;
-	std::string errs;
-
-	if (!Json::parseFromStream(builder, is, &root, &errs)) {
-		errorstream << "ModMetadata[" << m_mod_name
-			    << "]: failed read data "
-			       "(Json decoding failure). Message: "
-			    << errs << std::endl;
-		return false;
-	}
-
-	const Json::Value::Members attr_list = root.getMemberNames();
-	for (const auto &it : attr_list) {
-		Json::Value attr_value = root[it];
-		m_stringvars[it] = attr_value.asString();
-	}
-
-	return true;
+	return database->getModEntries(m_mod_name, &m_stringvars);
 }
 
 bool ModMetadata::setString(const std::string &name, const std::string &var)
 {
-	m_modified = Metadata::setString(name, var);
-	return m_modified;
+	if (!Metadata::setString(name, var))
+		return false;
+
+	m_modified_keys.insert(name);
+	m_modified = true;
+	return true;
 }
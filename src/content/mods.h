@@ -179,6 +179,8 @@ class ClientModConfiguration : public ModConfiguration
 };
 #endif
 
+class ModMetadataDatabase;
+
 class ModMetadata : public Metadata
 {
 public:
@@ -188,8 +190,8 @@ class ModMetadata : public Metadata
 
 	virtual void clear();
 
-	bool save(const std::string &root_path);
-	bool load(const std::string &root_path);
+	bool save(ModMetadataDatabase *database);
+	bool load(ModMetadataDatabase *database);
 
 	bool isModified() const { return m_modified; }
 	const std::string &getModName() const { return m_mod_name; }
@@ -198,5 +200,7 @@ class ModMetadata : public Metadata
 
 private:
 	std::string m_mod_name;
+	std::unordered_set<std::string> m_modified_keys;
+	bool m_cleared = false;
 	bool m_modified = false;
 };
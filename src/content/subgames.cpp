@@ -367,10 +367,12 @@ void loadGameConfAndInitWorld(const std::string &path, const std::string &name,
 		conf.set("backend", "sqlite3");
 		conf.set("player_backend", "sqlite3");
 		conf.set("auth_backend", "sqlite3");
+		conf.set("mod_storage_backend", "sqlite3");
 #else
 		conf.set("backend", "leveldb");
 		conf.set("player_backend", "leveldb");
 		conf.set("auth_backend", "leveldb");
+		conf.set("mod_storage_backend", "files");
 #endif
 		conf.setBool("creative_mode", g_settings->getBool("creative_mode"));
 		conf.setBool("enable_damage", g_settings->getBool("enable_damage"));
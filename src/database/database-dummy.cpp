@@ -80,3 +80,40 @@ void Database_Dummy::listPlayers(std::vector<std::string> &res)
 		res.emplace_back(player);
 	}
 }
+
+bool Database_Dummy::getModEntries(const std::string &modname, StringMap *storage)
+{
+	const auto mod_pair = m_mod_meta_database.find(modname);
+	if (mod_pair != m_mod_meta_database.cend()) {
+		for (const auto &pair : mod_pair->second)
+			(*storage)[pair.first] = pair.second;
+	}
+	return true;
+}
+
+bool Database_Dummy::setModEntry(const std::string &modname,
+	const std::string &key, const std::string &value)
+{
+	m_mod_meta_database[modname][key] = value;
+	return true;
+}
+
+bool Database_Dummy::removeModEntry(const std::string &modname, const std::string &key)
+{
+	auto mod_pair = m_mod_meta_database.find(modname);
+	if (mod_pair != m_mod_meta_database.end())
+		mod_pair->second.erase(key);
+	return true;
+}
+
+bool Database_Dummy::removeModEntries(const std::string &modname)
+{
+	m_mod_meta_database.erase(modname);
+	return true;
+}
+
+void Database_Dummy::listMods(std::vector<std::string> *res)
+{
+	for (const auto &pair : m_mod_meta_database)
+		res->push_back(pair.first);
+}
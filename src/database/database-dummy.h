@@ -21,10 +21,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <map>
 #include <string>
+#include <unordered_map>
 #include "database.h"
 #include "irrlichttypes.h"
 
-class Database_Dummy : public MapDatabase, public PlayerDatabase
+class Database_Dummy : public MapDatabase, public PlayerDatabase,
+	public ModMetadataDatabase
 {
 public:
 	bool saveBlock(const v3s16 &pos, const std::string &data);
@@ -37,10 +39,18 @@ class Database_Dummy : public MapDatabase, public PlayerDatabase
 	bool removePlayer(const std::string &name);
 	void listPlayers(std::vector<std::string> &res);
 
+	bool getModEntries(const std::string &modname, StringMap *storage);
+	bool setModEntry(const std::string &modname,
+		const std::string &key, const std::string &value);
+	bool removeModEntry(const std::string &modname, const std::string &key);
+	bool removeModEntries(const std::string &modname);
+	void listMods(std::vector<std::string> *res);
+
 	void beginSave() {}
 	void endSave() {}
 
 private:
 	std::map<s64, std::string> m_database;
 	std::set<std::string> m_player_database;
+	std::unordered_map<std::string, StringMap> m_mod_meta_database;
 };
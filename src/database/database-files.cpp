@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include <cassert>
+#include <fstream>
 #include <json/json.h>
 #include "convert_json.h"
 #include "database-files.h"
@@ -376,3 +377,160 @@ bool AuthDatabaseFiles::writeAuthFile()
 	}
 	return true;
 }
+
+ModMetadataDatabaseFiles::ModMetadataDatabaseFiles(const std::string &savedir):
+	m_storage_dir(savedir + DIR_DELIM + "mod_storage")
+{
+}
+
+bool ModMetadataDatabaseFiles::getModEntries(const std::string &modname, StringMap *storage)
+{
+	StringMap *meta = getModMetadata(modname);
+	if (!meta)
+		return false;
+
+	for (const auto &pair : *meta)
+		(*storage)[pair.first] = pair.second;
+	return true;
+}
+
+bool ModMetadataDatabaseFiles::setModEntry(const std::string &modname,
+	const std::string &key, const std::string &value)
+{
+	StringMap *meta = getModMetadata(modname);
+	if (!meta)
+		return false;
+
+	(*meta)[key] = value;
+	m_modified.insert(modname);
+	return true;
+}
+
+bool ModMetadataDatabaseFiles::removeModEntry(const std::string &modname,
+	const std::string &key)
+{
+	StringMap *meta = getModMetadata(modname);
+	if (!meta)
+		return false;
+
+	if (meta->erase(key) > 0)
+		m_modified.insert(modname);
+	return true;
+}
+
+bool ModMetadataDatabaseFiles::removeModEntries(const std::string &modname)
+{
+	StringMap *meta = getModMetadata(modname);
+	if (!meta)
+		return false;
+
+	if (!meta->empty()) {
+		meta->clear();
+		m_modified.insert(modname);
+	}
+	return true;
+}
+
+void ModMetadataDatabaseFiles::beginSave()
+{
+}
+
+void ModMetadataDatabaseFiles::endSave()
+{
+	if (m_modified.empty())
+		return;
+
+	if (!fs::CreateAllDirs(m_storage_dir)) {
+		errorstream << "ModMetadataDatabaseFiles: Unable to save. '"
+			<< m_storage_dir << "' cannot be created." << std::endl;
+		return;
+	}
+	if (!fs::IsDir(m_storage_dir)) {
+		errorstream << "ModMetadataDatabaseFiles: Unable to save. '"
+			<< m_storage_dir << "' is not a directory." << std::endl;
+		return;
+	}
+
+	for (auto it = m_modified.begin(); it != m_modified.end();) {
+		const std::string &modname = *it;
+
+		const auto found = m_mod_meta.find(modname);
+		if (found == m_mod_meta.end()) {
+			it = m_modified.erase(it);
+			continue;
+		}
+
+		std::string path = m_storage_dir + DIR_DELIM + modname;
+		if (found->second.empty()) {
+			if (fs::PathExists(path) && !fs::DeleteSingleFileOrEmptyDirectory(path)) {
+				errorstream << "ModMetadataDatabaseFiles[" << modname
+					<< "]: failed to remove file." << std::endl;
+				++it;
+				continue;
+			}
+			it = m_modified.erase(it);
+			continue;
+		}
+
+		Json::Value json(Json::objectValue);
+		for (const auto &pair : found->second)
+			json[pair.first] = pair.second;
+
+		if (!fs::safeWriteToFile(path, fastWriteJson(json))) {
+			errorstream << "ModMetadataDatabaseFiles[" << modname
+				<< "]: failed to write file." << std::endl;
+			++it;
+			continue;
+		}
+
+		it = m_modified.erase(it);
+	}
+}
+
+void ModMetadataDatabaseFiles::listMods(std::vector<std::string> *res)
+{
+	// List in-memory metadata first.
+	for (const auto &pair : m_mod_meta) {
+		if (!pair.second.empty())
+			res->push_back(pair.first);
+	}
+
+	// List other metadata present in the filesystem.
+	for (const auto &entry : fs::GetDirListing(m_storage_dir)) {
+		if (!entry.dir && m_mod_meta.count(entry.name) == 0)
+			res->push_back(entry.name);
+	}
+}
+
+StringMap *ModMetadataDatabaseFiles::getModMetadata(const std::string &modname)
+{
+	auto found = m_mod_meta.find(modname);
+	if (found != m_mod_meta.end())
+		return &found->second;
+
+	StringMap meta;
+
+	std::string path = m_storage_dir + DIR_DELIM + modname;
+	if (fs::PathExists(path)) {
+		std::ifstream is(path.c_str(), std::ios_base::binary);
+
+		Json::Value root;
+		Json::CharReaderBuilder builder;
+		builder.settings_["collectComments"] = false;
+		std::string errs;
+
+		if (!Json::parseFromStream(builder, is, &root, &errs)) {
+			errorstream << "ModMetadataDatabaseFiles[" << modname
+				<< "]: failed to decode data: " << errs << std::endl;
+			return nullptr;
+		}
+
+		const Json::Value::Members attr_list = root.getMemberNames();
+		for (const auto &it : attr_list) {
+			Json::Value attr_value = root[it];
+			meta[it] = attr_value.asString();
+		}
+	}
+
+	return &(m_mod_meta[modname] = std::move(meta));
+}
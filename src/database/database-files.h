@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "database.h"
 #include <unordered_map>
+#include <unordered_set>
 
 class PlayerDatabaseFiles : public PlayerDatabase
 {
@@ -69,3 +70,31 @@ class AuthDatabaseFiles : public AuthDatabase
 	bool readAuthFile();
 	bool writeAuthFile();
 };
+
+/*
+	One JSON file per mod in <world>/mod_storage. Mods are read lazily and
+	changed ones are rewritten as a whole in endSave().
+*/
+class ModMetadataDatabaseFiles : public ModMetadataDatabase
+{
+public:
+	ModMetadataDatabaseFiles(const std::string &savedir);
+	virtual ~ModMetadataDatabaseFiles() = default;
+
+	virtual bool getModEntries(const std::string &modname, StringMap *storage);
+	virtual bool setModEntry(const std::string &modname,
+		const std::string &key, const std::string &value);
+	virtual bool removeModEntry(const std::string &modname, const std::string &key);
+	virtual bool removeModEntries(const std::string &modname);
+	virtual void listMods(std::vector<std::string> *res);
+
+	virtual void beginSave();
+	virtual void endSave();
+
+private:
+	StringMap *getModMetadata(const std::string &modname);
+
+	std::string m_storage_dir;
+	std::unordered_map<std::string, StringMap> m_mod_meta;
+	std::unordered_set<std::string> m_modified;
+};
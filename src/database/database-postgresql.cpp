@@ -805,5 +805,138 @@ void AuthDatabasePostgreSQL::writePrivileges(const AuthEntry &authEntry)
 	}
 }
 
+ModMetadataDatabasePostgreSQL::ModMetadataDatabasePostgreSQL(const std::string &connect_string):
+	Database_PostgreSQL(connect_string),
+	ModMetadataDatabase()
+{
+	connectToDatabase();
+}
+
+void ModMetadataDatabasePostgreSQL::createDatabase()
+{
+	createTableIfNotExists("mod_storage",
+		"CREATE TABLE mod_storage ("
+			"modname TEXT NOT NULL,"
+			"key BYTEA NOT NULL,"
+			"value BYTEA NOT NULL,"
+			"PRIMARY KEY (modname, key)"
+		");");
+
+	infostream << "PostgreSQL: Mod Storage Database was initialized." << std::endl;
+}
+
+void ModMetadataDatabasePostgreSQL::initStatements()
+{
+	prepareStatement("get_entries",
+		"SELECT key, value FROM mod_storage WHERE modname = $1");
+
+	if (getPGVersion() < 90500) {
+		prepareStatement("set_entry_insert",
+			"INSERT INTO mod_storage (modname, key, value) SELECT "
+				"$1, $2, $3 "
+				"WHERE NOT EXISTS (SELECT true FROM mod_storage "
+				"WHERE modname = $1 AND key = $2)");
+
+		prepareStatement("set_entry_update",
+			"UPDATE mod_storage SET value = $3 WHERE modname = $1 AND key = $2");
+	} else {
+		prepareStatement("set_entry",
+			"INSERT INTO mod_storage (modname, key, value) VALUES ($1, $2, $3) "
+				"ON CONFLICT ON CONSTRAINT mod_storage_pkey DO "
+				"UPDATE SET value = $3");
+	}
+
+	prepareStatement("remove_entry",
+		"DELETE FROM mod_storage WHERE modname = $1 AND key = $2");
+
+	prepareStatement("remove_entries",
+		"DELETE FROM mod_storage WHERE modname = $1");
+
+	prepareStatement("list_mods",
+		"SELECT DISTINCT modname FROM mod_storage");
+}
+
+bool ModMetadataDatabasePostgreSQL::getModEntries(const std::string &modname,
+	StringMap *storage)
+{
+	verifyDatabase();
+
+	const void *args[] = { modname.c_str() };
+	const int argLen[] = { (int)modname.size() };
+	const int argFmt[] = { 0 };
+	PGresult *results = execPrepared("get_entries", ARRLEN(args), args,
+		argLen, argFmt, false);
+
+	int numrows = PQntuples(results);
+	for (int row = 0; row < numrows; row++) {
+		std::string key(PQgetvalue(results, row, 0), PQgetlength(results, row, 0));
+		(*storage)[key] =
+			std::string(PQgetvalue(results, row, 1), PQgetlength(results, row, 1));
+	}
+
+	PQclear(results);
+
+	return true;
+}
+
+bool ModMetadataDatabasePostgreSQL::setModEntry(const std::string &modname,
+	const std::string &key, const std::string &value)
+{
+	verifyDatabase();
+
+	const void *args[] = { modname.c_str(), key.c_str(), value.c_str() };
+	const int argLen[] = {
+		(int)modname.size(), (int)key.size(), (int)value.size()
+	};
+	const int argFmt[] = { 0, 1, 1 };
+
+	if (getPGVersion() < 90500) {
+		execPrepared("set_entry_update", ARRLEN(args), args, argLen, argFmt);
+		execPrepared("set_entry_insert", ARRLEN(args), args, argLen, argFmt);
+	} else {
+		execPrepared("set_entry", ARRLEN(args), args, argLen, argFmt);
+	}
+
+	return true;
+}
+
+bool ModMetadataDatabasePostgreSQL::removeModEntry(const std::string &modname,
+	const std::string &key)
+{
+	verifyDatabase();
+
+	const void *args[] = { modname.c_str(), key.c_str() };
+	const int argLen[] = { (int)modname.size(), (int)key.size() };
+	const int argFmt[] = { 0, 1 };
+	execPrepared("remove_entry", ARRLEN(args), args, argLen, argFmt);
+
+	return true;
+}
+
+bool ModMetadataDatabasePostgreSQL::removeModEntries(const std::string &modname)
+{
+	verifyDatabase();
+
+	const void *args[] = { modname.c_str() };
+	const int argLen[] = { (int)modname.size() };
+	const int argFmt[] = { 0 };
+	execPrepared("remove_entries", ARRLEN(args), args, argLen, argFmt);
+
+	return true;
+}
+
+void ModMetadataDatabasePostgreSQL::listMods(std::vector<std::string> *res)
+{
+	verifyDatabase();
+
+	PGresult *results = execPrepared("list_mods", 0,
+		NULL, NULL, NULL, false, false);
+
+	int numrows = PQntuples(results);
+	for (int row = 0; row < numrows; row++)
+		res->emplace_back(PQgetvalue(results, row, 0), PQgetlength(results, row, 0));
+
+	PQclear(results);
+}
 
 #endif // USE_POSTGRESQL
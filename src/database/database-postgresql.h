@@ -168,3 +168,24 @@ class AuthDatabasePostgreSQL : private Database_PostgreSQL, public AuthDatabase
 private:
 	virtual void writePrivileges(const AuthEntry &authEntry);
 };
+
+class ModMetadataDatabasePostgreSQL : private Database_PostgreSQL, public ModMetadataDatabase
+{
+public:
+	ModMetadataDatabasePostgreSQL(const std::string &connect_string);
+	virtual ~ModMetadataDatabasePostgreSQL() = default;
+
+	bool getModEntries(const std::string &modname, StringMap *storage);
+	bool setModEntry(const std::string &modname,
+		const std::string &key, const std::string &value);
+	bool removeModEntry(const std::string &modname, const std::string &key);
+	bool removeModEntries(const std::string &modname);
+	void listMods(std::vector<std::string> *res);
+
+	void beginSave() { Database_PostgreSQL::beginSave(); }
+	void endSave() { Database_PostgreSQL::endSave(); }
+
+protected:
+	virtual void createDatabase();
+	virtual void initStatements();
+};
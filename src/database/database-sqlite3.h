@@ -54,6 +54,11 @@ class Database_SQLite3 : public Database
 		sqlite3_vrfy(sqlite3_bind_text(s, iCol, str, strlen(str), NULL));
 	}
 
+	inline void blob_to_sqlite(sqlite3_stmt *s, int iCol, const std::string &str) const
+	{
+		sqlite3_vrfy(sqlite3_bind_blob(s, iCol, str.data(), str.size(), NULL));
+	}
+
 	inline void int_to_sqlite(sqlite3_stmt *s, int iCol, int val) const
 	{
 		sqlite3_vrfy(sqlite3_bind_int(s, iCol, val));
@@ -75,6 +80,13 @@ class Database_SQLite3 : public Database
 		return std::string(text ? text : "");
 	}
 
+	inline std::string sqlite_to_blob(sqlite3_stmt *s, int iCol)
+	{
+		const char *data = reinterpret_cast<const char *>(sqlite3_column_blob(s, iCol));
+		size_t len = sqlite3_column_bytes(s, iCol);
+		return data ? std::string(data, len) : std::string();
+	}
+
 	inline s32 sqlite_to_int(sqlite3_stmt *s, int iCol)
 	{
 		return sqlite3_column_int(s, iCol);
@@ -232,3 +244,31 @@ class AuthDatabaseSQLite3 : private Database_SQLite3, public AuthDatabase
 	sqlite3_stmt *m_stmt_delete_privs = nullptr;
 	sqlite3_stmt *m_stmt_last_insert_rowid = nullptr;
 };
+
+class ModMetadataDatabaseSQLite3 : private Database_SQLite3, public ModMetadataDatabase
+{
+public:
+	ModMetadataDatabaseSQLite3(const std::string &savedir);
+	virtual ~ModMetadataDatabaseSQLite3();
+
+	virtual bool getModEntries(const std::string &modname, StringMap *storage);
+	virtual bool setModEntry(const std::string &modname,
+		const std::string &key, const std::string &value);
+	virtual bool removeModEntry(const std::string &modname, const std::string &key);
+	virtual bool removeModEntries(const std::string &modname);
+	virtual void listMods(std::vector<std::string> *res);
+
+	virtual void beginSave() { Database_SQLite3::beginSave(); }
+	virtual void endSave() { Database_SQLite3::endSave(); }
+
+protected:
+	virtual void createDatabase();
+	virtual void initStatements();
+
+private:
+	sqlite3_stmt *m_stmt_get = nullptr;
+	sqlite3_stmt *m_stmt_set = nullptr;
+	sqlite3_stmt *m_stmt_remove = nullptr;
+	sqlite3_stmt *m_stmt_remove_all = nullptr;
+	sqlite3_stmt *m_stmt_list_mods = nullptr;
+};
@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irr_v3d.h"
 #include "irrlichttypes.h"
 #include "util/basic_macros.h"
+#include "util/string.h"
 
 class Database
 {
@@ -86,3 +87,20 @@ class AuthDatabase
 	virtual void listNames(std::vector<std::string> &res) = 0;
 	virtual void reload() = 0;
 };
+
+/*
+	Key-value storage of the mods (minetest.get_mod_storage()).
+	Writes may be batched between beginSave() and endSave().
+*/
+class ModMetadataDatabase : public Database
+{
+public:
+	virtual ~ModMetadataDatabase() = default;
+
+	virtual bool getModEntries(const std::string &modname, StringMap *storage) = 0;
+	virtual bool setModEntry(const std::string &modname,
+		const std::string &key, const std::string &value) = 0;
+	virtual bool removeModEntry(const std::string &modname, const std::string &key) = 0;
+	virtual bool removeModEntries(const std::string &modname) = 0;
+	virtual void listMods(std::vector<std::string> *res) = 0;
+};
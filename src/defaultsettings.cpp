@@ -383,6 +383,7 @@ void set_default_settings()
 	settings->setDefault("enable_ipv6", "true");
 	settings->setDefault("ipv6_server", "false");
 	settings->setDefault("max_packets_per_iteration","1024");
+	settings->setDefault("congestion_control", "classic");
 	settings->setDefault("port", "40000");
 	settings->setDefault("strict_protocol_version_checking", "false");
 	settings->setDefault("player_transfer_distance", "0");
@@ -409,6 +410,9 @@ void set_default_settings()
 
 	settings->setDefault("chat_message_format", "@name: @message");
 	settings->setDefault("profiler_print_interval", "0");
+	settings->setDefault("profiler_trace_file", "");
+	settings->setDefault("mod_accounting", "true");
+	settings->setDefault("mod_accounting_log_interval", "0");
 	settings->setDefault("active_object_send_range_blocks", "8");
 	settings->setDefault("active_block_range", "4");
 	//settings->setDefault("max_simultaneous_block_sends_per_client", "1");
@@ -438,6 +442,8 @@ void set_default_settings()
 	settings->setDefault("nodetimer_interval", "0.2");
 	settings->setDefault("ignore_world_load_errors", "false");
 	settings->setDefault("remote_media", "");
+	settings->setDefault("media_cache_size", "128");
+	settings->setDefault("media_server_port", "0");
 	settings->setDefault("debug_log_level", "warning");
 	settings->setDefault("debug_log_size_max", "50");
 	settings->setDefault("chat_log_level", "error");
@@ -445,6 +451,9 @@ void set_default_settings()
 	settings->setDefault("emergequeue_limit_diskonly", "128");
 	settings->setDefault("emergequeue_limit_generate", "128");
 	settings->setDefault("num_emerge_threads", "1");
+	settings->setDefault("num_async_threads", "0");
+	settings->setDefault("num_pathfinder_threads", "1");
+	settings->setDefault("num_physics_threads", "1");
 	settings->setDefault("log_mod_memory_usage_on_load", "false");
 	settings->setDefault("secure.enable_security", "true");
 	settings->setDefault("secure.trusted_mods", "");
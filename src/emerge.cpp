@@ -40,6 +40,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapgen/mg_schematic.h"
 #include "nodedef.h"
 #include "profiler.h"
+#include "scripting_emerge.h"
 #include "scripting_server.h"
 #include "server.h"
 #include "settings.h"
@@ -71,6 +72,9 @@ class EmergeThread : public Thread {
 	EmergeManager *m_emerge;
 	Mapgen *m_mapgen;
 
+	// Lua state for mods' mapgen scripts, only created if there are any
+	std::unique_ptr<EmergeScripting> m_script;
+
 	Event m_queue_event;
 	std::queue<v3s16> m_block_queue;
 
@@ -602,8 +606,7 @@ MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 	std::map<v3s16, MapBlock *> *modified_blocks)
 {
 	MutexAutoLock envlock(m_server->m_env_mutex);
-	ScopeProfiler sp(g_profiler,
-		"EmergeThread: after Mapgen::makeChunk", SPT_AVG);
+	PROFILE_ZONE("EmergeThread: after Mapgen::makeChunk", SPT_AVG);
 
 	/*
 		Perform post-processing on blocks (invalidate lighting, queue liquid
@@ -665,6 +668,18 @@ void *EmergeThread::run()
 	m_mapgen = m_emerge->m_mapgens[id];
 	enable_mapgen_debug_info = m_emerge->enable_mapgen_debug_info;
 
+	if (!m_server->m_mapgen_init_files.empty()) {
+		try {
+			m_script.reset(new EmergeScripting(m_server));
+			m_script->loadMapgenScripts();
+		} catch (const ModError &e) {
+			m_script.reset();
+			m_server->setAsyncFatalError(
+				"Failed to load mapgen scripts: " + std::string(e.what()));
+			return NULL;
+		}
+	}
+
 	try {
 	while (!stopRequested()) {
 		std::map<v3s16, MapBlock *> modified_blocks;
@@ -690,12 +705,26 @@ void *EmergeThread::run()
 		action = getBlockOrStartGen(pos, allow_gen, &block, &bmdata);
 		if (action == EMERGE_GENERATED) {
 			{
-				ScopeProfiler sp(g_profiler,
-					"EmergeThread: Mapgen::makeChunk", SPT_AVG);
+				PROFILE_ZONE("EmergeThread: Mapgen::makeChunk", SPT_AVG);
 
 				m_mapgen->makeChunk(&bmdata);
 			}
 
+			/*
+				Run the mapgen environment's on_generated callbacks,
+				this thread owns the chunk until finishGen
+			*/
+			if (m_script) {
+				PROFILE_ZONE("EmergeThread: Lua on_generated", SPT_AVG);
+
+				try {
+					m_script->on_generated(&bmdata, m_mapgen->blockseed);
+				} catch (const LuaError &e) {
+					m_server->setAsyncFatalError(
+						"Lua: mapgen on_generated: " + std::string(e.what()));
+				}
+			}
+
 			block = finishGen(pos, &bmdata, &modified_blocks);
 		}
 
@@ -734,6 +763,8 @@ void *EmergeThread::run()
 		m_server->setAsyncFatalError(err.str());
 	}
 
+	m_script.reset();
+
 	END_DEBUG_EXCEPTION_HANDLER
 	return NULL;
 }
@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "server.h"
 #include "daynightratio.h"
 #include "emerge.h"
+#include "mapblock.h"
 
 
 Environment::Environment(IGameDef *gamedef):
@@ -83,12 +84,47 @@ float Environment::getTimeOfDayF()
 	return m_time_of_day_f;
 }
 
+/*
+	If the current node of the iterator and the nodes within range around it
+	all lie in a block with the given emptiness flag, moves the iterator to
+	the last node before the line leaves that region and returns true.
+	Missing blocks read as ignore, which is never pointable.
+*/
+static bool skip_empty_block(Map &map, voxalgo::VoxelLineIterator &iterator,
+	const core::aabbox3d<s16> &range, u8 emptiness)
+{
+	const v3s16 blockpos = getNodeBlockPos(iterator.m_current_node_pos);
+	MapBlock *block = map.getBlockNoCreateNoEx(blockpos);
+	u8 block_emptiness = block ? block->getEmptiness() :
+		BLOCK_EMPTY_POINTABLE | BLOCK_EMPTY_LIQUIDS_POINTABLE;
+	if (!(block_emptiness & emptiness))
+		return false;
+
+	const v3s16 block_min = blockpos * MAP_BLOCKSIZE;
+	core::aabbox3d<s16> region(block_min - range.MinEdge,
+		block_min + (MAP_BLOCKSIZE - 1) - range.MaxEdge);
+	if (!region.isPointInside(iterator.m_current_node_pos))
+		return false;
+
+	iterator.skipInside(region);
+	return true;
+}
+
 bool Environment::line_of_sight(v3f pos1, v3f pos2, v3s16 *p)
 {
+	Map &map = getMap();
+	const core::aabbox3d<s16> no_range(0, 0, 0, 0, 0, 0);
+
 	// Iterate trough nodes on the line
 	voxalgo::VoxelLineIterator iterator(pos1 / BS, (pos2 - pos1) / BS);
 	do {
-		MapNode n = getMap().getNode(iterator.m_current_node_pos);
+		// Step over blocks that are all air
+		if (skip_empty_block(map, iterator, no_range, BLOCK_EMPTY_AIR)) {
+			iterator.next();
+			continue;
+		}
+
+		MapNode n = map.getNode(iterator.m_current_node_pos);
 
 		// Return non-air
 		if (n.param0 != CONTENT_AIR) {
@@ -141,12 +177,23 @@ void Environment::continueRaycast(RaycastState *state, PointedThing *result)
 	}
 
 	Map &map = getMap();
+	const u8 emptiness = state->m_liquids_pointable ?
+		BLOCK_EMPTY_LIQUIDS_POINTABLE : BLOCK_EMPTY_POINTABLE;
 	// If a node is found, this is the center of the
 	// first nodebox the shootline meets.
 	v3f found_boxcenter(0, 0, 0);
 	// The untested nodes are in this range.
 	core::aabbox3d<s16> new_nodes;
 	while (state->m_iterator.m_current_index <= lastIndex) {
+		// Nothing around the nodes inside a block without pointable
+		// nodes can be found, only the nodes after it need testing
+		if (skip_empty_block(map, state->m_iterator,
+				state->m_search_range, emptiness)) {
+			state->m_previous_node = state->m_iterator.m_current_node_pos;
+			state->m_iterator.next();
+			continue;
+		}
+
 		// Test the nodes around the current node in search_range.
 		new_nodes = state->m_search_range;
 		new_nodes.MinEdge += state->m_iterator.m_current_node_pos;
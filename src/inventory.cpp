@@ -88,8 +88,8 @@ void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
 {
 	clear();
 
-	// Read name
-	name = deSerializeJsonStringIfNeeded(is);
+	// Read name, interned at the end
+	std::string name = deSerializeJsonStringIfNeeded(is);
 
 	// Skip space
 	std::string tmp;
@@ -231,9 +231,10 @@ void ItemStack::deSerialize(std::istream &is, IItemDefManager *itemdef)
 		} while(false);
 	}
 
-	if (name.empty() || count == 0)
+	this->name = name;
+	if (this->name.empty() || count == 0)
 		clear();
-	else if (itemdef && itemdef->get(name).type == ITEM_TOOL)
+	else if (itemdef && itemdef->get(this->name).type == ITEM_TOOL)
 		count = 1;
 }
 
@@ -255,7 +256,7 @@ std::string ItemStack::getDescription(IItemDefManager *itemdef) const
 	std::string desc = metadata.getString("description");
 	if (desc.empty())
 		desc = getDefinition(itemdef).description;
-	return desc.empty() ? name : desc;
+	return desc.empty() ? name.str() : desc;
 }
 
 std::string ItemStack::getShortDescription(IItemDefManager *itemdef) const
@@ -380,6 +381,105 @@ ItemStack ItemStack::peekItem(u32 peekcount) const
 	return result;
 }
 
+/*
+	InventoryNameTable
+*/
+
+u16 InventoryNameTable::add(const ItemName &name)
+{
+	if (name.empty())
+		return 0;
+
+	auto it = m_indices.find(name.getId());
+	if (it != m_indices.end())
+		return it->second;
+
+	if (names.size() >= U16_MAX)
+		throw SerializationError("InventoryNameTable: too many item names");
+
+	names.push_back(name);
+	u16 index = names.size();
+	m_indices.emplace(name.getId(), index);
+	return index;
+}
+
+void InventoryNameTable::serialize(std::ostream &os) const
+{
+	writeU16(os, names.size());
+	for (const ItemName &name : names)
+		os << serializeString16(name);
+}
+
+void InventoryNameTable::deSerialize(std::istream &is)
+{
+	u16 count = readU16(is);
+	names.clear();
+	names.reserve(count);
+	for (u16 i = 0; i < count; i++)
+		names.emplace_back(deSerializeString16(is));
+}
+
+/*
+	Binary inventory slots, see TOCLIENT_INVENTORY_DELTA
+*/
+
+#define BINARY_SLOT_WEAR 0x01
+#define BINARY_SLOT_METADATA 0x02
+
+#define BINARY_LIST_KEEP 0
+#define BINARY_LIST_FULL 1
+#define BINARY_LIST_SLOTS 2
+
+static void serialize_slot(std::ostream &os, const ItemStack &item,
+		InventoryNameTable &names)
+{
+	if (item.empty()) {
+		writeU16(os, 0);
+		return;
+	}
+
+	writeU16(os, names.add(item.name));
+	writeU16(os, item.count);
+
+	u8 flags = 0;
+	if (item.wear != 0)
+		flags |= BINARY_SLOT_WEAR;
+	if (!item.metadata.empty())
+		flags |= BINARY_SLOT_METADATA;
+	writeU8(os, flags);
+
+	if (flags & BINARY_SLOT_WEAR)
+		writeU16(os, item.wear);
+	if (flags & BINARY_SLOT_METADATA) {
+		std::ostringstream meta_os(std::ios::binary);
+		item.metadata.serialize(meta_os);
+		os << serializeString32(meta_os.str());
+	}
+}
+
+static void deserialize_slot(std::istream &is, ItemStack &item,
+		const InventoryNameTable &names)
+{
+	item.clear();
+
+	u16 index = readU16(is);
+	if (index == 0)
+		return;
+	if (index > names.names.size())
+		throw SerializationError("deserialize_slot: invalid item name index");
+
+	item.name = names.names[index - 1];
+	item.count = readU16(is);
+
+	u8 flags = readU8(is);
+	if (flags & BINARY_SLOT_WEAR)
+		item.wear = readU16(is);
+	if (flags & BINARY_SLOT_METADATA) {
+		std::istringstream meta_is(deSerializeString32(is), std::ios::binary);
+		item.metadata.deSerialize(meta_is);
+	}
+}
+
 /*
 	Inventory
 */
@@ -504,6 +604,86 @@ void InventoryList::deSerialize(std::istream &is)
 	throw SerializationError(ss.str());
 }
 
+void InventoryList::serializeBinary(std::ostream &os, bool incremental,
+		InventoryNameTable &names) const
+{
+	os << serializeString16(m_name);
+
+	if (incremental && !m_dirty) {
+		writeU8(os, BINARY_LIST_KEEP);
+		return;
+	}
+
+	// A delta of most slots is not smaller than the whole list
+	if (incremental && !m_all_modified &&
+			m_modified_slots.size() * 2 < m_items.size()) {
+		writeU8(os, BINARY_LIST_SLOTS);
+		writeU32(os, m_modified_slots.size());
+		for (u32 i : m_modified_slots) {
+			writeU32(os, i);
+			serialize_slot(os, m_items[i], names);
+		}
+		return;
+	}
+
+	writeU8(os, BINARY_LIST_FULL);
+	writeU32(os, m_items.size());
+	writeU32(os, m_width);
+	for (const ItemStack &item : m_items)
+		serialize_slot(os, item, names);
+}
+
+void InventoryList::deSerializeBinary(std::istream &is,
+		const InventoryNameTable &names)
+{
+	ItemStack item;
+	u8 mode = readU8(is);
+	switch (mode) {
+	case BINARY_LIST_KEEP:
+		break;
+	case BINARY_LIST_FULL: {
+		setSize(readU32(is));
+		m_width = readU32(is);
+		for (ItemStack &slot : m_items)
+			deserialize_slot(is, slot, names);
+		setModified();
+		break;
+	}
+	case BINARY_LIST_SLOTS: {
+		u32 count = readU32(is);
+		for (u32 n = 0; n < count; n++) {
+			u32 i = readU32(is);
+			if (i >= m_items.size())
+				throw SerializationError("InventoryList::deSerializeBinary(): "
+						"slot out of range");
+			deserialize_slot(is, item, names);
+			changeItem(i, item);
+		}
+		break;
+	}
+	default:
+		throw SerializationError("InventoryList::deSerializeBinary(): "
+				"unknown list mode");
+	}
+}
+
+// Reads past a list that has no receiver, only kept and changed lists
+static void skip_list_binary(std::istream &is, const InventoryNameTable &names)
+{
+	ItemStack item;
+	u8 mode = readU8(is);
+	if (mode == BINARY_LIST_KEEP)
+		return;
+	if (mode != BINARY_LIST_SLOTS)
+		throw SerializationError("skip_list_binary: unexpected list mode");
+
+	u32 count = readU32(is);
+	for (u32 n = 0; n < count; n++) {
+		readU32(is);
+		deserialize_slot(is, item, names);
+	}
+}
+
 InventoryList::InventoryList(const InventoryList &other)
 {
 	*this = other;
@@ -516,7 +696,7 @@ InventoryList & InventoryList::operator = (const InventoryList &other)
 	m_width = other.m_width;
 	m_name = other.m_name;
 	m_itemdef = other.m_itemdef;
-	//setDirty(true);
+	setModified();
 
 	return *this;
 }
@@ -585,7 +765,7 @@ ItemStack InventoryList::changeItem(u32 i, const ItemStack &newitem)
 
 	ItemStack olditem = m_items[i];
 	m_items[i] = newitem;
-	setModified();
+	setSlotModified(i);
 	return olditem;
 }
 
@@ -593,7 +773,7 @@ void InventoryList::deleteItem(u32 i)
 {
 	assert(i < m_items.size()); // Pre-condition
 	m_items[i].clear();
-	setModified();
+	setSlotModified(i);
 }
 
 ItemStack InventoryList::addItem(const ItemStack &newitem_)
@@ -642,7 +822,7 @@ ItemStack InventoryList::addItem(u32 i, const ItemStack &newitem)
 
 	ItemStack leftover = m_items[i].addItem(newitem, m_itemdef);
 	if (leftover != newitem)
-		setModified();
+		setSlotModified(i);
 	return leftover;
 }
 
@@ -694,11 +874,13 @@ bool InventoryList::containsItem(const ItemStack &item, bool match_meta) const
 ItemStack InventoryList::removeItem(const ItemStack &item)
 {
 	ItemStack removed;
-	for (auto i = m_items.rbegin(); i != m_items.rend(); ++i) {
-		if (i->name == item.name) {
+	for (u32 i = m_items.size(); i-- > 0;) {
+		if (m_items[i].name == item.name) {
 			u32 still_to_remove = item.count - removed.count;
-			ItemStack leftover = removed.addItem(i->takeItem(still_to_remove),
-					m_itemdef);
+			ItemStack taken = m_items[i].takeItem(still_to_remove);
+			if (!taken.empty())
+				setSlotModified(i);
+			ItemStack leftover = removed.addItem(taken, m_itemdef);
 			// Allow oversized stacks
 			removed.count += leftover.count;
 
@@ -706,8 +888,6 @@ ItemStack InventoryList::removeItem(const ItemStack &item)
 				break;
 		}
 	}
-	if (!removed.empty())
-		setModified();
 	return removed;
 }
 
@@ -718,10 +898,34 @@ ItemStack InventoryList::takeItem(u32 i, u32 takecount)
 
 	ItemStack taken = m_items[i].takeItem(takecount);
 	if (!taken.empty())
-		setModified();
+		setSlotModified(i);
 	return taken;
 }
 
+void InventoryList::setModified(bool dirty)
+{
+	m_dirty = dirty;
+	m_all_modified = dirty;
+
+	if (m_slot_modified.size() != m_items.size()) {
+		m_slot_modified.assign(m_items.size(), false);
+	} else {
+		for (u32 i : m_modified_slots)
+			m_slot_modified[i] = false;
+	}
+	m_modified_slots.clear();
+}
+
+void InventoryList::setSlotModified(u32 i)
+{
+	m_dirty = true;
+	if (m_all_modified || m_slot_modified[i])
+		return;
+
+	m_slot_modified[i] = true;
+	m_modified_slots.push_back(i);
+}
+
 void InventoryList::moveItemSomewhere(u32 i, InventoryList *dest, u32 count)
 {
 	// Take item from source list
@@ -935,6 +1139,65 @@ void Inventory::deSerialize(std::istream &is)
 	throw SerializationError(ss.str());
 }
 
+void Inventory::serializeBinary(std::ostream &os, bool incremental) const
+{
+	// Names are known once all slots are written
+	InventoryNameTable names;
+	std::ostringstream lists_os(std::ios::binary);
+	writeU16(lists_os, m_lists.size());
+	for (const InventoryList *list : m_lists)
+		list->serializeBinary(lists_os, incremental, names);
+
+	writeU8(os, 0); // Version
+	names.serialize(os);
+	os << lists_os.str();
+}
+
+void Inventory::deSerializeBinary(std::istream &is)
+{
+	u8 version = readU8(is);
+	if (version != 0)
+		throw SerializationError("Inventory::deSerializeBinary(): "
+				"unsupported version");
+
+	InventoryNameTable names;
+	names.deSerialize(is);
+
+	u16 count = readU16(is);
+	std::vector<InventoryList *> new_lists;
+	new_lists.reserve(count);
+	for (u16 i = 0; i < count; i++) {
+		std::string listname = deSerializeString16(is);
+		InventoryList *list = getList(listname);
+		if (!list && is.peek() != BINARY_LIST_FULL) {
+			// The changes are based on a state this inventory never got,
+			// the next full update brings the list
+			errorstream << "Inventory::deSerializeBinary(): Got changes to list '"
+				<< listname << "' which is non-existent." << std::endl;
+			skip_list_binary(is, names);
+			continue;
+		}
+		if (!list) {
+			list = new InventoryList(listname, 0, m_itemdef);
+			m_lists.push_back(list);
+		}
+		list->deSerializeBinary(is, names);
+		new_lists.push_back(list);
+	}
+
+	// Remove all lists that were not sent
+	for (auto &list : m_lists) {
+		if (std::find(new_lists.begin(), new_lists.end(), list) != new_lists.end())
+			continue;
+
+		delete list;
+		list = nullptr;
+		setModified();
+	}
+	m_lists.erase(std::remove(m_lists.begin(), m_lists.end(),
+			nullptr), m_lists.end());
+}
+
 InventoryList * Inventory::addList(const std::string &name, u32 size)
 {
 	setModified();
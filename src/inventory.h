@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <istream>
 #include <ostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <cassert>
 
@@ -62,7 +63,7 @@ struct ItemStack
 
 	void clear()
 	{
-		name = "";
+		name = ItemName();
 		count = 0;
 		wear = 0;
 		metadata.clear();
@@ -119,7 +120,7 @@ struct ItemStack
 
 		if (item_cap == NULL)
 			// Fall back to the hand's tool capabilities
-			item_cap = itemdef->get("").tool_capabilities;
+			item_cap = itemdef->get(ItemName()).tool_capabilities;
 
 		assert(item_cap != NULL);
 		return metadata.getToolCapabilities(*item_cap); // Check for override
@@ -180,12 +181,32 @@ struct ItemStack
 	/*
 		Properties
 	*/
-	std::string name = "";
+	ItemName name;
 	u16 count = 0;
 	u16 wear = 0;
 	ItemStackMetadata metadata;
 };
 
+/*
+	Item names of a binary serialized inventory.
+	Slots refer to them by index, 0 is the empty item.
+*/
+struct InventoryNameTable
+{
+	// Returns the index of the name, adding it if needed
+	u16 add(const ItemName &name);
+
+	void serialize(std::ostream &os) const;
+	void deSerialize(std::istream &is);
+
+	// Starts at index 1
+	std::vector<ItemName> names;
+
+private:
+	// Index by ItemName::getId()
+	std::unordered_map<u32, u16> m_indices;
+};
+
 class InventoryList
 {
 public:
@@ -197,6 +218,10 @@ class InventoryList
 	void setName(const std::string &name);
 	void serialize(std::ostream &os, bool incremental) const;
 	void deSerialize(std::istream &is);
+	// Network format, only sends the changed slots when incremental
+	void serializeBinary(std::ostream &os, bool incremental,
+			InventoryNameTable &names) const;
+	void deSerializeBinary(std::istream &is, const InventoryNameTable &names);
 
 	InventoryList(const InventoryList &other);
 	InventoryList & operator = (const InventoryList &other);
@@ -267,15 +292,23 @@ class InventoryList
 	void moveItemSomewhere(u32 i, InventoryList *dest, u32 count);
 
 	inline bool checkModified() const { return m_dirty; }
-	inline void setModified(bool dirty = true) { m_dirty = dirty; }
+	// true marks the whole list as changed, false marks everything as sent
+	void setModified(bool dirty = true);
 
 private:
+	void setSlotModified(u32 i);
+
 	std::vector<ItemStack> m_items;
 	std::string m_name;
 	u32 m_size;
 	u32 m_width = 0;
 	IItemDefManager *m_itemdef;
 	bool m_dirty = true;
+
+	// Per-slot tracking, not used while m_all_modified is set
+	bool m_all_modified = true;
+	std::vector<u32> m_modified_slots;
+	std::vector<bool> m_slot_modified;
 };
 
 class Inventory
@@ -297,6 +330,9 @@ class Inventory
 	// Never ever serialize to disk using "incremental"!
 	void serialize(std::ostream &os, bool incremental = false) const;
 	void deSerialize(std::istream &is);
+	// Network format of TOCLIENT_INVENTORY_DELTA
+	void serializeBinary(std::ostream &os, bool incremental = false) const;
+	void deSerializeBinary(std::istream &is);
 
 	InventoryList * addList(const std::string &name, u32 size);
 	InventoryList * getList(const std::string &name);
@@ -281,6 +281,14 @@ class CItemDefManager: public IWritableItemDefManager
 		assert(i != m_item_definitions.cend());
 		return *(i->second);
 	}
+	virtual const ItemDefinition& get(const ItemName &name) const
+	{
+		const ItemDefinition *def = getById(name);
+		if (!def)
+			def = getById(m_unknown);
+		assert(def);
+		return *def;
+	}
 	virtual const std::string &getAlias(const std::string &name) const
 	{
 		auto it = m_aliases.find(name);
@@ -306,6 +314,10 @@ class CItemDefManager: public IWritableItemDefManager
 		// Get the definition
 		return m_item_definitions.find(name) != m_item_definitions.cend();
 	}
+	virtual bool isKnown(const ItemName &name) const
+	{
+		return getById(name) != nullptr;
+	}
 #ifndef SERVER
 public:
 	ClientCached* createClientCachedDirect(const std::string &name,
@@ -452,6 +464,8 @@ class CItemDefManager: public IWritableItemDefManager
 		}
 		m_item_definitions.clear();
 		m_aliases.clear();
+		m_definitions_by_id.clear();
+		m_aliases_by_id.clear();
 
 		// Add the four builtin items:
 		//   "" is the hand
@@ -480,6 +494,9 @@ class CItemDefManager: public IWritableItemDefManager
 		ignore_def->type = ITEM_NODE;
 		ignore_def->name = "ignore";
 		m_item_definitions.insert(std::make_pair("ignore", ignore_def));
+
+		for (const auto &it : m_item_definitions)
+			setById(ItemName(it.first), it.second);
 	}
 	virtual void registerItem(const ItemDefinition &def)
 	{
@@ -493,7 +510,12 @@ class CItemDefManager: public IWritableItemDefManager
 		else
 			*(m_item_definitions[def.name]) = def;
 
+		ItemName name(def.name);
+		setById(name, m_item_definitions[def.name]);
+
 		// Remove conflicting alias if it exists
+		if (name.getId() < m_aliases_by_id.size())
+			m_aliases_by_id[name.getId()] = 0;
 		bool alias_removed = (m_aliases.erase(def.name) != 0);
 		if(alias_removed)
 			infostream<<"ItemDefManager: erased alias "<<def.name
@@ -505,6 +527,7 @@ class CItemDefManager: public IWritableItemDefManager
 
 		delete m_item_definitions[name];
 		m_item_definitions.erase(name);
+		setById(ItemName(name), nullptr);
 	}
 	virtual void registerAlias(const std::string &name,
 			const std::string &convert_to)
@@ -513,6 +536,11 @@ class CItemDefManager: public IWritableItemDefManager
 			TRACESTREAM(<< "ItemDefManager: setting alias " << name
 				<< " -> " << convert_to << std::endl);
 			m_aliases[name] = convert_to;
+
+			u32 id = ItemName(name).getId();
+			if (id >= m_aliases_by_id.size())
+				m_aliases_by_id.resize(id + 1, 0);
+			m_aliases_by_id[id] = ItemName(convert_to).getId() + 1;
 		}
 	}
 	void serialize(std::ostream &os, u16 protocol_version)
@@ -577,10 +605,30 @@ class CItemDefManager: public IWritableItemDefManager
 #endif
 	}
 private:
+	// Resolves the alias, returns nullptr for unknown items
+	const ItemDefinition *getById(const ItemName &name) const
+	{
+		u32 id = name.getId();
+		if (id < m_aliases_by_id.size() && m_aliases_by_id[id] != 0)
+			id = m_aliases_by_id[id] - 1;
+		return id < m_definitions_by_id.size() ? m_definitions_by_id[id] : nullptr;
+	}
+	void setById(const ItemName &name, ItemDefinition *def)
+	{
+		u32 id = name.getId();
+		if (id >= m_definitions_by_id.size())
+			m_definitions_by_id.resize(id + 1, nullptr);
+		m_definitions_by_id[id] = def;
+	}
+
 	// Key is name
 	std::map<std::string, ItemDefinition*> m_item_definitions;
 	// Aliases
 	StringMap m_aliases;
+	// The same indexed by ItemName::getId(), aliases store the target id + 1
+	std::vector<ItemDefinition *> m_definitions_by_id;
+	std::vector<u32> m_aliases_by_id;
+	const ItemName m_unknown = ItemName(std::string("unknown"));
 #ifndef SERVER
 	// The id of the thread that is allowed to use irrlicht directly
 	std::thread::id m_main_thread;
@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <iostream>
 #include <set>
 #include "itemgroup.h"
+#include "itemname.h"
 #include "sound.h"
 #include "texture_override.h" // TextureOverride
 class IGameDef;
@@ -110,12 +111,15 @@ class IItemDefManager
 
 	// Get item definition
 	virtual const ItemDefinition& get(const std::string &name) const=0;
+	// Same by interned name, without looking up strings
+	virtual const ItemDefinition& get(const ItemName &name) const=0;
 	// Get alias definition
 	virtual const std::string &getAlias(const std::string &name) const=0;
 	// Get set of all defined item names and aliases
 	virtual void getAll(std::set<std::string> &result) const=0;
 	// Check if item is known
 	virtual bool isKnown(const std::string &name) const=0;
+	virtual bool isKnown(const ItemName &name) const=0;
 #ifndef SERVER
 	// Get item inventory texture
 	virtual video::ITexture* getInventoryTexture(const std::string &name,
@@ -144,12 +148,15 @@ class IWritableItemDefManager : public IItemDefManager
 
 	// Get item definition
 	virtual const ItemDefinition& get(const std::string &name) const=0;
+	// Same by interned name, without looking up strings
+	virtual const ItemDefinition& get(const ItemName &name) const=0;
 	// Get alias definition
 	virtual const std::string &getAlias(const std::string &name) const=0;
 	// Get set of all defined item names and aliases
 	virtual void getAll(std::set<std::string> &result) const=0;
 	// Check if item is known
 	virtual bool isKnown(const std::string &name) const=0;
+	virtual bool isKnown(const ItemName &name) const=0;
 #ifndef SERVER
 	// Get item inventory texture
 	virtual video::ITexture* getInventoryTexture(const std::string &name,
@@ -0,0 +1,58 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "itemname.h"
+#include "threading/mutex_auto_lock.h"
+#include <unordered_map>
+
+const std::string ItemName::s_empty;
+
+namespace {
+
+struct NameTable
+{
+	std::mutex mutex;
+	// Nodes don't move, entries point to their key
+	std::unordered_map<std::string, ItemName::Entry> entries;
+};
+
+// Never destroyed, names may be used by other static objects
+NameTable &get_table()
+{
+	static NameTable *table = new NameTable();
+	return *table;
+}
+
+}
+
+const ItemName::Entry *ItemName::intern(const std::string &name)
+{
+	if (name.empty())
+		return nullptr;
+
+	NameTable &table = get_table();
+	MutexAutoLock lock(table.mutex);
+	auto it = table.entries.find(name);
+	if (it == table.entries.end()) {
+		u32 id = table.entries.size() + 1;
+		it = table.entries.emplace(name, Entry{nullptr, id}).first;
+		it->second.name = &it->first;
+	}
+	return &it->second;
+}
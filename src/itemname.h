@@ -0,0 +1,106 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include <ostream>
+#include <string>
+
+/*
+	An interned item name.
+
+	Equal names share one entry, so comparing names is comparing pointers
+	and item definition managers index their definitions by the dense id.
+	Converting from a string looks the name up once; entries are never
+	freed. Converts to const std::string & for everything else.
+*/
+class ItemName
+{
+public:
+	struct Entry
+	{
+		const std::string *name;
+		u32 id;
+	};
+
+	// The empty name, id 0
+	ItemName() = default;
+
+	ItemName(const std::string &name) : m_entry(intern(name)) {}
+
+	ItemName &operator=(const std::string &name)
+	{
+		m_entry = intern(name);
+		return *this;
+	}
+
+	ItemName &operator=(const char *name)
+	{
+		m_entry = intern(name);
+		return *this;
+	}
+
+	const std::string &str() const
+	{
+		return m_entry ? *m_entry->name : s_empty;
+	}
+
+	operator const std::string &() const { return str(); }
+
+	// Dense, starts at 1 for the first interned non-empty name
+	u32 getId() const { return m_entry ? m_entry->id : 0; }
+
+	bool empty() const { return !m_entry; }
+	size_t size() const { return str().size(); }
+	const char *c_str() const { return str().c_str(); }
+
+	bool operator==(const ItemName &other) const { return m_entry == other.m_entry; }
+	bool operator!=(const ItemName &other) const { return m_entry != other.m_entry; }
+	bool operator==(const std::string &other) const { return str() == other; }
+	bool operator!=(const std::string &other) const { return str() != other; }
+	bool operator==(const char *other) const { return str() == other; }
+	bool operator!=(const char *other) const { return str() != other; }
+
+	// By name, for sorted containers and output
+	bool operator<(const ItemName &other) const { return str() < other.str(); }
+
+private:
+	static const Entry *intern(const std::string &name);
+
+	static const std::string s_empty;
+
+	// nullptr is the empty name
+	const Entry *m_entry = nullptr;
+};
+
+inline bool operator==(const std::string &a, const ItemName &b) { return b == a; }
+inline bool operator!=(const std::string &a, const ItemName &b) { return b != a; }
+inline bool operator==(const char *a, const ItemName &b) { return b == a; }
+inline bool operator!=(const char *a, const ItemName &b) { return b != a; }
+
+inline std::string operator+(const std::string &a, const ItemName &b) { return a + b.str(); }
+inline std::string operator+(const ItemName &a, const std::string &b) { return a.str() + b; }
+inline std::string operator+(const char *a, const ItemName &b) { return a + b.str(); }
+inline std::string operator+(const ItemName &a, const char *b) { return a.str() + b; }
+
+inline std::ostream &operator<<(std::ostream &os, const ItemName &name)
+{
+	return os << name.str();
+}
@@ -37,6 +37,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "config.h"
 #include "player.h"
 #include "porting.h"
+#include "profiler.h"
 #include "network/socket.h"
 #include "mapblock.h"
 #if USE_CURSES
@@ -240,8 +241,14 @@ int main(int argc, char *argv[])
 
 	sanity_check(!game_params.world_path.empty());
 
-	if (game_params.is_dedicated_server)
-		return run_dedicated_server(game_params, cmd_args) ? 0 : 1;
+	if (!g_settings->get("profiler_trace_file").empty())
+		g_profiler->startTrace(g_settings->get("profiler_trace_file"));
+
+	if (game_params.is_dedicated_server) {
+		retval = run_dedicated_server(game_params, cmd_args) ? 0 : 1;
+		g_profiler->stopTrace();
+		return retval;
+	}
 
 #ifndef SERVER
 	ClientLauncher launcher;
@@ -256,6 +263,8 @@ int main(int argc, char *argv[])
 
 	print_modified_quicktune_values();
 
+	g_profiler->stopTrace();
+
 	// Stop httpfetch thread (if started)
 	httpfetch_cleanup();
 
@@ -329,6 +338,8 @@ static void set_allowed_options(OptionList *allowed_options)
 		_("Migrate from current players backend to another (Only works when using minetestserver or with --server)"))));
 	allowed_options->insert(std::make_pair("migrate-auth", ValueSpec(VALUETYPE_STRING,
 		_("Migrate from current auth backend to another (Only works when using minetestserver or with --server)"))));
+	allowed_options->insert(std::make_pair("migrate-mod-storage", ValueSpec(VALUETYPE_STRING,
+		_("Migrate from current mod storage backend to another (Only works when using minetestserver or with --server)"))));
 	allowed_options->insert(std::make_pair("terminal", ValueSpec(VALUETYPE_FLAG,
 			_("Feature an interactive terminal (Only works when using minetestserver or with --server)"))));
 	allowed_options->insert(std::make_pair("recompress", ValueSpec(VALUETYPE_FLAG,
@@ -914,6 +925,9 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	if (cmd_args.exists("migrate-auth"))
 		return ServerEnvironment::migrateAuthDatabase(game_params, cmd_args);
 
+	if (cmd_args.exists("migrate-mod-storage"))
+		return Server::migrateModStorageDatabase(game_params, cmd_args);
+
 	if (cmd_args.getFlag("recompress"))
 		return recompress_map_database(game_params, cmd_args, bind_addr);
 
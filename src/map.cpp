@@ -47,6 +47,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "database/database-sqlite3.h"
 #endif
 #include "script/scripting_server.h"
+#include <atomic>
 #include <deque>
 #include <queue>
 #if USE_LEVELDB
@@ -60,13 +61,142 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #endif
 #include <zstd.h>
 
+// Server map blocks that were not used for this long (in seconds)
+// get their node data compressed
+#define BLOCK_COMPRESS_TIMEOUT 5.0f
+
+// Granularity of the unload queue, in seconds of the usage clock
+#define BLOCK_UNLOAD_SLOT_WIDTH 1.0
+// Bounds the unloading (and saving) work of a single timerUpdate call
+#define BLOCK_UNLOAD_MAX_PER_STEP 1000
 
 /*
 	Map
 */
 
+/*
+	MapBlockIndex
+*/
+
+#define BLOCK_INDEX_MIN_CAPACITY 256
+
+MapBlockIndex::MapBlockIndex():
+	m_slots(BLOCK_INDEX_MIN_CAPACITY, Slot{0, nullptr}),
+	m_mask(BLOCK_INDEX_MIN_CAPACITY - 1)
+{
+}
+
+MapBlock *MapBlockIndex::get(v3s16 p) const
+{
+	u64 key = packPos(p);
+	for (size_t i = slotFor(key);; i = (i + 1) & m_mask) {
+		const Slot &slot = m_slots[i];
+		if (!slot.block)
+			return nullptr;
+		if (slot.key == key)
+			return slot.block;
+	}
+}
+
+void MapBlockIndex::insert(v3s16 p, MapBlock *block)
+{
+	assert(block);
+
+	// Keep the load factor at or below 1/2 so that probe runs stay short
+	if ((m_count + 1) * 2 > m_slots.size())
+		grow();
+
+	u64 key = packPos(p);
+	for (size_t i = slotFor(key);; i = (i + 1) & m_mask) {
+		Slot &slot = m_slots[i];
+		if (!slot.block) {
+			slot.key = key;
+			slot.block = block;
+			m_count++;
+			return;
+		}
+		if (slot.key == key) {
+			slot.block = block;
+			return;
+		}
+	}
+}
+
+void MapBlockIndex::erase(v3s16 p)
+{
+	u64 key = packPos(p);
+	size_t i = slotFor(key);
+	for (;; i = (i + 1) & m_mask) {
+		if (!m_slots[i].block)
+			return;
+		if (m_slots[i].key == key)
+			break;
+	}
+
+	m_slots[i].block = nullptr;
+	m_count--;
+
+	// Backward-shift the rest of the probe run into the hole, so that no
+	// tombstones are needed
+	for (size_t j = (i + 1) & m_mask; m_slots[j].block; j = (j + 1) & m_mask) {
+		size_t home = slotFor(m_slots[j].key);
+		// Move the entry if its home slot is not within (i, j]
+		if (((j - home) & m_mask) >= ((j - i) & m_mask)) {
+			m_slots[i] = m_slots[j];
+			m_slots[j].block = nullptr;
+			i = j;
+		}
+	}
+}
+
+void MapBlockIndex::clear()
+{
+	m_slots.assign(BLOCK_INDEX_MIN_CAPACITY, Slot{0, nullptr});
+	m_mask = BLOCK_INDEX_MIN_CAPACITY - 1;
+	m_count = 0;
+}
+
+void MapBlockIndex::grow()
+{
+	std::vector<Slot> old;
+	old.swap(m_slots);
+	m_slots.assign(old.size() * 2, Slot{0, nullptr});
+	m_mask = m_slots.size() - 1;
+
+	for (const Slot &slot : old) {
+		if (!slot.block)
+			continue;
+		size_t i = slotFor(slot.key);
+		while (m_slots[i].block)
+			i = (i + 1) & m_mask;
+		m_slots[i] = slot;
+	}
+}
+
+/*
+	Map
+*/
+
+// Generations are unique across all maps, so a stale cache entry can never
+// match a map that happens to be allocated at the same address later.
+static std::atomic<u64> g_block_index_gen(1);
+
+#define BLOCK_LOOKUP_CACHE_SIZE 4
+
+struct BlockLookupCacheEntry {
+	// 0 is never handed out as a generation
+	u64 gen = 0;
+	v3s16 pos;
+	MapBlock *block = nullptr;
+};
+
+// Most recently used blocks of this thread, front first
+static thread_local BlockLookupCacheEntry
+		t_block_lookup_cache[BLOCK_LOOKUP_CACHE_SIZE];
+
 Map::Map(IGameDef *gamedef):
 	m_gamedef(gamedef),
+	m_block_index_gen(g_block_index_gen++),
 	m_nodedef(gamedef->ndef())
 {
 }
@@ -93,6 +223,11 @@ void Map::removeEventReceiver(MapEventReceiver *event_receiver)
 
 void Map::dispatchEvent(const MapEditEvent &event)
 {
+	if (event.type == MEET_OTHER) {
+		for (const v3s16 &blockpos : event.modified_blocks)
+			m_collision_cache.invalidateBlock(blockpos);
+	}
+
 	for (MapEventReceiver *event_receiver : m_event_receivers) {
 		event_receiver->onMapEditEvent(event);
 	}
@@ -124,13 +259,51 @@ MapSector * Map::getSectorNoGenerate(v2s16 p)
 	return getSectorNoGenerateNoLock(p);
 }
 
+void Map::indexBlock(MapBlock *block)
+{
+	m_block_index.insert(block->getPos(), block);
+	m_collision_cache.invalidateBlock(block->getPos());
+
+	// Have timerUpdate look at new blocks soon
+	block->resetUsageTimer();
+	queueBlockCheck(block, m_usage_time);
+}
+
+void Map::unindexBlock(MapBlock *block)
+{
+	m_block_index.erase(block->getPos());
+	m_collision_cache.invalidateBlock(block->getPos());
+	m_block_index_gen = g_block_index_gen++;
+}
+
 MapBlock * Map::getBlockNoCreateNoEx(v3s16 p3d)
 {
-	v2s16 p2d(p3d.X, p3d.Z);
-	MapSector * sector = getSectorNoGenerate(p2d);
-	if(sector == NULL)
-		return NULL;
-	MapBlock *block = sector->getBlockNoCreateNoEx(p3d.Y);
+	BlockLookupCacheEntry *cache = t_block_lookup_cache;
+	const u64 gen = m_block_index_gen;
+
+	if (cache[0].gen == gen && cache[0].pos == p3d)
+		return cache[0].block;
+
+	for (int i = 1; i < BLOCK_LOOKUP_CACHE_SIZE; i++) {
+		if (cache[i].gen != gen || cache[i].pos != p3d)
+			continue;
+		// Move to front
+		BlockLookupCacheEntry hit = cache[i];
+		for (; i > 0; i--)
+			cache[i] = cache[i - 1];
+		cache[0] = hit;
+		return hit.block;
+	}
+
+	MapBlock *block = m_block_index.get(p3d);
+	// Only remember hits, a miss may turn into a hit without a new generation
+	if (block) {
+		for (int i = BLOCK_LOOKUP_CACHE_SIZE - 1; i > 0; i--)
+			cache[i] = cache[i - 1];
+		cache[0].gen = gen;
+		cache[0].pos = p3d;
+		cache[0].block = block;
+	}
 	return block;
 }
 
@@ -199,6 +372,7 @@ void Map::setNode(v3s16 p, MapNode & n)
 	MapBlock *block = getBlockNoCreate(blockpos);
 	v3s16 relpos = p - blockpos*MAP_BLOCKSIZE;
 	set_node_in_block(block, relpos, n);
+	m_collision_cache.invalidateNode(p);
 }
 
 void Map::addNodeAndUpdate(v3s16 p, MapNode n,
@@ -249,6 +423,7 @@ void Map::addNodeAndUpdate(v3s16 p, MapNode n,
 			modified_block.second->expireDayNightDiff();
 		}
 	}
+	m_collision_cache.invalidateNode(p);
 
 #if USE_SQLITE
 	// Report for rollback
@@ -335,20 +510,12 @@ bool Map::removeNodeWithEvent(v3s16 p)
 	return succeeded;
 }
 
-struct TimeOrderedMapBlock {
-	MapSector *sect;
-	MapBlock *block;
-
-	TimeOrderedMapBlock(MapSector *sect, MapBlock *block) :
-		sect(sect),
-		block(block)
-	{}
-
-	bool operator<(const TimeOrderedMapBlock &b) const
-	{
-		return block->getUsageTimer() < b.block->getUsageTimer();
-	};
-};
+void Map::queueBlockCheck(MapBlock *block, double due)
+{
+	u32 slot = due > 0 ? (u32)(due / BLOCK_UNLOAD_SLOT_WIDTH) : 0;
+	block->setUnloadSlot(slot);
+	m_unload_queue[slot].push_back(block->getPos());
+}
 
 /*
 	Updates usage timers
@@ -357,114 +524,124 @@ void Map::timerUpdate(float dtime, float unload_timeout, u32 max_loaded_blocks,
 		std::vector<v3s16> *unloaded_blocks)
 {
 	bool save_before_unloading = (mapType() == MAPTYPE_SERVER);
+	// The client needs flat node arrays for meshing anyway
+	bool compress_nodes = (mapType() == MAPTYPE_SERVER);
 
 	// Profile modified reasons
 	Profiler modprofiler;
 
-	std::vector<v2s16> sector_deletion_queue;
+	std::set<v2s16> emptied_sectors;
 	u32 deleted_blocks_count = 0;
 	u32 saved_blocks_count = 0;
-	u32 block_count_all = 0;
 
-	beginSave();
+	m_usage_time += dtime;
+	const double now = m_usage_time;
+	// Blocks that can't be unloaded now are looked at again after this
+	const double recheck_delay =
+			std::max<double>(unload_timeout, BLOCK_UNLOAD_SLOT_WIDTH);
+	// When over the block limit, slots that are not due yet are processed
+	// too, but only up to here so that blocks filed again during this call
+	// aren't picked up over and over
+	const u32 slot_limit = (u32)((now + recheck_delay) / BLOCK_UNLOAD_SLOT_WIDTH);
 
-	// If there is no practical limit, we spare creation of mapblock_queue
-	if (max_loaded_blocks == U32_MAX) {
-		for (auto &sector_it : m_sectors) {
-			MapSector *sector = sector_it.second;
-
-			bool all_blocks_deleted = true;
-
-			MapBlockVect blocks;
-			sector->getBlocks(blocks);
-
-			for (MapBlock *block : blocks) {
-				block->incrementUsageTimer(dtime);
-
-				if (block->refGet() == 0
-						&& block->getUsageTimer() > unload_timeout) {
-					v3s16 p = block->getPos();
+	beginSave();
 
-					// Save if modified
-					if (block->getModified() != MOD_STATE_CLEAN
-							&& save_before_unloading) {
-						modprofiler.add(block->getModifiedReasonString(), 1);
-						if (!saveBlock(block))
-							continue;
-						saved_blocks_count++;
-					}
+	std::vector<v3s16> positions;
+	while (!m_unload_queue.empty()
+			&& deleted_blocks_count < BLOCK_UNLOAD_MAX_PER_STEP) {
+		auto slot_it = m_unload_queue.begin();
+		const u32 slot = slot_it->first;
+		bool due = (slot + 1) * BLOCK_UNLOAD_SLOT_WIDTH <= now;
+		if (!due && !(m_block_index.size() > max_loaded_blocks
+				&& slot < slot_limit))
+			break;
 
-					// Delete from memory
-					sector->deleteBlock(block);
+		positions.clear();
+		positions.swap(slot_it->second);
+		m_unload_queue.erase(slot_it);
 
-					if (unloaded_blocks)
-						unloaded_blocks->push_back(p);
+		size_t i = 0;
+		for (; i < positions.size(); i++) {
+			if (deleted_blocks_count >= BLOCK_UNLOAD_MAX_PER_STEP)
+				break;
 
-					deleted_blocks_count++;
-				} else {
-					all_blocks_deleted = false;
-					block_count_all++;
-				}
+			v3s16 p = positions[i];
+			MapBlock *block = m_block_index.get(p);
+			if (!block) {
+				// Deleted by someone else, which may have left its sector empty
+				MapSector *sector = getSectorNoGenerate(v2s16(p.X, p.Z));
+				if (sector && sector->empty())
+					emptied_sectors.insert(sector->getPos());
+				continue;
 			}
+			// Stale entry, the block was filed elsewhere
+			if (block->getUnloadSlot() != slot)
+				continue;
 
-			if (all_blocks_deleted) {
-				sector_deletion_queue.push_back(sector_it.first);
+			if (block->refGet() != 0) {
+				queueBlockCheck(block, now + recheck_delay);
+				continue;
 			}
-		}
-	} else {
-		std::priority_queue<TimeOrderedMapBlock> mapblock_queue;
-		for (auto &sector_it : m_sectors) {
-			MapSector *sector = sector_it.second;
 
-			MapBlockVect blocks;
-			sector->getBlocks(blocks);
+			float idle = block->getUsageTimer();
+			bool compress_pending = compress_nodes
+					&& !block->isCompressionChecked();
+			double last_used = now - idle;
+			double proper_due = last_used + (compress_pending ?
+					std::min(BLOCK_COMPRESS_TIMEOUT, unload_timeout) :
+					unload_timeout);
+
+			// When over the limit, the blocks that are already in the right
+			// slot are the least recently used ones
+			bool evict = m_block_index.size() > max_loaded_blocks
+					&& proper_due < (slot + 1) * BLOCK_UNLOAD_SLOT_WIDTH;
+
+			if (idle > unload_timeout || evict) {
+				// Save if modified
+				if (block->getModified() != MOD_STATE_CLEAN
+						&& save_before_unloading) {
+					modprofiler.add(block->getModifiedReasonString(), 1);
+					if (!saveBlock(block)) {
+						queueBlockCheck(block, now + recheck_delay);
+						continue;
+					}
+					saved_blocks_count++;
+				}
 
-			for (MapBlock *block : blocks) {
-				block->incrementUsageTimer(dtime);
-				mapblock_queue.push(TimeOrderedMapBlock(sector, block));
-			}
-		}
-		block_count_all = mapblock_queue.size();
-		// Delete old blocks, and blocks over the limit from the memory
-		while (!mapblock_queue.empty() && (mapblock_queue.size() > max_loaded_blocks
-				|| mapblock_queue.top().block->getUsageTimer() > unload_timeout)) {
-			TimeOrderedMapBlock b = mapblock_queue.top();
-			mapblock_queue.pop();
+				// Delete from memory
+				MapSector *sector = getSectorNoGenerate(v2s16(p.X, p.Z));
+				sector->deleteBlock(block);
+				if (sector->empty())
+					emptied_sectors.insert(sector->getPos());
 
-			MapBlock *block = b.block;
+				if (unloaded_blocks)
+					unloaded_blocks->push_back(p);
 
-			if (block->refGet() != 0)
+				deleted_blocks_count++;
 				continue;
-
-			v3s16 p = block->getPos();
-
-			// Save if modified
-			if (block->getModified() != MOD_STATE_CLEAN && save_before_unloading) {
-				modprofiler.add(block->getModifiedReasonString(), 1);
-				if (!saveBlock(block))
-					continue;
-				saved_blocks_count++;
 			}
 
-			// Delete from memory
-			b.sect->deleteBlock(block);
-
-			if (unloaded_blocks)
-				unloaded_blocks->push_back(p);
+			if (compress_pending && idle > BLOCK_COMPRESS_TIMEOUT) {
+				block->compressNodes();
+				compress_pending = false;
+			}
 
-			deleted_blocks_count++;
-			block_count_all--;
+			double next_check = last_used + (compress_pending ?
+					BLOCK_COMPRESS_TIMEOUT : unload_timeout);
+			queueBlockCheck(block, std::max(next_check, now));
 		}
-		// Delete empty sectors
-		for (auto &sector_it : m_sectors) {
-			if (sector_it.second->empty()) {
-				sector_deletion_queue.push_back(sector_it.first);
-			}
+
+		// Keep what was left over for the next call
+		if (i < positions.size()) {
+			std::vector<v3s16> &rest = m_unload_queue[slot];
+			rest.insert(rest.end(), positions.begin() + i, positions.end());
 		}
 	}
 	endSave();
 
 	// Finally delete the empty sectors
+	std::vector<v2s16> sector_deletion_queue(emptied_sectors.begin(),
+			emptied_sectors.end());
 	deleteSectors(sector_deletion_queue);
 
 	if(deleted_blocks_count != 0)
@@ -474,7 +651,7 @@ void Map::timerUpdate(float dtime, float unload_timeout, u32 max_loaded_blocks,
 				<<" blocks from memory";
 		if(save_before_unloading)
 			infostream<<", of which "<<saved_blocks_count<<" were written";
-		infostream<<", "<<block_count_all<<" blocks in memory";
+		infostream<<", "<<m_block_index.size()<<" blocks in memory";
 		infostream<<"."<<std::endl;
 		if(saved_blocks_count != 0){
 			PrintInfo(infostream); // ServerMap/ClientMap:
@@ -486,7 +663,51 @@ void Map::timerUpdate(float dtime, float unload_timeout, u32 max_loaded_blocks,
 
 void Map::unloadUnreferencedBlocks(std::vector<v3s16> *unloaded_blocks)
 {
-	timerUpdate(0.0, -1.0, 0, unloaded_blocks);
+	bool save_before_unloading = (mapType() == MAPTYPE_SERVER);
+
+	std::vector<v2s16> sector_deletion_queue;
+	u32 deleted_blocks_count = 0;
+
+	beginSave();
+	for (auto &sector_it : m_sectors) {
+		MapSector *sector = sector_it.second;
+
+		MapBlockVect blocks;
+		sector->getBlocks(blocks);
+
+		for (MapBlock *block : blocks) {
+			if (block->refGet() != 0)
+				continue;
+
+			v3s16 p = block->getPos();
+
+			// Save if modified
+			if (block->getModified() != MOD_STATE_CLEAN
+					&& save_before_unloading && !saveBlock(block))
+				continue;
+
+			// Delete from memory
+			sector->deleteBlock(block);
+
+			if (unloaded_blocks)
+				unloaded_blocks->push_back(p);
+
+			deleted_blocks_count++;
+		}
+
+		if (sector->empty())
+			sector_deletion_queue.push_back(sector_it.first);
+	}
+	endSave();
+
+	deleteSectors(sector_deletion_queue);
+
+	if (deleted_blocks_count != 0) {
+		PrintInfo(infostream); // ServerMap/ClientMap:
+		infostream << "Unloaded " << deleted_blocks_count
+				<< " unreferenced blocks from memory, "
+				<< m_block_index.size() << " blocks in memory." << std::endl;
+	}
 }
 
 void Map::deleteSectors(std::vector<v2s16> &sectorList)
@@ -1804,6 +2025,7 @@ void ServerMap::loadBlock(std::string *blob, v3s16 p3d, MapSector *sector, bool
 
 		// Read basic data
 		block->deSerialize(is, version, true);
+		block->compressNodes();
 
 		// If it's a new block, insert it to the map
 		if (created_new) {
@@ -24,9 +24,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <set>
 #include <map>
 #include <list>
+#include <vector>
 
 #include "irrlichttypes_bloated.h"
 #include "mapnode.h"
+#include "collision.h"
 #include "constants.h"
 #include "voxel.h"
 #include "modifiedstate.h"
@@ -112,6 +114,49 @@ struct MapEditEvent
 	}
 };
 
+/*
+	Flat open-addressing hash table from block positions to the loaded
+	MapBlocks. MapSector keeps it in sync so that block lookups don't have
+	to walk the sector tree.
+*/
+class MapBlockIndex
+{
+public:
+	MapBlockIndex();
+
+	MapBlock *get(v3s16 p) const;
+	void insert(v3s16 p, MapBlock *block);
+	void erase(v3s16 p);
+	void clear();
+
+	size_t size() const { return m_count; }
+	size_t capacity() const { return m_slots.size(); }
+
+private:
+	struct Slot {
+		u64 key;
+		// nullptr marks an empty slot
+		MapBlock *block;
+	};
+
+	static inline u64 packPos(v3s16 p)
+	{
+		return (u64)(u16)p.X | ((u64)(u16)p.Y << 16) | ((u64)(u16)p.Z << 32);
+	}
+
+	inline size_t slotFor(u64 key) const
+	{
+		u64 h = key * 0x9E3779B97F4A7C15ULL;
+		return (size_t)(h ^ (h >> 32)) & m_mask;
+	}
+
+	void grow();
+
+	std::vector<Slot> m_slots;
+	size_t m_mask;
+	size_t m_count = 0;
+};
+
 class MapEventReceiver
 {
 public:
@@ -156,6 +201,10 @@ class Map /*: public NodeContainer*/
 	*/
 	virtual MapSector * emergeSector(v2s16 p){ return NULL; }
 
+	// Keep the block index in sync, called by MapSector
+	void indexBlock(MapBlock *block);
+	void unindexBlock(MapBlock *block);
+
 	// Returns InvalidPositionException if not found
 	MapBlock * getBlockNoCreate(v3s16 p);
 	// Returns NULL if not found
@@ -167,6 +216,9 @@ class Map /*: public NodeContainer*/
 
 	inline const NodeDefManager * getNodeDefManager() { return m_nodedef; }
 
+	// Node collision boxes of the current environment step
+	CollisionBoxCache &getCollisionCache() { return m_collision_cache; }
+
 	// Returns InvalidPositionException if not found
 	bool isNodeUnderground(v3s16 p);
 
@@ -208,8 +260,13 @@ class Map /*: public NodeContainer*/
 	virtual bool saveBlock(MapBlock *block) { return false; }
 	virtual bool deleteBlock(v3s16 blockpos) { return false; }
 
+	// Clock the usage timers of the blocks are measured against
+	double getUsageTime() const { return m_usage_time; }
+
 	/*
-		Updates usage timers and unloads unused blocks and sectors.
+		Advances the usage clock and unloads unused blocks and sectors.
+		Only blocks whose turn in the unload queue has come are looked at,
+		and at most a bounded number of them is unloaded per call.
 		Saves modified blocks before unloading on MAPTYPE_SERVER.
 	*/
 	void timerUpdate(float dtime, float unload_timeout, u32 max_loaded_blocks,
@@ -286,12 +343,31 @@ class Map /*: public NodeContainer*/
 	MapSector *m_sector_cache = nullptr;
 	v2s16 m_sector_cache_p;
 
+	// All loaded blocks, by position
+	MapBlockIndex m_block_index;
+	// Changes whenever a block leaves the index, which invalidates the
+	// per-thread lookup caches of getBlockNoCreateNoEx
+	u64 m_block_index_gen;
+
+	void queueBlockCheck(MapBlock *block, double due);
+
+	// Usage clock, advanced by timerUpdate
+	double m_usage_time = 0;
+	// Positions of loaded blocks by the time slot in which they should be
+	// looked at next. Entries are re-filed lazily: a block that was used in
+	// the meantime is only moved when its slot comes up, and entries whose
+	// block is gone or was filed elsewhere (see MapBlock::getUnloadSlot) are
+	// dropped.
+	std::map<u32, std::vector<v3s16>> m_unload_queue;
+
 	// Queued transforming water nodes
 	UniqueQueue<v3s16> m_transforming_liquid;
 
 	// This stores the properties of the nodes on the map.
 	const NodeDefManager *m_nodedef;
 
+	CollisionBoxCache m_collision_cache;
+
 	bool determineAdditionalOcclusionCheck(const v3s16 &pos_camera,
 		const core::aabbox3d<s16> &block_bounds, v3s16 &check);
 	bool isOccluded(const v3s16 &pos_camera, const v3s16 &pos_target,
@@ -76,6 +76,16 @@ MapBlock::MapBlock(Map *parent, v3s16 pos, IGameDef *gamedef, bool dummy):
 		reallocate();
 }
 
+void MapBlock::resetUsageTimer()
+{
+	m_last_used = m_parent ? m_parent->getUsageTime() : 0;
+}
+
+float MapBlock::getUsageTimer() const
+{
+	return m_parent ? m_parent->getUsageTime() - m_last_used : 0;
+}
+
 MapBlock::~MapBlock()
 {
 #ifndef SERVER
@@ -102,14 +112,14 @@ MapNode MapBlock::getNodeParent(v3s16 p, bool *is_valid_position)
 	if (!isValidPosition(p))
 		return m_parent->getNode(getPosRelative() + p, is_valid_position);
 
-	if (!data) {
+	if (isDummy()) {
 		if (is_valid_position)
 			*is_valid_position = false;
 		return {CONTENT_IGNORE};
 	}
 	if (is_valid_position)
 		*is_valid_position = true;
-	return data[p.Z * zstride + p.Y * ystride + p.X];
+	return readNode(p.Z * zstride + p.Y * ystride + p.X);
 }
 
 std::string MapBlock::getModifiedReasonString()
@@ -134,11 +144,119 @@ std::string MapBlock::getModifiedReasonString()
 }
 
 
+bool MapBlock::compressNodes()
+{
+	m_compression_checked = true;
+
+	if (!data)
+		return isCompressed();
+
+	// Fast path for uniform blocks
+	u32 i = 1;
+	while (i < nodecount && data[i] == data[0])
+		i++;
+	if (i == nodecount) {
+		m_palette.assign(1, data[0]);
+		delete[] data;
+		data = nullptr;
+		return true;
+	}
+
+	std::vector<MapNode> palette;
+	std::unordered_map<u32, u8> palette_ids;
+	u8 *ids = new u8[nodecount];
+	u32 prev_key = 0;
+	u8 prev_id = 0;
+	for (i = 0; i < nodecount; i++) {
+		const MapNode &n = data[i];
+		const u32 key = (u32)n.param0 << 16 | (u32)n.param1 << 8 | n.param2;
+		if (i > 0 && key == prev_key) {
+			ids[i] = prev_id;
+			continue;
+		}
+
+		auto it = palette_ids.find(key);
+		if (it == palette_ids.end()) {
+			if (palette.size() == 256) {
+				delete[] ids;
+				return false;
+			}
+			it = palette_ids.emplace(key, (u8)palette.size()).first;
+			palette.push_back(n);
+		}
+		prev_key = key;
+		prev_id = ids[i] = it->second;
+	}
+
+	u8 shift = 0;
+	while ((1U << (1U << shift)) < palette.size())
+		shift++;
+
+	const u32 per_word_shift = 5 - shift;
+	m_indices.assign(nodecount >> per_word_shift, 0);
+	for (i = 0; i < nodecount; i++) {
+		const u32 bit = (i & ((1U << per_word_shift) - 1)) << shift;
+		m_indices[i >> per_word_shift] |= (u32)ids[i] << bit;
+	}
+	delete[] ids;
+
+	m_palette = std::move(palette);
+	m_index_shift = shift;
+	delete[] data;
+	data = nullptr;
+	return true;
+}
+
+u32 MapBlock::getNodeStorageSize() const
+{
+	if (data)
+		return nodecount * sizeof(MapNode);
+
+	return m_palette.capacity() * sizeof(MapNode) +
+		m_indices.capacity() * sizeof(u32);
+}
+
+void MapBlock::decompressNodes(MapNode *dst) const
+{
+	if (m_indices.empty()) {
+		std::fill(dst, dst + nodecount, m_palette[0]);
+		return;
+	}
+
+	for (u32 i = 0; i < nodecount; i++)
+		dst[i] = readNode(i);
+}
+
+void MapBlock::expandNodes()
+{
+	MapNode *nodes = new MapNode[nodecount];
+	decompressNodes(nodes);
+	clearCompressedNodes();
+	delete[] data;
+	data = nodes;
+}
+
+void MapBlock::clearCompressedNodes()
+{
+	std::vector<MapNode>().swap(m_palette);
+	std::vector<u32>().swap(m_indices);
+	m_index_shift = 0;
+	m_compression_checked = false;
+}
+
 void MapBlock::copyTo(VoxelManipulator &dst)
 {
 	v3s16 data_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
+	if (isCompressed()) {
+		MapNode nodes[nodecount];
+		decompressNodes(nodes);
+		dst.copyFrom(nodes, data_area, v3s16(0,0,0),
+				getPosRelative(), data_size);
+		return;
+	}
+
 	// Copy from data to VoxelManipulator
 	dst.copyFrom(data, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
@@ -149,6 +267,10 @@ void MapBlock::copyFrom(VoxelManipulator &dst)
 	v3s16 data_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
+	// Nodes that are CONTENT_IGNORE in the VoxelManipulator are kept
+	if (isCompressed())
+		expandNodes();
+
 	// Copy from VoxelManipulator to data
 	dst.copyTo(data, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
@@ -161,13 +283,26 @@ void MapBlock::actuallyUpdateDayNightDiff()
 	// Running this function un-expires m_day_night_differs
 	m_day_night_differs_expired = false;
 
-	if (!data) {
+	if (isDummy()) {
 		m_day_night_differs = false;
 		return;
 	}
 
 	bool differs = false;
 
+	// A compressed block only needs to look at its distinct nodes
+	if (isCompressed()) {
+		bool only_air = true;
+		for (const MapNode &n : m_palette) {
+			if (!differs && !n.isLightDayNightEq(nodemgr))
+				differs = true;
+			if (n.getContent() != CONTENT_AIR)
+				only_air = false;
+		}
+		m_day_night_differs = differs && !only_air;
+		return;
+	}
+
 	/*
 		Check if any lighting value differs
 	*/
@@ -209,7 +344,7 @@ void MapBlock::actuallyUpdateDayNightDiff()
 
 void MapBlock::expireDayNightDiff()
 {
-	if (!data) {
+	if (isDummy()) {
 		m_day_night_differs = false;
 		m_day_night_differs_expired = false;
 		return;
@@ -218,6 +353,54 @@ void MapBlock::expireDayNightDiff()
 	m_day_night_differs_expired = true;
 }
 
+static inline u8 clear_emptiness(u8 emptiness, content_t c,
+		const NodeDefManager *nodemgr)
+{
+	if (c == CONTENT_AIR)
+		return emptiness;
+
+	const ContentFeatures &f = nodemgr->get(c);
+	if (f.pointable)
+		return 0;
+	emptiness &= ~BLOCK_EMPTY_AIR;
+	if (f.isLiquid())
+		emptiness &= ~BLOCK_EMPTY_LIQUIDS_POINTABLE;
+	return emptiness;
+}
+
+void MapBlock::updateEmptiness()
+{
+	const NodeDefManager *nodemgr = m_gamedef->ndef();
+	m_emptiness_expired = false;
+
+	u8 emptiness = BLOCK_EMPTY_AIR | BLOCK_EMPTY_POINTABLE |
+			BLOCK_EMPTY_LIQUIDS_POINTABLE;
+
+	// Dummy blocks read as ignore
+	if (isDummy()) {
+		m_emptiness = clear_emptiness(emptiness, CONTENT_IGNORE, nodemgr);
+		return;
+	}
+
+	if (isCompressed()) {
+		for (const MapNode &n : m_palette)
+			emptiness = clear_emptiness(emptiness, n.getContent(), nodemgr);
+		m_emptiness = emptiness;
+		return;
+	}
+
+	// Blocks with anything pointable usually stop at the first nodes
+	content_t previous_c = CONTENT_AIR;
+	for (u32 i = 0; i < nodecount && emptiness; i++) {
+		content_t c = data[i].getContent();
+		if (c == previous_c)
+			continue;
+		emptiness = clear_emptiness(emptiness, c, nodemgr);
+		previous_c = c;
+	}
+	m_emptiness = emptiness;
+}
+
 s16 MapBlock::getGroundLevel(v2s16 p2d)
 {
 	if(isDummy())
@@ -227,7 +410,7 @@ s16 MapBlock::getGroundLevel(v2s16 p2d)
 		s16 y = MAP_BLOCKSIZE-1;
 		for(; y>=0; y--)
 		{
-			MapNode n = getNodeRef(p2d.X, y, p2d.Y);
+			MapNode n = readNode(p2d.Y * zstride + y * ystride + p2d.X);
 			if (m_gamedef->ndef()->get(n).walkable) {
 				if(y == MAP_BLOCKSIZE-1)
 					return -2;
@@ -360,7 +543,7 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 	if(!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
 
-	if (!data)
+	if (isDummy())
 		throw SerializationError("ERROR: Not writing dummy block.");
 
 	FATAL_ERROR_IF(version < SER_FMT_VER_LOWEST_WRITE, "Serialisation version error");
@@ -391,7 +574,10 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
  	if(disk)
 	{
 		MapNode *tmp_nodes = new MapNode[nodecount];
-		memcpy(tmp_nodes, data, nodecount * sizeof(MapNode));
+		if (isCompressed())
+			decompressNodes(tmp_nodes);
+		else
+			memcpy(tmp_nodes, data, nodecount * sizeof(MapNode));
 		getBlockNodeIdMapping(&nimap, tmp_nodes, m_gamedef->ndef());
 
 		buf = MapNode::serializeBulk(version, tmp_nodes, nodecount,
@@ -405,6 +591,14 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 			nimap.serialize(os);
 		}
 	}
+	else if (isCompressed())
+	{
+		MapNode *tmp_nodes = new MapNode[nodecount];
+		decompressNodes(tmp_nodes);
+		buf = MapNode::serializeBulk(version, tmp_nodes, nodecount,
+				content_width, params_width);
+		delete[] tmp_nodes;
+	}
 	else
 	{
 		buf = MapNode::serializeBulk(version, data, nodecount,
@@ -467,7 +661,7 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 
 void MapBlock::serializeNetworkSpecific(std::ostream &os)
 {
-	if (!data) {
+	if (isDummy()) {
 		throw SerializationError("ERROR: Not writing dummy block.");
 	}
 
@@ -481,7 +675,14 @@ void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 
 	TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())<<std::endl);
 
+	// All nodes are overwritten below
+	if (isCompressed()) {
+		clearCompressedNodes();
+		data = new MapNode[nodecount];
+	}
+
 	m_day_night_differs_expired = false;
+	m_emptiness_expired = true;
 
 	if(version <= 21)
 	{
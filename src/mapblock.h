@@ -66,6 +66,17 @@ class VoxelManipulator;
 #define MOD_REASON_VMANIP                    (1 << 19)
 #define MOD_REASON_UNKNOWN                   (1 << 20)
 
+////
+//// MapBlock emptiness flags, see MapBlock::getEmptiness()
+////
+
+// Every node is air
+#define BLOCK_EMPTY_AIR                      (1 << 0)
+// No node is pointable
+#define BLOCK_EMPTY_POINTABLE                (1 << 1)
+// No node is pointable or a liquid
+#define BLOCK_EMPTY_LIQUIDS_POINTABLE        (1 << 2)
+
 ////
 //// MapBlock itself
 ////
@@ -88,6 +99,7 @@ class MapBlock
 
 	void reallocate()
 	{
+		clearCompressedNodes();
 		delete[] data;
 		data = new MapNode[nodecount];
 		for (u32 i = 0; i < nodecount; i++)
@@ -96,11 +108,41 @@ class MapBlock
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_REALLOCATE);
 	}
 
+	// Returns the flat node array, expanding compressed node data first
 	MapNode* getData()
 	{
+		if (isCompressed())
+			expandNodes();
 		return data;
 	}
 
+	////
+	//// Compressed node storage
+	////
+
+	/*
+		Replaces the flat node array by a palette of the distinct nodes and
+		bit-packed indices into it, or by a single node for uniform blocks.
+		Blocks with more than 256 distinct nodes are left alone.
+		Any write expands the block back to the flat array.
+		Returns true if the block is compressed afterwards.
+	*/
+	bool compressNodes();
+
+	inline bool isCompressed() const
+	{
+		return !m_palette.empty();
+	}
+
+	// True if compressNodes() was called since the nodes were last written
+	inline bool isCompressionChecked() const
+	{
+		return m_compression_checked;
+	}
+
+	// Bytes used by the node storage of this block
+	u32 getNodeStorageSize() const;
+
 	////
 	//// Modification tracking methods
 	////
@@ -114,8 +156,11 @@ class MapBlock
 		} else if (mod == m_modified) {
 			m_modified_reason |= reason;
 		}
-		if (mod == MOD_STATE_WRITE_NEEDED)
+		if (mod == MOD_STATE_WRITE_NEEDED) {
 			contents_cached = false;
+			m_compression_checked = false;
+			m_emptiness_expired = true;
+		}
 	}
 
 	inline u32 getModified()
@@ -140,9 +185,9 @@ class MapBlock
 	//// Flags
 	////
 
-	inline bool isDummy()
+	inline bool isDummy() const
 	{
-		return !data;
+		return !data && !isCompressed();
 	}
 
 	inline void unDummify()
@@ -242,7 +287,7 @@ class MapBlock
 
 	inline bool isValidPosition(s16 x, s16 y, s16 z)
 	{
-		return data
+		return !isDummy()
 			&& x >= 0 && x < MAP_BLOCKSIZE
 			&& y >= 0 && y < MAP_BLOCKSIZE
 			&& z >= 0 && z < MAP_BLOCKSIZE;
@@ -260,7 +305,7 @@ class MapBlock
 		if (!*valid_position)
 			return {CONTENT_IGNORE};
 
-		return data[z * zstride + y * ystride + x];
+		return readNode(z * zstride + y * ystride + x);
 	}
 
 	inline MapNode getNode(v3s16 p, bool *valid_position)
@@ -279,6 +324,8 @@ class MapBlock
 		if (!isValidPosition(x, y, z))
 			throw InvalidPositionException();
 
+		if (isCompressed())
+			expandNodes();
 		data[z * zstride + y * ystride + x] = n;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
 	}
@@ -294,11 +341,11 @@ class MapBlock
 
 	inline MapNode getNodeNoCheck(s16 x, s16 y, s16 z, bool *valid_position)
 	{
-		*valid_position = data != nullptr;
+		*valid_position = !isDummy();
 		if (!*valid_position)
 			return {CONTENT_IGNORE};
 
-		return data[z * zstride + y * ystride + x];
+		return readNode(z * zstride + y * ystride + x);
 	}
 
 	inline MapNode getNodeNoCheck(v3s16 p, bool *valid_position)
@@ -312,21 +359,23 @@ class MapBlock
 	//// Caller must ensure that this is not a dummy block (by calling isDummy())
 	////
 
-	inline const MapNode &getNodeUnsafe(s16 x, s16 y, s16 z)
+	inline MapNode getNodeUnsafe(s16 x, s16 y, s16 z)
 	{
-		return data[z * zstride + y * ystride + x];
+		return readNode(z * zstride + y * ystride + x);
 	}
 
-	inline const MapNode &getNodeUnsafe(v3s16 &p)
+	inline MapNode getNodeUnsafe(v3s16 &p)
 	{
 		return getNodeUnsafe(p.X, p.Y, p.Z);
 	}
 
 	inline void setNodeNoCheck(s16 x, s16 y, s16 z, MapNode & n)
 	{
-		if (!data)
+		if (isDummy())
 			throw InvalidPositionException();
 
+		if (isCompressed())
+			expandNodes();
 		data[z * zstride + y * ystride + x] = n;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE_NO_CHECK);
 	}
@@ -363,6 +412,15 @@ class MapBlock
 		return m_day_night_differs;
 	}
 
+	// Returns the BLOCK_EMPTY_* flags that hold for this block.
+	// Raycasts use them to step over whole blocks.
+	inline u8 getEmptiness()
+	{
+		if (m_emptiness_expired)
+			updateEmptiness();
+		return m_emptiness;
+	}
+
 	////
 	//// Miscellaneous stuff
 	////
@@ -405,22 +463,21 @@ class MapBlock
 	}
 
 	////
-	//// Usage timer (see m_usage_timer)
+	//// Usage timer (see m_last_used)
 	////
 
-	inline void resetUsageTimer()
-	{
-		m_usage_timer = 0;
-	}
+	void resetUsageTimer();
+	float getUsageTimer() const;
 
-	inline void incrementUsageTimer(float dtime)
+	// Slot of the parent's unload queue this block is filed under
+	inline u32 getUnloadSlot() const
 	{
-		m_usage_timer += dtime;
+		return m_unload_slot;
 	}
 
-	inline float getUsageTimer()
+	inline void setUnloadSlot(u32 slot)
 	{
-		return m_usage_timer;
+		m_unload_slot = slot;
 	}
 
 	////
@@ -496,6 +553,8 @@ class MapBlock
 		if (!isValidPosition(x, y, z))
 			throw InvalidPositionException();
 
+		if (isCompressed())
+			expandNodes();
 		return data[z * zstride + y * ystride + x];
 	}
 
@@ -504,6 +563,30 @@ class MapBlock
 		return getNodeRef(p.X, p.Y, p.Z);
 	}
 
+	// Caller must ensure that this is not a dummy block
+	inline MapNode readNode(u32 i) const
+	{
+		if (data)
+			return data[i];
+		if (m_indices.empty())
+			return m_palette[0];
+
+		// m_index_shift is log2 of the bits per index, so indices never
+		// straddle two words
+		const u32 per_word_shift = 5 - m_index_shift;
+		const u32 word = m_indices[i >> per_word_shift];
+		const u32 bit = (i & ((1U << per_word_shift) - 1)) << m_index_shift;
+		return m_palette[(word >> bit) & ((1U << (1U << m_index_shift)) - 1)];
+	}
+
+	void updateEmptiness();
+
+	// Writes all nodes of a compressed block to dst
+	void decompressNodes(MapNode *dst) const;
+	// Turns a compressed block back into a flat array
+	void expandNodes();
+	void clearCompressedNodes();
+
 public:
 	/*
 		Public member variables
@@ -551,11 +634,21 @@ class MapBlock
 	IGameDef *m_gamedef;
 
 	/*
-		If NULL, block is a dummy block.
+		If NULL and there is no palette, block is a dummy block.
 		Dummy blocks are used for caching not-found-on-disk blocks.
 	*/
 	MapNode *data = nullptr;
 
+	/*
+		Compressed node storage, used instead of data when the palette
+		is not empty. Uniform blocks have a single palette entry and no
+		indices.
+	*/
+	std::vector<MapNode> m_palette;
+	std::vector<u32> m_indices;
+	u8 m_index_shift = 0;
+	bool m_compression_checked = false;
+
 	/*
 		- On the server, this is used for telling whether the
 		  block has been modified from the one on disk.
@@ -588,6 +681,10 @@ class MapBlock
 	bool m_day_night_differs = false;
 	bool m_day_night_differs_expired = true;
 
+	// BLOCK_EMPTY_* flags, recomputed on demand after the nodes change
+	u8 m_emptiness = 0;
+	bool m_emptiness_expired = true;
+
 	bool m_generated = false;
 
 	/*
@@ -599,10 +696,12 @@ class MapBlock
 	u32 m_disk_timestamp = BLOCK_TIMESTAMP_UNDEFINED;
 
 	/*
-		When the block is accessed, this is set to 0.
-		Map will unload the block when this reaches a timeout.
+		When the block is accessed, this is set to the parent's usage clock
+		(see Map::getUsageTime()). Map will unload the block when it has not
+		been accessed for a timeout.
 	*/
-	float m_usage_timer = 0;
+	double m_last_used = 0;
+	u32 m_unload_slot = 0;
 
 	/*
 		Reference count; currently used for determining if this block is in
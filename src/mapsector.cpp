@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "exceptions.h"
 #include "mapblock.h"
 #include "serialization.h"
+#include "map.h"
 
 MapSector::MapSector(Map *parent, v2s16 pos, IGameDef *gamedef):
 		m_parent(parent),
@@ -41,6 +42,7 @@ void MapSector::deleteBlocks()
 
 	// Delete all
 	for (auto &block : m_blocks) {
+		m_parent->unindexBlock(block.second);
 		delete block.second;
 	}
 
@@ -88,6 +90,7 @@ MapBlock * MapSector::createBlankBlock(s16 y)
 	MapBlock *block = createBlankBlockNoInsert(y);
 
 	m_blocks[y] = block;
+	m_parent->indexBlock(block);
 
 	return block;
 }
@@ -106,6 +109,7 @@ void MapSector::insertBlock(MapBlock *block)
 
 	// Insert into container
 	m_blocks[block_y] = block;
+	m_parent->indexBlock(block);
 }
 
 void MapSector::deleteBlock(MapBlock *block)
@@ -117,6 +121,7 @@ void MapSector::deleteBlock(MapBlock *block)
 
 	// Remove from container
 	m_blocks.erase(block_y);
+	m_parent->unindexBlock(block);
 
 	// Delete
 	delete block;
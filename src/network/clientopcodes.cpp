@@ -117,9 +117,9 @@ const ToClientCommandHandler toClientCommandTable[TOCLIENT_NUM_MSG_TYPES] =
 	{ "TOCLIENT_SET_SUN",                  TOCLIENT_STATE_CONNECTED, &Client::handleCommand_HudSetSun }, // 0x5a
 	{ "TOCLIENT_SET_MOON",                 TOCLIENT_STATE_CONNECTED, &Client::handleCommand_HudSetMoon }, // 0x5b
 	{ "TOCLIENT_SET_STARS",                TOCLIENT_STATE_CONNECTED, &Client::handleCommand_HudSetStars }, // 0x5c
-	null_command_handler,
-	null_command_handler,
-	null_command_handler,
+	{ "TOCLIENT_ACTIVE_OBJECT_STATES",     TOCLIENT_STATE_CONNECTED, &Client::handleCommand_ActiveObjectStates }, // 0x5d
+	{ "TOCLIENT_NODES_CHANGED",            TOCLIENT_STATE_CONNECTED, &Client::handleCommand_NodesChanged }, // 0x5e
+	{ "TOCLIENT_INVENTORY_DELTA",          TOCLIENT_STATE_CONNECTED, &Client::handleCommand_InventoryDelta }, // 0x5f
 	{ "TOCLIENT_SRP_BYTES_S_B",            TOCLIENT_STATE_NOT_CONNECTED, &Client::handleCommand_SrpBytesSandB }, // 0x60
 	{ "TOCLIENT_FORMSPEC_PREPEND",         TOCLIENT_STATE_CONNECTED, &Client::handleCommand_FormspecPrepend }, // 0x61,
 	{ "TOCLIENT_MINIMAP_MODES",            TOCLIENT_STATE_CONNECTED, &Client::handleCommand_MinimapModes }, // 0x62,
@@ -257,6 +257,28 @@ void Client::handleCommand_AddNode(NetworkPacket* pkt)
 	addNode(p, n, remove_metadata);
 }
 
+void Client::handleCommand_NodesChanged(NetworkPacket* pkt)
+{
+	// Meshes are updated once for all of the changes
+	std::map<v3s16, MapBlock*> modified_blocks;
+
+	while (pkt->getRemainingBytes() >= 6 + 2 + 1 + 1 + 1) {
+		v3s16 p;
+		MapNode n;
+		u8 keep_metadata;
+		*pkt >> p >> n.param0 >> n.param1 >> n.param2 >> keep_metadata;
+
+		try {
+			m_env.getMap().addNodeAndUpdate(p, n, modified_blocks,
+					keep_metadata == 0);
+		} catch (InvalidPositionException &e) {
+		}
+	}
+
+	for (const auto &modified_block : modified_blocks)
+		addUpdateMeshTaskWithEdge(modified_block.first, false, true);
+}
+
 void Client::handleCommand_NodemetaChanged(NetworkPacket *pkt)
 {
 	if (pkt->getSize() < 1)
@@ -313,6 +335,7 @@ void Client::handleCommand_BlockData(NetworkPacket* pkt)
 		*/
 		block->deSerialize(istr, m_server_ser_ver, false);
 		block->deSerializeNetworkSpecific(istr);
+		m_env.getMap().getCollisionCache().invalidateBlock(p);
 	}
 	else {
 		/*
@@ -480,6 +503,7 @@ void Client::handleCommand_ActiveObjectRemoveAdd(NetworkPacket* pkt)
 		for (u16 i = 0; i < removed_count; i++) {
 			*pkt >> id;
 			m_env.removeActiveObject(id);
+			m_object_states.erase(id);
 		}
 
 		// Read added objects
@@ -529,6 +553,24 @@ void Client::handleCommand_ActiveObjectMessages(NetworkPacket* pkt)
 	}
 }
 
+void Client::handleCommand_ActiveObjectStates(NetworkPacket* pkt)
+{
+	std::string datastring(pkt->getString(0), pkt->getSize());
+	std::istringstream is(datastring, std::ios_base::binary);
+
+	u16 id;
+	ObjectPosition pos;
+	while (is.peek() != EOF) {
+		if (readObjectState(is, m_object_states, id, pos)) {
+			m_env.processActiveObjectMessage(id, pos.serializeCommand());
+		} else if (is.fail()) {
+			errorstream << "Client::handleCommand_ActiveObjectStates: "
+				<< "truncated packet" << std::endl;
+			break;
+		}
+	}
+}
+
 void Client::handleCommand_Movement(NetworkPacket* pkt)
 {
 	LocalPlayer *player = m_env.getLocalPlayer();
@@ -697,6 +739,13 @@ void Client::handleCommand_AnnounceMedia(NetworkPacket* pkt)
 
 		*pkt >> str;
 
+		// A server that serves media itself doesn't know under which
+		// address it was reached
+		std::string server_addr = getAddressName();
+		if (server_addr.find(':') != std::string::npos)
+			server_addr = '[' + server_addr + ']';
+		str_replace(str, "$server", server_addr);
+
 		Strfnd sf(str);
 		while(!sf.at_end()) {
 			std::string baseurl = trim(sf.next(","));
@@ -987,6 +1036,50 @@ void Client::handleCommand_DetachedInventory(NetworkPacket* pkt)
 	inv->deSerialize(is);
 }
 
+void Client::handleCommand_InventoryDelta(NetworkPacket* pkt)
+{
+	u8 type;
+	*pkt >> type;
+
+	Inventory *inv = nullptr;
+	if (type == 0) {
+		LocalPlayer *player = m_env.getLocalPlayer();
+		assert(player != NULL);
+		inv = &player->inventory;
+	} else {
+		std::string name;
+		*pkt >> name;
+
+		const auto &inv_it = m_detached_inventories.find(name);
+		if (type == 2) {
+			if (inv_it != m_detached_inventories.end()) {
+				delete inv_it->second;
+				m_detached_inventories.erase(inv_it);
+			}
+			return;
+		}
+
+		if (inv_it == m_detached_inventories.end()) {
+			inv = new Inventory(m_itemdef);
+			m_detached_inventories[name] = inv;
+		} else {
+			inv = inv_it->second;
+		}
+	}
+
+	std::string contents(pkt->getRemainingString(), pkt->getRemainingBytes());
+	std::istringstream is(contents, std::ios::binary);
+	inv->deSerializeBinary(is);
+
+	if (type == 0) {
+		m_update_wielded_item = true;
+
+		delete m_inventory_from_server;
+		m_inventory_from_server = new Inventory(*inv);
+		m_inventory_from_server_age = 0.0;
+	}
+}
+
 void Client::handleCommand_ShowFormSpec(NetworkPacket* pkt)
 {
 	std::string formspec = readFormspec(pkt);
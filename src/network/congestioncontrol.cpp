@@ -0,0 +1,329 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "congestioncontrol.h"
+#include "mt_connection.h"
+#include "log.h"
+#include "util/numeric.h"
+#include <cmath>
+
+namespace con
+{
+
+/*
+	ClassicCongestionControl
+*/
+
+ClassicCongestionControl::ClassicCongestionControl() :
+	m_window_size(START_RELIABLE_WINDOW_SIZE)
+{
+}
+
+void ClassicCongestionControl::setWindowSize(s32 size)
+{
+	m_window_size = rangelim(size,
+			MIN_RELIABLE_WINDOW_SIZE, MAX_RELIABLE_WINDOW_SIZE_SEND);
+}
+
+void ClassicCongestionControl::onAcked(u32 packets, u32 bytes, u32 in_flight,
+		float rtt)
+{
+	m_packets_acked += packets;
+	m_bytes_acked += bytes;
+}
+
+void ClassicCongestionControl::onLost(u32 packets)
+{
+	m_packets_lost += packets;
+}
+
+void ClassicCongestionControl::onTooLate()
+{
+	m_packets_too_late++;
+}
+
+void ClassicCongestionControl::step(float dtime)
+{
+	m_loss_timer += dtime;
+	m_bytes_timer += dtime;
+
+	if (m_loss_timer > 1.0f) {
+		m_loss_timer -= 1.0f;
+
+		bool reasonable_amount_of_data_transmitted =
+				m_bytes_acked > m_window_size * 512 / 2;
+
+		// Packets too late means either packet duplication along the way
+		// or we were too fast in resending it (which should be self-regulating).
+		// Count this a signal of congestion, like packet loss.
+		u32 packet_loss = MYMIN(m_packets_lost + m_packets_too_late, m_packets_acked);
+		u32 packets_successful = m_packets_acked;
+		m_packets_lost = 0;
+		m_packets_too_late = 0;
+		m_packets_acked = 0;
+
+		/* dynamic window size */
+		float successful_to_lost_ratio = 0.0f;
+		bool done = false;
+
+		if (packets_successful > 0) {
+			successful_to_lost_ratio = (float)packet_loss / packets_successful;
+		} else if (packet_loss > 0) {
+			setWindowSize((s32)m_window_size - 10);
+			done = true;
+		}
+
+		if (!done) {
+			if (successful_to_lost_ratio < 0.01f) {
+				/* don't even think about increasing if we didn't even
+				 * use major parts of our window */
+				if (reasonable_amount_of_data_transmitted)
+					setWindowSize((s32)m_window_size + 100);
+			} else if (successful_to_lost_ratio < 0.05f) {
+				/* don't even think about increasing if we didn't even
+				 * use major parts of our window */
+				if (reasonable_amount_of_data_transmitted)
+					setWindowSize((s32)m_window_size + 50);
+			} else if (successful_to_lost_ratio > 0.15f) {
+				setWindowSize((s32)m_window_size - 100);
+			} else if (successful_to_lost_ratio > 0.1f) {
+				setWindowSize((s32)m_window_size - 50);
+			}
+		}
+	}
+
+	// The amount of data is judged over the same period as the rate statistics
+	if (m_bytes_timer > 10.0f) {
+		m_bytes_timer = 0.0f;
+		m_bytes_acked = 0;
+	}
+}
+
+/*
+	CubicCongestionControl
+*/
+
+// Scaling constant of the cubic curve, in packets/s^3
+#define CUBIC_C 0.4f
+// Multiplicative decrease factor
+#define CUBIC_BETA 0.7f
+// Round trip time assumed until one is measured
+#define CUBIC_INITIAL_RTT 0.5f
+
+CubicCongestionControl::CubicCongestionControl() :
+	m_cwnd(START_RELIABLE_WINDOW_SIZE),
+	m_ssthresh(MAX_RELIABLE_WINDOW_SIZE_SEND)
+{
+}
+
+void CubicCongestionControl::onAcked(u32 packets, u32 bytes, u32 in_flight,
+		float rtt)
+{
+	if (rtt >= 0.0f)
+		m_srtt = m_srtt < 0.0f ? rtt : m_srtt * 0.875f + rtt * 0.125f;
+
+	// Don't grow a window that isn't used, the application is the limit
+	if ((in_flight + packets) * 2 < m_cwnd)
+		return;
+
+	if (m_cwnd < m_ssthresh) {
+		// Slow start
+		m_cwnd += packets;
+	} else {
+		const float rtt_now = m_srtt < 0.0f ? CUBIC_INITIAL_RTT : m_srtt;
+		if (m_epoch_start < 0.0f) {
+			m_epoch_start = m_time;
+			if (m_cwnd < m_w_max) {
+				m_k = std::cbrt((m_w_max - m_cwnd) / CUBIC_C);
+			} else {
+				m_k = 0.0f;
+				m_w_max = m_cwnd;
+			}
+			m_w_est = m_cwnd;
+		}
+
+		// Where the curve will be one round trip from now
+		float t = m_time - m_epoch_start + rtt_now;
+		float target = m_w_max + CUBIC_C * (t - m_k) * (t - m_k) * (t - m_k);
+		target = rangelim(target, m_cwnd, m_cwnd * 1.5f);
+		if (target > m_cwnd)
+			m_cwnd += (target - m_cwnd) / m_cwnd * packets;
+		else
+			m_cwnd += 0.01f * packets / m_cwnd;
+
+		// Never be slower than a Reno sender would be
+		m_w_est += 3.0f * (1.0f - CUBIC_BETA) / (1.0f + CUBIC_BETA) *
+				packets / m_cwnd;
+		if (m_w_est > m_cwnd)
+			m_cwnd = m_w_est;
+	}
+
+	m_cwnd = MYMIN(m_cwnd, MAX_RELIABLE_WINDOW_SIZE_SEND);
+}
+
+void CubicCongestionControl::onLost(u32 packets)
+{
+	// The losses of one round trip are the same congestion event
+	if (packets == 0 || m_time < m_recovery_end)
+		return;
+	m_recovery_end = m_time + (m_srtt < 0.0f ? CUBIC_INITIAL_RTT : m_srtt);
+
+	m_epoch_start = -1.0f;
+	// Fast convergence: give room to newer flows if the window shrank
+	if (m_cwnd < m_w_max)
+		m_w_max = m_cwnd * (1.0f + CUBIC_BETA) / 2.0f;
+	else
+		m_w_max = m_cwnd;
+
+	m_cwnd = MYMAX(m_cwnd * CUBIC_BETA, MIN_RELIABLE_WINDOW_SIZE);
+	m_ssthresh = m_cwnd;
+}
+
+void CubicCongestionControl::step(float dtime)
+{
+	m_time += dtime;
+}
+
+/*
+	BBRCongestionControl
+*/
+
+// Window as a multiple of the bandwidth-delay product, the part above one
+// probes for more bandwidth
+#define BBR_WINDOW_GAIN 1.25f
+// Growth of the window per round during startup, at most
+#define BBR_STARTUP_GAIN 2.89f
+// Startup ends when the bandwidth grew less than this for a few rounds
+#define BBR_STARTUP_GROWTH 1.25f
+#define BBR_STARTUP_ROUNDS 3
+// How long the lowest round trip time is trusted
+#define BBR_MIN_RTT_LIFETIME 10.0f
+// Startup also ends when a round loses this share of its packets
+#define BBR_STARTUP_MAX_LOSS 0.2f
+// More loss than this after startup is not random, the window is too big
+#define BBR_MAX_LOSS 0.5f
+// Rounds are not shorter than this, to get useful rate samples. The send
+// thread may take that long to make use of an ACK, so it is also the
+// lowest round trip time used for the window.
+#define BBR_MIN_ROUND_TIME 0.05f
+
+BBRCongestionControl::BBRCongestionControl() :
+	m_cwnd(START_RELIABLE_WINDOW_SIZE)
+{
+}
+
+float BBRCongestionControl::getBandwidth() const
+{
+	float bandwidth = 0.0f;
+	for (float sample : m_bandwidth)
+		bandwidth = MYMAX(bandwidth, sample);
+	return bandwidth;
+}
+
+void BBRCongestionControl::onAcked(u32 packets, u32 bytes, u32 in_flight,
+		float rtt)
+{
+	if (rtt >= 0.0f && (m_min_rtt < 0.0f || rtt <= m_min_rtt ||
+			m_time - m_min_rtt_time > BBR_MIN_RTT_LIFETIME)) {
+		m_min_rtt = rtt;
+		m_min_rtt_time = m_time;
+	}
+
+	m_round_delivered += packets;
+	if ((in_flight + packets) * 2 < m_cwnd)
+		m_round_app_limited = true;
+
+	if (m_startup && !m_round_app_limited) {
+		// Like slow start, but no faster than the deliveries grow
+		float elapsed = MYMAX(m_time - m_round_start, BBR_MIN_ROUND_TIME);
+		float bandwidth = MYMAX(getBandwidth(), m_round_delivered / elapsed);
+		float limit = BBR_STARTUP_GAIN * bandwidth *
+				MYMAX(m_min_rtt, BBR_MIN_ROUND_TIME);
+		if (m_cwnd < limit)
+			m_cwnd = MYMIN(m_cwnd + packets, MAX_RELIABLE_WINDOW_SIZE_SEND);
+	}
+
+	if (m_time - m_round_start >= MYMAX(m_min_rtt, BBR_MIN_ROUND_TIME))
+		endRound();
+}
+
+void BBRCongestionControl::endRound()
+{
+	float sample = m_round_delivered / (m_time - m_round_start);
+	float bandwidth = getBandwidth();
+	// A sender that doesn't use its window says little about the link,
+	// unless it was faster than that anyway
+	if (!m_round_app_limited || sample > bandwidth) {
+		m_bandwidth[m_round % BBR_BANDWIDTH_ROUNDS] = sample;
+		m_round++;
+		bandwidth = getBandwidth();
+	}
+
+	bool heavy_loss = m_round_lost > m_round_delivered * BBR_STARTUP_MAX_LOSS;
+	bool overflow = m_round_lost > m_round_delivered * BBR_MAX_LOSS;
+	m_round_start = m_time;
+	m_round_delivered = 0;
+	m_round_lost = 0;
+	m_round_app_limited = false;
+
+	if (m_startup) {
+		if (heavy_loss) {
+			m_startup = false;
+		} else if (bandwidth >= m_full_bandwidth * BBR_STARTUP_GROWTH) {
+			m_full_bandwidth = bandwidth;
+			m_full_bandwidth_rounds = 0;
+		} else if (++m_full_bandwidth_rounds >= BBR_STARTUP_ROUNDS) {
+			m_startup = false;
+		}
+	}
+
+	if (!m_startup && overflow) {
+		// The queue overflows, forget the rates that led there
+		for (float &bw : m_bandwidth)
+			bw = MYMIN(bw, sample);
+		bandwidth = getBandwidth();
+	}
+
+	if (!m_startup && m_min_rtt >= 0.0f) {
+		float window = (overflow ? 1.0f : BBR_WINDOW_GAIN) * bandwidth *
+				MYMAX(m_min_rtt, BBR_MIN_ROUND_TIME);
+		m_cwnd = rangelim((u32)window,
+				MIN_RELIABLE_WINDOW_SIZE, MAX_RELIABLE_WINDOW_SIZE_SEND);
+	}
+}
+
+void BBRCongestionControl::step(float dtime)
+{
+	m_time += dtime;
+}
+
+std::unique_ptr<CongestionControl> createCongestionControl(const std::string &name)
+{
+	if (name == "cubic")
+		return std::unique_ptr<CongestionControl>(new CubicCongestionControl());
+	if (name == "bbr")
+		return std::unique_ptr<CongestionControl>(new BBRCongestionControl());
+	if (name != "classic") {
+		warningstream << "Unknown congestion control algorithm \"" << name
+			<< "\", using classic" << std::endl;
+	}
+	return std::unique_ptr<CongestionControl>(new ClassicCongestionControl());
+}
+
+} // namespace con
@@ -0,0 +1,185 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include <memory>
+#include <string>
+
+namespace con
+{
+
+/*
+	Decides how many reliable packets of a channel may be on the wire
+	without being acknowledged.
+
+	All times are in seconds. The owner serializes the calls.
+*/
+class CongestionControl
+{
+public:
+	virtual ~CongestionControl() = default;
+
+	virtual const char *getName() const = 0;
+
+	// Packets in flight that may not be exceeded when sending
+	virtual u32 getWindowSize() const = 0;
+
+	/*
+		Some packets were acknowledged.
+		in_flight: number of unacknowledged packets before this ACK
+		rtt: round trip time measured by this ACK, < 0 if unknown
+	*/
+	virtual void onAcked(u32 packets, u32 bytes, u32 in_flight, float rtt) = 0;
+
+	// Some packets are going to be resent because they were not acknowledged
+	virtual void onLost(u32 packets) = 0;
+
+	// A packet was acknowledged after it has been resent already
+	virtual void onTooLate() {}
+
+	virtual void step(float dtime) = 0;
+};
+
+/*
+	The original heuristic: once a second, grow or shrink the window
+	depending on the ratio of lost to acknowledged packets.
+*/
+class ClassicCongestionControl : public CongestionControl
+{
+public:
+	ClassicCongestionControl();
+
+	const char *getName() const { return "classic"; }
+	u32 getWindowSize() const { return m_window_size; }
+
+	void onAcked(u32 packets, u32 bytes, u32 in_flight, float rtt);
+	void onLost(u32 packets);
+	void onTooLate();
+	void step(float dtime);
+
+private:
+	void setWindowSize(s32 size);
+
+	u32 m_window_size;
+	u32 m_packets_lost = 0;
+	u32 m_packets_too_late = 0;
+	u32 m_packets_acked = 0;
+	u32 m_bytes_acked = 0;
+	float m_loss_timer = 0.0f;
+	float m_bytes_timer = 0.0f;
+};
+
+/*
+	CUBIC (RFC 8312) counted in packets: after a loss the window is cut
+	to BETA and then grows along a cubic curve that is flat around the
+	window size the loss happened at. Losses are acted upon at most once
+	per round trip, and the window only grows while it is actually used.
+*/
+class CubicCongestionControl : public CongestionControl
+{
+public:
+	CubicCongestionControl();
+
+	const char *getName() const { return "cubic"; }
+	u32 getWindowSize() const { return (u32)m_cwnd; }
+
+	void onAcked(u32 packets, u32 bytes, u32 in_flight, float rtt);
+	void onLost(u32 packets);
+	void step(float dtime);
+
+	float getSmoothedRTT() const { return m_srtt; }
+
+private:
+	float m_cwnd;
+	float m_ssthresh;
+	// Window size at the last loss
+	float m_w_max = 0.0f;
+	// Time from the start of an epoch until the window reaches m_w_max
+	float m_k = 0.0f;
+	// Start of the current congestion avoidance epoch, < 0 if none
+	double m_epoch_start = -1.0;
+	// Estimate of the window a Reno sender would have
+	float m_w_est = 0.0f;
+	float m_srtt = -1.0f;
+	// Sum of the step times. A float would stop advancing after about
+	// a day and a half.
+	double m_time = 0.0;
+	// Losses before this time belong to the last reduction
+	double m_recovery_end = 0.0;
+};
+
+/*
+	A window-only take on BBR: the window is a multiple of the product of
+	the bottleneck bandwidth (the highest delivery rate over the last few
+	round trips) and the lowest round trip time seen lately. It starts out
+	like slow start until the bandwidth stops growing or packets get
+	dropped in bulk. After that, random loss does not shrink the window,
+	which keeps lossy high-latency links busy. Only losing more than it
+	delivers drops the probing and the old rate samples.
+*/
+#define BBR_BANDWIDTH_ROUNDS 10
+
+class BBRCongestionControl : public CongestionControl
+{
+public:
+	BBRCongestionControl();
+
+	const char *getName() const { return "bbr"; }
+	u32 getWindowSize() const { return m_cwnd; }
+
+	void onAcked(u32 packets, u32 bytes, u32 in_flight, float rtt);
+	void onLost(u32 packets) { m_round_lost += packets; }
+	void step(float dtime);
+
+	// In packets/s
+	float getBandwidth() const;
+	float getMinRTT() const { return m_min_rtt; }
+	bool isStartup() const { return m_startup; }
+
+private:
+	void endRound();
+
+	u32 m_cwnd;
+	bool m_startup = true;
+	// Bandwidth when it last grew noticeably during startup
+	float m_full_bandwidth = 0.0f;
+	u32 m_full_bandwidth_rounds = 0;
+
+	float m_min_rtt = -1.0f;
+	double m_min_rtt_time = 0.0;
+
+	// Delivery rate samples of the last rounds
+	float m_bandwidth[BBR_BANDWIDTH_ROUNDS] = {};
+	u32 m_round = 0;
+	double m_round_start = 0.0;
+	u32 m_round_delivered = 0;
+	u32 m_round_lost = 0;
+	// The window was not used up at some point in this round
+	bool m_round_app_limited = false;
+
+	// Sum of the step times, double for the same reason as in CUBIC
+	double m_time = 0.0;
+};
+
+// Returns the default algorithm for unknown names
+std::unique_ptr<CongestionControl> createCongestionControl(const std::string &name);
+
+} // namespace con
@@ -169,6 +169,63 @@ SharedBuffer<u8> makeReliablePacket(const SharedBuffer<u8> &data, u16 seqnum)
 	return b;
 }
 
+bool ReliableAck::covers(u16 s) const
+{
+	if (s == seqnum)
+		return true;
+	if (!extended)
+		return false;
+	if ((s16)(next_expected - s) > 0)
+		return true;
+	for (const auto &range : ranges) {
+		if ((s16)(s - range.first) >= 0 && (s16)(range.second - s) >= 0)
+			return true;
+	}
+	return false;
+}
+
+SharedBuffer<u8> makeAckPacket(const ReliableAck &ack)
+{
+	u32 range_count = ack.extended ? MYMIN(ack.ranges.size(), ACK_MAX_RANGES) : 0;
+	SharedBuffer<u8> b(ack.extended ? 7 + range_count * 4 : 4);
+
+	writeU8(&b[0], PACKET_TYPE_CONTROL);
+	writeU8(&b[1], CONTROLTYPE_ACK);
+	writeU16(&b[2], ack.seqnum);
+	if (!ack.extended)
+		return b;
+
+	writeU16(&b[4], ack.next_expected);
+	writeU8(&b[6], range_count);
+	for (u32 i = 0; i < range_count; i++) {
+		writeU16(&b[7 + i * 4], ack.ranges[i].first);
+		writeU16(&b[9 + i * 4], ack.ranges[i].second);
+	}
+	return b;
+}
+
+ReliableAck readAckPacket(const SharedBuffer<u8> &data)
+{
+	if (data.getSize() < 4)
+		throw InvalidIncomingDataException("packetdata.getSize() < 4 (ACK header size)");
+
+	ReliableAck ack;
+	ack.seqnum = readU16(&data[2]);
+	if (data.getSize() < 7)
+		return ack;
+
+	ack.extended = true;
+	ack.next_expected = readU16(&data[4]);
+	u32 range_count = readU8(&data[6]);
+	if (range_count > ACK_MAX_RANGES || data.getSize() < 7 + range_count * 4)
+		throw InvalidIncomingDataException("Invalid ACK ranges");
+
+	ack.ranges.reserve(range_count);
+	for (u32 i = 0; i < range_count; i++)
+		ack.ranges.emplace_back(readU16(&data[7 + i * 4]), readU16(&data[9 + i * 4]));
+	return ack;
+}
+
 /*
 	ReliablePacketBuffer
 */
@@ -177,85 +234,208 @@ void ReliablePacketBuffer::print()
 {
 	MutexAutoLock listlock(m_list_mutex);
 	LOG(dout_con<<"Dump of ReliablePacketBuffer:" << std::endl);
+	if (m_count == 0)
+		return;
 	unsigned int index = 0;
-	for (BufferedPacket &bufferedPacket : m_list) {
-		u16 s = readU16(&(bufferedPacket.data[BASE_HEADER_SIZE+1]));
-		LOG(dout_con<<index<< ":" << s << std::endl);
-		index++;
+	for (u16 s = m_first;; s++) {
+		if (findSlot(s)) {
+			LOG(dout_con<<index<< ":" << s << std::endl);
+			index++;
+		}
+		if (s == m_last)
+			break;
 	}
 }
 
 bool ReliablePacketBuffer::empty()
 {
 	MutexAutoLock listlock(m_list_mutex);
-	return m_list.empty();
+	return m_count == 0;
 }
 
 u32 ReliablePacketBuffer::size()
 {
 	MutexAutoLock listlock(m_list_mutex);
-	return m_list.size();
+	return m_count;
 }
 
-RPBSearchResult ReliablePacketBuffer::findPacket(u16 seqnum)
+u32 ReliablePacketBuffer::capacity()
 {
-	std::list<BufferedPacket>::iterator i = m_list.begin();
-	for(; i != m_list.end(); ++i)
-	{
-		u16 s = readU16(&(i->data[BASE_HEADER_SIZE+1]));
-		if (s == seqnum)
-			break;
+	MutexAutoLock listlock(m_list_mutex);
+	return m_slots.size();
+}
+
+ReliablePacketBuffer::Slot *ReliablePacketBuffer::findSlot(u16 seqnum)
+{
+	if (m_count == 0)
+		return nullptr;
+	Slot &slot = m_slots[seqnum & (m_slots.size() - 1)];
+	if (!slot.packet || slot.seqnum != seqnum)
+		return nullptr;
+	return &slot;
+}
+
+void ReliablePacketBuffer::grow(u32 span)
+{
+	u32 capacity = MYMAX(m_slots.size(), RELIABLE_BUFFER_MIN_SLOTS);
+	while (capacity < span)
+		capacity *= 2;
+	if (capacity == m_slots.size())
+		return;
+
+	std::vector<Slot> slots(capacity);
+	for (Slot &slot : m_slots) {
+		if (slot.packet)
+			slots[slot.seqnum & (capacity - 1)] = std::move(slot);
+	}
+	m_slots.swap(slots);
+}
+
+BufferedPacket ReliablePacketBuffer::take(Slot &slot)
+{
+	BufferedPacket p = std::move(*slot.packet);
+	p.time = m_time - slot.sent_at;
+	p.totaltime = m_time - slot.buffered_at;
+	slot.packet.reset();
+
+	if ((s32)(slot.send_id - m_newest_taken_send_id) > 0)
+		m_newest_taken_send_id = slot.send_id;
+
+	u16 seqnum = slot.seqnum;
+	m_count--;
+	if (m_count != 0) {
+		// Skip the holes left by packets that are gone already
+		if (seqnum == m_first) {
+			do
+				m_first++;
+			while (!findSlot(m_first));
+		} else if (seqnum == m_last) {
+			do
+				m_last--;
+			while (!findSlot(m_last));
+		}
 	}
-	return i;
+
+	if (m_resend_entries > 2 * m_count + RELIABLE_BUFFER_MIN_SLOTS)
+		compactResendQueues();
+
+	return p;
 }
 
 bool ReliablePacketBuffer::getFirstSeqnum(u16& result)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	if (m_list.empty())
+	if (m_count == 0)
 		return false;
-	const BufferedPacket &p = m_list.front();
-	result = readU16(&p.data[BASE_HEADER_SIZE + 1]);
+	result = m_first;
 	return true;
 }
 
 BufferedPacket ReliablePacketBuffer::popFirst()
 {
 	MutexAutoLock listlock(m_list_mutex);
-	if (m_list.empty())
+	if (m_count == 0)
 		throw NotFoundException("Buffer is empty");
-	BufferedPacket p = std::move(m_list.front());
-	m_list.pop_front();
-
-	if (m_list.empty()) {
-		m_oldest_non_answered_ack = 0;
-	} else {
-		m_oldest_non_answered_ack =
-				readU16(&m_list.front().data[BASE_HEADER_SIZE + 1]);
-	}
-	return p;
+	return take(*findSlot(m_first));
 }
 
 BufferedPacket ReliablePacketBuffer::popSeqnum(u16 seqnum)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	RPBSearchResult r = findPacket(seqnum);
-	if (r == notFound()) {
+	Slot *slot = findSlot(seqnum);
+	if (!slot) {
 		LOG(dout_con<<"Sequence number: " << seqnum
 				<< " not found in reliable buffer"<<std::endl);
 		throw NotFoundException("seqnum not found in buffer");
 	}
-	BufferedPacket p = std::move(*r);
+	return take(*slot);
+}
 
-	m_list.erase(r);
+u32 ReliablePacketBuffer::popAcked(const ReliableAck &ack, u32 &bytes)
+{
+	MutexAutoLock listlock(m_list_mutex);
+	u32 popped = 0;
+	auto pop = [&] (u16 seqnum) {
+		Slot *slot = findSlot(seqnum);
+		if (!slot || seqnum == ack.seqnum)
+			return;
+		bytes += slot->packet->data.getSize();
+		take(*slot);
+		popped++;
+	};
 
-	if (m_list.empty()) {
-		m_oldest_non_answered_ack = 0;
-	} else {
-		m_oldest_non_answered_ack =
-				readU16(&m_list.front().data[BASE_HEADER_SIZE + 1]);
+	// Everything before next_expected
+	while (m_count != 0 && (s16)(ack.next_expected - m_first) > 0)
+		pop(m_first);
+
+	for (const auto &range : ack.ranges) {
+		if (m_count == 0)
+			break;
+		// Only look at the part of the range that can be in the buffer
+		u16 first = range.first, last = range.second;
+		if ((s16)(last - first) < 0)
+			continue;
+		if ((s16)(first - m_first) < 0)
+			first = m_first;
+		if ((s16)(last - m_last) > 0)
+			last = m_last;
+		if ((s16)(last - first) < 0)
+			continue;
+		for (u16 seqnum = first;; seqnum++) {
+			pop(seqnum);
+			if (seqnum == last || m_count == 0)
+				break;
+		}
 	}
-	return p;
+	return popped;
+}
+
+void ReliablePacketBuffer::getRanges(std::vector<std::pair<u16, u16>> &ranges,
+		u32 max_ranges)
+{
+	MutexAutoLock listlock(m_list_mutex);
+	if (m_count == 0)
+		return;
+
+	u16 seqnum = m_first;
+	u32 found = 0;
+	while (ranges.size() < max_ranges) {
+		// seqnum is in the buffer here
+		u16 first = seqnum;
+		while (++found < m_count && findSlot(seqnum + 1))
+			seqnum++;
+		ranges.emplace_back(first, seqnum);
+		if (found == m_count)
+			break;
+
+		do
+			seqnum++;
+		while (!findSlot(seqnum));
+	}
+}
+
+u32 ReliablePacketBuffer::markLost(u32 threshold)
+{
+	MutexAutoLock listlock(m_list_mutex);
+	u32 marked = 0;
+	if (m_count == 0)
+		return marked;
+
+	// Holes are filled oldest first, so only look at the start
+	u16 seqnum = m_first;
+	for (u32 i = 0; i < RELIABLE_BUFFER_MIN_SLOTS; i++, seqnum++) {
+		Slot *slot = findSlot(seqnum);
+		if (slot && !slot->lost &&
+				(s32)(m_newest_taken_send_id - slot->send_id) >= (s32)threshold) {
+			slot->lost = true;
+			m_lost_queue.push_back({slot->seqnum, slot->send_id});
+			m_resend_entries++;
+			marked++;
+		}
+		if (seqnum == m_last)
+			break;
+	}
+	return marked;
 }
 
 void ReliablePacketBuffer::insert(const BufferedPacket &p, u16 next_expected)
@@ -285,82 +465,89 @@ void ReliablePacketBuffer::insert(const BufferedPacket &p, u16 next_expected)
 		return;
 	}
 
-	sanity_check(m_list.size() <= SEQNUM_MAX); // FIXME: Handle the error?
-
-	// Find the right place for the packet and insert it there
-	// If list is empty, just add it
-	if (m_list.empty())
-	{
-		m_list.push_back(p);
-		m_oldest_non_answered_ack = seqnum;
-		// Done.
-		return;
-	}
-
-	// Otherwise find the right place
-	std::list<BufferedPacket>::iterator i = m_list.begin();
-	// Find the first packet in the list which has a higher seqnum
-	u16 s = readU16(&(i->data[BASE_HEADER_SIZE+1]));
-
-	/* case seqnum is smaller then next_expected seqnum */
-	/* this is true e.g. on wrap around */
-	if (seqnum < next_expected) {
-		while(((s < seqnum) || (s >= next_expected)) && (i != m_list.end())) {
-			++i;
-			if (i != m_list.end())
-				s = readU16(&(i->data[BASE_HEADER_SIZE+1]));
-		}
-	}
-	/* non wrap around case (at least for incoming and next_expected */
-	else
-	{
-		while(((s < seqnum) && (s >= next_expected)) && (i != m_list.end())) {
-			++i;
-			if (i != m_list.end())
-				s = readU16(&(i->data[BASE_HEADER_SIZE+1]));
-		}
-	}
-
-	if (s == seqnum) {
+	if (Slot *slot = findSlot(seqnum)) {
 		/* nothing to do this seems to be a resent packet */
 		/* for paranoia reason data should be compared */
-		if (
-			(readU16(&(i->data[BASE_HEADER_SIZE+1])) != seqnum) ||
-			(i->data.getSize() != p.data.getSize()) ||
-			(i->address != p.address)
-			)
-		{
+		BufferedPacket &old = *slot->packet;
+		if (old.data.getSize() != p.data.getSize() || old.address != p.address) {
 			/* if this happens your maximum transfer window may be to big */
 			fprintf(stderr,
 					"Duplicated seqnum %d non matching packet detected:\n",
 					seqnum);
 			fprintf(stderr, "Old: seqnum: %05d size: %04d, address: %s\n",
-					readU16(&(i->data[BASE_HEADER_SIZE+1])),i->data.getSize(),
-					i->address.serializeString().c_str());
+					readU16(&(old.data[BASE_HEADER_SIZE+1])), old.data.getSize(),
+					old.address.serializeString().c_str());
 			fprintf(stderr, "New: seqnum: %05d size: %04u, address: %s\n",
-					readU16(&(p.data[BASE_HEADER_SIZE+1])),p.data.getSize(),
+					readU16(&(p.data[BASE_HEADER_SIZE+1])), p.data.getSize(),
 					p.address.serializeString().c_str());
 			throw IncomingDataCorruption("duplicated packet isn't same as original one");
 		}
+		return;
 	}
-	/* insert or push back */
-	else if (i != m_list.end()) {
-		m_list.insert(i, p);
-	} else {
-		m_list.push_back(p);
+
+	// The seqnums in the buffer never span more than half of the seqnum
+	// space (see MAX_RELIABLE_WINDOW_SIZE), so a signed difference orders
+	// them correctly across wrap-arounds
+	u16 first = seqnum, last = seqnum;
+	if (m_count != 0) {
+		first = (s16)(seqnum - m_first) < 0 ? seqnum : m_first;
+		last = (s16)(seqnum - m_last) > 0 ? seqnum : m_last;
 	}
+	u32 span = (u16)(last - first) + 1;
+	if (span > m_slots.size())
+		grow(span);
+
+	Slot &slot = m_slots[seqnum & (m_slots.size() - 1)];
+	slot.packet.reset(new BufferedPacket(p));
+	slot.seqnum = seqnum;
+	slot.lost = false;
+	slot.buffered_at = m_time - p.totaltime;
+	slot.sent_at = m_time - p.time;
+	m_first = first;
+	m_last = last;
+	m_count++;
+
+	queueResend(slot);
+}
+
+void ReliablePacketBuffer::queueResend(Slot &slot)
+{
+	slot.send_id = m_next_send_id++;
+	if (m_next_send_id == 0)
+		m_next_send_id = 1;
+	slot.lost = false;
+
+	u32 queue = MYMIN(slot.packet->resend_count, RELIABLE_BUFFER_RESEND_QUEUES - 1);
+	m_resend_queues[queue].push_back({slot.seqnum, slot.send_id});
+	m_resend_entries++;
+}
+
+bool ReliablePacketBuffer::isResendEntryCurrent(const ResendEntry &entry)
+{
+	Slot *slot = findSlot(entry.seqnum);
+	return slot && slot->send_id == entry.send_id;
+}
 
-	/* update last packet number */
-	m_oldest_non_answered_ack = readU16(&m_list.front().data[BASE_HEADER_SIZE+1]);
+void ReliablePacketBuffer::compactResendQueues()
+{
+	auto compact = [this] (std::deque<ResendEntry> &queue) {
+		queue.erase(std::remove_if(queue.begin(), queue.end(),
+			[this] (const ResendEntry &entry) {
+				return !isResendEntryCurrent(entry);
+			}), queue.end());
+		m_resend_entries += queue.size();
+	};
+
+	m_resend_entries = 0;
+	for (std::deque<ResendEntry> &queue : m_resend_queues)
+		compact(queue);
+	compact(m_lost_queue);
 }
 
 void ReliablePacketBuffer::incrementTimeouts(float dtime)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	for (BufferedPacket &bufferedPacket : m_list) {
-		bufferedPacket.time += dtime;
-		bufferedPacket.totaltime += dtime;
-	}
+	m_time += dtime;
 }
 
 std::list<BufferedPacket>
@@ -368,22 +555,52 @@ std::list<BufferedPacket>
 {
 	MutexAutoLock listlock(m_list_mutex);
 	std::list<BufferedPacket> timed_outs;
-	for (BufferedPacket &bufferedPacket : m_list) {
-		// resend time scales exponentially with each cycle
-		const float pkt_timeout = timeout *
-				powf(RESEND_SCALE_BASE, bufferedPacket.resend_count);
-
-		if (bufferedPacket.time < pkt_timeout)
-			continue;
 
+	auto resend = [&] (Slot *slot) {
+		BufferedPacket &p = *slot->packet;
 		// caller will resend packet so reset time and increase counter
-		bufferedPacket.time = 0.0f;
-		bufferedPacket.resend_count++;
+		slot->sent_at = m_time;
+		p.resend_count++;
+		queueResend(*slot);
+
+		timed_outs.push_back(p);
+		BufferedPacket &copy = timed_outs.back();
+		copy.time = 0.0f;
+		copy.totaltime = m_time - slot->buffered_at;
+	};
+
+	// Packets known to be lost don't have to wait for the timeout
+	while (!m_lost_queue.empty() && timed_outs.size() < max_packets) {
+		ResendEntry entry = m_lost_queue.front();
+		m_lost_queue.pop_front();
+		m_resend_entries--;
+		if (isResendEntryCurrent(entry))
+			resend(findSlot(entry.seqnum));
+	}
 
-		timed_outs.push_back(bufferedPacket);
+	for (std::deque<ResendEntry> &queue : m_resend_queues) {
+		// Each queue is ordered by the time of sending, stop at the first
+		// one that has not timed out yet
+		while (!queue.empty() && timed_outs.size() < max_packets) {
+			Slot *slot = findSlot(queue.front().seqnum);
+			if (!slot || slot->send_id != queue.front().send_id) {
+				queue.pop_front();
+				m_resend_entries--;
+				continue;
+			}
 
-		if (timed_outs.size() >= max_packets)
-			break;
+			BufferedPacket &p = *slot->packet;
+			// resend time scales exponentially with each cycle
+			const float pkt_timeout = timeout *
+					powf(RESEND_SCALE_BASE, p.resend_count);
+
+			if (m_time - slot->sent_at < pkt_timeout)
+				break;
+
+			queue.pop_front();
+			m_resend_entries--;
+			resend(slot);
+		}
 	}
 	return timed_outs;
 }
@@ -437,9 +654,23 @@ SharedBuffer<u8> IncomingSplitPacket::reassemble()
 IncomingSplitBuffer::~IncomingSplitBuffer()
 {
 	MutexAutoLock listlock(m_map_mutex);
-	for (auto &i : m_buf) {
-		delete i.second;
+	for (Slot &slot : m_buf) {
+		delete slot.packet;
+	}
+	for (auto &it : m_overflow) {
+		delete it.second;
+	}
+}
+
+u32 IncomingSplitBuffer::size()
+{
+	MutexAutoLock listlock(m_map_mutex);
+	u32 count = 0;
+	for (const Slot &slot : m_buf) {
+		if (slot.packet)
+			count++;
 	}
+	return count + m_overflow.size();
 }
 
 SharedBuffer<u8> IncomingSplitBuffer::insert(const BufferedPacket &p, bool reliable)
@@ -466,14 +697,36 @@ SharedBuffer<u8> IncomingSplitBuffer::insert(const BufferedPacket &p, bool relia
 		return SharedBuffer<u8>();
 	}
 
-	// Add if doesn't exist
-	IncomingSplitPacket *sp;
-	if (m_buf.find(seqnum) == m_buf.end()) {
-		sp = new IncomingSplitPacket(chunk_count, reliable);
-		m_buf[seqnum] = sp;
-	} else {
-		sp = m_buf[seqnum];
+	// Reliable and unreliable split packets share the seqnums, so a slot
+	// may still be taken by an older packet. That one can't be dropped:
+	// the chunks of a reliable packet are acknowledged already.
+	Slot &slot = m_buf[seqnum % SPLIT_BUFFER_SLOTS];
+	// A seqnum is either in its slot or in the overflow, never in both
+	IncomingSplitPacket **entry = nullptr;
+	bool in_overflow = false;
+	if (slot.packet && slot.seqnum == seqnum) {
+		entry = &slot.packet;
+	} else if (!m_overflow.empty()) {
+		auto it = m_overflow.find(seqnum);
+		if (it != m_overflow.end()) {
+			entry = &it->second;
+			in_overflow = true;
+		}
 	}
+	if (!entry) {
+		if (!slot.packet) {
+			slot.seqnum = seqnum;
+			entry = &slot.packet;
+		} else {
+			entry = &m_overflow[seqnum];
+			in_overflow = true;
+		}
+	}
+
+	// Add if doesn't exist
+	if (!*entry)
+		*entry = new IncomingSplitPacket(chunk_count, reliable);
+	IncomingSplitPacket *sp = *entry;
 
 	if (chunk_count != sp->chunk_count) {
 		errorstream << "IncomingSplitBuffer::insert(): chunk_count="
@@ -501,7 +754,10 @@ SharedBuffer<u8> IncomingSplitBuffer::insert(const BufferedPacket &p, bool relia
 	SharedBuffer<u8> fulldata = sp->reassemble();
 
 	// Remove sp from buffer
-	m_buf.erase(seqnum);
+	if (in_overflow)
+		m_overflow.erase(seqnum);
+	else
+		slot.packet = nullptr;
 	delete sp;
 
 	return fulldata;
@@ -509,24 +765,31 @@ SharedBuffer<u8> IncomingSplitBuffer::insert(const BufferedPacket &p, bool relia
 
 void IncomingSplitBuffer::removeUnreliableTimedOuts(float dtime, float timeout)
 {
-	std::deque<u16> remove_queue;
-	{
-		MutexAutoLock listlock(m_map_mutex);
-		for (auto &i : m_buf) {
-			IncomingSplitPacket *p = i.second;
-			// Reliable ones are not removed by timeout
-			if (p->reliable)
-				continue;
-			p->time += dtime;
-			if (p->time >= timeout)
-				remove_queue.push_back(i.first);
+	MutexAutoLock listlock(m_map_mutex);
+	for (Slot &slot : m_buf) {
+		IncomingSplitPacket *p = slot.packet;
+		// Reliable ones are not removed by timeout
+		if (!p || p->reliable)
+			continue;
+		p->time += dtime;
+		if (p->time >= timeout) {
+			LOG(dout_con<<"NOTE: Removing timed out unreliable split packet"<<std::endl);
+			delete p;
+			slot.packet = nullptr;
 		}
 	}
-	for (u16 j : remove_queue) {
-		MutexAutoLock listlock(m_map_mutex);
-		LOG(dout_con<<"NOTE: Removing timed out unreliable split packet"<<std::endl);
-		delete m_buf[j];
-		m_buf.erase(j);
+	for (auto it = m_overflow.begin(); it != m_overflow.end();) {
+		IncomingSplitPacket *p = it->second;
+		if (!p->reliable) {
+			p->time += dtime;
+			if (p->time >= timeout) {
+				LOG(dout_con<<"NOTE: Removing timed out unreliable split packet"<<std::endl);
+				delete p;
+				it = m_overflow.erase(it);
+				continue;
+			}
+		}
+		++it;
 	}
 }
 
@@ -578,6 +841,7 @@ u16 Channel::getOutgoingSequenceNumber(bool& successful)
 	MutexAutoLock internal(m_internal_mutex);
 	u16 retval = next_outgoing_seqnum;
 	u16 lowest_unacked_seqnumber;
+	const u32 window_size = m_congestion_control->getWindowSize();
 
 	/* shortcut if there ain't any packet in outgoing list */
 	if (outgoing_reliables_sent.empty())
@@ -629,11 +893,18 @@ bool Channel::putBackSequenceNumber(u16 seqnum)
 	return false;
 }
 
-void Channel::UpdateBytesSent(unsigned int bytes, unsigned int packets)
+void Channel::setCongestionControl(std::unique_ptr<CongestionControl> congestion_control)
+{
+	MutexAutoLock internal(m_internal_mutex);
+	m_congestion_control = std::move(congestion_control);
+}
+
+void Channel::UpdatePacketsAcked(unsigned int packets, unsigned int bytes,
+		unsigned int in_flight, float rtt)
 {
 	MutexAutoLock internal(m_internal_mutex);
 	current_bytes_transfered += bytes;
-	current_packet_successful += packets;
+	m_congestion_control->onAcked(packets, bytes, in_flight, rtt);
 }
 
 void Channel::UpdateBytesReceived(unsigned int bytes) {
@@ -651,76 +922,22 @@ void Channel::UpdateBytesLost(unsigned int bytes)
 void Channel::UpdatePacketLossCounter(unsigned int count)
 {
 	MutexAutoLock internal(m_internal_mutex);
-	current_packet_loss += count;
+	m_congestion_control->onLost(count);
 }
 
 void Channel::UpdatePacketTooLateCounter()
 {
 	MutexAutoLock internal(m_internal_mutex);
-	current_packet_too_late++;
+	m_congestion_control->onTooLate();
 }
 
 void Channel::UpdateTimers(float dtime)
 {
 	bpm_counter += dtime;
-	packet_loss_counter += dtime;
 
-	if (packet_loss_counter > 1.0f) {
-		packet_loss_counter -= 1.0f;
-
-		unsigned int packet_loss;
-		unsigned int packets_successful;
-		unsigned int packet_too_late;
-
-		bool reasonable_amount_of_data_transmitted = false;
-
-		{
-			MutexAutoLock internal(m_internal_mutex);
-			packet_loss = current_packet_loss;
-			packet_too_late = current_packet_too_late;
-			packets_successful = current_packet_successful;
-
-			if (current_bytes_transfered > (unsigned int) (window_size*512/2)) {
-				reasonable_amount_of_data_transmitted = true;
-			}
-			current_packet_loss = 0;
-			current_packet_too_late = 0;
-			current_packet_successful = 0;
-		}
-
-		// Packets too late means either packet duplication along the way
-		// or we were too fast in resending it (which should be self-regulating).
-		// Count this a signal of congestion, like packet loss.
-		packet_loss = std::min(packet_loss + packet_too_late, packets_successful);
-
-		/* dynamic window size */
-		float successful_to_lost_ratio = 0.0f;
-		bool done = false;
-
-		if (packets_successful > 0) {
-			successful_to_lost_ratio = (float)packet_loss / packets_successful;
-		} else if (packet_loss > 0) {
-			setWindowSize(window_size - 10);
-			done = true;
-		}
-
-		if (!done) {
-			if (successful_to_lost_ratio < 0.01f) {
-				/* don't even think about increasing if we didn't even
-				 * use major parts of our window */
-				if (reasonable_amount_of_data_transmitted)
-					setWindowSize(window_size + 100);
-			} else if (successful_to_lost_ratio < 0.05f) {
-				/* don't even think about increasing if we didn't even
-				 * use major parts of our window */
-				if (reasonable_amount_of_data_transmitted)
-					setWindowSize(window_size + 50);
-			} else if (successful_to_lost_ratio > 0.15f) {
-				setWindowSize(window_size - 100);
-			} else if (successful_to_lost_ratio > 0.1f) {
-				setWindowSize(window_size - 50);
-			}
-		}
+	{
+		MutexAutoLock internal(m_internal_mutex);
+		m_congestion_control->step(dtime);
 	}
 
 	if (bpm_counter > 10.0f) {
@@ -919,8 +1136,10 @@ void Peer::Drop()
 UDPPeer::UDPPeer(u16 a_id, Address a_address, Connection* connection) :
 	Peer(a_address,a_id,connection)
 {
-	for (Channel &channel : channels)
-		channel.setWindowSize(START_RELIABLE_WINDOW_SIZE);
+	for (Channel &channel : channels) {
+		channel.setCongestionControl(
+			createCongestionControl(connection->getCongestionControl()));
+	}
 }
 
 bool UDPPeer::getAddress(MTProtocols type,Address& toset)
@@ -1175,8 +1394,8 @@ Connection::Connection(u32 protocol_id, u32 max_packet_size, float timeout,
 	m_protocol_id(protocol_id),
 	m_sendThread(new ConnectionSendThread(max_packet_size, timeout)),
 	m_receiveThread(new ConnectionReceiveThread(max_packet_size)),
-	m_bc_peerhandler(peerhandler)
-
+	m_bc_peerhandler(peerhandler),
+	m_congestion_control(g_settings->get("congestion_control"))
 {
 	/* Amount of time Receive() will wait for data, this is entirely different
 	 * from the connection timeout */
@@ -1564,22 +1783,19 @@ void Connection::DisconnectPeer(session_t peer_id)
 	putCommand(discon);
 }
 
-void Connection::sendAck(session_t peer_id, u8 channelnum, u16 seqnum)
+void Connection::sendAck(session_t peer_id, u8 channelnum, const ReliableAck &ack)
 {
 	assert(channelnum < CHANNEL_COUNT); // Pre-condition
 
 	LOG(dout_con<<getDesc()
 			<<" Queuing ACK command to peer_id: " << peer_id <<
 			" channel: " << (channelnum & 0xFF) <<
-			" seqnum: " << seqnum << std::endl);
+			" seqnum: " << ack.seqnum <<
+			" next expected: " << ack.next_expected <<
+			" ranges: " << ack.ranges.size() << std::endl);
 
 	ConnectionCommand c;
-	SharedBuffer<u8> ack(4);
-	writeU8(&ack[0], PACKET_TYPE_CONTROL);
-	writeU8(&ack[1], CONTROLTYPE_ACK);
-	writeU16(&ack[2], seqnum);
-
-	c.ack(peer_id, channelnum, ack);
+	c.ack(peer_id, channelnum, makeAckPacket(ack));
 	putCommand(std::move(c));
 	m_sendThread->Trigger();
 }
@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "connectionthreads.h"
+#include <algorithm>
 #include "log.h"
 #include "profiler.h"
 #include "settings.h"
@@ -49,6 +50,13 @@ std::mutex log_conthread_mutex;
 
 #define WINDOW_SIZE 5
 
+// A reliable packet is resent without waiting for its timeout once a
+// selective ACK covers this many packets sent after it
+#define FAST_RESEND_THRESHOLD 3
+
+// Queued ACKs are sent when this many are queued at the latest
+#define ACK_MAX_QUEUED 32
+
 static session_t readPeerId(u8 *packetdata)
 {
 	return readU16(&packetdata[4]);
@@ -907,6 +915,10 @@ void ConnectionReceiveThread::receive(SharedBuffer<u8> &packetdata,
 			packet_queued = false;
 		}
 
+		// Acknowledge what came in so far once there is a pause
+		if (m_queued_acks != 0 && !m_connection->m_udpSocket.WaitData(0))
+			sendQueuedAcks();
+
 		// Call Receive() to wait for incoming data
 		Address sender;
 		s32 received_size = m_connection->m_udpSocket.Receive(sender,
@@ -1077,6 +1089,57 @@ bool ConnectionReceiveThread::checkIncomingBuffers(Channel *channel,
 	return false;
 }
 
+void ConnectionReceiveThread::queueAck(UDPPeer *peer, u8 channelnum, u16 seqnum)
+{
+	std::vector<u16> &pending_acks = peer->channels[channelnum].pending_acks;
+	if (pending_acks.empty() && std::find(m_ack_peers.begin(), m_ack_peers.end(),
+			peer->id) == m_ack_peers.end())
+		m_ack_peers.push_back(peer->id);
+	pending_acks.push_back(seqnum);
+
+	if (++m_queued_acks >= ACK_MAX_QUEUED)
+		sendQueuedAcks();
+}
+
+void ConnectionReceiveThread::sendQueuedAcks()
+{
+	for (session_t peer_id : m_ack_peers) {
+		PeerHelper peer = m_connection->getPeerNoEx(peer_id);
+		if (!peer)
+			continue;
+		UDPPeer *udp_peer = dynamic_cast<UDPPeer *>(&peer);
+		if (!udp_peer)
+			continue;
+
+		for (u8 channelnum = 0; channelnum < CHANNEL_COUNT; channelnum++) {
+			Channel &channel = udp_peer->channels[channelnum];
+			if (channel.pending_acks.empty())
+				continue;
+
+			ReliableAck ack;
+			ack.extended = true;
+			ack.next_expected = channel.readNextIncomingSeqNum();
+			channel.incoming_reliables.getRanges(ack.ranges, ACK_MAX_RANGES);
+
+			// The last ACK covers the others, unless the peer only reads
+			// the seqnum or they don't fit into it
+			ack.seqnum = channel.pending_acks.back();
+			for (size_t i = 0; i + 1 < channel.pending_acks.size(); i++) {
+				u16 seqnum = channel.pending_acks[i];
+				if (udp_peer->m_extended_acks && ack.covers(seqnum))
+					continue;
+				ReliableAck single = ack;
+				single.seqnum = seqnum;
+				m_connection->sendAck(peer_id, channelnum, single);
+			}
+			m_connection->sendAck(peer_id, channelnum, ack);
+			channel.pending_acks.clear();
+		}
+	}
+	m_ack_peers.clear();
+	m_queued_acks = 0;
+}
+
 SharedBuffer<u8> ConnectionReceiveThread::processPacket(Channel *channel,
 	const SharedBuffer<u8> &packetdata, session_t peer_id, u8 channelnum, bool reliable)
 {
@@ -1127,52 +1190,67 @@ SharedBuffer<u8> ConnectionReceiveThread::handlePacketType_Control(Channel *chan
 	if (controltype == CONTROLTYPE_ACK) {
 		assert(channel != NULL);
 
-		if (packetdata.getSize() < 4) {
-			throw InvalidIncomingDataException(
-				"packetdata.getSize() < 4 (ACK header size)");
-		}
-
-		u16 seqnum = readU16(&packetdata[2]);
+		ReliableAck ack = readAckPacket(packetdata);
 		LOG(dout_con << m_connection->getDesc() << " [ CONTROLTYPE_ACK: channelnum="
 			<< ((int) channelnum & 0xff) << ", peer_id=" << peer->id << ", seqnum="
-			<< seqnum << " ]" << std::endl);
+			<< ack.seqnum << " ]" << std::endl);
+
+		UDPPeer *udp_peer = dynamic_cast<UDPPeer *>(peer);
+		if (ack.extended)
+			udp_peer->m_extended_acks = true;
 
+		u32 in_flight = channel->outgoing_reliables_sent.size();
 		try {
-			BufferedPacket p = channel->outgoing_reliables_sent.popSeqnum(seqnum);
+			BufferedPacket p = channel->outgoing_reliables_sent.popSeqnum(ack.seqnum);
 
 			// the rtt calculation will be a bit off for re-sent packets but that's okay
+			float rtt = -1.0f;
 			{
 				// Get round trip time
 				u64 current_time = porting::getTimeMs();
 
 				// a overflow is quite unlikely but as it'd result in major
 				// rtt miscalculation we handle it here
-				if (current_time > p.absolute_send_time) {
-					float rtt = (current_time - p.absolute_send_time) / 1000.0f;
-
-					// Let peer calculate stuff according to it
-					// (avg_rtt and resend_timeout)
-					dynamic_cast<UDPPeer *>(peer)->reportRTT(rtt);
-				} else if (p.totaltime > 0) {
-					float rtt = p.totaltime;
-
-					// Let peer calculate stuff according to it
-					// (avg_rtt and resend_timeout)
-					dynamic_cast<UDPPeer *>(peer)->reportRTT(rtt);
-				}
+				if (current_time > p.absolute_send_time)
+					rtt = (current_time - p.absolute_send_time) / 1000.0f;
+				else if (p.totaltime > 0)
+					rtt = p.totaltime;
+
+				// Let peer calculate stuff according to it
+				// (avg_rtt and resend_timeout)
+				if (rtt >= 0.0f)
+					udp_peer->reportRTT(rtt);
 			}
 
-			// put bytes for max bandwidth calculation
-			channel->UpdateBytesSent(p.data.getSize(), 1);
-			if (channel->outgoing_reliables_sent.size() == 0)
-				m_connection->TriggerSend();
+			// put bytes for max bandwidth calculation, the round trip time of
+			// a resent packet is ambiguous
+			channel->UpdatePacketsAcked(1, p.data.getSize(), in_flight,
+				p.resend_count == 0 ? rtt : -1.0f);
 		} catch (NotFoundException &e) {
-			LOG(derr_con << m_connection->getDesc()
-				<< "WARNING: ACKed packet not in outgoing queue"
-				<< " seqnum=" << seqnum << std::endl);
-			channel->UpdatePacketTooLateCounter();
+			// A selective ACK repeats what the ones before it said
+			if (!ack.extended) {
+				LOG(derr_con << m_connection->getDesc()
+					<< "WARNING: ACKed packet not in outgoing queue"
+					<< " seqnum=" << ack.seqnum << std::endl);
+				channel->UpdatePacketTooLateCounter();
+			}
+		}
+
+		if (ack.extended) {
+			u32 bytes = 0;
+			u32 packets = channel->outgoing_reliables_sent.popAcked(ack, bytes);
+			if (packets != 0)
+				channel->UpdatePacketsAcked(packets, bytes, in_flight);
+
+			// Packets missing in front of acknowledged ones are lost,
+			// don't wait for their timeout
+			if (channel->outgoing_reliables_sent.markLost(FAST_RESEND_THRESHOLD) != 0)
+				m_connection->TriggerSend();
 		}
 
+		if (channel->outgoing_reliables_sent.size() == 0)
+			m_connection->TriggerSend();
+
 		throw ProcessedSilentlyException("Got an ACK");
 	} else if (controltype == CONTROLTYPE_SET_PEER_ID) {
 		// Got a packet to set our peer id
@@ -1281,7 +1359,7 @@ SharedBuffer<u8> ConnectionReceiveThread::handlePacketType_Reliable(Channel *cha
 	/* packet is within our receive window send ack */
 	if (seqnum_in_window(seqnum,
 		channel->readNextIncomingSeqNum(), MAX_RELIABLE_WINDOW_SIZE)) {
-		m_connection->sendAck(peer->id, channelnum, seqnum);
+		queueAck(dynamic_cast<UDPPeer *>(peer), channelnum, seqnum);
 	} else {
 		is_future_packet = seqnum_higher(seqnum, channel->readNextIncomingSeqNum());
 		is_old_packet = seqnum_higher(channel->readNextIncomingSeqNum(), seqnum);
@@ -1298,7 +1376,7 @@ SharedBuffer<u8> ConnectionReceiveThread::handlePacketType_Reliable(Channel *cha
 				<< "RE-SENDING ACK: peer_id: " << peer->id
 				<< ", channel: " << (channelnum & 0xFF)
 				<< ", seqnum: " << seqnum << std::endl;)
-			m_connection->sendAck(peer->id, channelnum, seqnum);
+			queueAck(dynamic_cast<UDPPeer *>(peer), channelnum, seqnum);
 
 			throw ProcessedSilentlyException("Retransmitting ack for old packet");
 		}
@@ -117,6 +117,13 @@ class ConnectionReceiveThread : public Thread
 	bool checkIncomingBuffers(
 			Channel *channel, session_t &peer_id, SharedBuffer<u8> &dst);
 
+	/*
+		ACKs are collected while packets keep coming in. Peers that send
+		selective ACKs get one for all of them, others one per packet.
+	*/
+	void queueAck(UDPPeer *peer, u8 channelnum, u16 seqnum);
+	void sendQueuedAcks();
+
 	/*
 		Processes a packet with the basic header stripped out.
 		Parameters:
@@ -152,5 +159,9 @@ class ConnectionReceiveThread : public Thread
 	static const PacketTypeHandler packetTypeRouter[PACKET_TYPE_MAX];
 
 	Connection *m_connection = nullptr;
+
+	// Peers with queued ACKs
+	std::vector<session_t> m_ack_peers;
+	u32 m_queued_acks = 0;
 };
 }
@@ -0,0 +1,550 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "mediaserver.h"
+#include "networkexceptions.h"
+#include "log.h"
+#include "porting.h"
+#include "util/hex.h"
+#include "util/serialize.h"
+#include "util/string.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0501
+#endif
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define LAST_SOCKET_ERR() WSAGetLastError()
+#define SOCKET_WOULD_BLOCK(e) ((e) == WSAEWOULDBLOCK)
+#define socket_poll WSAPoll
+typedef WSAPOLLFD pollfd_t;
+typedef int socklen_t;
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#define LAST_SOCKET_ERR() (errno)
+#define SOCKET_WOULD_BLOCK(e) ((e) == EAGAIN || (e) == EWOULDBLOCK || (e) == EINTR)
+#define socket_poll poll
+typedef struct pollfd pollfd_t;
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+// Same as in clientmedia.h
+#define MTHASHSET_FILE_SIGNATURE 0x4d544853 // 'MTHS'
+
+#define MEDIA_SERVER_MAX_CLIENTS 256
+// Connections without any traffic for this long are closed
+#define MEDIA_SERVER_TIMEOUT_MS 30000
+// Largest request accepted, enough for a hash set of every media file
+#define MEDIA_SERVER_MAX_REQUEST (2 * 1024 * 1024)
+// The client doesn't ask for more in one bulk download
+#define MEDIA_SERVER_MAX_BULK_FILES 256
+
+static void close_socket(int handle)
+{
+#ifdef _WIN32
+	closesocket(handle);
+#else
+	close(handle);
+#endif
+}
+
+static void set_non_blocking(int handle)
+{
+#ifdef _WIN32
+	u_long mode = 1;
+	ioctlsocket(handle, FIONBIO, &mode);
+#else
+	fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+#endif
+#ifdef SO_NOSIGPIPE
+	int value = 1;
+	setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &value, sizeof(value));
+#endif
+}
+
+MediaHTTPServer::MediaHTTPServer() :
+	Thread("MediaServer")
+{
+}
+
+MediaHTTPServer::~MediaHTTPServer()
+{
+	stop();
+	wait();
+
+	for (Client &client : m_clients)
+		closeClient(client);
+	if (m_handle >= 0)
+		close_socket(m_handle);
+}
+
+void MediaHTTPServer::listen(const Address &addr)
+{
+	m_handle = socket(addr.getFamily(), SOCK_STREAM, IPPROTO_TCP);
+	if (m_handle < 0)
+		throw SocketException("Failed to create media server socket");
+
+	int value = 1;
+	setsockopt(m_handle, SOL_SOCKET, SO_REUSEADDR,
+			reinterpret_cast<char *>(&value), sizeof(value));
+
+	int result;
+	if (addr.isIPv6()) {
+		// Accept IPv4 connections too
+		value = 0;
+		setsockopt(m_handle, IPPROTO_IPV6, IPV6_V6ONLY,
+				reinterpret_cast<char *>(&value), sizeof(value));
+
+		struct sockaddr_in6 address = addr.getAddress6();
+		address.sin6_family = AF_INET6;
+		address.sin6_port = htons(addr.getPort());
+		result = bind(m_handle, (const struct sockaddr *)&address, sizeof(address));
+	} else {
+		struct sockaddr_in address = addr.getAddress();
+		address.sin_family = AF_INET;
+		address.sin_port = htons(addr.getPort());
+		result = bind(m_handle, (const struct sockaddr *)&address, sizeof(address));
+	}
+
+	if (result < 0 || ::listen(m_handle, 64) < 0) {
+		close_socket(m_handle);
+		m_handle = -1;
+		throw SocketException("Failed to listen on port " +
+				std::to_string(addr.getPort()) + " for media");
+	}
+	set_non_blocking(m_handle);
+
+	// Find out which port was picked
+	struct sockaddr_storage bound;
+	socklen_t bound_size = sizeof(bound);
+	m_port = addr.getPort();
+	if (getsockname(m_handle, (struct sockaddr *)&bound, &bound_size) == 0) {
+		if (bound.ss_family == AF_INET6)
+			m_port = ntohs(((struct sockaddr_in6 *)&bound)->sin6_port);
+		else
+			m_port = ntohs(((struct sockaddr_in *)&bound)->sin_port);
+	}
+}
+
+void MediaHTTPServer::addFile(const std::string &sha1, const std::string &path,
+		u64 size, std::shared_ptr<const std::string> data)
+{
+	std::lock_guard<std::mutex> lock(m_files_mutex);
+	m_files[hex_encode(sha1)] = File{path, size, std::move(data)};
+}
+
+bool MediaHTTPServer::getFile(const std::string &sha1_hex, File &file)
+{
+	std::lock_guard<std::mutex> lock(m_files_mutex);
+	auto it = m_files.find(sha1_hex);
+	if (it == m_files.end())
+		return false;
+	file = it->second;
+	return true;
+}
+
+void *MediaHTTPServer::run()
+{
+	std::vector<pollfd_t> fds;
+
+	while (!stopRequested()) {
+		fds.clear();
+		pollfd_t pfd;
+		pfd.fd = m_handle;
+		pfd.events = m_clients.size() < MEDIA_SERVER_MAX_CLIENTS ? POLLIN : 0;
+		pfd.revents = 0;
+		fds.push_back(pfd);
+		for (const Client &client : m_clients) {
+			pfd.fd = client.handle;
+			pfd.events = client.response.empty() ? POLLIN : POLLOUT;
+			fds.push_back(pfd);
+		}
+
+		if (socket_poll(fds.data(), fds.size(), 100) < 0) {
+			int e = LAST_SOCKET_ERR();
+			if (SOCKET_WOULD_BLOCK(e))
+				continue;
+			errorstream << "MediaHTTPServer: poll failed: " << e << std::endl;
+			break;
+		}
+
+		const u64 now = porting::getTimeMs();
+		for (size_t i = 0; i < m_clients.size(); i++) {
+			Client &client = m_clients[i];
+			short revents = fds[i + 1].revents;
+			bool ok = true;
+			if (revents & POLLOUT)
+				ok = send(client);
+			else if (revents & (POLLIN | POLLHUP | POLLERR))
+				ok = receive(client);
+			else if (revents & POLLNVAL)
+				ok = false;
+
+			if (revents)
+				client.last_active = now;
+			else if (now - client.last_active > MEDIA_SERVER_TIMEOUT_MS)
+				ok = false;
+
+			if (!ok)
+				closeClient(client);
+		}
+
+		m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+				[] (const Client &client) { return client.handle < 0; }),
+				m_clients.end());
+
+		if (!(fds[0].revents & POLLIN))
+			continue;
+		while (m_clients.size() < MEDIA_SERVER_MAX_CLIENTS) {
+			int handle = accept(m_handle, nullptr, nullptr);
+			if (handle < 0)
+				break;
+			set_non_blocking(handle);
+			Client client;
+			client.handle = handle;
+			client.last_active = now;
+			m_clients.push_back(std::move(client));
+		}
+	}
+
+	return nullptr;
+}
+
+void MediaHTTPServer::closeClient(Client &client)
+{
+	if (client.file)
+		fclose(client.file);
+	client.file = nullptr;
+	if (client.handle >= 0)
+		close_socket(client.handle);
+	client.handle = -1;
+}
+
+bool MediaHTTPServer::receive(Client &client)
+{
+	char buf[4096];
+	int len = recv(client.handle, buf, sizeof(buf), 0);
+	if (len == 0)
+		return false;
+	if (len < 0)
+		return SOCKET_WOULD_BLOCK(LAST_SOCKET_ERR());
+
+	client.request.append(buf, len);
+	if (client.request.size() > MEDIA_SERVER_MAX_REQUEST)
+		return false;
+
+	if (handleRequest(client))
+		return send(client);
+	return true;
+}
+
+bool MediaHTTPServer::send(Client &client)
+{
+	while (!client.response.empty()) {
+		Segment &segment = client.response.front();
+		if (segment.size == 0) {
+			if (client.file)
+				fclose(client.file);
+			client.file = nullptr;
+			client.response.pop_front();
+			continue;
+		}
+
+		const size_t chunk = MYMIN(segment.size, (u64)1024 * 1024);
+		long sent;
+		if (segment.data) {
+			sent = ::send(client.handle, segment.data->c_str() + segment.offset,
+					chunk, SEND_FLAGS);
+		} else {
+			if (!client.file)
+				client.file = fopen(segment.path.c_str(), "rb");
+			if (!client.file) {
+				errorstream << "MediaHTTPServer: Could not open \""
+						<< segment.path << "\"" << std::endl;
+				return false;
+			}
+#ifdef __linux__
+			off_t offset = segment.offset;
+			sent = sendfile(client.handle, fileno(client.file), &offset, chunk);
+#else
+			char buf[65536];
+			size_t len = 0;
+			if (fseek(client.file, segment.offset, SEEK_SET) == 0)
+				len = fread(buf, 1, MYMIN(chunk, sizeof(buf)), client.file);
+			if (len == 0)
+				return false;
+			sent = ::send(client.handle, buf, len, SEND_FLAGS);
+#endif
+			// The file got shorter since it was announced
+			if (sent == 0)
+				return false;
+		}
+
+		if (sent < 0)
+			return SOCKET_WOULD_BLOCK(LAST_SOCKET_ERR());
+
+		segment.offset += sent;
+		segment.size -= sent;
+		// Let poll() tell when there is room again
+		if (segment.size > 0)
+			return true;
+	}
+
+	if (client.close)
+		return false;
+	// Pipelined requests
+	if (handleRequest(client))
+		return send(client);
+	return true;
+}
+
+bool MediaHTTPServer::handleRequest(Client &client)
+{
+	size_t header_end = client.request.find("\r\n\r\n");
+	if (header_end == std::string::npos)
+		return false;
+
+	std::vector<std::string> lines = str_split(
+			client.request.substr(0, header_end), '\n');
+	std::vector<std::string> request_line = str_split(trim(lines[0]), ' ');
+
+	u64 content_length = 0;
+	std::string range;
+	bool close = false;
+	for (size_t i = 1; i < lines.size(); i++) {
+		size_t colon = lines[i].find(':');
+		if (colon == std::string::npos)
+			continue;
+		std::string name = lowercase(trim(lines[i].substr(0, colon)));
+		std::string value = trim(lines[i].substr(colon + 1));
+		if (name == "content-length")
+			content_length = std::strtoull(value.c_str(), nullptr, 10);
+		else if (name == "range")
+			range = value;
+		else if (name == "connection")
+			close = lowercase(value) == "close";
+	}
+
+	if (content_length > MEDIA_SERVER_MAX_REQUEST) {
+		client.request.clear();
+		client.close = true;
+		respondError(client, "413 Payload Too Large");
+		return true;
+	}
+
+	const size_t request_size = header_end + 4 + content_length;
+	if (client.request.size() < request_size)
+		return false;
+	std::string body = client.request.substr(header_end + 4, content_length);
+	client.request.erase(0, request_size);
+
+	if (request_line.size() != 3 || request_line[1].empty() ||
+			request_line[1][0] != '/') {
+		client.close = true;
+		respondError(client, "400 Bad Request");
+		return true;
+	}
+	const std::string &method = request_line[0];
+	const std::string name = request_line[1].substr(1);
+	client.close = close || request_line[2] == "HTTP/1.0";
+
+	verbosestream << "MediaHTTPServer: " << method << " "
+			<< request_line[1] << std::endl;
+
+	if (method == "POST" && name == "index.mth")
+		sendHashSet(client, body);
+	else if (method == "POST" && name == "bulk-download")
+		sendBulk(client, body);
+	else if (method == "GET" || method == "HEAD")
+		sendFile(client, range, method == "HEAD", name);
+	else if (method == "POST")
+		respondError(client, "404 Not Found");
+	else
+		respondError(client, "405 Method Not Allowed");
+	return true;
+}
+
+void MediaHTTPServer::respond(Client &client, const std::string &status,
+		const std::string &headers, u64 content_length)
+{
+	std::string *head = new std::string("HTTP/1.1 " + status + "\r\n");
+	head->append("Server: MultiCraft\r\n");
+	head->append("Content-Length: ").append(std::to_string(content_length));
+	head->append("\r\n").append(headers);
+	if (client.close)
+		head->append("Connection: close\r\n");
+	head->append("\r\n");
+
+	Segment segment;
+	segment.data.reset(head);
+	segment.offset = 0;
+	segment.size = head->size();
+	client.response.push_back(std::move(segment));
+}
+
+void MediaHTTPServer::respondError(Client &client, const std::string &status)
+{
+	respond(client, status, "", 0);
+}
+
+void MediaHTTPServer::sendFile(Client &client, const std::string &range,
+		bool head, const std::string &name)
+{
+	File file;
+	if (!getFile(name, file)) {
+		respondError(client, "404 Not Found");
+		return;
+	}
+
+	u64 start = 0, end = file.size;
+	std::string status = "200 OK";
+	std::string headers = "Content-Type: application/octet-stream\r\n"
+			"Accept-Ranges: bytes\r\n";
+
+	// Only a single range is supported, the whole file is sent otherwise
+	if (str_starts_with(range, "bytes=") && range.find(',') == std::string::npos) {
+		std::string spec = range.substr(6);
+		size_t dash = spec.find('-');
+		bool valid = dash != std::string::npos;
+		if (valid && dash == 0) {
+			// Last bytes of the file
+			u64 count = std::strtoull(spec.c_str() + 1, nullptr, 10);
+			start = file.size - MYMIN(count, file.size);
+			valid = count > 0;
+		} else if (valid) {
+			start = std::strtoull(spec.c_str(), nullptr, 10);
+			if (dash + 1 < spec.size())
+				end = MYMIN(std::strtoull(spec.c_str() + dash + 1, nullptr, 10) + 1,
+						file.size);
+			valid = start < end;
+		}
+
+		if (!valid) {
+			respond(client, "416 Range Not Satisfiable",
+					"Content-Range: bytes */" + std::to_string(file.size) + "\r\n", 0);
+			return;
+		}
+		status = "206 Partial Content";
+		headers.append("Content-Range: bytes ").append(std::to_string(start))
+				.append("-").append(std::to_string(end - 1)).append("/")
+				.append(std::to_string(file.size)).append("\r\n");
+	}
+
+	respond(client, status, headers, end - start);
+	if (head)
+		return;
+
+	Segment segment;
+	segment.data = file.data;
+	segment.path = file.path;
+	segment.offset = start;
+	segment.size = end - start;
+	client.response.push_back(std::move(segment));
+}
+
+void MediaHTTPServer::sendHashSet(Client &client, const std::string &body)
+{
+	const u8 *data = (const u8 *)body.c_str();
+	if (body.size() < 6 || (body.size() - 6) % 20 != 0 ||
+			readU32(data) != MTHASHSET_FILE_SIGNATURE || readU16(data + 4) != 1) {
+		respondError(client, "400 Bad Request");
+		return;
+	}
+
+	// Version 2 tells that bulk downloads are supported
+	std::string *result = new std::string(body.substr(0, 6));
+	writeU16((u8 *)&(*result)[4], 2);
+	{
+		std::lock_guard<std::mutex> lock(m_files_mutex);
+		for (size_t pos = 6; pos < body.size(); pos += 20) {
+			if (m_files.count(hex_encode(body.c_str() + pos, 20)))
+				result->append(body, pos, 20);
+		}
+	}
+
+	respond(client, "200 OK", "Content-Type: application/octet-stream\r\n",
+			result->size());
+
+	Segment segment;
+	segment.data.reset(result);
+	segment.offset = 0;
+	segment.size = result->size();
+	client.response.push_back(std::move(segment));
+}
+
+void MediaHTTPServer::sendBulk(Client &client, const std::string &body)
+{
+	if (body.empty() || body.size() % 20 != 0 ||
+			body.size() / 20 > MEDIA_SERVER_MAX_BULK_FILES) {
+		respondError(client, "400 Bad Request");
+		return;
+	}
+
+	// Every file is preceded by its u32 size
+	std::vector<File> files;
+	u64 content_length = 0;
+	for (size_t pos = 0; pos < body.size(); pos += 20) {
+		File file;
+		if (!getFile(hex_encode(body.c_str() + pos, 20), file)) {
+			respondError(client, "404 Not Found");
+			return;
+		}
+		content_length += 4 + file.size;
+		files.push_back(std::move(file));
+	}
+
+	respond(client, "200 OK", "Content-Type: application/octet-stream\r\n",
+			content_length);
+
+	for (File &file : files) {
+		std::string *size = new std::string(4, '\0');
+		writeU32((u8 *)&(*size)[0], file.size);
+
+		Segment segment;
+		segment.data.reset(size);
+		segment.offset = 0;
+		segment.size = 4;
+		client.response.push_back(segment);
+
+		segment.data = std::move(file.data);
+		segment.path = std::move(file.path);
+		segment.size = file.size;
+		client.response.push_back(std::move(segment));
+	}
+}
@@ -0,0 +1,116 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "address.h"
+#include "threading/thread.h"
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+	A small HTTP/1.1 server that offers the media of the server the way a
+	remote_media server does, so clients don't have to fetch it over UDP:
+
+	POST index.mth       - hash set of the requested files that are available
+	POST bulk-download   - several files in one response
+	GET/HEAD <sha1 hex>  - one file, a single byte range may be requested
+
+	Files are sent from the media cache when they are in there and
+	straight from disk (with sendfile() where available) otherwise.
+*/
+class MediaHTTPServer : public Thread
+{
+public:
+	MediaHTTPServer();
+	~MediaHTTPServer();
+
+	// Throws SocketException if the address can't be listened on.
+	// Port 0 picks a free port.
+	void listen(const Address &addr);
+	u16 getPort() const { return m_port; }
+
+	// sha1 is the raw digest, data is null if the file has to be read from disk
+	void addFile(const std::string &sha1, const std::string &path, u64 size,
+			std::shared_ptr<const std::string> data);
+
+protected:
+	void *run();
+
+private:
+	struct File
+	{
+		std::string path;
+		u64 size;
+		std::shared_ptr<const std::string> data;
+	};
+
+	// Part of a response, sent from memory if data is set, else from path
+	struct Segment
+	{
+		std::shared_ptr<const std::string> data;
+		std::string path;
+		u64 offset;
+		u64 size;
+	};
+
+	struct Client
+	{
+		int handle;
+		// Received bytes that don't form a complete request yet
+		std::string request;
+		std::deque<Segment> response;
+		// Open file of the first segment
+		FILE *file = nullptr;
+		u64 last_active;
+		bool close = false;
+	};
+
+	bool receive(Client &client);
+	bool send(Client &client);
+	// Returns false if the request is not complete yet
+	bool handleRequest(Client &client);
+
+	void respond(Client &client, const std::string &status,
+			const std::string &headers, u64 content_length);
+	void respondError(Client &client, const std::string &status);
+	void sendFile(Client &client, const std::string &range, bool head,
+			const std::string &name);
+	void sendHashSet(Client &client, const std::string &body);
+	void sendBulk(Client &client, const std::string &body);
+
+	bool getFile(const std::string &sha1_hex, File &file);
+	void closeClient(Client &client);
+
+	int m_handle = -1;
+	u16 m_port = 0;
+
+	std::mutex m_files_mutex;
+	// By hex encoded SHA1
+	std::unordered_map<std::string, File> m_files;
+
+	// Only used by the thread
+	std::vector<Client> m_clients;
+};
@@ -28,7 +28,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/thread.h"
 #include "util/numeric.h"
 #include "networkprotocol.h"
+#include "congestioncontrol.h"
 #include <iostream>
+#include <deque>
+#include <memory>
 #include <vector>
 #include <map>
 
@@ -165,6 +168,10 @@ CONTROL: This is a packet used by the protocol.
 controltype and data description:
 	CONTROLTYPE_ACK
 		[2] u16 seqnum
+		Optionally followed by a selective ACK, older peers ignore it:
+		[4] u16 next_expected (every seqnum before it was received)
+		[6] u8 range_count
+		[7] range_count * (u16 first, u16 last) further received seqnums
 	CONTROLTYPE_SET_PEER_ID
 		[2] session_t peer_id_new
 	CONTROLTYPE_PING
@@ -178,6 +185,9 @@ controltype and data description:
 #define CONTROLTYPE_PING 2
 #define CONTROLTYPE_DISCO 3
 
+// Maximum number of ranges of received seqnums in an ACK
+#define ACK_MAX_RANGES 16
+
 /*
 ORIGINAL: This is a plain packet with no control and no error
 checking at all.
@@ -225,12 +235,40 @@ enum PacketType: u8 {
 	PACKET_TYPE_RELIABLE = 3,
 	PACKET_TYPE_MAX
 };
+
+// Contents of a CONTROLTYPE_ACK packet
+struct ReliableAck
+{
+	u16 seqnum = 0;
+	// Whether the selective ACK below is present
+	bool extended = false;
+	u16 next_expected = 0;
+	// Inclusive ranges of seqnums
+	std::vector<std::pair<u16, u16>> ranges;
+
+	// Whether the ACK says that seqnum was received
+	bool covers(u16 seqnum) const;
+};
+
+// Make the CONTROLTYPE_ACK packet, without base header
+SharedBuffer<u8> makeAckPacket(const ReliableAck &ack);
+
+// Read a CONTROLTYPE_ACK packet, throws InvalidIncomingDataException
+ReliableAck readAckPacket(const SharedBuffer<u8> &data);
 /*
 	A buffer which stores reliable packets and sorts them internally
 	for fast access to the smallest one.
+
+	Packets live in a ring indexed by seqnum, which grows to cover the
+	span of seqnums in the buffer. Looking up, inserting and removing a
+	packet is O(1). For resending, packets are also queued by the time they
+	were last sent, in one FIFO per resend count, so that timed out packets
+	are found without looking at the others.
 */
 
-typedef std::list<BufferedPacket>::iterator RPBSearchResult;
+#define RELIABLE_BUFFER_MIN_SLOTS 64
+// Packets resent more often than this share the last resend queue
+#define RELIABLE_BUFFER_RESEND_QUEUES 8
 
 class ReliablePacketBuffer
 {
@@ -243,6 +281,24 @@ class ReliablePacketBuffer
 	BufferedPacket popSeqnum(u16 seqnum);
 	void insert(const BufferedPacket &p, u16 next_expected);
 
+	/*
+		Removes the packets a selective ACK covers, except for ack.seqnum
+		which is left to the caller. Returns the number of packets removed
+		and adds up their size in bytes.
+	*/
+	u32 popAcked(const ReliableAck &ack, u32 &bytes);
+
+	// Gets up to max_ranges inclusive ranges of the seqnums in the buffer
+	void getRanges(std::vector<std::pair<u16, u16>> &ranges, u32 max_ranges);
+
+	/*
+		Packets that were sent at least threshold packets earlier than the
+		newest removed one are probably lost. Makes the next getTimedOuts()
+		return them regardless of the timeout, each only once per sending.
+		Returns the number of packets newly found lost.
+	*/
+	u32 markLost(u32 threshold);
+
 	void incrementTimeouts(float dtime);
 	std::list<BufferedPacket> getTimedOuts(float timeout, u32 max_packets);
 
@@ -250,22 +306,64 @@ class ReliablePacketBuffer
 	bool empty();
 	u32 size();
 
+	// Number of slots of the ring, for testing
+	u32 capacity();
 
 private:
-	RPBSearchResult findPacket(u16 seqnum); // does not perform locking
-	inline RPBSearchResult notFound() { return m_list.end(); }
+	struct Slot {
+		std::unique_ptr<BufferedPacket> packet;
+		u16 seqnum = 0;
+		// Times of the buffer clock (see m_time)
+		double buffered_at = 0.0;
+		double sent_at = 0.0;
+		// Identifies the current entry in the resend queues
+		u32 send_id = 0;
+		// In the lost queue
+		bool lost = false;
+	};
 
-	std::list<BufferedPacket> m_list;
+	struct ResendEntry {
+		u16 seqnum;
+		u32 send_id;
+	};
 
-	u16 m_oldest_non_answered_ack;
+	// These do not perform locking
+	Slot *findSlot(u16 seqnum);
+	BufferedPacket take(Slot &slot);
+	void grow(u32 span);
+	void queueResend(Slot &slot);
+	bool isResendEntryCurrent(const ResendEntry &entry);
+	void compactResendQueues();
+
+	std::vector<Slot> m_slots;
+	u32 m_count = 0;
+	// Oldest and newest seqnum in the buffer, only valid if m_count != 0
+	u16 m_first = 0;
+	u16 m_last = 0;
+
+	std::deque<ResendEntry> m_resend_queues[RELIABLE_BUFFER_RESEND_QUEUES];
+	// Packets to resend right away
+	std::deque<ResendEntry> m_lost_queue;
+	size_t m_resend_entries = 0;
+	u32 m_next_send_id = 1;
+	// send_id of the most recently sent packet that was removed
+	u32 m_newest_taken_send_id = 0;
+	double m_time = 0.0;
 
 	std::mutex m_list_mutex;
 };
 
 /*
 	A buffer for reconstructing split packets
+
+	Incomplete packets are kept in a ring indexed by seqnum. A peer usually
+	has only a few of them in flight. If a packet's slot is still taken by
+	an older incomplete one, the new packet goes to a map by seqnum
+	instead; the older one may be reliable and can't be dropped.
 */
 
+#define SPLIT_BUFFER_SLOTS 64
+
 class IncomingSplitBuffer
 {
 public:
@@ -278,9 +376,18 @@ class IncomingSplitBuffer
 
 	void removeUnreliableTimedOuts(float dtime, float timeout);
 
+	// Number of incomplete packets, for testing
+	u32 size();
+
 private:
-	// Key is seqnum
-	std::map<u16, IncomingSplitPacket*> m_buf;
+	struct Slot {
+		u16 seqnum = 0;
+		IncomingSplitPacket *packet = nullptr;
+	};
+
+	Slot m_buf[SPLIT_BUFFER_SLOTS];
+	// Packets whose slot was taken when they arrived, by seqnum
+	std::map<u16, IncomingSplitPacket *> m_overflow;
 
 	std::mutex m_map_mutex;
 };
@@ -414,9 +521,16 @@ class Channel
 	Channel() = default;
 	~Channel() = default;
 
+	// Seqnums to acknowledge, only used by the receive thread
+	std::vector<u16> pending_acks;
+
+	void setCongestionControl(std::unique_ptr<CongestionControl> congestion_control);
+
 	void UpdatePacketLossCounter(unsigned int count);
 	void UpdatePacketTooLateCounter();
-	void UpdateBytesSent(unsigned int bytes,unsigned int packages=1);
+	// in_flight is the number of sent reliables before the ACK, rtt < 0 if unknown
+	void UpdatePacketsAcked(unsigned int packets, unsigned int bytes,
+			unsigned int in_flight, float rtt = -1.0f);
 	void UpdateBytesLost(unsigned int bytes);
 	void UpdateBytesReceived(unsigned int bytes);
 
@@ -444,27 +558,20 @@ class Channel
 	const float getAvgIncomingRateKB()
 		{ MutexAutoLock lock(m_internal_mutex); return avg_incoming_kbps; };
 
-	const unsigned int getWindowSize() const { return window_size; };
-
-	void setWindowSize(long size)
+	const unsigned int getWindowSize()
 	{
-		window_size = (int)rangelim(size,
-				MIN_RELIABLE_WINDOW_SIZE, MAX_RELIABLE_WINDOW_SIZE_SEND);
+		MutexAutoLock lock(m_internal_mutex);
+		return m_congestion_control->getWindowSize();
 	};
 private:
 	std::mutex m_internal_mutex;
-	int window_size = MIN_RELIABLE_WINDOW_SIZE;
+	std::unique_ptr<CongestionControl> m_congestion_control;
 
 	u16 next_incoming_seqnum = SEQNUM_INITIAL;
 
 	u16 next_outgoing_seqnum = SEQNUM_INITIAL;
 	u16 next_outgoing_split_seqnum = SEQNUM_INITIAL;
 
-	unsigned int current_packet_loss = 0;
-	unsigned int current_packet_too_late = 0;
-	unsigned int current_packet_successful = 0;
-	float packet_loss_counter = 0.0f;
-
 	unsigned int current_bytes_transfered = 0;
 	unsigned int current_bytes_received = 0;
 	unsigned int current_bytes_lost = 0;
@@ -668,6 +775,8 @@ class UDPPeer : public Peer
 
 	Channel channels[CHANNEL_COUNT];
 	bool m_pending_disconnect = false;
+	// The peer sends selective ACKs, only used by the receive thread
+	bool m_extended_acks = false;
 private:
 	// This is changed dynamically
 	float resend_timeout = 0.5;
@@ -774,6 +883,7 @@ class Connection
 	const u32 GetProtocolID() const { return m_protocol_id; };
 	const std::string getDesc();
 	void DisconnectPeer(session_t peer_id);
+	const std::string &getCongestionControl() const { return m_congestion_control; }
 
 protected:
 	PeerHelper getPeerNoEx(session_t peer_id);
@@ -785,7 +895,7 @@ class Connection
 
 	void SetPeerID(session_t id) { m_peer_id = id; }
 
-	void sendAck(session_t peer_id, u8 channelnum, u16 seqnum);
+	void sendAck(session_t peer_id, u8 channelnum, const ReliableAck &ack);
 
 	void PrintInfo(std::ostream &out);
 
@@ -834,6 +944,9 @@ class Connection
 	bool m_shutting_down = false;
 
 	session_t m_next_remote_peer_id = 2;
+
+	// Algorithm for the channels of new peers
+	std::string m_congestion_control;
 };
 
 } // namespace
@@ -741,6 +741,77 @@ enum ToClientCommand
 		f32 scale
 	*/
 
+	TOCLIENT_ACTIVE_OBJECT_STATES = 0x5d,
+	/*
+		Position updates replacing AO_CMD_UPDATE_POSITION for newer clients,
+		see activeobjectstate.h. Sent reliably for new baselines.
+		for all objects {
+			u16 id
+			u8 flags (AOS_*)
+			u8 baseline id
+			if AOS_BASELINE {
+				v3f32 position, velocity, acceleration, rotation
+			} else {
+				v3s16 position offset from the baseline, in AOS_POSITION_STEP
+				if AOS_VELOCITY: v3s16 velocity, in AOS_POSITION_STEP
+				if AOS_ACCELERATION: v3s16 acceleration, in AOS_POSITION_STEP
+				if AOS_ROTATION: u16[3] rotation, in 360/65536 degrees
+			}
+			u8 update interval, in 1/100 s
+		}
+	*/
+
+	TOCLIENT_NODES_CHANGED = 0x5e,
+	/*
+		Node changes of a server step, replacing TOCLIENT_ADDNODE and
+		TOCLIENT_REMOVENODE for newer clients. Removed nodes are sent as air.
+		for all changed nodes {
+			v3s16 position
+			u16 param0
+			u8 param1
+			u8 param2
+			u8 keep_metadata
+		}
+	*/
+
+	TOCLIENT_INVENTORY_DELTA = 0x5f,
+	/*
+		Binary inventory replacing TOCLIENT_INVENTORY and
+		TOCLIENT_DETACHED_INVENTORY for newer clients.
+		u8 type (0 = player inventory, 1 = detached, 2 = remove detached)
+		if type != 0: std::string detached inventory name
+		if type != 2 {
+			u8 version (0)
+			u16 count of item names
+			for all item names: std::string name
+			u16 count of lists
+			for all lists {
+				std::string name
+				u8 mode (0 = unchanged, 1 = whole list, 2 = changed slots)
+				if mode == 1 {
+					u32 size
+					u32 width
+					for all slots: slot
+				} else if mode == 2 {
+					u32 count of slots
+					for all changed slots {
+						u32 index
+						slot
+					}
+				}
+			}
+		}
+		Lists that are not sent are removed.
+		slot:
+			u16 item name index starting at 1, 0 = empty
+			if not empty {
+				u16 count
+				u8 flags (0x01 = wear, 0x02 = metadata)
+				if flags & 0x01: u16 wear
+				if flags & 0x02: u32 len + data of the serialized metadata
+			}
+	*/
+
 	TOCLIENT_SRP_BYTES_S_B = 0x60,
 	/*
 		Belonging to AUTH_MECHANISM_SRP.
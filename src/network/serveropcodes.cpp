@@ -216,9 +216,9 @@ const ClientCommandFactory clientCommandFactoryTable[TOCLIENT_NUM_MSG_TYPES] =
 	{ "TOCLIENT_SET_SUN",                  0, true }, // 0x5a
 	{ "TOCLIENT_SET_MOON",                 0, true }, // 0x5b
 	{ "TOCLIENT_SET_STARS",                0, true }, // 0x5c
-	null_command_factory, // 0x5d
-	null_command_factory, // 0x5e
-	null_command_factory, // 0x5f
+	{ "TOCLIENT_ACTIVE_OBJECT_STATES",     0, true }, // 0x5d (unrel over channel 1 unless a baseline)
+	{ "TOCLIENT_NODES_CHANGED",            0, true }, // 0x5e
+	{ "TOCLIENT_INVENTORY_DELTA",          0, true }, // 0x5f
 	{ "TOSERVER_SRP_BYTES_S_B",            0, true }, // 0x60
 	{ "TOCLIENT_FORMSPEC_PREPEND",         0, true }, // 0x61
 	{ "TOCLIENT_MINIMAP_MODES",            0, true }, // 0x62
@@ -686,6 +686,14 @@ class NodeDefManager {
 		m_node_registration_complete = completed;
 	}
 
+	/*!
+	 * Returns true once node registration has finished, i.e.
+	 * the name <-> ID mapping won't change anymore.
+	 */
+	inline bool getNodeRegistrationStatus() const {
+		return m_node_registration_complete;
+	}
+
 	/*!
 	 * Notifies the registered NodeResolver instances that node registration
 	 * has finished, then unregisters all listeners.
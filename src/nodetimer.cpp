@@ -22,6 +22,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "serialization.h"
 #include "util/serialize.h"
 #include "constants.h" // MAP_BLOCKSIZE
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 
 /*
 	NodeTimer
@@ -43,6 +46,11 @@ void NodeTimer::deSerialize(std::istream &is)
 	NodeTimerList
 */
 
+double NodeTimerList::now() const
+{
+	return m_wheel ? m_wheel->getTime() : m_time;
+}
+
 void NodeTimerList::serialize(std::ostream &os, u8 map_format_version) const
 {
 	if (map_format_version == 24) {
@@ -60,14 +68,13 @@ void NodeTimerList::serialize(std::ostream &os, u8 map_format_version) const
 		writeU16(os, m_timers.size());
 	}
 
-	for (const auto &timer : m_timers) {
-		NodeTimer t = timer.second;
-		NodeTimer nt = NodeTimer(t.timeout,
-			t.timeout - (f32)(timer.first - m_time), t.position);
-		v3s16 p = t.position;
+	double time = now();
+	for (const auto &it : m_timers) {
+		const Entry &e = it.second;
+		NodeTimer nt(e.timeout, e.timeout - (f32)(e.trigger_time - time),
+			positionOf(it.first));
 
-		u16 p16 = p.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE + p.Y * MAP_BLOCKSIZE + p.X;
-		writeU16(os, p16);
+		writeU16(os, it.first);
 		nt.serialize(os);
 	}
 }
@@ -113,7 +120,7 @@ void NodeTimerList::deSerialize(std::istream &is, u8 map_format_version)
 			continue;
 		}
 
-		if (m_iterators.find(p) != m_iterators.end()) {
+		if (m_timers.find(indexOf(p)) != m_timers.end()) {
 			warningstream<<"NodeTimerList::deSerialize(): "
 					<<"already set data at position"
 					<<"("<<p.X<<","<<p.Y<<","<<p.Z<<"): Ignoring."
@@ -125,26 +132,185 @@ void NodeTimerList::deSerialize(std::istream &is, u8 map_format_version)
 	}
 }
 
+NodeTimer NodeTimerList::get(const v3s16 &p) const
+{
+	auto it = m_timers.find(indexOf(p));
+	if (it == m_timers.end())
+		return NodeTimer();
+	const Entry &e = it->second;
+	return NodeTimer(e.timeout, e.timeout - (f32)(e.trigger_time - now()), p);
+}
+
+void NodeTimerList::remove(const v3s16 &p)
+{
+	// A wheel entry is left behind, takeExpired won't find the timer
+	m_timers.erase(indexOf(p));
+}
+
+void NodeTimerList::insert(const NodeTimer &timer)
+{
+	u16 index = indexOf(timer.position);
+	Entry e;
+	e.timeout = timer.timeout;
+	e.trigger_time = now() + (double)(timer.timeout - timer.elapsed);
+	e.wheel_id = m_wheel ?
+		m_wheel->schedule(e.trigger_time, m_blockpos, index) : 0;
+	m_timers[index] = e;
+}
+
 std::vector<NodeTimer> NodeTimerList::step(float dtime)
 {
 	std::vector<NodeTimer> elapsed_timers;
+
+	if (m_wheel) {
+		// Rare, the wheel steps attached lists. Catch up without it.
+		NodeTimerWheel *wheel = m_wheel;
+		detach();
+		elapsed_timers = step(dtime);
+		attach(wheel, m_blockpos);
+		return elapsed_timers;
+	}
+
 	m_time += dtime;
-	if (m_next_trigger_time == -1. || m_time < m_next_trigger_time) {
+	if (m_timers.empty())
 		return elapsed_timers;
+
+	std::vector<std::pair<double, u16>> due;
+	for (const auto &it : m_timers) {
+		if (it.second.trigger_time <= m_time)
+			due.emplace_back(it.second.trigger_time, it.first);
 	}
-	std::multimap<double, NodeTimer>::iterator i = m_timers.begin();
-	// Process timers
-	for (; i != m_timers.end() && i->first <= m_time; ++i) {
-		NodeTimer t = i->second;
-		t.elapsed = t.timeout + (f32)(m_time - i->first);
-		elapsed_timers.push_back(t);
-		m_iterators.erase(t.position);
+	std::sort(due.begin(), due.end());
+
+	elapsed_timers.reserve(due.size());
+	for (const auto &d : due) {
+		const Entry &e = m_timers[d.second];
+		elapsed_timers.emplace_back(e.timeout,
+			e.timeout + (f32)(m_time - e.trigger_time), positionOf(d.second));
+		m_timers.erase(d.second);
 	}
-	// Delete elapsed timers
-	m_timers.erase(m_timers.begin(), i);
-	if (m_timers.empty())
-		m_next_trigger_time = -1.;
-	else
-		m_next_trigger_time = m_timers.begin()->first;
 	return elapsed_timers;
 }
+
+void NodeTimerList::attach(NodeTimerWheel *wheel, v3s16 blockpos)
+{
+	assert(!m_wheel);
+
+	// Time doesn't pass for a list without wheel
+	double shift = wheel->getTime() - m_time;
+	for (auto &it : m_timers) {
+		Entry &e = it.second;
+		e.trigger_time += shift;
+		e.wheel_id = wheel->schedule(e.trigger_time, blockpos, it.first);
+	}
+	m_wheel = wheel;
+	m_blockpos = blockpos;
+}
+
+void NodeTimerList::detach()
+{
+	if (!m_wheel)
+		return;
+
+	m_time = m_wheel->getTime();
+	for (auto &it : m_timers)
+		it.second.wheel_id = 0;
+	m_wheel = nullptr;
+}
+
+bool NodeTimerList::takeExpired(u16 index, u32 wheel_id, NodeTimer &timer)
+{
+	auto it = m_timers.find(index);
+	if (it == m_timers.end() || it->second.wheel_id != wheel_id)
+		return false;
+
+	const Entry &e = it->second;
+	timer = NodeTimer(e.timeout, e.timeout + (f32)(now() - e.trigger_time),
+		positionOf(index));
+	m_timers.erase(it);
+	return true;
+}
+
+/*
+	NodeTimerWheel
+*/
+
+NodeTimerWheel::NodeTimerWheel(f32 resolution):
+	m_resolution(resolution)
+{
+}
+
+u32 NodeTimerWheel::schedule(double trigger_time, v3s16 blockpos, u16 index)
+{
+	Entry entry;
+	// Round up, timers must never come up early
+	entry.tick = (u64)std::max(std::ceil(trigger_time / m_resolution), 0.0);
+	// Due ones go into the next tick, like the timers set while stepping
+	entry.tick = std::max(entry.tick, m_tick + 1);
+	entry.timer.blockpos = blockpos;
+	entry.timer.index = index;
+	entry.timer.id = m_next_id++;
+	if (m_next_id == 0)
+		m_next_id = 1;
+	entry.timer.trigger_time = trigger_time;
+
+	place(entry);
+	m_count++;
+	return entry.timer.id;
+}
+
+void NodeTimerWheel::place(const Entry &entry)
+{
+	// The lowest level whose span still contains both the current and the
+	// trigger tick
+	for (u32 level = 0; level < LEVELS; level++) {
+		u32 span_shift = SLOT_BITS * (level + 1);
+		if ((entry.tick >> span_shift) == (m_tick >> span_shift)) {
+			u32 slot = (entry.tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+			m_slots[level][slot].push_back(entry);
+			return;
+		}
+	}
+	m_overflow.push_back(entry);
+}
+
+void NodeTimerWheel::cascade(std::vector<Entry> &slot)
+{
+	std::vector<Entry> entries;
+	entries.swap(slot);
+	for (const Entry &entry : entries)
+		place(entry);
+}
+
+void NodeTimerWheel::advance(f32 dtime, std::vector<Expired> &expired)
+{
+	size_t first_expired = expired.size();
+
+	m_time += dtime;
+	u64 target = (u64)std::max(std::floor(m_time / m_resolution), 0.0);
+
+	while (m_tick < target) {
+		m_tick++;
+
+		// Going past the span of a level moves the entries of its next slot
+		// down, the highest level first
+		if ((m_tick & ((1ULL << (SLOT_BITS * LEVELS)) - 1)) == 0)
+			cascade(m_overflow);
+		for (u32 level = LEVELS - 1; level > 0; level--) {
+			if ((m_tick & ((1ULL << (SLOT_BITS * level)) - 1)) != 0)
+				continue;
+			cascade(m_slots[level][(m_tick >> (SLOT_BITS * level)) & (SLOTS - 1)]);
+		}
+
+		std::vector<Entry> &slot = m_slots[0][m_tick & (SLOTS - 1)];
+		for (const Entry &entry : slot)
+			expired.push_back(entry.timer);
+		m_count -= slot.size();
+		slot.clear();
+	}
+
+	std::sort(expired.begin() + first_expired, expired.end(),
+		[](const Expired &a, const Expired &b) {
+			return a.trigger_time < b.trigger_time;
+		});
+}
@@ -20,8 +20,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include "irr_v3d.h"
+#include "constants.h"
 #include <iostream>
-#include <map>
+#include <unordered_map>
 #include <vector>
 
 /*
@@ -50,8 +51,14 @@ class NodeTimer
 	v3s16 position;
 };
 
+class NodeTimerWheel;
+
 /*
 	List of timers of all the nodes of a block
+
+	While the block is active, the list is attached to the NodeTimerWheel of
+	the environment, which takes care of finding the timers that expired.
+	The list then follows the clock of the wheel.
 */
 
 class NodeTimerList
@@ -64,65 +71,115 @@ class NodeTimerList
 	void deSerialize(std::istream &is, u8 map_format_version);
 
 	// Get timer
-	NodeTimer get(const v3s16 &p) {
-		std::map<v3s16, std::multimap<double, NodeTimer>::iterator>::iterator n =
-			m_iterators.find(p);
-		if (n == m_iterators.end())
-			return NodeTimer();
-		NodeTimer t = n->second->second;
-		t.elapsed = t.timeout - (n->second->first - m_time);
-		return t;
-	}
+	NodeTimer get(const v3s16 &p) const;
 	// Deletes timer
-	void remove(v3s16 p) {
-		std::map<v3s16, std::multimap<double, NodeTimer>::iterator>::iterator n =
-			m_iterators.find(p);
-		if(n != m_iterators.end()) {
-			double removed_time = n->second->first;
-			m_timers.erase(n->second);
-			m_iterators.erase(n);
-			// Yes, this is float equality, but it is not a problem
-			// since we only test equality of floats as an ordered type
-			// and thus we never lose precision
-			if (removed_time == m_next_trigger_time) {
-				if (m_timers.empty())
-					m_next_trigger_time = -1.;
-				else
-					m_next_trigger_time = m_timers.begin()->first;
-			}
-		}
-	}
-	// Undefined behaviour if there already is a timer
-	void insert(NodeTimer timer) {
-		v3s16 p = timer.position;
-		double trigger_time = m_time + (double)(timer.timeout - timer.elapsed);
-		std::multimap<double, NodeTimer>::iterator it =
-			m_timers.insert(std::pair<double, NodeTimer>(
-				trigger_time, timer
-			));
-		m_iterators.insert(
-			std::pair<v3s16, std::multimap<double, NodeTimer>::iterator>(p, it));
-		if (m_next_trigger_time == -1. || trigger_time < m_next_trigger_time)
-			m_next_trigger_time = trigger_time;
-	}
+	void remove(const v3s16 &p);
+	// Replaces a timer that is already there
+	void insert(const NodeTimer &timer);
 	// Deletes old timer and sets a new one
 	inline void set(const NodeTimer &timer) {
-		remove(timer.position);
 		insert(timer);
 	}
 	// Deletes all timers
 	void clear() {
 		m_timers.clear();
-		m_iterators.clear();
-		m_next_trigger_time = -1.;
 	}
 
+	size_t size() const { return m_timers.size(); }
+
 	// Move forward in time, returns elapsed timers
 	std::vector<NodeTimer> step(float dtime);
 
+	// Hands the timers over to a wheel, the list then follows its clock
+	void attach(NodeTimerWheel *wheel, v3s16 blockpos);
+	// Takes the timers back, the clock of the list stands still from now on
+	void detach();
+	bool isAttached() const { return m_wheel != nullptr; }
+
+	// Removes and returns the timer an expired wheel entry refers to,
+	// unless the timer was removed or set again in the meantime
+	bool takeExpired(u16 index, u32 wheel_id, NodeTimer &timer);
+
+	static inline u16 indexOf(const v3s16 &p)
+	{
+		return p.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE + p.Y * MAP_BLOCKSIZE + p.X;
+	}
+
+	static inline v3s16 positionOf(u16 index)
+	{
+		return v3s16(index % MAP_BLOCKSIZE,
+			(index / MAP_BLOCKSIZE) % MAP_BLOCKSIZE,
+			index / (MAP_BLOCKSIZE * MAP_BLOCKSIZE));
+	}
+
 private:
-	std::multimap<double, NodeTimer> m_timers;
-	std::map<v3s16, std::multimap<double, NodeTimer>::iterator> m_iterators;
-	double m_next_trigger_time = -1.0;
+	struct Entry {
+		f32 timeout;
+		double trigger_time;
+		// 0 while the list is not attached
+		u32 wheel_id;
+	};
+
+	double now() const;
+
+	// Keyed by node index (see indexOf)
+	std::unordered_map<u16, Entry> m_timers;
+	NodeTimerWheel *m_wheel = nullptr;
+	v3s16 m_blockpos;
+	double m_time = 0.0;
+};
+
+/*
+	Hierarchical timing wheel driving the node timers of all active blocks.
+
+	Scheduling is O(1). Timers that are removed or set again are not looked
+	up in the wheel, the stale entries are dropped once they come up (see
+	NodeTimerList::takeExpired).
+*/
+
+class NodeTimerWheel
+{
+public:
+	struct Expired {
+		v3s16 blockpos;
+		u16 index;
+		u32 id;
+		double trigger_time;
+	};
+
+	NodeTimerWheel(f32 resolution = 0.05f);
+
+	double getTime() const { return m_time; }
+
+	// Returns the id of the new entry
+	u32 schedule(double trigger_time, v3s16 blockpos, u16 index);
+
+	// Move forward in time, appends the entries that came up ordered by
+	// trigger time
+	void advance(f32 dtime, std::vector<Expired> &expired);
+
+	// Number of entries, including stale ones
+	size_t size() const { return m_count; }
+
+private:
+	static const u32 LEVELS = 4;
+	static const u32 SLOT_BITS = 6;
+	static const u32 SLOTS = 1 << SLOT_BITS;
+
+	struct Entry {
+		u64 tick;
+		Expired timer;
+	};
+
+	void place(const Entry &entry);
+	void cascade(std::vector<Entry> &slot);
+
+	std::vector<Entry> m_slots[LEVELS][SLOTS];
+	// Entries too far in the future for the wheel
+	std::vector<Entry> m_overflow;
+	f32 m_resolution;
 	double m_time = 0.0;
+	u64 m_tick = 0;
+	u32 m_next_id = 1;
+	size_t m_count = 0;
 };
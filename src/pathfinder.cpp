@@ -24,7 +24,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "pathfinder.h"
 #include "map.h"
+#include "mapblock.h"
 #include "nodedef.h"
+#include "util/thread.h"
+#include <queue>
+#include <set>
 
 //#define PATHFINDER_DEBUG
 //#define PATHFINDER_CALC_TIME
@@ -59,10 +63,55 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define PATHFINDER_MAX_WAYPOINTS 700
 
+/* limits of PathfinderService */
+#define PATHFINDER_MAX_CACHED_BLOCKS 4096
+#define PATHFINDER_MAX_ASYNC_SEARCHDISTANCE 64
+
 /******************************************************************************/
 /* Class definitions                                                          */
 /******************************************************************************/
 
+/** looks up nodes on the map, used by synchronous searches */
+class MapPathNodeSource : public PathNodeSource {
+public:
+	MapPathNodeSource(Map *map, const NodeDefManager *ndef) :
+		m_map(map), m_ndef(ndef) {}
+
+	virtual PathNodeType getNodeType(v3s16 pos);
+
+private:
+	Map *m_map;
+	const NodeDefManager *m_ndef;
+};
+
+/** a search queued in PathfinderService */
+struct PathJob {
+	u32 id;
+	v3s16 source;
+	v3s16 destination;
+	unsigned int searchdistance;
+	unsigned int max_jump;
+	unsigned int max_drop;
+	PathAlgorithm algo;
+	std::string mod_origin;
+
+	v3s16 blockpos_min;   /**< blocks the search area is in              */
+	v3s16 blockpos_max;
+	PathBlockMap blocks;  /**< the loaded ones of them                    */
+};
+
+class PathfinderThread : public Thread {
+public:
+	PathfinderThread(PathfinderService *service) :
+		Thread("Pathfinder"), m_service(service) {}
+
+protected:
+	void *run();
+
+private:
+	PathfinderService *m_service;
+};
+
 
 /** representation of cost in specific direction */
 class PathCost {
@@ -179,7 +228,7 @@ class Pathfinder {
 
 public:
 	Pathfinder() = delete;
-	Pathfinder(Map *map, const NodeDefManager *ndef) : m_map(map), m_ndef(ndef) {}
+	Pathfinder(PathNodeSource *nodes) : m_nodes(nodes) {}
 
 	~Pathfinder();
 
@@ -321,9 +370,9 @@ class Pathfinder {
 	friend class GridNodeContainer;
 	GridNodeContainer *m_nodes_container = nullptr;
 
-	Map *m_map = nullptr;
+	PathNodeSource *m_nodes = nullptr;
 
-	const NodeDefManager *m_ndef = nullptr;
+	PathNodeType getNodeType(v3s16 pos) { return m_nodes->getNodeType(pos); }
 
 	friend class PathfinderCompareHeuristic;
 
@@ -413,7 +462,8 @@ std::vector<v3s16> get_path(Map* map, const NodeDefManager *ndef,
 		unsigned int max_drop,
 		PathAlgorithm algo)
 {
-	return Pathfinder(map, ndef).getPath(source, destination,
+	MapPathNodeSource nodes(map, ndef);
+	return Pathfinder(&nodes).getPath(source, destination,
 				searchdistance, max_jump, max_drop, algo);
 }
 
@@ -513,20 +563,19 @@ void PathGridnode::setCost(v3s16 dir, const PathCost &cost)
 
 void GridNodeContainer::initNode(v3s16 ipos, PathGridnode *p_node)
 {
-	const NodeDefManager *ndef = m_pathf->m_ndef;
 	PathGridnode &elem = *p_node;
 
 	v3s16 realpos = m_pathf->getRealPos(ipos);
 
-	MapNode current = m_pathf->m_map->getNode(realpos);
-	MapNode below   = m_pathf->m_map->getNode(realpos + v3s16(0, -1, 0));
+	PathNodeType current = m_pathf->getNodeType(realpos);
+	PathNodeType below   = m_pathf->getNodeType(realpos + v3s16(0, -1, 0));
 
 
-	if ((current.param0 == CONTENT_IGNORE) ||
-			(below.param0 == CONTENT_IGNORE)) {
+	if ((current == PATH_NODE_IGNORE) ||
+			(below == PATH_NODE_IGNORE)) {
 		DEBUG_OUT("Pathfinder: " << PP(realpos) <<
 			" current or below is invalid element" << std::endl);
-		if (current.param0 == CONTENT_IGNORE) {
+		if (current == PATH_NODE_IGNORE) {
 			elem.type = 'i';
 			DEBUG_OUT(PP(ipos) << ": " << 'i' << std::endl);
 		}
@@ -534,10 +583,10 @@ void GridNodeContainer::initNode(v3s16 ipos, PathGridnode *p_node)
 	}
 
 	//don't add anything if it isn't an air node
-	if (ndef->get(current).walkable || !ndef->get(below).walkable) {
+	if (current == PATH_NODE_WALKABLE || below != PATH_NODE_WALKABLE) {
 			DEBUG_OUT("Pathfinder: " << PP(realpos)
 				<< " not on surface" << std::endl);
-			if (ndef->get(current).walkable) {
+			if (current == PATH_NODE_WALKABLE) {
 				elem.type = 's';
 				DEBUG_OUT(PP(ipos) << ": " << 's' << std::endl);
 			} else {
@@ -664,14 +713,12 @@ std::vector<v3s16> Pathfinder::getPath(v3s16 source,
 #endif
 
 	//fail if source or destination is walkable
-	MapNode node_at_pos = m_map->getNode(destination);
-	if (m_ndef->get(node_at_pos).walkable) {
+	if (getNodeType(destination) == PATH_NODE_WALKABLE) {
 		VERBOSE_TARGET << "Destination is walkable. " <<
 				"Pos: " << PP(destination) << std::endl;
 		return retval;
 	}
-	node_at_pos = m_map->getNode(source);
-	if (m_ndef->get(node_at_pos).walkable) {
+	if (getNodeType(source) == PATH_NODE_WALKABLE) {
 		VERBOSE_TARGET << "Source is walkable. " <<
 				"Pos: " << PP(source) << std::endl;
 		return retval;
@@ -838,28 +885,28 @@ PathCost Pathfinder::calcCost(v3s16 pos, v3s16 dir)
 		return retval;
 	}
 
-	MapNode node_at_pos2 = m_map->getNode(pos2);
+	PathNodeType node_at_pos2 = getNodeType(pos2);
 
 	//did we get information about node?
-	if (node_at_pos2.param0 == CONTENT_IGNORE ) {
+	if (node_at_pos2 == PATH_NODE_IGNORE) {
 			VERBOSE_TARGET << "Pathfinder: (1) area at pos: "
 					<< PP(pos2) << " not loaded";
 			return retval;
 	}
 
-	if (!m_ndef->get(node_at_pos2).walkable) {
-		MapNode node_below_pos2 =
-			m_map->getNode(pos2 + v3s16(0, -1, 0));
+	if (node_at_pos2 != PATH_NODE_WALKABLE) {
+		PathNodeType node_below_pos2 =
+			getNodeType(pos2 + v3s16(0, -1, 0));
 
 		//did we get information about node?
-		if (node_below_pos2.param0 == CONTENT_IGNORE ) {
+		if (node_below_pos2 == PATH_NODE_IGNORE) {
 				VERBOSE_TARGET << "Pathfinder: (2) area at pos: "
 					<< PP((pos2 + v3s16(0, -1, 0))) << " not loaded";
 				return retval;
 		}
 
 		//test if the same-height neighbor is suitable
-		if (m_ndef->get(node_below_pos2).walkable) {
+		if (node_below_pos2 == PATH_NODE_WALKABLE) {
 			//SUCCESS!
 			retval.valid = true;
 			retval.value = 1;
@@ -870,19 +917,17 @@ PathCost Pathfinder::calcCost(v3s16 pos, v3s16 dir)
 		else {
 			//test if we can fall a couple of nodes (m_maxdrop)
 			v3s16 testpos = pos2 + v3s16(0, -1, 0);
-			MapNode node_at_pos = m_map->getNode(testpos);
+			PathNodeType node_at_pos = getNodeType(testpos);
 
-			while ((node_at_pos.param0 != CONTENT_IGNORE) &&
-					(!m_ndef->get(node_at_pos).walkable) &&
+			while ((node_at_pos == PATH_NODE_OPEN) &&
 					(testpos.Y > m_limits.MinEdge.Y)) {
 				testpos += v3s16(0, -1, 0);
-				node_at_pos = m_map->getNode(testpos);
+				node_at_pos = getNodeType(testpos);
 			}
 
 			//did we find surface?
 			if ((testpos.Y >= m_limits.MinEdge.Y) &&
-					(node_at_pos.param0 != CONTENT_IGNORE) &&
-					(m_ndef->get(node_at_pos).walkable)) {
+					(node_at_pos == PATH_NODE_WALKABLE)) {
 				if ((pos2.Y - testpos.Y - 1) <= m_maxdrop) {
 					//SUCCESS!
 					retval.valid = true;
@@ -908,34 +953,31 @@ PathCost Pathfinder::calcCost(v3s16 pos, v3s16 dir)
 
 		v3s16 targetpos = pos2; // position for jump target
 		v3s16 jumppos = pos; // position for checking if jumping space is free
-		MapNode node_target = m_map->getNode(targetpos);
-		MapNode node_jump = m_map->getNode(jumppos);
+		PathNodeType node_target = getNodeType(targetpos);
+		PathNodeType node_jump = getNodeType(jumppos);
 		bool headbanger = false; // true if anything blocks jumppath
 
-		while ((node_target.param0 != CONTENT_IGNORE) &&
-				(m_ndef->get(node_target).walkable) &&
+		while ((node_target == PATH_NODE_WALKABLE) &&
 				(targetpos.Y < m_limits.MaxEdge.Y)) {
 			//if the jump would hit any solid node, discard
-			if ((node_jump.param0 == CONTENT_IGNORE) ||
-					(m_ndef->get(node_jump).walkable)) {
+			if (node_jump != PATH_NODE_OPEN) {
 					headbanger = true;
 				break;
 			}
 			targetpos += v3s16(0, 1, 0);
 			jumppos   += v3s16(0, 1, 0);
-			node_target = m_map->getNode(targetpos);
-			node_jump   = m_map->getNode(jumppos);
+			node_target = getNodeType(targetpos);
+			node_jump   = getNodeType(jumppos);
 
 		}
 		//check headbanger one last time
-		if ((node_jump.param0 == CONTENT_IGNORE) ||
-			(m_ndef->get(node_jump).walkable)) {
+		if (node_jump != PATH_NODE_OPEN) {
 			headbanger = true;
 		}
 
 		//did we find surface without banging our head?
 		if ((!headbanger) && (targetpos.Y <= m_limits.MaxEdge.Y) &&
-				(!m_ndef->get(node_target).walkable)) {
+				(node_target != PATH_NODE_WALKABLE)) {
 
 			if (targetpos.Y - pos2.Y <= m_maxjump) {
 				//SUCCESS!
@@ -1235,20 +1277,18 @@ v3s16 Pathfinder::walkDownwards(v3s16 pos, unsigned int max_down) {
 	if (max_down == 0)
 		return pos;
 	v3s16 testpos = v3s16(pos);
-	MapNode node_at_pos = m_map->getNode(testpos);
+	PathNodeType node_at_pos = getNodeType(testpos);
 	unsigned int down = 0;
-	while ((node_at_pos.param0 != CONTENT_IGNORE) &&
-			(!m_ndef->get(node_at_pos).walkable) &&
+	while ((node_at_pos == PATH_NODE_OPEN) &&
 			(testpos.Y > m_limits.MinEdge.Y) &&
 			(down <= max_down)) {
 		testpos += v3s16(0, -1, 0);
 		down++;
-		node_at_pos = m_map->getNode(testpos);
+		node_at_pos = getNodeType(testpos);
 	}
 	//did we find surface?
 	if ((testpos.Y >= m_limits.MinEdge.Y) &&
-			(node_at_pos.param0 != CONTENT_IGNORE) &&
-			(m_ndef->get(node_at_pos).walkable)) {
+			(node_at_pos == PATH_NODE_WALKABLE)) {
 		if (down == 0) {
 			pos = testpos;
 		} else if ((down - 1) <= max_down) {
@@ -1439,3 +1479,328 @@ void Pathfinder::printPath(const std::vector<v3s16> &path)
 }
 
 #endif
+
+/******************************************************************************/
+PathNodeType MapPathNodeSource::getNodeType(v3s16 pos)
+{
+	MapNode n = m_map->getNode(pos);
+	if (n.param0 == CONTENT_IGNORE)
+		return PATH_NODE_IGNORE;
+	return m_ndef->get(n).walkable ? PATH_NODE_WALKABLE : PATH_NODE_OPEN;
+}
+
+/******************************************************************************/
+void PathBlock::classify(const NodeDefManager *ndef)
+{
+	std::call_once(m_classified, [this, ndef] {
+		if (!contents)
+			return;
+
+		for (u32 i = 0; i < MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE; i++) {
+			content_t c = contents[i];
+			if (c == CONTENT_IGNORE) {
+				nodes[i] = PATH_NODE_IGNORE;
+			} else if (ndef->get(c).walkable) {
+				nodes[i] = PATH_NODE_WALKABLE;
+			} else {
+				nodes[i] = PATH_NODE_OPEN;
+				passable = true;
+			}
+		}
+		contents.reset();
+	});
+}
+
+/******************************************************************************/
+PathNodeType SnapshotPathNodeSource::getNodeType(v3s16 pos)
+{
+	v3s16 blockpos = getNodeBlockPos(pos);
+	if (!m_last_valid || blockpos != m_last_blockpos) {
+		m_last_blockpos = blockpos;
+		m_last_block = nullptr;
+		m_last_valid = true;
+
+		PathBlockMap::const_iterator it = m_blocks.find(blockpos);
+		if (it != m_blocks.end() && (!m_corridor ||
+				m_corridor->find(blockpos) != m_corridor->end()))
+			m_last_block = it->second.get();
+	}
+
+	if (!m_last_block)
+		return PATH_NODE_IGNORE;
+
+	v3s16 rel = pos - blockpos * MAP_BLOCKSIZE;
+	return m_last_block->nodes[rel.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+			rel.Y * MAP_BLOCKSIZE + rel.X];
+}
+
+/******************************************************************************/
+void *PathfinderThread::run()
+{
+	while (!stopRequested()) {
+		PathJob *job = m_service->m_jobs.pop_frontNoEx(100);
+		if (job)
+			m_service->runJob(job);
+	}
+
+	return nullptr;
+}
+
+/******************************************************************************/
+bool findCorridor(const PathBlockMap &blocks, v3s16 source,
+		v3s16 destination, std::set<v3s16> &corridor)
+{
+	const v3s16 start = getNodeBlockPos(source);
+	const v3s16 end   = getNodeBlockPos(destination);
+	const v3s16 dirs[6] = {
+		v3s16(1, 0, 0), v3s16(-1, 0, 0),
+		v3s16(0, 1, 0), v3s16(0, -1, 0),
+		v3s16(0, 0, 1), v3s16(0, 0, -1)
+	};
+
+	auto passable = [&blocks] (v3s16 blockpos) {
+		PathBlockMap::const_iterator it = blocks.find(blockpos);
+		return it != blocks.end() && it->second->passable;
+	};
+	auto distance = [&end] (v3s16 blockpos) {
+		return std::abs(blockpos.X - end.X) + std::abs(blockpos.Y - end.Y) +
+				std::abs(blockpos.Z - end.Z);
+	};
+
+	if (!passable(start) || !passable(end))
+		return false;
+
+	// value: block the search came from
+	std::map<v3s16, v3s16> came_from;
+	std::map<v3s16, int> cost;
+	// estimated total cost, block
+	typedef std::pair<int, std::pair<int, v3s16>> OpenEntry;
+	std::priority_queue<OpenEntry, std::vector<OpenEntry>,
+			std::greater<OpenEntry>> open;
+
+	came_from[start] = start;
+	cost[start] = 0;
+	open.emplace(distance(start), std::make_pair(0, start));
+
+	bool found = false;
+	while (!open.empty()) {
+		v3s16 current = open.top().second.second;
+		int current_cost = open.top().second.first;
+		open.pop();
+
+		if (current == end) {
+			found = true;
+			break;
+		}
+		if (current_cost > cost[current])
+			continue;
+
+		for (const v3s16 &dir : dirs) {
+			v3s16 next = current + dir;
+			if (!passable(next))
+				continue;
+
+			int next_cost = current_cost + 1;
+			std::map<v3s16, int>::iterator it = cost.find(next);
+			if (it != cost.end() && it->second <= next_cost)
+				continue;
+
+			cost[next] = next_cost;
+			came_from[next] = current;
+			open.emplace(next_cost + distance(next),
+					std::make_pair(next_cost, next));
+		}
+	}
+
+	if (!found)
+		return false;
+
+	// Nodes of a path along the chain can be in the neighbouring blocks too,
+	// e.g. the ground it leads over
+	for (v3s16 blockpos = end;; blockpos = came_from[blockpos]) {
+		for (s16 z = -1; z <= 1; z++)
+		for (s16 y = -1; y <= 1; y++)
+		for (s16 x = -1; x <= 1; x++)
+			corridor.insert(blockpos + v3s16(x, y, z));
+
+		if (blockpos == start)
+			break;
+	}
+	return true;
+}
+
+/******************************************************************************/
+PathfinderService::PathfinderService(Map *map, const NodeDefManager *ndef) :
+	m_map(map), m_ndef(ndef)
+{
+}
+
+PathfinderService::~PathfinderService()
+{
+	stop();
+}
+
+/******************************************************************************/
+void PathfinderService::start(unsigned int num_threads)
+{
+	for (unsigned int i = 0; i < num_threads; i++) {
+		m_threads.emplace_back(new PathfinderThread(this));
+		m_threads.back()->start();
+	}
+}
+
+/******************************************************************************/
+void PathfinderService::stop()
+{
+	for (std::unique_ptr<PathfinderThread> &thread : m_threads)
+		thread->stop();
+	for (std::unique_ptr<PathfinderThread> &thread : m_threads)
+		thread->wait();
+	m_threads.clear();
+
+	// Drop the searches no thread got to
+	while (PathJob *job = m_jobs.pop_frontNoEx(0))
+		delete job;
+}
+
+/******************************************************************************/
+u32 PathfinderService::findPath(v3s16 source,
+		v3s16 destination,
+		unsigned int searchdistance,
+		unsigned int max_jump,
+		unsigned int max_drop,
+		PathAlgorithm algo,
+		const std::string &mod_origin)
+{
+	PathJob *job = new PathJob();
+	job->id             = m_next_id++;
+	job->source         = source;
+	job->destination    = destination;
+	job->searchdistance = MYMIN(searchdistance,
+			PATHFINDER_MAX_ASYNC_SEARCHDISTANCE);
+	job->max_jump       = max_jump;
+	job->max_drop       = max_drop;
+	job->algo           = algo;
+	job->mod_origin     = mod_origin;
+
+	// Collect the blocks of the search area, including the nodes below it
+	// that tell whether its lowest nodes can be stood on
+	s16 d = job->searchdistance;
+	job->blockpos_min = getNodeBlockPos(v3s16(
+			MYMIN(source.X, destination.X) - d,
+			MYMIN(source.Y, destination.Y) - d - 1,
+			MYMIN(source.Z, destination.Z) - d));
+	job->blockpos_max = getNodeBlockPos(v3s16(
+			MYMAX(source.X, destination.X) + d,
+			MYMAX(source.Y, destination.Y) + d,
+			MYMAX(source.Z, destination.Z) + d));
+
+	for (s16 z = job->blockpos_min.Z; z <= job->blockpos_max.Z; z++)
+	for (s16 y = job->blockpos_min.Y; y <= job->blockpos_max.Y; y++)
+	for (s16 x = job->blockpos_min.X; x <= job->blockpos_max.X; x++) {
+		v3s16 blockpos(x, y, z);
+		std::shared_ptr<PathBlock> block = getBlock(blockpos);
+		if (block)
+			job->blocks.emplace(blockpos, std::move(block));
+	}
+
+	u32 id = job->id;
+	if (m_threads.empty())
+		runJob(job);
+	else
+		m_jobs.push_back(job);
+	return id;
+}
+
+/******************************************************************************/
+std::shared_ptr<PathBlock> PathfinderService::getBlock(v3s16 blockpos)
+{
+	{
+		MutexAutoLock lock(m_cache_mutex);
+		auto it = m_cache.find(blockpos);
+		if (it != m_cache.end()) {
+			m_cache_order.splice(m_cache_order.begin(), m_cache_order,
+					it->second.first);
+			return it->second.second;
+		}
+	}
+
+	MapBlock *block = m_map->getBlockNoCreateNoEx(blockpos);
+	if (!block || !block->isGenerated())
+		return nullptr;
+
+	// Only copy the contents here, the search classifies them
+	std::shared_ptr<PathBlock> result = std::make_shared<PathBlock>();
+	result->contents.reset(
+			new content_t[MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE]);
+	content_t *content = result->contents.get();
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++)
+		*content++ = block->getNodeUnsafe(x, y, z).param0;
+
+	MutexAutoLock lock(m_cache_mutex);
+	m_cache_order.push_front(blockpos);
+	m_cache[blockpos] = std::make_pair(m_cache_order.begin(), result);
+
+	// Drop the least recently used block
+	if (m_cache.size() > PATHFINDER_MAX_CACHED_BLOCKS) {
+		m_cache.erase(m_cache_order.back());
+		m_cache_order.pop_back();
+	}
+	return result;
+}
+
+/******************************************************************************/
+void PathfinderService::invalidateBlock(v3s16 blockpos)
+{
+	MutexAutoLock lock(m_cache_mutex);
+	auto it = m_cache.find(blockpos);
+	if (it == m_cache.end())
+		return;
+
+	m_cache_order.erase(it->second.first);
+	m_cache.erase(it);
+}
+
+/******************************************************************************/
+void PathfinderService::runJob(PathJob *job)
+{
+	PathResult result;
+	result.id = job->id;
+	result.mod_origin = job->mod_origin;
+
+	for (const auto &it : job->blocks)
+		it.second->classify(m_ndef);
+
+	// Search along the corridor first, then in the whole area. If there is
+	// no corridor, there is no path either.
+	std::set<v3s16> corridor;
+	if (findCorridor(job->blocks, job->source, job->destination, corridor)) {
+		SnapshotPathNodeSource nodes(job->blocks, &corridor);
+		result.path = Pathfinder(&nodes).getPath(job->source,
+				job->destination, job->searchdistance, job->max_jump,
+				job->max_drop, job->algo);
+
+		if (result.path.empty()) {
+			SnapshotPathNodeSource all_nodes(job->blocks, nullptr);
+			result.path = Pathfinder(&all_nodes).getPath(job->source,
+					job->destination, job->searchdistance, job->max_jump,
+					job->max_drop, job->algo);
+		}
+	}
+
+	delete job;
+
+	MutexAutoLock lock(m_results_mutex);
+	m_results.push_back(std::move(result));
+}
+
+/******************************************************************************/
+void PathfinderService::getResults(std::vector<PathResult> &results)
+{
+	MutexAutoLock lock(m_results_mutex);
+	for (PathResult &result : m_results)
+		results.push_back(std::move(result));
+	m_results.clear();
+}
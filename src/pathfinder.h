@@ -22,8 +22,17 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 /******************************************************************************/
 /* Includes                                                                   */
 /******************************************************************************/
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
 #include <vector>
 #include "irr_v3d.h"
+#include "constants.h"
+#include "mapnode.h"
+#include "util/container.h"
 
 /******************************************************************************/
 /* Forward declarations                                                       */
@@ -31,6 +40,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 class NodeDefManager;
 class Map;
+class PathfinderThread;
+struct PathJob;
 
 /******************************************************************************/
 /* Typedefs and macros                                                        */
@@ -50,6 +61,13 @@ typedef enum {
 	PA_PLAIN_NP          /**< A* algorithm without prefetching of map data */
 } PathAlgorithm;
 
+/** what the pathfinder needs to know about a node */
+enum PathNodeType : u8 {
+	PATH_NODE_IGNORE,    /**< not loaded or not to be looked at           */
+	PATH_NODE_OPEN,      /**< can be walked through                       */
+	PATH_NODE_WALKABLE   /**< can be walked on                            */
+};
+
 /******************************************************************************/
 /* declarations                                                               */
 /******************************************************************************/
@@ -62,3 +80,129 @@ std::vector<v3s16> get_path(Map *map, const NodeDefManager *ndef,
 		unsigned int max_jump,
 		unsigned int max_drop,
 		PathAlgorithm algo);
+
+/** Abstract class to look up nodes */
+class PathNodeSource {
+public:
+	virtual PathNodeType getNodeType(v3s16 pos)=0;
+	virtual ~PathNodeSource() = default;
+};
+
+/** walkability of the nodes of a block, cached by PathfinderService */
+struct PathBlock {
+	PathNodeType nodes[MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE];
+	bool passable = false; /**< whether any node can be walked through */
+
+	/** contents of the nodes as copied from the map, until classified */
+	std::unique_ptr<content_t[]> contents;
+
+	/** fills in the nodes from the contents once, may be called by any thread */
+	void classify(const NodeDefManager *ndef);
+
+private:
+	std::once_flag m_classified;
+};
+
+typedef std::map<v3s16, std::shared_ptr<PathBlock>> PathBlockMap;
+
+/** looks up nodes in classified blocks collected for a search */
+class SnapshotPathNodeSource : public PathNodeSource {
+public:
+	/**
+	 * @param blocks walkability of the blocks
+	 * @param corridor blocks to look at, all if nullptr
+	 */
+	SnapshotPathNodeSource(const PathBlockMap &blocks,
+			const std::set<v3s16> *corridor) :
+		m_blocks(blocks), m_corridor(corridor) {}
+
+	virtual PathNodeType getNodeType(v3s16 pos);
+
+private:
+	const PathBlockMap &m_blocks;
+	const std::set<v3s16> *m_corridor;
+
+	/* last looked up block, as nodes are mostly looked up next to each other */
+	v3s16 m_last_blockpos;
+	const PathBlock *m_last_block = nullptr;
+	bool m_last_valid = false;
+};
+
+/**
+ * Finds blocks a path from the source to the destination block can lead
+ * through, with A* on the graph of classified blocks that have a node to
+ * walk through. Paths between nodes always lead through such a chain.
+ * @param corridor blocks of the chain and their neighbours
+ * @return false if there is no such chain
+ */
+bool findCorridor(const PathBlockMap &blocks, v3s16 source,
+		v3s16 destination, std::set<v3s16> &corridor);
+
+/** result of a search started by PathfinderService::findPath */
+struct PathResult
+{
+	u32 id;
+	std::vector<v3s16> path; /**< empty if no path was found */
+	std::string mod_origin;  /**< mod that started the search */
+};
+
+/**
+ * Finds paths on worker threads.
+ *
+ * The walkability of map blocks is cached for all searches and has to be
+ * invalidated when a block changes. The server thread only copies the node
+ * contents of blocks that aren't cached, the worker threads classify them.
+ * A search first looks for a corridor on the graph of blocks and then only
+ * looks at the nodes in there.
+ */
+class PathfinderService
+{
+public:
+	PathfinderService(Map *map, const NodeDefManager *ndef);
+	~PathfinderService();
+
+	void start(unsigned int num_threads);
+	void stop();
+
+	/**
+	 * starts a search like get_path, the environment must be locked
+	 * @return id of the search, reported with the result
+	 */
+	u32 findPath(v3s16 source,
+			v3s16 destination,
+			unsigned int searchdistance,
+			unsigned int max_jump,
+			unsigned int max_drop,
+			PathAlgorithm algo,
+			const std::string &mod_origin);
+
+	/** forgets the cached walkability of a block, may be called by any thread */
+	void invalidateBlock(v3s16 blockpos);
+
+	/** appends the results of finished searches */
+	void getResults(std::vector<PathResult> &results);
+
+private:
+	friend class PathfinderThread;
+
+	/** cached walkability of a block, nullptr if it's not loaded */
+	std::shared_ptr<PathBlock> getBlock(v3s16 blockpos);
+	void runJob(PathJob *job);
+
+	Map *m_map;
+	const NodeDefManager *m_ndef;
+
+	std::mutex m_cache_mutex;
+	/* value: position in m_cache_order, block */
+	std::map<v3s16, std::pair<std::list<v3s16>::iterator,
+			std::shared_ptr<PathBlock>>> m_cache;
+	/* most recently used first */
+	std::list<v3s16> m_cache_order;
+
+	u32 m_next_id = 0;
+	MutexedQueue<PathJob *> m_jobs;
+	std::vector<std::unique_ptr<PathfinderThread>> m_threads;
+
+	std::mutex m_results_mutex;
+	std::vector<PathResult> m_results;
+};
@@ -19,9 +19,304 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "profiler.h"
 #include "porting.h"
+#include "log.h"
+#include "util/thread.h"
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <vector>
 
 static Profiler main_profiler;
 Profiler *g_profiler = &main_profiler;
+
+/*
+	Profiler zones
+*/
+
+// Entries of a thread that wait to be written to the trace
+#define TRACE_BUFFER_SIZE 4096
+
+struct ZoneInfo
+{
+	std::string name;
+	ScopeProfilerType type;
+};
+
+struct TraceEvent
+{
+	u64 start;
+	u32 duration;
+	u16 zone;
+};
+
+struct ZoneThreadData
+{
+	// Written by the thread, taken by Profiler::collectZones
+	std::atomic<u64> time_ns[PROFILER_MAX_ZONES];
+	std::atomic<u32> count[PROFILER_MAX_ZONES];
+
+	// Ring buffer written by the thread, read by the trace thread
+	TraceEvent events[TRACE_BUFFER_SIZE];
+	std::atomic<u32> events_head{0};
+	std::atomic<u32> events_tail{0};
+
+	u32 tid;
+};
+
+// Gives the data of an exited thread to the next one that needs it
+struct ZoneThreadHandle
+{
+	ZoneThreadData *data = nullptr;
+	~ZoneThreadHandle();
+};
+
+static std::mutex g_zones_mutex;
+static ZoneInfo g_zones[PROFILER_MAX_ZONES];
+static std::atomic<u16> g_zone_count{0};
+// Never freed, the data of exited threads is reused
+static std::vector<ZoneThreadData *> g_zone_threads;
+static std::vector<ZoneThreadData *> g_free_zone_threads;
+static thread_local ZoneThreadHandle t_zone_thread;
+
+static std::atomic<bool> g_trace_enabled{false};
+static std::atomic<u32> g_trace_dropped{0};
+
+ZoneThreadHandle::~ZoneThreadHandle()
+{
+	if (!data)
+		return;
+	MutexAutoLock lock(g_zones_mutex);
+	g_free_zone_threads.push_back(data);
+}
+
+static ZoneThreadData *get_zone_thread_data()
+{
+	if (t_zone_thread.data)
+		return t_zone_thread.data;
+
+	MutexAutoLock lock(g_zones_mutex);
+	ZoneThreadData *data;
+	if (!g_free_zone_threads.empty()) {
+		data = g_free_zone_threads.back();
+		g_free_zone_threads.pop_back();
+	} else {
+		data = new ZoneThreadData();
+		data->tid = g_zone_threads.size() + 1;
+		g_zone_threads.push_back(data);
+	}
+	t_zone_thread.data = data;
+	return data;
+}
+
+ProfilerZone::ProfilerZone(const char *name, ScopeProfilerType type)
+{
+	MutexAutoLock lock(g_zones_mutex);
+	u16 count = g_zone_count.load();
+	if (count == PROFILER_MAX_ZONES) {
+		errorstream << "ProfilerZone: too many zones, not profiling "
+				<< name << std::endl;
+		m_id = PROFILER_MAX_ZONES;
+		return;
+	}
+
+	m_id = count;
+	g_zones[m_id].name = std::string(name) + " [ms]";
+	g_zones[m_id].type = type;
+	g_zone_count.store(count + 1);
+}
+
+ZoneProfiler::ZoneProfiler(const ProfilerZone &zone) :
+		m_id(zone.getId()), m_start(porting::getTimeNs())
+{
+}
+
+ZoneProfiler::~ZoneProfiler()
+{
+	if (m_id >= PROFILER_MAX_ZONES)
+		return;
+
+	u64 duration = porting::getTimeNs() - m_start;
+	ZoneThreadData *data = get_zone_thread_data();
+	data->time_ns[m_id].fetch_add(duration, std::memory_order_relaxed);
+	data->count[m_id].fetch_add(1, std::memory_order_relaxed);
+
+	if (!g_trace_enabled.load(std::memory_order_relaxed))
+		return;
+
+	u32 head = data->events_head.load(std::memory_order_relaxed);
+	if (head - data->events_tail.load(std::memory_order_acquire) >= TRACE_BUFFER_SIZE) {
+		g_trace_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	TraceEvent &event = data->events[head % TRACE_BUFFER_SIZE];
+	event.start = m_start;
+	event.duration = (u32)MYMIN(duration, (u64)U32_MAX);
+	event.zone = m_id;
+	data->events_head.store(head + 1, std::memory_order_release);
+}
+
+class ProfilerTraceThread : public Thread
+{
+public:
+	ProfilerTraceThread(const std::string &path) :
+		Thread("ProfilerTrace"), m_path(path) {}
+
+	bool open();
+
+protected:
+	void *run();
+
+private:
+	// Writes the entries the threads recorded so far
+	void writeEvents();
+
+	std::string m_path;
+	std::ofstream m_os;
+	u64 m_start_time;
+	bool m_first_event = true;
+};
+
+bool ProfilerTraceThread::open()
+{
+	m_os.open(m_path, std::ios::binary | std::ios::trunc);
+	if (!m_os.good())
+		return false;
+
+	// JSON array format of the Trace Event Format
+	m_os << "[\n";
+	m_start_time = porting::getTimeNs();
+	return true;
+}
+
+void *ProfilerTraceThread::run()
+{
+	while (!stopRequested()) {
+		sleep_ms(50);
+		writeEvents();
+	}
+
+	writeEvents();
+	m_os << "\n]\n";
+	m_os.close();
+
+	u32 dropped = g_trace_dropped.exchange(0);
+	if (dropped > 0) {
+		warningstream << "Profiler trace: " << dropped
+				<< " zone entries were dropped" << std::endl;
+	}
+	return nullptr;
+}
+
+void ProfilerTraceThread::writeEvents()
+{
+	std::vector<ZoneThreadData *> threads;
+	u16 zone_count;
+	{
+		MutexAutoLock lock(g_zones_mutex);
+		threads = g_zone_threads;
+		zone_count = g_zone_count.load();
+	}
+
+	char buf[100];
+	for (ZoneThreadData *data : threads) {
+		u32 tail = data->events_tail.load(std::memory_order_relaxed);
+		u32 head = data->events_head.load(std::memory_order_acquire);
+		for (; tail != head; tail++) {
+			const TraceEvent &event = data->events[tail % TRACE_BUFFER_SIZE];
+			// Entries of the time before the trace was started
+			if (event.start < m_start_time || event.zone >= zone_count)
+				continue;
+
+			if (!m_first_event)
+				m_os << ",\n";
+			m_first_event = false;
+			porting::mt_snprintf(buf, sizeof(buf),
+					"\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					data->tid, (event.start - m_start_time) / 1000.0,
+					event.duration / 1000.0);
+			m_os << "{\"name\":\"" << g_zones[event.zone].name << "\"," << buf;
+		}
+		data->events_tail.store(tail, std::memory_order_release);
+	}
+	m_os.flush();
+}
+
+static std::mutex g_trace_mutex;
+static std::unique_ptr<ProfilerTraceThread> g_trace_thread;
+
+bool Profiler::startTrace(const std::string &path)
+{
+	MutexAutoLock lock(g_trace_mutex);
+	if (g_trace_thread)
+		return false;
+
+	std::unique_ptr<ProfilerTraceThread> thread(new ProfilerTraceThread(path));
+	if (!thread->open()) {
+		errorstream << "Profiler: could not open trace file "
+				<< path << std::endl;
+		return false;
+	}
+
+	g_trace_thread = std::move(thread);
+	g_trace_enabled = true;
+	g_trace_thread->start();
+	infostream << "Profiler: recording a trace to " << path << std::endl;
+	return true;
+}
+
+void Profiler::stopTrace()
+{
+	MutexAutoLock lock(g_trace_mutex);
+	if (!g_trace_thread)
+		return;
+
+	g_trace_enabled = false;
+	g_trace_thread->stop();
+	g_trace_thread->wait();
+	g_trace_thread.reset();
+}
+
+void Profiler::collectZones()
+{
+	std::vector<ZoneThreadData *> threads;
+	u16 zone_count;
+	{
+		MutexAutoLock lock(g_zones_mutex);
+		threads = g_zone_threads;
+		zone_count = g_zone_count.load();
+	}
+
+	for (u16 id = 0; id < zone_count; id++) {
+		u64 time_ns = 0;
+		u32 count = 0;
+		for (ZoneThreadData *data : threads) {
+			time_ns += data->time_ns[id].exchange(0, std::memory_order_relaxed);
+			count += data->count[id].exchange(0, std::memory_order_relaxed);
+		}
+		if (count == 0)
+			continue;
+
+		// Names and types don't change after registration
+		const ZoneInfo &zone = g_zones[id];
+		float time_ms = time_ns / 1000000.0f;
+		switch (zone.type) {
+		case SPT_ADD:
+			add(zone.name, time_ms);
+			break;
+		case SPT_AVG: {
+			MutexAutoLock lock(m_mutex);
+			int &avgcount = m_avgcounts[zone.name];
+			assert(avgcount != -2);
+			avgcount = MYMAX(avgcount, 0) + count;
+			m_data[zone.name] += time_ms;
+			break;
+		}
+		case SPT_GRAPH_ADD:
+			graphAdd(zone.name, time_ms);
+			break;
+		}
+	}
+}
 ScopeProfiler::ScopeProfiler(
 		Profiler *profiler, const std::string &name, ScopeProfilerType type) :
 		m_profiler(profiler),
@@ -95,6 +390,9 @@ void Profiler::avg(const std::string &name, float value)
 
 void Profiler::clear()
 {
+	// Drop what the zones measured so far as well
+	collectZones();
+
 	MutexAutoLock lock(m_mutex);
 	for (auto &it : m_data) {
 		it.second = 0;
@@ -162,6 +460,8 @@ int Profiler::print(std::ostream &o, u32 page, u32 pagecount)
 
 void Profiler::getPage(GraphValues &o, u32 page, u32 pagecount)
 {
+	collectZones();
+
 	MutexAutoLock lock(m_mutex);
 
 	u32 minindex, maxindex;
@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <ostream>
 
 #include "threading/mutex_auto_lock.h"
+#include "util/basic_macros.h"
 #include "util/timetaker.h"
 #include "util/numeric.h"      // paging()
 
@@ -69,6 +70,8 @@ class Profiler
 	}
 	void graphGet(GraphValues &result)
 	{
+		collectZones();
+
 		MutexAutoLock lock(m_mutex);
 		result = m_graphvalues;
 		m_graphvalues.clear();
@@ -81,7 +84,14 @@ class Profiler
 		m_data.erase(name);
 	}
 
+	// Records the entries of profiler zones to a Chrome trace file
+	bool startTrace(const std::string &path);
+	void stopTrace();
+
 private:
+	// Adds up the times of the profiler zones since the last call
+	void collectZones();
+
 	std::mutex m_mutex;
 	std::map<std::string, float> m_data;
 	std::map<std::string, int> m_avgcounts;
@@ -107,3 +117,50 @@ class ScopeProfiler
 	TimeTaker *m_timer = nullptr;
 	enum ScopeProfilerType m_type;
 };
+
+/*
+	Profiler zones are for scopes that are entered very often, where the
+	string handling and locking of ScopeProfiler would distort the times.
+
+	A zone is registered once (see PROFILE_ZONE). Each thread sums up the
+	times of its zones without locking or allocating, and the sums are
+	added to g_profiler under the name of the zone when its values are
+	read. While a trace is being recorded, the entries are also put into
+	a buffer of the thread, which a background thread writes to the file.
+*/
+
+#define PROFILER_MAX_ZONES 256
+
+class ProfilerZone
+{
+public:
+	ProfilerZone(const char *name, ScopeProfilerType type = SPT_ADD);
+	DISABLE_CLASS_COPY(ProfilerZone);
+
+	u16 getId() const { return m_id; }
+
+private:
+	u16 m_id;
+};
+
+class ZoneProfiler
+{
+public:
+	ZoneProfiler(const ProfilerZone &zone);
+	~ZoneProfiler();
+	DISABLE_CLASS_COPY(ZoneProfiler);
+
+private:
+	u16 m_id;
+	u64 m_start;
+};
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+
+// Profiles the rest of the scope, like ScopeProfiler with g_profiler
+#define PROFILE_ZONE(name, type) \
+	static const ProfilerZone PROFILER_CONCAT(profiler_zone_, __LINE__)( \
+			name, type); \
+	ZoneProfiler PROFILER_CONCAT(zone_profiler_, __LINE__)( \
+			PROFILER_CONCAT(profiler_zone_, __LINE__))
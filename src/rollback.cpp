@@ -18,9 +18,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "rollback.h"
+#include <algorithm>
 #include <fstream>
 #include <list>
 #include <sstream>
+#include "constants.h"
 #include "log.h"
 #include "mapnode.h"
 #include "gamedef.h"
@@ -31,9 +33,24 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "inventorymanager.h" // deserializing InventoryLocations
 #include "sqlite3.h"
 #include "filesys.h"
+#include "threading/mutex_auto_lock.h"
+#include "threading/thread.h"
 
 #define POINTS_PER_NODE (16.0)
 
+// Actions are written in batches of this many, or at least this often
+#define ROLLBACK_BATCH_SIZE 500
+#define ROLLBACK_WRITE_INTERVAL_MS 1000
+// The server thread writes itself if the writer falls this far behind
+#define ROLLBACK_MAX_QUEUE 20000
+
+// Recent actions are kept in memory this long, and at most this many
+#define ROLLBACK_RECENT_SECONDS 100
+#define ROLLBACK_RECENT_MAX 50000
+
+// Actions further away than this have a suspect nearness of 0
+#define ROLLBACK_SUSPECT_RADIUS ((s16)(100 / POINTS_PER_NODE) + 1)
+
 #define SQLRES(f, good) \
 	if ((f) != (good)) {\
 		throw FileNotGoodException(std::string("RollbackManager: " \
@@ -88,6 +105,35 @@ struct Entity {
 };
 
 
+class RollbackWriterThread : public Thread
+{
+public:
+	RollbackWriterThread(RollbackManager *mgr) :
+		Thread("RollbackWriter"), m_mgr(mgr) {}
+
+protected:
+	void *run();
+
+private:
+	RollbackManager *m_mgr;
+};
+
+void *RollbackWriterThread::run()
+{
+	while (!stopRequested()) {
+		m_mgr->m_writer_wake.wait(ROLLBACK_WRITE_INTERVAL_MS);
+		try {
+			m_mgr->flush();
+		} catch (std::exception &e) {
+			errorstream << "RollbackManager: writing actions failed: "
+				<< e.what() << std::endl;
+		}
+	}
+
+	return nullptr;
+}
+
+
 
 RollbackManager::RollbackManager(const std::string & world_path,
 		IGameDef * gamedef_) :
@@ -109,11 +155,20 @@ RollbackManager::RollbackManager(const std::string & world_path,
 		migrate(txt_filename);
 		fs::DeleteSingleFileOrEmptyDirectory(migrating_flag);
 	}
+
+	// Older actions are only in the database
+	m_recent_since = time(0) + 1;
+
+	m_writer.reset(new RollbackWriterThread(this));
+	m_writer->start();
 }
 
 
 RollbackManager::~RollbackManager()
 {
+	m_writer->stop();
+	m_writer_wake.post();
+	m_writer->wait();
 	flush();
 
 	FINALIZE_STATEMENT(stmt_insert);
@@ -872,88 +927,216 @@ std::string RollbackManager::getSuspect(v3s16 p, float nearness_shortcut,
 	if (!current_actor.empty()) {
 		return current_actor;
 	}
-	int cur_time = time(0);
+	time_t cur_time = time(0);
 	time_t first_time = cur_time - (100 - min_nearness);
-	RollbackAction likely_suspect;
+	expireRecent(cur_time);
+
+	// The newest action reaching nearness_shortcut wins, otherwise the
+	// nearest one, the newest of them if several are equally near
+	const RecentAction *likely_suspect = nullptr;
 	float likely_suspect_nearness = 0;
-	for (std::list<RollbackAction>::const_reverse_iterator
-	     i = action_latest_buffer.rbegin();
-	     i != action_latest_buffer.rend(); ++i) {
-		if (i->unix_time < first_time) {
-			break;
-		}
-		if (i->actor.empty()) {
-			continue;
-		}
-		// Find position of suspect or continue
-		v3s16 suspect_p;
-		if (!i->getPosition(&suspect_p)) {
-			continue;
-		}
-		float f = getSuspectNearness(i->actor_is_guess, suspect_p,
-					     i->unix_time, p, cur_time);
-		if (f >= min_nearness && f > likely_suspect_nearness) {
+	const RecentAction *shortcut_suspect = nullptr;
+	const v3s16 radius(ROLLBACK_SUSPECT_RADIUS, ROLLBACK_SUSPECT_RADIUS,
+			ROLLBACK_SUSPECT_RADIUS);
+	visitRecent(p - radius, p + radius, first_time, [&] (const RecentAction &recent,
+			v3s16 suspect_p) {
+		const RollbackAction &action = recent.action;
+		float f = getSuspectNearness(action.actor_is_guess, suspect_p,
+				action.unix_time, p, cur_time);
+		if (f < min_nearness)
+			return;
+		if (f > likely_suspect_nearness || (f == likely_suspect_nearness &&
+				likely_suspect && recent.seq > likely_suspect->seq)) {
 			likely_suspect_nearness = f;
-			likely_suspect = *i;
-			if (likely_suspect_nearness >= nearness_shortcut) {
-				break;
-			}
+			likely_suspect = &recent;
 		}
+		if (f >= nearness_shortcut &&
+				(!shortcut_suspect || recent.seq > shortcut_suspect->seq))
+			shortcut_suspect = &recent;
+	});
+	if (shortcut_suspect) {
+		return shortcut_suspect->action.actor;
 	}
 	// No likely suspect was found
 	if (likely_suspect_nearness == 0) {
 		return "";
 	}
 	// Likely suspect was found
-	return likely_suspect.actor;
+	return likely_suspect->action.actor;
 }
 
 
 void RollbackManager::flush()
 {
-	sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
+	MutexAutoLock lock(m_db_mutex);
+	writeQueued();
+}
 
-	std::list<RollbackAction>::const_iterator iter;
 
-	for (iter  = action_todisk_buffer.begin();
-			iter != action_todisk_buffer.end();
-			++iter) {
-		if (iter->actor.empty()) {
+void RollbackManager::writeQueued()
+{
+	std::vector<RollbackAction> batch;
+	{
+		MutexAutoLock lock(m_queue_mutex);
+		batch.swap(m_queue);
+	}
+	if (batch.empty()) {
+		return;
+	}
+
+	sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
+
+	for (const RollbackAction &action : batch) {
+		if (action.actor.empty()) {
 			continue;
 		}
 
-		registerRow(actionRowFromRollbackAction(*iter));
+		registerRow(actionRowFromRollbackAction(action));
 	}
 
 	sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
-	action_todisk_buffer.clear();
 }
 
 
 void RollbackManager::addAction(const RollbackAction & action)
 {
-	action_todisk_buffer.push_back(action);
-	action_latest_buffer.push_back(action);
+	addRecent(action);
 
-	// Flush to disk sometimes
-	if (action_todisk_buffer.size() >= 500) {
+	size_t queued;
+	{
+		MutexAutoLock lock(m_queue_mutex);
+		m_queue.push_back(action);
+		queued = m_queue.size();
+	}
+
+	if (queued >= ROLLBACK_MAX_QUEUE) {
+		// Writing doesn't keep up, bound the memory used by the queue
 		flush();
+	} else if (queued == ROLLBACK_BATCH_SIZE) {
+		m_writer_wake.post();
+	}
+}
+
+
+void RollbackManager::addRecent(const RollbackAction &action)
+{
+	v3s16 p;
+	if (action.actor.empty() || !action.getPosition(&p)) {
+		return;
+	}
+
+	v3s16 blockpos = getContainerPos(p, MAP_BLOCKSIZE);
+	m_recent[blockpos].push_back({m_recent_seq++, action});
+	m_recent_order.push_back(blockpos);
+
+	expireRecent(action.unix_time);
+}
+
+
+void RollbackManager::expireRecent(time_t now)
+{
+	while (!m_recent_order.empty()) {
+		auto it = m_recent.find(m_recent_order.front());
+		std::deque<RecentAction> &actions = it->second;
+		time_t t = actions.front().action.unix_time;
+		if (t >= now - ROLLBACK_RECENT_SECONDS &&
+				m_recent_order.size() <= ROLLBACK_RECENT_MAX) {
+			break;
+		}
+
+		m_recent_since = std::max(m_recent_since, t + 1);
+		actions.pop_front();
+		if (actions.empty()) {
+			m_recent.erase(it);
+		}
+		m_recent_order.pop_front();
+	}
+}
+
+
+template <typename F>
+void RollbackManager::visitRecent(v3s16 minp, v3s16 maxp, time_t first_time,
+		F visit)
+{
+	auto visit_block = [&] (const std::deque<RecentAction> &actions) {
+		for (auto i = actions.rbegin(); i != actions.rend(); ++i) {
+			if (i->action.unix_time < first_time) {
+				break;
+			}
+			v3s16 p;
+			i->action.getPosition(&p);
+			if (p.X >= minp.X && p.X <= maxp.X && p.Y >= minp.Y &&
+					p.Y <= maxp.Y && p.Z >= minp.Z && p.Z <= maxp.Z) {
+				visit(*i, p);
+			}
+		}
+	};
+
+	v3s16 bmin = getContainerPos(minp, MAP_BLOCKSIZE);
+	v3s16 bmax = getContainerPos(maxp, MAP_BLOCKSIZE);
+	v3s32 blocks = v3s32(bmax.X, bmax.Y, bmax.Z) - v3s32(bmin.X, bmin.Y, bmin.Z) +
+			v3s32(1, 1, 1);
+
+	// Large boxes are cheaper to check block by block
+	if ((s64)blocks.X * blocks.Y * blocks.Z > (s64)m_recent.size()) {
+		for (const auto &it : m_recent) {
+			visit_block(it.second);
+		}
+		return;
+	}
+
+	v3s16 bp;
+	for (bp.Z = bmin.Z; bp.Z <= bmax.Z; bp.Z++)
+	for (bp.Y = bmin.Y; bp.Y <= bmax.Y; bp.Y++)
+	for (bp.X = bmin.X; bp.X <= bmax.X; bp.X++) {
+		auto it = m_recent.find(bp);
+		if (it != m_recent.end()) {
+			visit_block(it->second);
+		}
 	}
 }
 
 std::list<RollbackAction> RollbackManager::getEntriesSince(time_t first_time)
 {
-	flush();
+	MutexAutoLock lock(m_db_mutex);
+	writeQueued();
 	return getActionsSince(first_time);
 }
 
 std::list<RollbackAction> RollbackManager::getNodeActors(v3s16 pos, int range,
 		time_t seconds, int limit)
 {
-	flush();
 	time_t cur_time = time(0);
 	time_t first_time = cur_time - seconds;
+	expireRecent(cur_time);
+
+	if (range >= 0 && first_time >= m_recent_since) {
+		// All of them are still in memory
+		std::vector<const RecentAction *> found;
+		auto clamp = [] (s32 v) { return (s16)rangelim(v, S16_MIN, S16_MAX); };
+		v3s16 minp(clamp(pos.X - range), clamp(pos.Y - range), clamp(pos.Z - range));
+		v3s16 maxp(clamp(pos.X + range), clamp(pos.Y + range), clamp(pos.Z + range));
+		visitRecent(minp, maxp, first_time, [&] (const RecentAction &recent,
+				v3s16 p) {
+			found.push_back(&recent);
+		});
+		std::sort(found.begin(), found.end(), [] (const RecentAction *a,
+				const RecentAction *b) {
+			return a->seq > b->seq;
+		});
+		if (limit >= 0 && found.size() > (size_t)limit) {
+			found.resize(limit);
+		}
 
+		std::list<RollbackAction> actions;
+		for (const RecentAction *recent : found) {
+			actions.push_back(recent->action);
+		}
+		return actions;
+	}
+
+	MutexAutoLock lock(m_db_mutex);
+	writeQueued();
 	return getActionsSince_range(first_time, pos, range, limit);
 }
 
@@ -964,7 +1147,8 @@ std::list<RollbackAction> RollbackManager::getRevertActions(
 	time_t cur_time = time(0);
 	time_t first_time = cur_time - seconds;
 
-	flush();
+	MutexAutoLock lock(m_db_mutex);
+	writeQueued();
 
 	return getActionsSince(first_time, actor_filter);
 }
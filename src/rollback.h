@@ -20,16 +20,27 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <string>
+#include "IrrCompileConfig.h"
 #include "irr_v3d.h"
 #include "rollback_interface.h"
+#include <deque>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include "sqlite3.h"
+#ifdef _IRR_COMPILE_WITH_SDL_DEVICE_
+#include "threading/sdl_semaphore.h"
+#else
+#include "threading/semaphore.h"
+#endif
 
 class IGameDef;
 
 struct ActionRow;
 struct Entity;
+class RollbackWriterThread;
 
 class RollbackManager: public IRollbackManager
 {
@@ -43,6 +54,7 @@ class RollbackManager: public IRollbackManager
 	void setActor(const std::string & actor, bool is_guess);
 	std::string getSuspect(v3s16 p, float nearness_shortcut,
 			float min_nearness);
+	// Writes all queued actions, waiting for the writer thread if needed
 	void flush();
 
 	void addAction(const RollbackAction & action);
@@ -53,6 +65,24 @@ class RollbackManager: public IRollbackManager
 			const std::string & actor_filter, time_t seconds);
 
 private:
+	friend class RollbackWriterThread;
+	// Permit unittests to move the start of the recent actions
+	friend class TestRollback;
+
+	struct RecentAction {
+		// Orders actions of the same second
+		u64 seq;
+		RollbackAction action;
+	};
+
+	// Writes the queued actions, m_db_mutex must be locked
+	void writeQueued();
+	void addRecent(const RollbackAction &action);
+	void expireRecent(time_t now);
+	// Calls visit for recent actions in the box of nodes, newest first by block
+	template <typename F>
+	void visitRecent(v3s16 minp, v3s16 maxp, time_t first_time, F visit);
+
 	void registerNewActor(const int id, const std::string & name);
 	void registerNewNode(const int id, const std::string & name);
 	int getActorId(const std::string & name);
@@ -84,9 +114,23 @@ class RollbackManager: public IRollbackManager
 	std::string current_actor;
 	bool current_actor_is_guess = false;
 
-	std::list<RollbackAction> action_todisk_buffer;
-	std::list<RollbackAction> action_latest_buffer;
-
+	// Actions waiting for the writer thread
+	std::vector<RollbackAction> m_queue;
+	std::mutex m_queue_mutex;
+	std::unique_ptr<RollbackWriterThread> m_writer;
+	Semaphore m_writer_wake;
+
+	// Recent actions with a position by block, oldest first. Used by
+	// getSuspect() and getNodeActors(), only on the server thread.
+	std::map<v3s16, std::deque<RecentAction>> m_recent;
+	// Blocks of all recent actions, oldest first
+	std::deque<v3s16> m_recent_order;
+	u64 m_recent_seq = 0;
+	// m_recent has all actions since then
+	time_t m_recent_since;
+
+	// Guards the database and the known actors and nodes
+	std::mutex m_db_mutex;
 	std::string database_path;
 	sqlite3 * db;
 	sqlite3_stmt * stmt_insert;
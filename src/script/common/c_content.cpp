@@ -1146,13 +1146,73 @@ NodeBox read_nodebox(lua_State *L, int index)
 	return nodebox;
 }
 
+/******************************************************************************/
+/*
+	The registry table at CUSTOM_RIDX_NODE_NAMES maps content IDs to the
+	interned Lua name strings and node names (and aliases) back to their IDs,
+	so that the hot paths below neither rehash names nor allocate.
+	It is only used once node registration is complete, since the mapping
+	may change until then.
+*/
+static void push_node_name(lua_State *L, content_t c, const NodeDefManager *ndef)
+{
+	if (!ndef->getNodeRegistrationStatus()) {
+		lua_pushstring(L, ndef->get(c).name.c_str());
+		return;
+	}
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_NODE_NAMES);
+	lua_rawgeti(L, -1, c);
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		const std::string &name = ndef->get(c).name;
+		lua_pushlstring(L, name.c_str(), name.size());
+		lua_pushvalue(L, -1);
+		lua_rawseti(L, -3, c);
+	}
+	lua_remove(L, -2);
+}
+
+// Reads the node name at the top of the stack
+static content_t read_node_name(lua_State *L, const NodeDefManager *ndef)
+{
+	bool cache = ndef->getNodeRegistrationStatus();
+	if (cache) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_NODE_NAMES);
+		lua_pushvalue(L, -2);
+		lua_rawget(L, -2);
+		if (lua_isnumber(L, -1)) {
+			content_t id = lua_tointeger(L, -1);
+			lua_pop(L, 2);
+			return id;
+		}
+		lua_pop(L, 2);
+	}
+
+	std::string name = lua_tostring(L, -1);
+	content_t id = CONTENT_IGNORE;
+	if (!ndef->getId(name, id))
+		throw LuaError("\"" + name + "\" is not a registered node!");
+
+	if (cache) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_NODE_NAMES);
+		lua_pushvalue(L, -2);
+		lua_pushinteger(L, id);
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
+	}
+	return id;
+}
+
 /******************************************************************************/
 MapNode readnode(lua_State *L, int index, const NodeDefManager *ndef)
 {
 	lua_getfield(L, index, "name");
 	if (!lua_isstring(L, -1))
 		throw LuaError("Node name is not set or is not a string!");
-	std::string name = lua_tostring(L, -1);
+	// Convert numbers before the name is used as a table key
+	lua_tostring(L, -1);
+	content_t id = read_node_name(L, ndef);
 	lua_pop(L, 1);
 
 	u8 param1 = 0;
@@ -1167,10 +1227,6 @@ MapNode readnode(lua_State *L, int index, const NodeDefManager *ndef)
 		param2 = lua_tonumber(L, -1);
 	lua_pop(L, 1);
 
-	content_t id = CONTENT_IGNORE;
-	if (!ndef->getId(name, id))
-		throw LuaError("\"" + name + "\" is not a registered node!");
-
 	return {id, param1, param2};
 }
 
@@ -1178,7 +1234,7 @@ MapNode readnode(lua_State *L, int index, const NodeDefManager *ndef)
 void pushnode(lua_State *L, const MapNode &n, const NodeDefManager *ndef)
 {
 	lua_createtable(L, 0, 3);
-	lua_pushstring(L, ndef->get(n).name.c_str());
+	push_node_name(L, n.getContent(), ndef);
 	lua_setfield(L, -2, "name");
 	lua_pushinteger(L, n.getParam1());
 	lua_setfield(L, -2, "param1");
@@ -0,0 +1,79 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "cpp_api/s_accounting.h"
+#include "cpp_api/s_base.h"
+#include <cstring>
+
+ModAccounting::ModAccounting()
+{
+	m_mods.emplace_back();
+	m_builtin = getIndex(BUILTIN_MOD_NAME);
+}
+
+void ModAccounting::hookAllocator(lua_State *L)
+{
+	m_alloc = lua_getallocf(L, &m_alloc_ud);
+	lua_setallocf(L, &ModAccounting::alloc, this);
+}
+
+void ModAccounting::setMod(const char *mod)
+{
+	// Outside of a scope the time since the last charge isn't spent in Lua
+	if (m_depth > 0)
+		charge();
+	m_current = getIndex(mod ? mod : "??");
+	m_mods[m_current].calls++;
+}
+
+void ModAccounting::getUsage(std::vector<ModUsage> &usage) const
+{
+	usage.insert(usage.end(), m_mods.begin() + 1, m_mods.end());
+}
+
+u16 ModAccounting::getIndex(const char *mod)
+{
+	// Callbacks of one mod often run one after another
+	if (m_current != NO_MOD && strcmp(m_mods[m_current].mod.c_str(), mod) == 0)
+		return m_current;
+
+	auto it = m_indices.find(mod);
+	if (it != m_indices.end())
+		return it->second;
+
+	// Origins are mod names, don't let a broken one grow this forever
+	if (m_mods.size() > U16_MAX)
+		return NO_MOD;
+
+	u16 index = m_mods.size();
+	m_mods.emplace_back();
+	m_mods.back().mod = mod;
+	m_indices.emplace(mod, index);
+	return index;
+}
+
+void *ModAccounting::alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	ModAccounting *self = static_cast<ModAccounting *>(ud);
+	// osize is meaningless for new blocks in Lua 5.2 and later
+	size_t old_size = ptr ? osize : 0;
+	if (nsize > old_size)
+		self->m_mods[self->m_current].alloc_bytes += nsize - old_size;
+	return self->m_alloc(self->m_alloc_ud, ptr, osize, nsize);
+}
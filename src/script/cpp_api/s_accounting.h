@@ -0,0 +1,135 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "porting.h"
+#include "util/basic_macros.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include <lua.h>
+}
+
+struct ModUsage
+{
+	std::string mod;
+	// Wall time spent in Lua while the mod was running
+	u64 time_us = 0;
+	// Callbacks run for the mod
+	u64 calls = 0;
+	// Bytes allocated by Lua while the mod was running, not the live size
+	u64 alloc_bytes = 0;
+};
+
+/*
+	Attributes the time spent in and the memory allocated by a Lua state to
+	the mod whose code is running, as told by the origin of the callbacks.
+
+	Time is only counted inside ModAccountingScopes, which the script API
+	opens whenever C++ calls into Lua. Not thread-safe, all calls must hold
+	the script lock.
+*/
+class ModAccounting
+{
+public:
+	ModAccounting();
+
+	// Makes L allocate through this, must be destroyed after lua_close(L)
+	void hookAllocator(lua_State *L);
+
+	// Charges the time so far and makes mod the running one
+	void setMod(const char *mod);
+
+	// Appends the totals since creation of all mods that ran
+	void getUsage(std::vector<ModUsage> &usage) const;
+
+private:
+	friend class ModAccountingScope;
+
+	// Index of the entry used outside of Lua, never reported
+	static const u16 NO_MOD = 0;
+
+	u16 getIndex(const char *mod);
+
+	void charge()
+	{
+		u64 now = porting::getTimeUs();
+		m_mods[m_current].time_us += now - m_since;
+		m_since = now;
+	}
+
+	static void *alloc(void *ud, void *ptr, size_t osize, size_t nsize);
+
+	std::vector<ModUsage> m_mods;
+	std::unordered_map<std::string, u16> m_indices;
+
+	u16 m_current = NO_MOD;
+	u16 m_builtin;
+	u32 m_depth = 0;
+	u64 m_since = 0;
+
+	lua_Alloc m_alloc = nullptr;
+	void *m_alloc_ud = nullptr;
+};
+
+/*
+	Opened by C++ before running Lua. The outermost scope starts out charging
+	to builtin, nested ones keep charging to the mod that called into C++.
+	The previous mod is restored on exit. Does nothing if accounting is null.
+*/
+class ModAccountingScope
+{
+public:
+	ModAccountingScope(ModAccounting *accounting, const char *mod = nullptr) :
+			m_accounting(accounting)
+	{
+		if (!m_accounting)
+			return;
+
+		m_previous = m_accounting->m_current;
+		if (m_accounting->m_depth++ == 0) {
+			m_accounting->m_since = porting::getTimeUs();
+			m_accounting->m_current = m_accounting->m_builtin;
+		}
+		if (mod)
+			m_accounting->setMod(mod);
+	}
+
+	~ModAccountingScope()
+	{
+		if (!m_accounting)
+			return;
+
+		if (--m_accounting->m_depth == 0 ||
+				m_accounting->m_current != m_previous) {
+			m_accounting->charge();
+			m_accounting->m_current = m_previous;
+		}
+	}
+
+	DISABLE_CLASS_COPY(ModAccountingScope);
+
+private:
+	ModAccounting *m_accounting;
+	u16 m_previous = 0;
+};
@@ -31,7 +31,9 @@ extern "C" {
 #include "log.h"
 #include "filesys.h"
 #include "porting.h"
+#include "settings.h"
 #include "common/c_internal.h"
+#include "lua_api/l_base.h"
 
 /******************************************************************************/
 AsyncEngine::~AsyncEngine()
@@ -86,13 +88,14 @@ void AsyncEngine::initialize(unsigned int numEngines)
 
 /******************************************************************************/
 unsigned int AsyncEngine::queueAsyncJob(const std::string &func,
-		const std::string &params)
+		const std::string &params, const std::string &mod_origin)
 {
 	jobQueueMutex.lock();
 	LuaJobInfo toAdd;
 	toAdd.id = jobIdCounter++;
 	toAdd.serializedFunction = func;
 	toAdd.serializedParams = params;
+	toAdd.mod_origin = mod_origin;
 
 	jobQueue.push_back(toAdd);
 
@@ -134,6 +137,9 @@ void AsyncEngine::step(lua_State *L)
 {
 	int error_handler = PUSH_ERROR_HANDLER(L);
 	lua_getglobal(L, "core");
+
+	ScriptApiBase *script = ModApiBase::getScriptApiBase(L);
+
 	MutexAutoLock autolock(resultQueueMutex);
 	while (!resultQueue.empty()) {
 		LuaJobInfo jobDone = resultQueue.front();
@@ -151,7 +157,14 @@ void AsyncEngine::step(lua_State *L)
 		lua_pushlstring(L, jobDone.serializedResult.data(),
 				jobDone.serializedResult.size());
 
-		PCALL_RESL(L, lua_pcall(L, 2, 0, error_handler));
+		// Attribute the callback to the mod that queued the job
+		const char *origin = jobDone.mod_origin.empty() ?
+				nullptr : jobDone.mod_origin.c_str();
+		script->setOriginDirect(origin);
+
+		int result = lua_pcall(L, 2, 0, error_handler);
+		if (result)
+			script_error(L, result, origin, "<async>");
 	}
 	lua_pop(L, 2); // Pop core and error handler
 }
@@ -167,21 +180,29 @@ void AsyncEngine::prepareEnvironment(lua_State* L, int top)
 /******************************************************************************/
 AsyncWorkerThread::AsyncWorkerThread(AsyncEngine* jobDispatcher,
 		const std::string &name) :
-	Thread(name),
 	ScriptApiBase(ScriptingType::Async),
+	Thread(name),
 	jobDispatcher(jobDispatcher)
 {
 	lua_State *L = getStack();
 
+	if (jobDispatcher->server) {
+		setGameDef(jobDispatcher->server);
+
+		if (g_settings->getBool("secure.enable_security"))
+			initializeSecurity();
+	}
+
 	// Prepare job lua environment
 	lua_getglobal(L, "core");
 	int top = lua_gettop(L);
 
 	// Push builtin initialization type
-	lua_pushstring(L, "async");
+	lua_pushstring(L, jobDispatcher->server ? "async_game" : "async");
 	lua_setglobal(L, "INIT");
 
 	jobDispatcher->prepareEnvironment(L, top);
+	lua_pop(L, 1); // Pop core
 }
 
 /******************************************************************************/
@@ -190,20 +211,40 @@ AsyncWorkerThread::~AsyncWorkerThread()
 	sanity_check(!isRunning());
 }
 
+/******************************************************************************/
+void AsyncWorkerThread::loadAsyncInitFiles()
+{
+	for (const auto &file : jobDispatcher->server->m_async_init_files) {
+		try {
+			loadMod(file.second, file.first);
+		} catch (const ModError &e) {
+			errorstream << "Failed to load async script of mod \""
+				<< file.first << "\": " << e.what() << std::endl;
+			FATAL_ERROR("Execution of async mod environment failed");
+		}
+	}
+}
+
 /******************************************************************************/
 void* AsyncWorkerThread::run()
 {
 	lua_State *L = getStack();
 
-	std::string script = getServer()->getBuiltinLuaPath() + DIR_DELIM + "init.lua";
+	std::string script = Server::getBuiltinLuaPath() + DIR_DELIM + "init.lua";
 	try {
-		loadScript(script);
+		if (jobDispatcher->server)
+			loadMod(script, BUILTIN_MOD_NAME);
+		else
+			loadScript(script);
 	} catch (const ModError &e) {
 		errorstream << "Execution of async base environment failed: "
 			<< e.what() << std::endl;
 		FATAL_ERROR("Execution of async base environment failed");
 	}
 
+	if (jobDispatcher->server)
+		loadAsyncInitFiles();
+
 	int error_handler = PUSH_ERROR_HANDLER(L);
 
 	lua_getglobal(L, "core");
@@ -228,16 +269,41 @@ void* AsyncWorkerThread::run()
 		luaL_checktype(L, -1, LUA_TFUNCTION);
 
 		// Call it
-		lua_pushlstring(L,
-				toProcess.serializedFunction.data(),
-				toProcess.serializedFunction.size());
+		if (jobDispatcher->server) {
+			// The function was dumped by the server thread, so it is
+			// trusted bytecode. Mods can't pass arbitrary strings here.
+			setOriginDirect(toProcess.mod_origin.empty() ?
+					nullptr : toProcess.mod_origin.c_str());
+			if (luaL_loadbuffer(L, toProcess.serializedFunction.data(),
+					toProcess.serializedFunction.size(), "=(async)")) {
+				errorstream << "ASYNC WORKER: Unable to load function: "
+					<< lua_tostring(L, -1) << std::endl;
+				lua_pop(L, 1);
+				lua_pushnil(L);
+			}
+		} else {
+			lua_pushlstring(L,
+					toProcess.serializedFunction.data(),
+					toProcess.serializedFunction.size());
+		}
 		lua_pushlstring(L,
 				toProcess.serializedParams.data(),
 				toProcess.serializedParams.size());
 
 		int result = lua_pcall(L, 2, 1, error_handler);
 		if (result) {
-			PCALL_RES(result);
+			if (jobDispatcher->server) {
+				// Exceptions can't leave this thread, make the server
+				// thread report the error instead
+				try {
+					scriptError(result, "<async>");
+				} catch (const LuaError &e) {
+					jobDispatcher->server->setAsyncFatalError(
+							std::string("Async job: ") + e.what());
+				}
+			} else {
+				PCALL_RES(result);
+			}
 			toProcess.serializedResult = "";
 		} else {
 			// Fetch result
@@ -34,9 +34,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #endif
 #include "lua.h"
 #include "cpp_api/s_base.h"
+#include "cpp_api/s_security.h"
 
 // Forward declarations
 class AsyncEngine;
+class Server;
 
 
 // Declarations
@@ -52,6 +54,8 @@ struct LuaJobInfo
 	std::string serializedParams = "";
 	// Result of function call
 	std::string serializedResult = "";
+	// Name of the mod who invoked this call
+	std::string mod_origin = "";
 	// JobID used to identify a job and match it to callback
 	unsigned int id = 0;
 
@@ -59,7 +63,9 @@ struct LuaJobInfo
 };
 
 // Asynchronous working environment
-class AsyncWorkerThread : public Thread, public ScriptApiBase {
+class AsyncWorkerThread : public Thread,
+		virtual public ScriptApiBase,
+		public ScriptApiSecurity {
 public:
 	AsyncWorkerThread(AsyncEngine* jobDispatcher, const std::string &name);
 	virtual ~AsyncWorkerThread();
@@ -67,6 +73,9 @@ class AsyncWorkerThread : public Thread, public ScriptApiBase {
 	void *run();
 
 private:
+	// Loads the mod scripts registered with core.register_async_dofile
+	void loadAsyncInitFiles();
+
 	AsyncEngine *jobDispatcher = nullptr;
 };
 
@@ -76,6 +85,7 @@ class AsyncEngine {
 	typedef void (*StateInitializer)(lua_State *L, int top);
 public:
 	AsyncEngine() = default;
+	AsyncEngine(Server *server) : server(server) {}
 	~AsyncEngine();
 
 	/**
@@ -94,9 +104,11 @@ class AsyncEngine {
 	 * Queue an async job
 	 * @param func Serialized lua function
 	 * @param params Serialized parameters
+	 * @param mod_origin Modname of the mod requesting the job
 	 * @return jobid The job is queued
 	 */
-	unsigned int queueAsyncJob(const std::string &func, const std::string &params);
+	unsigned int queueAsyncJob(const std::string &func, const std::string &params,
+			const std::string &mod_origin = "");
 
 	/**
 	 * Engine step to process finished jobs
@@ -129,6 +141,9 @@ class AsyncEngine {
 	void prepareEnvironment(lua_State* L, int top);
 
 private:
+	// Server this engine belongs to, nullptr for the main menu
+	Server *server = nullptr;
+
 	// Variable locking the engine against further modification
 	bool initDone = false;
 
@@ -28,6 +28,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "porting.h"
 #include "util/string.h"
 #include "server.h"
+#include "settings.h"
 #ifndef SERVER
 #include "client/client.h"
 #endif
@@ -85,6 +86,11 @@ ScriptApiBase::ScriptApiBase(ScriptingType type):
 
 	lua_atpanic(m_luastack, &luaPanic);
 
+	if (m_type == ScriptingType::Server && g_settings->getBool("mod_accounting")) {
+		m_accounting.reset(new ModAccounting());
+		m_accounting->hookAllocator(m_luastack);
+	}
+
 	if (m_type == ScriptingType::Client)
 		clientOpenLibs(m_luastack);
 	else
@@ -138,6 +144,10 @@ ScriptApiBase::ScriptApiBase(ScriptingType type):
 	lua_rawseti(m_luastack, LUA_REGISTRYINDEX, CUSTOM_RIDX_BACKTRACE);
 	lua_pop(m_luastack, 1); // pop debug
 
+	// Cache of node names, used by pushnode() and readnode()
+	lua_newtable(m_luastack);
+	lua_rawseti(m_luastack, LUA_REGISTRYINDEX, CUSTOM_RIDX_NODE_NAMES);
+
 	// If we are using LuaJIT add a C++ wrapper function to catch
 	// exceptions thrown in Lua -> C++ calls
 #if USE_LUAJIT
@@ -205,6 +215,7 @@ void ScriptApiBase::loadMod(const std::string &script_path,
 		const std::string &mod_name)
 {
 	ModNameStorer mod_name_storer(getStack(), mod_name);
+	ModAccountingScope accounting_scope(m_accounting.get(), mod_name.c_str());
 
 	loadScript(script_path);
 }
@@ -365,6 +376,8 @@ void ScriptApiBase::stackDump(std::ostream &o)
 void ScriptApiBase::setOriginDirect(const char *origin)
 {
 	m_last_run_mod = origin ? origin : "??";
+	if (m_accounting)
+		m_accounting->setMod(m_last_run_mod.c_str());
 }
 
 void ScriptApiBase::setOriginFromTableRaw(int index, const char *fxn)
@@ -375,9 +388,21 @@ void ScriptApiBase::setOriginFromTableRaw(int index, const char *fxn)
 	m_last_run_mod = lua_istable(L, index) ?
 		getstringfield_default(L, index, "mod_origin", "") : "";
 	//printf(">>>> running %s for mod: %s\n", fxn, m_last_run_mod.c_str());
+	if (m_accounting && !m_last_run_mod.empty())
+		m_accounting->setMod(m_last_run_mod.c_str());
 #endif
 }
 
+bool ScriptApiBase::getModUsage(std::vector<ModUsage> &usage)
+{
+	RecursiveMutexAutoLock lock(m_luastackmutex);
+	if (!m_accounting)
+		return false;
+
+	m_accounting->getUsage(usage);
+	return true;
+}
+
 /*
  * How ObjectRefs are handled in Lua:
  * When an active object is created, an ObjectRef is created on the Lua side
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <iostream>
+#include <memory>
 #include <string>
 #include <thread>
 #include <mutex>
@@ -35,6 +36,7 @@ extern "C" {
 #include "irrlichttypes.h"
 #include "common/c_types.h"
 #include "common/c_internal.h"
+#include "cpp_api/s_accounting.h"
 #include "debug.h"
 #include "config.h"
 
@@ -61,6 +63,7 @@ extern "C" {
 enum class ScriptingType: u8 {
 	Async,
 	Client,
+	Emerge,
 	MainMenu,
 	Server
 };
@@ -112,6 +115,9 @@ class ScriptApiBase : protected LuaHelper {
 	void setOriginDirect(const char *origin);
 	void setOriginFromTableRaw(int index, const char *fxn);
 
+	// Returns false if per-mod accounting is disabled
+	bool getModUsage(std::vector<ModUsage> &usage);
+
 	void clientOpenLibs(lua_State *L);
 
 protected:
@@ -148,6 +154,8 @@ class ScriptApiBase : protected LuaHelper {
 	std::recursive_mutex m_luastackmutex;
 	std::string     m_last_run_mod;
 	bool            m_secure = false;
+	// Only on the server, null if disabled
+	std::unique_ptr<ModAccounting> m_accounting;
 #ifdef SCRIPTAPI_LOCK_DEBUG
 	int             m_lock_recursion_count{};
 	std::thread::id m_owning_thread;
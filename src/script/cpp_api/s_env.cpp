@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "environment.h"
 #include "mapgen/mapgen.h"
 #include "lua_api/l_env.h"
+#include "pathfinder.h"
 #include "server.h"
 
 void ScriptApiEnv::environment_OnGenerated(v3s16 minp, v3s16 maxp,
@@ -157,12 +158,21 @@ void ScriptApiEnv::initializeEnvironment(ServerEnvironment *env)
 		s16 max_y = INT16_MAX;
 		getintfield(L, current_abm, "max_y", max_y);
 
-		lua_getfield(L, current_abm, "action");
+		// action_batch takes precedence over action
+		bool batched = false;
+		lua_getfield(L, current_abm, "action_batch");
+		if (lua_isnil(L, -1)) {
+			lua_pop(L, 1);
+			lua_getfield(L, current_abm, "action");
+		} else {
+			batched = true;
+		}
 		luaL_checktype(L, current_abm + 1, LUA_TFUNCTION);
 		lua_pop(L, 1);
 
 		LuaABM *abm = new LuaABM(L, id, trigger_contents, required_neighbors,
-			trigger_interval, trigger_chance, simple_catch_up, min_y, max_y);
+			trigger_interval, trigger_chance, simple_catch_up, min_y, max_y,
+			batched);
 
 		env->addActiveBlockModifier(abm);
 
@@ -267,3 +277,38 @@ void ScriptApiEnv::on_emerge_area_completion(
 		luaL_unref(L, LUA_REGISTRYINDEX, state->args_ref);
 	}
 }
+
+void ScriptApiEnv::on_path_found(const PathResult &result)
+{
+	SCRIPTAPI_PRECHECKHEADER
+
+	int error_handler = PUSH_ERROR_HANDLER(L);
+
+	lua_getglobal(L, "core");
+	lua_getfield(L, -1, "path_event_handler");
+	luaL_checktype(L, -1, LUA_TFUNCTION);
+
+	lua_pushinteger(L, result.id);
+	if (result.path.empty()) {
+		lua_pushnil(L);
+	} else {
+		lua_createtable(L, result.path.size(), 0);
+		int index = 1;
+		for (const v3s16 &pos : result.path) {
+			push_v3s16(L, pos);
+			lua_rawseti(L, -2, index++);
+		}
+	}
+
+	setOriginDirect(result.mod_origin.c_str());
+
+	try {
+		PCALL_RES(lua_pcall(L, 2, 0, error_handler));
+	} catch (LuaError &e) {
+		getServer()->setAsyncFatalError(
+				std::string("on_path_found: ") + e.what() + "\n"
+				+ script_get_backtrace(L));
+	}
+
+	lua_pop(L, 2); // Pop core and error handler
+}
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 class ServerEnvironment;
 struct ScriptCallbackState;
+struct PathResult;
 
 class ScriptApiEnv : virtual public ScriptApiBase
 {
@@ -41,5 +42,8 @@ class ScriptApiEnv : virtual public ScriptApiBase
 	void on_emerge_area_completion(v3s16 blockpos, int action,
 		ScriptCallbackState *state);
 
+	// Called when a search queued from core.find_path_async() finished
+	void on_path_found(const PathResult &result);
+
 	void initializeEnvironment(ServerEnvironment *env);
 };
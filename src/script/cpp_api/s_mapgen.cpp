@@ -0,0 +1,50 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "cpp_api/s_mapgen.h"
+#include "cpp_api/s_internal.h"
+#include "common/c_converter.h"
+#include "lua_api/l_vmanip.h"
+#include "emerge.h"
+
+void ScriptApiMapgen::on_generated(BlockMakeData *bmdata, u32 blockseed)
+{
+	SCRIPTAPI_PRECHECKHEADER
+
+	v3s16 minp = bmdata->blockpos_min * MAP_BLOCKSIZE;
+	v3s16 maxp = bmdata->blockpos_max * MAP_BLOCKSIZE +
+				 v3s16(1,1,1) * (MAP_BLOCKSIZE - 1);
+
+	// Get core.registered_on_generateds
+	lua_getglobal(L, "core");
+	lua_getfield(L, -1, "registered_on_generateds");
+
+	// The VoxelManip only wraps the chunk's MMVManip, it is written back
+	// by ServerMap::finishBlockMake() once all callbacks are done
+	LuaVoxelManip *o = new LuaVoxelManip(bmdata->vmanip, true);
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, "VoxelManip");
+	lua_setmetatable(L, -2);
+
+	// Call callbacks
+	push_v3s16(L, minp);
+	push_v3s16(L, maxp);
+	lua_pushnumber(L, blockseed);
+	runCallbacks(4, RUN_CALLBACKS_MODE_FIRST);
+}
@@ -25,7 +25,6 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irr_v3d.h"
 #include "util/areastore.h"
 #include "filesys.h"
-#include <fstream>
 
 static inline void get_data_and_border_flags(lua_State *L, u8 start_i,
 		bool *borders, bool *data)
@@ -297,8 +296,16 @@ int LuaAreaStore::l_from_file(lua_State *L)
 	const char *filename = luaL_checkstring(L, 2);
 	CHECK_SECURE_PATH(L, filename, false);
 
-	std::ifstream is(filename, std::ios::binary);
-	return deserialization_helper(L, o->as, is);
+	try {
+		o->as->deserializeFile(filename);
+	} catch (const SerializationError &e) {
+		lua_pushboolean(L, false);
+		lua_pushstring(L, e.what());
+		return 2;
+	}
+
+	lua_pushboolean(L, true);
+	return 1;
 }
 
 LuaAreaStore::LuaAreaStore() : as(AreaStore::getOptimalImplementation())
@@ -312,7 +319,9 @@ LuaAreaStore::LuaAreaStore(const std::string &type)
 		as = new SpatialAreaStore();
 	} else
 #endif
-	{
+	if (type == "RTree") {
+		as = new RTreeAreaStore();
+	} else {
 		as = new VectorAreaStore();
 	}
 }
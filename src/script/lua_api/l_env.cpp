@@ -65,6 +65,7 @@ void LuaABM::trigger(ServerEnvironment *env, v3s16 p, MapNode n,
 	lua_State *L = scriptIface->getStack();
 	sanity_check(lua_checkstack(L, 20));
 	StackUnroller stack_unroller(L);
+	ModAccountingScope accounting_scope(scriptIface->m_accounting.get());
 
 	int error_handler = PUSH_ERROR_HANDLER(L);
 
@@ -100,6 +101,62 @@ void LuaABM::trigger(ServerEnvironment *env, v3s16 p, MapNode n,
 	lua_pop(L, 1); // Pop error handler
 }
 
+void LuaABM::triggerBatch(ServerEnvironment *env,
+		const std::vector<std::pair<v3s16, MapNode>> &nodes,
+		u32 active_object_count, u32 active_object_count_wider)
+{
+	ServerScripting *scriptIface = env->getScriptIface();
+	scriptIface->realityCheck();
+
+	lua_State *L = scriptIface->getStack();
+	sanity_check(lua_checkstack(L, 20));
+	StackUnroller stack_unroller(L);
+	ModAccountingScope accounting_scope(scriptIface->m_accounting.get());
+
+	int error_handler = PUSH_ERROR_HANDLER(L);
+
+	// Get registered_abms
+	lua_getglobal(L, "core");
+	lua_getfield(L, -1, "registered_abms");
+	luaL_checktype(L, -1, LUA_TTABLE);
+	lua_remove(L, -2); // Remove core
+
+	// Get registered_abms[m_id]
+	lua_pushinteger(L, m_id);
+	lua_gettable(L, -2);
+	if(lua_isnil(L, -1))
+		FATAL_ERROR("");
+	lua_remove(L, -2); // Remove registered_abms
+
+	scriptIface->setOriginFromTable(-1);
+
+	// Call action_batch
+	luaL_checktype(L, -1, LUA_TTABLE);
+	lua_getfield(L, -1, "action_batch");
+	luaL_checktype(L, -1, LUA_TFUNCTION);
+	lua_remove(L, -2); // Remove registered_abms[m_id]
+
+	const NodeDefManager *ndef = env->getGameDef()->ndef();
+	lua_createtable(L, nodes.size(), 0);
+	lua_createtable(L, nodes.size(), 0);
+	int i = 1;
+	for (const auto &it : nodes) {
+		push_v3s16(L, it.first);
+		lua_rawseti(L, -3, i);
+		pushnode(L, it.second, ndef);
+		lua_rawseti(L, -2, i);
+		i++;
+	}
+	lua_pushnumber(L, active_object_count);
+	lua_pushnumber(L, active_object_count_wider);
+
+	int result = lua_pcall(L, 4, 0, error_handler);
+	if (result)
+		scriptIface->scriptError(result, "LuaABM::triggerBatch");
+
+	lua_pop(L, 1); // Pop error handler
+}
+
 void LuaLBM::trigger(ServerEnvironment *env, v3s16 p, MapNode n)
 {
 	ServerScripting *scriptIface = env->getScriptIface();
@@ -108,6 +165,7 @@ void LuaLBM::trigger(ServerEnvironment *env, v3s16 p, MapNode n)
 	lua_State *L = scriptIface->getStack();
 	sanity_check(lua_checkstack(L, 20));
 	StackUnroller stack_unroller(L);
+	ModAccountingScope accounting_scope(scriptIface->m_accounting.get());
 
 	int error_handler = PUSH_ERROR_HANDLER(L);
 
@@ -381,6 +439,26 @@ int ModApiEnvMod::l_get_node_or_nil(lua_State *L)
 	return 1;
 }
 
+// get_node_raw(x, y, z) -> content, param1, param2, pos_ok
+int ModApiEnvMod::l_get_node_raw(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	// Same rounding as read_v3s16(), without creating a table
+	v3d pf(luaL_checknumber(L, 1), luaL_checknumber(L, 2),
+		luaL_checknumber(L, 3));
+	v3s16 pos = doubleToInt(pf, 1.0);
+	// Do it
+	bool pos_ok;
+	MapNode n = env->getMap().getNode(pos, &pos_ok);
+	// Return node and whether it was loaded
+	lua_pushinteger(L, n.getContent());
+	lua_pushinteger(L, n.getParam1());
+	lua_pushinteger(L, n.getParam2());
+	lua_pushboolean(L, pos_ok);
+	return 4;
+}
+
 // get_node_light(pos, timeofday)
 // pos = {x=num, y=num, z=num}
 // timeofday: nil = current time, 0 = night, 0.5 = day
@@ -1178,6 +1256,48 @@ int ModApiEnvMod::l_raycast(lua_State *L)
 	return LuaRaycast::create_object(L);
 }
 
+// raycast_batch(rays, objects, liquids) -> {pointed_thing, ...}
+// rays = {{pos1, pos2}, ...}
+int ModApiEnvMod::l_raycast_batch(lua_State *L)
+{
+	GET_PLAIN_ENV_PTR;
+
+	bool csm = false;
+#ifndef SERVER
+	csm = getClient(L) != nullptr;
+#endif
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	bool objects = true;
+	bool liquids = false;
+	if (lua_isboolean(L, 2))
+		objects = readParam<bool>(L, 2);
+	if (lua_isboolean(L, 3))
+		liquids = readParam<bool>(L, 3);
+
+	// Rays from one place mostly pass the same blocks one after another,
+	// which the map's block lookup cache and the block emptiness flags
+	// make cheap for all but the first
+	s32 len = lua_objlen(L, 1);
+	lua_createtable(L, len, 0);
+	for (s32 i = 1; i <= len; i++) {
+		lua_rawgeti(L, 1, i);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		lua_rawgeti(L, -1, 1);
+		v3f pos1 = checkFloatPos(L, -1);
+		lua_rawgeti(L, -2, 2);
+		v3f pos2 = checkFloatPos(L, -1);
+		lua_pop(L, 3);
+
+		RaycastState state(core::line3d<f32>(pos1, pos2), objects, liquids);
+		PointedThing pointed;
+		env->continueRaycast(&state, &pointed);
+		push_pointed_thing(L, pointed, csm, true);
+		lua_rawseti(L, -2, i);
+	}
+	return 1;
+}
+
 // load_area(p1, [p2])
 // load mapblocks in area p1..p2, but do not generate map
 int ModApiEnvMod::l_load_area(lua_State *L)
@@ -1321,6 +1441,36 @@ int ModApiEnvMod::l_find_path(lua_State *L)
 	return 0;
 }
 
+// find_path_async_raw(pos1, pos2, searchdistance,
+//     max_jump, max_drop, algorithm, mod_origin) -> search id
+int ModApiEnvMod::l_find_path_async_raw(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	v3s16 pos1                  = read_v3s16(L, 1);
+	v3s16 pos2                  = read_v3s16(L, 2);
+	unsigned int searchdistance = luaL_checkint(L, 3);
+	unsigned int max_jump       = luaL_checkint(L, 4);
+	unsigned int max_drop       = luaL_checkint(L, 5);
+	PathAlgorithm algo          = PA_PLAIN_NP;
+	if (!lua_isnoneornil(L, 6)) {
+		std::string algorithm = luaL_checkstring(L, 6);
+
+		if (algorithm == "A*")
+			algo = PA_PLAIN;
+
+		if (algorithm == "Dijkstra")
+			algo = PA_DIJKSTRA;
+	}
+	std::string mod_origin = luaL_checkstring(L, 7);
+
+	u32 id = getServer(L)->getPathfinder()->findPath(pos1, pos2,
+		searchdistance, max_jump, max_drop, algo, mod_origin);
+
+	lua_pushinteger(L, id);
+	return 1;
+}
+
 // spawn_tree(pos, treedef)
 int ModApiEnvMod::l_spawn_tree(lua_State *L)
 {
@@ -1475,6 +1625,7 @@ void ModApiEnvMod::Initialize(lua_State *L, int top)
 	API_FCT(remove_node);
 	API_FCT(get_node);
 	API_FCT(get_node_or_nil);
+	API_FCT(get_node_raw);
 	API_FCT(get_node_light);
 	API_FCT(get_natural_light);
 	API_FCT(place_node);
@@ -1509,8 +1660,10 @@ void ModApiEnvMod::Initialize(lua_State *L, int top)
 	API_FCT(clear_objects);
 	API_FCT(spawn_tree);
 	API_FCT(find_path);
+	API_FCT(find_path_async_raw);
 	API_FCT(line_of_sight);
 	API_FCT(raycast);
+	API_FCT(raycast_batch);
 	API_FCT(transforming_liquid_add);
 	API_FCT(forceload_block);
 	API_FCT(forceload_free_block);
@@ -1531,4 +1684,5 @@ void ModApiEnvMod::InitializeClient(lua_State *L, int top)
 	API_FCT(find_nodes_in_area_under_air);
 	API_FCT(line_of_sight);
 	API_FCT(raycast);
+	API_FCT(raycast_batch);
 }
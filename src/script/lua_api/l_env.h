@@ -51,6 +51,9 @@ class ModApiEnvMod : public ModApiBase {
 	// pos = {x=num, y=num, z=num}
 	static int l_get_node_or_nil(lua_State *L);
 
+	// get_node_raw(x, y, z) -> content, param1, param2, pos_ok
+	static int l_get_node_raw(lua_State *L);
+
 	// get_node_light(pos, timeofday)
 	// pos = {x=num, y=num, z=num}
 	// timeofday: nil = current time, 0 = night, 0.5 = day
@@ -180,10 +183,17 @@ class ModApiEnvMod : public ModApiBase {
 	// raycast(pos1, pos2, objects, liquids) -> Raycast
 	static int l_raycast(lua_State *L);
 
+	// raycast_batch(rays, objects, liquids) -> {pointed_thing, ...}
+	static int l_raycast_batch(lua_State *L);
+
 	// find_path(pos1, pos2, searchdistance,
 	//     max_jump, max_drop, algorithm) -> table containing path
 	static int l_find_path(lua_State *L);
 
+	// find_path_async_raw(pos1, pos2, searchdistance,
+	//     max_jump, max_drop, algorithm, mod_origin) -> search id
+	static int l_find_path_async_raw(lua_State *L);
+
 	// transforming_liquid_add(pos)
 	static int l_transforming_liquid_add(lua_State *L);
 
@@ -227,11 +237,13 @@ class LuaABM : public ActiveBlockModifier {
 	bool m_simple_catch_up;
 	s16 m_min_y;
 	s16 m_max_y;
+	bool m_batched;
 public:
 	LuaABM(lua_State *L, int id,
 			const std::vector<std::string> &trigger_contents,
 			const std::vector<std::string> &required_neighbors,
-			float trigger_interval, u32 trigger_chance, bool simple_catch_up, s16 min_y, s16 max_y):
+			float trigger_interval, u32 trigger_chance, bool simple_catch_up, s16 min_y, s16 max_y,
+			bool batched):
 		m_id(id),
 		m_trigger_contents(trigger_contents),
 		m_required_neighbors(required_neighbors),
@@ -239,7 +251,8 @@ class LuaABM : public ActiveBlockModifier {
 		m_trigger_chance(trigger_chance),
 		m_simple_catch_up(simple_catch_up),
 		m_min_y(min_y),
-		m_max_y(max_y)
+		m_max_y(max_y),
+		m_batched(batched)
 	{
 	}
 	virtual const std::vector<std::string> &getTriggerContents() const
@@ -270,8 +283,15 @@ class LuaABM : public ActiveBlockModifier {
 	{
 		return m_max_y;
 	}
+	virtual bool getBatched()
+	{
+		return m_batched;
+	}
 	virtual void trigger(ServerEnvironment *env, v3s16 p, MapNode n,
 			u32 active_object_count, u32 active_object_count_wider);
+	virtual void triggerBatch(ServerEnvironment *env,
+			const std::vector<std::pair<v3s16, MapNode>> &nodes,
+			u32 active_object_count, u32 active_object_count_wider);
 };
 
 class LuaLBM : public LoadingBlockModifierDef
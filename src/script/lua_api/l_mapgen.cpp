@@ -1894,3 +1894,10 @@ void ModApiMapgen::Initialize(lua_State *L, int top)
 	API_FCT(serialize_schematic);
 	API_FCT(read_schematic);
 }
+
+void ModApiMapgen::InitializeEmerge(lua_State *L, int top)
+{
+	API_FCT(get_biome_id);
+	API_FCT(get_biome_name);
+	API_FCT(get_mapgen_object);
+}
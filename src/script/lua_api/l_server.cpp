@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/c_content.h"
 #include "cpp_api/s_base.h"
 #include "cpp_api/s_security.h"
+#include "scripting_server.h"
 #include "server.h"
 #include "environment.h"
 #include "remoteplayer.h"
@@ -56,6 +57,30 @@ int ModApiServer::l_get_server_uptime(lua_State *L)
 	return 1;
 }
 
+// get_mod_usage()
+int ModApiServer::l_get_mod_usage(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	std::vector<ModUsage> usage;
+	if (!getScriptApiBase(L)->getModUsage(usage)) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	lua_createtable(L, 0, usage.size());
+	for (const ModUsage &mod : usage) {
+		lua_createtable(L, 0, 3);
+		lua_pushnumber(L, mod.time_us / 1000000.0);
+		lua_setfield(L, -2, "time");
+		lua_pushnumber(L, mod.calls);
+		lua_setfield(L, -2, "calls");
+		lua_pushnumber(L, mod.alloc_bytes);
+		lua_setfield(L, -2, "allocated");
+		lua_setfield(L, -2, mod.mod.c_str());
+	}
+	return 1;
+}
+
 
 // print(text)
 int ModApiServer::l_print(lua_State *L)
@@ -561,11 +586,84 @@ int ModApiServer::l_set_last_run_mod(lua_State *L)
 	return 0;
 }
 
+static int dump_writer(lua_State *L, const void *p, size_t sz, void *ud)
+{
+	static_cast<std::string *>(ud)->append(static_cast<const char *>(p), sz);
+	return 0;
+}
+
+// do_async_callback(func, params, mod_origin)
+int ModApiServer::l_do_async_callback(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	ServerScripting *script = getScriptApi<ServerScripting>(L);
+
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	std::string serialized_params = luaL_checkstring(L, 2);
+	std::string mod_origin = luaL_checkstring(L, 3);
+
+	// The function is dumped here instead of using string.dump so that
+	// mods can never hand raw bytecode to the async environment
+	if (lua_iscfunction(L, 1))
+		return luaL_error(L, "C functions can't be run asynchronously");
+	std::string serialized_func;
+	lua_pushvalue(L, 1);
+	int dump_result = lua_dump(L, dump_writer, &serialized_func);
+	lua_pop(L, 1);
+	if (dump_result != 0 || serialized_func.empty())
+		return luaL_error(L, "Unable to dump the async function");
+
+	u32 job_id = script->queueAsync(serialized_func, serialized_params,
+			mod_origin);
+
+	lua_pushinteger(L, job_id);
+	return 1;
+}
+
+// register_async_dofile(path)
+int ModApiServer::l_register_async_dofile(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	std::string path = readParam<std::string>(L, 1);
+	CHECK_SECURE_PATH(L, path.c_str(), false);
+
+	// Find currently running mod name (only at init time)
+	lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_CURRENT_MOD_NAME);
+	if (!lua_isstring(L, -1))
+		throw LuaError("register_async_dofile can only be called at load time");
+	std::string modname = readParam<std::string>(L, -1);
+
+	getServer(L)->m_async_init_files.emplace_back(modname, path);
+	lua_pushboolean(L, true);
+	return 1;
+}
+
+// register_mapgen_script(path)
+int ModApiServer::l_register_mapgen_script(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	std::string path = readParam<std::string>(L, 1);
+	CHECK_SECURE_PATH(L, path.c_str(), false);
+
+	// Find currently running mod name (only at init time)
+	lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_CURRENT_MOD_NAME);
+	if (!lua_isstring(L, -1))
+		throw LuaError("register_mapgen_script can only be called at load time");
+	std::string modname = readParam<std::string>(L, -1);
+
+	getServer(L)->m_mapgen_init_files.emplace_back(modname, path);
+	lua_pushboolean(L, true);
+	return 1;
+}
+
 void ModApiServer::Initialize(lua_State *L, int top)
 {
 	API_FCT(request_shutdown);
 	API_FCT(get_server_status);
 	API_FCT(get_server_uptime);
+	API_FCT(get_mod_usage);
 	API_FCT(get_worldpath);
 	API_FCT(is_singleplayer);
 
@@ -597,4 +695,21 @@ void ModApiServer::Initialize(lua_State *L, int top)
 
 	API_FCT(get_last_run_mod);
 	API_FCT(set_last_run_mod);
+
+	API_FCT(do_async_callback);
+	API_FCT(register_async_dofile);
+	API_FCT(register_mapgen_script);
+}
+
+void ModApiServer::InitializeAsync(lua_State *L, int top)
+{
+	API_FCT(get_worldpath);
+	API_FCT(is_singleplayer);
+
+	API_FCT(get_current_modname);
+	API_FCT(get_modpath);
+	API_FCT(get_modnames);
+
+	API_FCT(get_last_run_mod);
+	API_FCT(set_last_run_mod);
 }
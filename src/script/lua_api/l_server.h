@@ -33,6 +33,9 @@ class ModApiServer : public ModApiBase
 	// get_server_uptime()
 	static int l_get_server_uptime(lua_State *L);
 
+	// get_mod_usage()
+	static int l_get_mod_usage(lua_State *L);
+
 	// get_worldpath()
 	static int l_get_worldpath(lua_State *L);
 
@@ -112,6 +115,16 @@ class ModApiServer : public ModApiBase
 	// set_last_run_mod(modname)
 	static int l_set_last_run_mod(lua_State *L);
 
+	// do_async_callback(func, params, mod_origin)
+	static int l_do_async_callback(lua_State *L);
+
+	// register_async_dofile(path)
+	static int l_register_async_dofile(lua_State *L);
+
+	// register_mapgen_script(path)
+	static int l_register_mapgen_script(lua_State *L);
+
 public:
 	static void Initialize(lua_State *L, int top);
+	static void InitializeAsync(lua_State *L, int top);
 };
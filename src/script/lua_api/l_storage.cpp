@@ -36,7 +36,7 @@ int ModApiStorage::l_get_mod_storage(lua_State *L)
 
 	ModMetadata *store = new ModMetadata(mod_name);
 	if (IGameDef *gamedef = getGameDef(L)) {
-		store->load(gamedef->getModStoragePath());
+		store->load(gamedef->getModStorageDatabase());
 		gamedef->registerModStorage(store);
 	} else {
 		delete store;
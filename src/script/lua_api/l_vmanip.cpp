@@ -46,6 +46,10 @@ int LuaVoxelManip::l_read_from_map(lua_State *L)
 	LuaVoxelManip *o = checkobject(L, 1);
 	MMVManip *vm = o->vm;
 
+	// Emerge threads must not touch the map outside of finishBlockMake
+	if (!ModApiBase::getEnv(L))
+		throw LuaError("VoxelManip:read_from_map is not available in this environment");
+
 	v3s16 bp1 = getNodeBlockPos(check_v3s16(L, 2));
 	v3s16 bp2 = getNodeBlockPos(check_v3s16(L, 3));
 	sortBoxVerticies(bp1, bp2);
@@ -0,0 +1,82 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "scripting_emerge.h"
+#include "cpp_api/s_internal.h"
+#include "filesys.h"
+#include "server.h"
+#include "settings.h"
+#include "lua_api/l_item.h"
+#include "lua_api/l_mapgen.h"
+#include "lua_api/l_noise.h"
+#include "lua_api/l_server.h"
+#include "lua_api/l_settings.h"
+#include "lua_api/l_util.h"
+#include "lua_api/l_vmanip.h"
+
+EmergeScripting::EmergeScripting(Server *server):
+		ScriptApiBase(ScriptingType::Emerge)
+{
+	setGameDef(server);
+
+	// There is no environment here, functions that need one
+	// must not be exposed to this state
+
+	SCRIPTAPI_PRECHECKHEADER
+
+	if (g_settings->getBool("secure.enable_security"))
+		initializeSecurity();
+
+	lua_getglobal(L, "core");
+	int top = lua_gettop(L);
+
+	InitializeModApi(L, top);
+	lua_pop(L, 1);
+
+	// Push builtin initialization type
+	lua_pushstring(L, "emerge");
+	lua_setglobal(L, "INIT");
+}
+
+void EmergeScripting::loadMapgenScripts()
+{
+	loadMod(Server::getBuiltinLuaPath() + DIR_DELIM "init.lua",
+			BUILTIN_MOD_NAME);
+
+	for (const auto &file : getServer()->m_mapgen_init_files)
+		loadMod(file.second, file.first);
+}
+
+void EmergeScripting::InitializeModApi(lua_State *L, int top)
+{
+	// Register reference classes (userdata)
+	LuaPerlinNoise::Register(L);
+	LuaPerlinNoiseMap::Register(L);
+	LuaPseudoRandom::Register(L);
+	LuaPcgRandom::Register(L);
+	LuaSecureRandom::Register(L);
+	LuaSettings::Register(L);
+	LuaVoxelManip::Register(L);
+
+	// Initialize mod api modules
+	ModApiItemMod::InitializeEmerge(L, top);
+	ModApiMapgen::InitializeEmerge(L, top);
+	ModApiServer::InitializeAsync(L, top);
+	ModApiUtil::InitializeAsync(L, top);
+}
@@ -0,0 +1,44 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "cpp_api/s_base.h"
+#include "cpp_api/s_mapgen.h"
+#include "cpp_api/s_security.h"
+
+/*****************************************************************************/
+/* Scripting <-> Emerge Thread Interface                                     */
+/*****************************************************************************/
+
+class EmergeScripting:
+		virtual public ScriptApiBase,
+		public ScriptApiMapgen,
+		public ScriptApiSecurity
+{
+public:
+	EmergeScripting(Server *server);
+
+	// Load builtin and the scripts registered with
+	// core.register_mapgen_script(), throws ModError
+	void loadMapgenScripts();
+
+private:
+	void InitializeModApi(lua_State *L, int top);
+};
@@ -51,7 +51,8 @@ extern "C" {
 }
 
 ServerScripting::ServerScripting(Server* server):
-		ScriptApiBase(ScriptingType::Server)
+		ScriptApiBase(ScriptingType::Server),
+		asyncEngine(server)
 {
 	setGameDef(server);
 
@@ -88,6 +89,34 @@ ServerScripting::ServerScripting(Server* server):
 	infostream << "SCRIPTAPI: Initialized game modules" << std::endl;
 }
 
+void ServerScripting::initAsync()
+{
+	infostream << "SCRIPTAPI: Initializing async engine" << std::endl;
+	asyncEngine.registerStateInitializer(InitializeAsync);
+
+	s16 nthreads = g_settings->getS16("num_async_threads");
+	// If automatic, leave a proc for the main thread and one for
+	// some other misc thread
+	if (nthreads == 0)
+		nthreads = Thread::getNumberOfProcessors() - 2;
+	if (nthreads < 1)
+		nthreads = 1;
+
+	asyncEngine.initialize(nthreads);
+}
+
+void ServerScripting::stepAsync()
+{
+	asyncEngine.step(getStack());
+}
+
+u32 ServerScripting::queueAsync(const std::string &serialized_func,
+		const std::string &serialized_params, const std::string &mod_origin)
+{
+	return asyncEngine.queueAsyncJob(serialized_func, serialized_params,
+			mod_origin);
+}
+
 void ServerScripting::InitializeModApi(lua_State *L, int top)
 {
 	// Register reference classes (userdata)
@@ -127,3 +156,19 @@ void ServerScripting::InitializeModApi(lua_State *L, int top)
 	ModApiStorage::Initialize(L, top);
 	ModApiChannels::Initialize(L, top);
 }
+
+void ServerScripting::InitializeAsync(lua_State *L, int top)
+{
+	// classes
+	LuaItemStack::Register(L);
+	LuaPerlinNoise::Register(L);
+	LuaPerlinNoiseMap::Register(L);
+	LuaPseudoRandom::Register(L);
+	LuaPcgRandom::Register(L);
+	LuaSecureRandom::Register(L);
+	LuaSettings::Register(L);
+
+	// globals
+	ModApiServer::InitializeAsync(L, top);
+	ModApiUtil::InitializeAsync(L, top);
+}
@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 #include "cpp_api/s_base.h"
+#include "cpp_api/s_async.h"
 #include "cpp_api/s_entity.h"
 #include "cpp_api/s_env.h"
 #include "cpp_api/s_inventory.h"
@@ -48,6 +49,20 @@ class ServerScripting:
 
 	// use ScriptApiBase::loadMod() to load mods
 
+	// Initialize async engine, call this AFTER loading all mods
+	void initAsync();
+
+	// Global step handler to collect async results
+	void stepAsync();
+
+	// Pass job to async threads
+	u32 queueAsync(const std::string &serialized_func,
+			const std::string &serialized_params, const std::string &mod_origin);
+
 private:
 	void InitializeModApi(lua_State *L, int top);
+
+	static void InitializeAsync(lua_State *L, int top);
+
+	AsyncEngine asyncEngine;
 };
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <iostream>
 #include <queue>
 #include <algorithm>
+#include <iomanip>
 #include "network/mt_connection.h"
 #include "network/networkprotocol.h"
 #include "network/serveropcodes.h"
@@ -57,17 +58,28 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/serialize.h"
 #include "util/thread.h"
 #include "defaultsettings.h"
+#include "gameparams.h"
 #include "server/mods.h"
 #include "util/base64.h"
 #include "util/hashing.h"
 #include "util/hex.h"
 #include "database/database.h"
+#include "database/database-dummy.h"
+#include "database/database-files.h"
+#if USE_SQLITE
+#include "database/database-sqlite3.h"
+#endif
+#if USE_POSTGRESQL
+#include "database/database-postgresql.h"
+#endif
 #include "chatmessage.h"
 #include "chat_interface.h"
 #include "remoteplayer.h"
 #include "server/player_sao.h"
 #include "server/serverinventorymgr.h"
 #include "translation.h"
+#include "network/mediaserver.h"
+#include "pathfinder.h"
 #include <zstd.h>
 #if defined(__ANDROID__) || defined(__APPLE__)
 #include "util/encryption.h"
@@ -284,6 +296,8 @@ Server::Server(
 			"Valid received packets processed");
 
 	m_lag_gauge->set(g_settings->getFloat("dedicated_server_step"));
+
+	m_mod_usage_summary_interval = g_settings->getFloat("mod_accounting_log_interval");
 }
 
 Server::~Server()
@@ -434,6 +448,15 @@ void Server::init()
 	ServerMap *servermap = new ServerMap(m_path_world, this, m_emerge, m_metrics_backend.get());
 	m_startup_server_map = servermap;
 
+	m_pathfinder.reset(new PathfinderService(servermap, m_nodedef));
+
+	// Open the mod storage before any mod can ask for it
+	try {
+		m_mod_storage_database.reset(openModStorageDatabase(m_path_world));
+	} catch (const BaseException &e) {
+		throw ServerError(std::string("Failed to open mod storage: ") + e.what());
+	}
+
 	// Initialize scripting
 	infostream << "Server: Initializing Lua" << std::endl;
 
@@ -446,6 +469,21 @@ void Server::init()
 
 	m_modmgr->loadMods(m_script);
 
+	// The media server learns of the files as they are collected
+	u16 media_server_port = g_settings->getU16("media_server_port");
+	if (media_server_port != 0 && !m_simple_singleplayer_mode) {
+		Address media_addr = m_bind_addr;
+		media_addr.setPort(media_server_port);
+		m_media_server.reset(new MediaHTTPServer());
+		try {
+			m_media_server->listen(media_addr);
+		} catch (SocketException &e) {
+			errorstream << "Server: " << e.what() << ", media is only "
+					<< "sent the usual way" << std::endl;
+			m_media_server.reset();
+		}
+	}
+
 	// Read Textures and calculate sha1 sums
 	fillMediaCache();
 
@@ -496,6 +534,9 @@ void Server::init()
 	// Give environment reference to scripting api
 	m_script->initializeEnvironment(m_env);
 
+	// Do this after regular script init is done
+	m_script->initAsync();
+
 	// Register us to receive map edit events
 	servermap->addEventReceiver(this);
 
@@ -532,6 +573,14 @@ void Server::start()
 	// Start thread
 	m_thread->start();
 
+	m_pathfinder->start(rangelim(g_settings->getU16("num_pathfinder_threads"), 1, 16));
+
+	if (m_media_server) {
+		m_media_server->start();
+		actionstream << "Serving media over HTTP on port "
+				<< m_media_server->getPort() << "." << std::endl;
+	}
+
 	actionstream << "World at [" << m_path_world << "]" << std::endl;
 	actionstream << "Server for gameid=\"" << m_gamespec.id
 			<< "\" listening on " << m_bind_addr.serializeString() << ":"
@@ -548,6 +597,14 @@ void Server::stop()
 	m_thread->wait();
 	//m_emergethread.stop();
 
+	if (m_media_server) {
+		m_media_server->stop();
+		m_media_server->wait();
+	}
+
+	if (m_pathfinder)
+		m_pathfinder->stop();
+
 	infostream<<"Server: Threads stopped"<<std::endl;
 }
 
@@ -589,7 +646,7 @@ void Server::AsyncRunStep(bool initial_step)
 	if((dtime < 0.001) && !initial_step)
 		return;
 
-	ScopeProfiler sp(g_profiler, "Server::AsyncRunStep()", SPT_AVG);
+	PROFILE_ZONE("Server::AsyncRunStep()", SPT_AVG);
 
 	{
 		MutexAutoLock lock1(m_step_dtime_mutex);
@@ -636,6 +693,15 @@ void Server::AsyncRunStep(bool initial_step)
 		m_env->reportMaxLagEstimate(max_lag);
 		// Step environment
 		m_env->step(dtime);
+
+		// Run callbacks of finished async jobs
+		m_script->stepAsync();
+
+		// Run callbacks of finished path searches
+		std::vector<PathResult> paths;
+		m_pathfinder->getResults(paths);
+		for (const PathResult &result : paths)
+			m_script->on_path_found(result);
 	}
 
 	static const float map_timer_and_unload_dtime = 2.92;
@@ -643,7 +709,7 @@ void Server::AsyncRunStep(bool initial_step)
 	{
 		MutexAutoLock lock(m_env_mutex);
 		// Run Map's timers and unload unused data
-		ScopeProfiler sp(g_profiler, "Server: map timer and unload");
+		PROFILE_ZONE("Server: map timer and unload", SPT_ADD);
 		m_env->getMap().timerUpdate(map_timer_and_unload_dtime,
 			g_settings->getFloat("server_unload_unused_data_timeout"),
 			U32_MAX);
@@ -677,7 +743,7 @@ void Server::AsyncRunStep(bool initial_step)
 
 		MutexAutoLock lock(m_env_mutex);
 
-		ScopeProfiler sp(g_profiler, "Server: liquid transform");
+		PROFILE_ZONE("Server: liquid transform", SPT_ADD);
 
 		std::map<v3s16, MapBlock*> modified_blocks;
 		m_env->getMap().transformLiquids(modified_blocks, m_env);
@@ -729,7 +795,7 @@ void Server::AsyncRunStep(bool initial_step)
 
 		m_clients.lock();
 		const RemoteClientMap &clients = m_clients.getClientList();
-		ScopeProfiler sp(g_profiler, "Server: update objects within range");
+		PROFILE_ZONE("Server: update objects within range", SPT_ADD);
 
 		m_player_gauge->set(clients.size());
 		for (const auto &client_it : clients) {
@@ -755,13 +821,15 @@ void Server::AsyncRunStep(bool initial_step)
 		if (m_mod_storage_save_timer <= 0.0f) {
 			m_mod_storage_save_timer = g_settings->getFloat("server_map_save_interval");
 			int n = 0;
+			m_mod_storage_database->beginSave();
 			for (std::unordered_map<std::string, ModMetadata *>::const_iterator
 				it = m_mod_storages.begin(); it != m_mod_storages.end(); ++it) {
 				if (it->second->isModified()) {
-					it->second->save(getModStoragePath());
+					it->second->save(m_mod_storage_database.get());
 					n++;
 				}
 			}
+			m_mod_storage_database->endSave();
 			if (n > 0)
 				infostream << "Saved " << n << " modified mod storages." << std::endl;
 		}
@@ -772,12 +840,16 @@ void Server::AsyncRunStep(bool initial_step)
 	*/
 	{
 		MutexAutoLock envlock(m_env_mutex);
-		ScopeProfiler sp(g_profiler, "Server: send SAO messages");
+		PROFILE_ZONE("Server: send SAO messages", SPT_ADD);
 
 		// Key = object id
 		// Value = data sent by object
 		std::unordered_map<u16, std::vector<ActiveObjectMessage>*> buffered_messages;
 
+		// Latest position update of each object, for clients that get
+		// them as object states
+		std::unordered_map<u16, ObjectPosition> positions;
+
 		// Get active object messages from environment
 		ActiveObjectMessage aom(0);
 		u32 aom_count = 0;
@@ -785,6 +857,18 @@ void Server::AsyncRunStep(bool initial_step)
 			if (!m_env->getActiveObjectMessage(&aom))
 				break;
 
+			ObjectPosition position;
+			if (!aom.reliable && position.deSerializeCommand(aom.datastring)) {
+				auto it = positions.find(aom.id);
+				if (it != positions.end()) {
+					// Don't interpolate past a jump
+					position.do_interpolate &= it->second.do_interpolate;
+					it->second = position;
+				} else {
+					positions.emplace(aom.id, position);
+				}
+			}
+
 			std::vector<ActiveObjectMessage>* message_list = nullptr;
 			auto n = buffered_messages.find(aom.id);
 			if (n == buffered_messages.end()) {
@@ -799,6 +883,21 @@ void Server::AsyncRunStep(bool initial_step)
 
 		m_aom_buffer_counter->increment(aom_count);
 
+		// Send position updates to players who do not see the attachment
+		auto wants_position = [] (RemoteClient *client, PlayerSAO *player,
+				ServerActiveObject *sao) {
+			if (sao->getId() == player->getId())
+				return false;
+
+			// Do not send position updates for attached players
+			// as long the parent is known to the client
+			ServerActiveObject *parent = sao->getParent();
+			return !parent || client->m_known_objects.find(parent->getId()) ==
+					client->m_known_objects.end();
+		};
+
+		const double now = getUptime();
+
 		m_clients.lock();
 		const RemoteClientMap &clients = m_clients.getClientList();
 		// Route data to every client
@@ -808,6 +907,9 @@ void Server::AsyncRunStep(bool initial_step)
 			unreliable_data.clear();
 			RemoteClient *client = client_it.second;
 			PlayerSAO *player = getPlayerSAO(client->peer_id);
+			const bool send_states = player &&
+					(m_clients.getMulticraftProtocolVersion(client->peer_id) > 5 ||
+					m_simple_singleplayer_mode);
 			// Go through all objects in message buffer
 			for (const auto &buffered_message : buffered_messages) {
 				// If object does not exist or is not known by client, skip it
@@ -820,17 +922,17 @@ void Server::AsyncRunStep(bool initial_step)
 				std::vector<ActiveObjectMessage>* list = buffered_message.second;
 				// Go through every message
 				for (const ActiveObjectMessage &aom : *list) {
-					// Send position updates to players who do not see the attachment
 					if (aom.datastring[0] == AO_CMD_UPDATE_POSITION) {
-						if (sao->getId() == player->getId())
+						if (!wants_position(client, player, sao))
 							continue;
 
-						// Do not send position updates for attached players
-						// as long the parent is known to the client
-						ServerActiveObject *parent = sao->getParent();
-						if (parent && client->m_known_objects.find(parent->getId()) !=
-								client->m_known_objects.end())
+						// Sent as object state below
+						if (send_states && !aom.reliable) {
+							ObjectSyncState &state = client->m_object_states[id];
+							state.pending = positions[id];
+							state.has_pending = true;
 							continue;
+						}
 					}
 
 					// Add full new data to appropriate buffer
@@ -854,6 +956,41 @@ void Server::AsyncRunStep(bool initial_step)
 			if (!unreliable_data.empty()) {
 				SendActiveObjectMessages(client->peer_id, unreliable_data, false);
 			}
+
+			if (!send_states)
+				continue;
+
+			/*
+				Position updates, far away objects get them less often.
+				Updates held back are sent later unless superseded.
+			*/
+			reliable_data.clear();
+			unreliable_data.clear();
+			const v3f player_pos = player->getBasePosition();
+			for (auto &state_it : client->m_object_states) {
+				ObjectSyncState &state = state_it.second;
+				if (!state.has_pending)
+					continue;
+
+				ObjectPosition &pos = state.pending;
+				f32 interval = rangelim((pos.position.getDistanceFrom(player_pos) -
+						OBJECT_STATE_FULL_RATE_DISTANCE) / OBJECT_STATE_SLOWDOWN_DISTANCE,
+						0.0f, 1.0f);
+				if (pos.do_interpolate && !pos.is_movement_end &&
+						now - state.last_sent < interval)
+					continue;
+
+				// Interpolate until the next update is due
+				pos.update_interval = MYMAX(pos.update_interval, interval);
+				state.write(state_it.first, pos, reliable_data, unreliable_data);
+				state.has_pending = false;
+				state.last_sent = now;
+			}
+
+			if (!reliable_data.empty())
+				SendActiveObjectStates(client->peer_id, reliable_data, true);
+			if (!unreliable_data.empty())
+				SendActiveObjectStates(client->peer_id, unreliable_data, false);
 		}
 		m_clients.unlock();
 
@@ -898,13 +1035,12 @@ void Server::AsyncRunStep(bool initial_step)
 			case MEET_ADDNODE:
 			case MEET_SWAPNODE:
 				prof.add("MEET_ADDNODE", 1);
-				sendAddNode(event->p, event->n, &far_players,
-						disable_single_change_sending ? 5 : 30,
-						event->type == MEET_ADDNODE);
+				sendNodeChange(*event, far_players,
+						disable_single_change_sending ? 5 : 30);
 				break;
 			case MEET_REMOVENODE:
 				prof.add("MEET_REMOVENODE", 1);
-				sendRemoveNode(event->p, &far_players,
+				sendNodeChange(*event, far_players,
 						disable_single_change_sending ? 5 : 30);
 				break;
 			case MEET_BLOCK_NODE_METADATA_CHANGED: {
@@ -964,6 +1100,8 @@ void Server::AsyncRunStep(bool initial_step)
 			prof.print(verbosestream);
 		}
 
+		SendNodeChanges();
+
 		// Send all metadata updates
 		if (node_meta_updates.size())
 			sendMetadataChanged(node_meta_updates);
@@ -993,7 +1131,7 @@ void Server::AsyncRunStep(bool initial_step)
 			counter = 0.0;
 			MutexAutoLock lock(m_env_mutex);
 
-			ScopeProfiler sp(g_profiler, "Server: map saving (sum)");
+			PROFILE_ZONE("Server: map saving (sum)", SPT_ADD);
 
 #if BAN_MANAGER
 			// Save ban file
@@ -1013,9 +1151,96 @@ void Server::AsyncRunStep(bool initial_step)
 		}
 	}
 
+	reportModUsage(dtime);
+
 	m_shutdown_state.tick(dtime, this);
 }
 
+void Server::reportModUsage(float dtime)
+{
+	m_mod_usage_timer += dtime;
+	if (m_mod_usage_timer < 1.0f)
+		return;
+	float elapsed = m_mod_usage_timer;
+	m_mod_usage_timer = 0.0f;
+
+	std::vector<ModUsage> usage;
+	if (!m_script->getModUsage(usage))
+		return;
+
+	for (const ModUsage &mod : usage) {
+		auto it = m_mod_usage.find(mod.mod);
+		if (it == m_mod_usage.end()) {
+			// Metric names only allow [a-zA-Z0-9_:]
+			std::string name = mod.mod;
+			for (char &c : name) {
+				if (!isalnum(c) && c != '_')
+					c = '_';
+			}
+			name = "minetest_core_mod_" + name;
+
+			ModUsageReport report;
+			report.time_counter = m_metrics_backend->addCounter(name + "_time",
+					"Time spent in Lua by mod " + mod.mod + " (in seconds)");
+			report.calls_counter = m_metrics_backend->addCounter(name + "_calls",
+					"Callbacks run for mod " + mod.mod);
+			report.alloc_counter = m_metrics_backend->addCounter(name + "_alloc",
+					"Bytes allocated by Lua for mod " + mod.mod);
+			it = m_mod_usage.emplace(mod.mod, report).first;
+		}
+
+		ModUsageReport &report = it->second;
+		report.time_counter->increment((mod.time_us - report.time_us) / 1000000.0);
+		report.calls_counter->increment(mod.calls - report.calls);
+		report.alloc_counter->increment(mod.alloc_bytes - report.alloc_bytes);
+		report.time_us = mod.time_us;
+		report.calls = mod.calls;
+		report.alloc_bytes = mod.alloc_bytes;
+	}
+
+	if (m_mod_usage_summary_interval <= 0.0f)
+		return;
+	m_mod_usage_summary_timer += elapsed;
+	if (m_mod_usage_summary_timer < m_mod_usage_summary_interval)
+		return;
+
+	// Log the mods that took the most time since the last summary
+	typedef std::pair<const std::string, ModUsageReport> ModUsageEntry;
+	std::vector<std::pair<u64, const ModUsageEntry *>> busiest;
+	for (const ModUsageEntry &it : m_mod_usage) {
+		u64 time_us = it.second.time_us - it.second.summary_time_us;
+		if (time_us > 0)
+			busiest.emplace_back(time_us, &it);
+	}
+	std::sort(busiest.begin(), busiest.end(),
+		[](const std::pair<u64, const ModUsageEntry *> &a,
+				const std::pair<u64, const ModUsageEntry *> &b) {
+			return a.first > b.first;
+		});
+
+	std::ostringstream os;
+	os << std::fixed << std::setprecision(1);
+	os << "Lua usage over the last " << m_mod_usage_summary_timer << " s:";
+	for (size_t i = 0; i < busiest.size() && i < 5; i++) {
+		const ModUsageReport &report = busiest[i].second->second;
+		os << (i > 0 ? "," : "") << " " << busiest[i].second->first << " "
+			<< busiest[i].first / 1000.0f / m_mod_usage_summary_timer << " ms/s ("
+			<< report.calls - report.summary_calls << " calls, "
+			<< (report.alloc_bytes - report.summary_alloc_bytes) / 1024 << " KiB)";
+	}
+	if (busiest.empty())
+		os << " none";
+	actionstream << os.str() << std::endl;
+
+	for (auto &it : m_mod_usage) {
+		ModUsageReport &report = it.second;
+		report.summary_time_us = report.time_us;
+		report.summary_calls = report.calls;
+		report.summary_alloc_bytes = report.alloc_bytes;
+	}
+	m_mod_usage_summary_timer = 0.0f;
+}
+
 void Server::Receive()
 {
 	NetworkPacket pkt;
@@ -1146,7 +1371,7 @@ void Server::ProcessData(NetworkPacket *pkt)
 	// Environment is locked first.
 	MutexAutoLock envlock(m_env_mutex);
 
-	ScopeProfiler sp(g_profiler, "Server: Process network packet (sum)");
+	PROFILE_ZONE("Server: Process network packet (sum)", SPT_ADD);
 	u32 peer_id = pkt->getPeerId();
 
 #if BAN_MANAGER
@@ -1235,6 +1460,14 @@ void Server::setTimeOfDay(u32 time)
 
 void Server::onMapEditEvent(const MapEditEvent &event)
 {
+	// Path searches must not use the old walkability of changed blocks
+	if (event.type != MEET_BLOCK_NODE_METADATA_CHANGED) {
+		if (event.type != MEET_OTHER)
+			m_pathfinder->invalidateBlock(getNodeBlockPos(event.p));
+		for (const v3s16 &blockpos : event.modified_blocks)
+			m_pathfinder->invalidateBlock(blockpos);
+	}
+
 	if (m_ignore_map_edit_events_area.contains(event.getArea()))
 		return;
 
@@ -1243,6 +1476,9 @@ void Server::onMapEditEvent(const MapEditEvent &event)
 
 void Server::SetBlocksNotSent(std::map<v3s16, MapBlock *>& block)
 {
+	for (const auto &it : block)
+		m_pathfinder->invalidateBlock(it.first);
+
 	std::vector<session_t> clients = m_clients.getClientIDs();
 	m_clients.lock();
 	// Set the modified blocks unsent for all the clients
@@ -1505,9 +1741,7 @@ static std::string compressPayload(const std::string &data, bool client_reads_zs
 void Server::SendInventory(PlayerSAO *sao, bool incremental)
 {
 	RemotePlayer *player = sao->getPlayer();
-
-	// Do not send new format to old clients
-	incremental &= player->protocol_version >= 38;
+	const session_t peer_id = sao->getPeerID();
 
 	UpdateCrafting(player);
 
@@ -1515,16 +1749,26 @@ void Server::SendInventory(PlayerSAO *sao, bool incremental)
 		Serialize it
 	*/
 
-	NetworkPacket pkt(TOCLIENT_INVENTORY, 0, sao->getPeerID());
+	// Newer clients only get the changed slots
+	const bool binary = m_clients.getMulticraftProtocolVersion(peer_id) > 7 ||
+			m_simple_singleplayer_mode;
 
 	std::ostringstream os(std::ios::binary);
-	sao->getInventory()->serialize(os, incremental);
+	if (binary) {
+		writeU8(os, 0); // Player inventory
+		sao->getInventory()->serializeBinary(os, incremental);
+	} else {
+		// Do not send new format to old clients
+		incremental &= player->protocol_version >= 38;
+		sao->getInventory()->serialize(os, incremental);
+	}
 	sao->getInventory()->setModified(false);
 	player->setModified(true);
 
-	const std::string s = compressPayload(os.str(),
-			m_clients.getMulticraftProtocolVersion(sao->getPeerID()) > 4 ||
-			m_simple_singleplayer_mode);
+	NetworkPacket pkt(binary ? TOCLIENT_INVENTORY_DELTA : TOCLIENT_INVENTORY,
+			0, peer_id);
+	const std::string s = compressPayload(os.str(), binary ||
+			m_clients.getMulticraftProtocolVersion(peer_id) > 4);
 	pkt.putRawString(s.c_str(), s.size());
 	Send(&pkt);
 }
@@ -2030,6 +2274,7 @@ void Server::SendActiveObjectRemoveAdd(RemoteClient *client, PlayerSAO *playersa
 
 		// Remove from known objects
 		client->m_known_objects.erase(id);
+		client->m_object_states.erase(id);
 
 		if (obj && obj->m_known_by_count > 0)
 			obj->m_known_by_count--;
@@ -2100,6 +2345,21 @@ void Server::SendActiveObjectMessages(session_t peer_id, const std::string &data
 			&pkt, reliable);
 }
 
+void Server::SendActiveObjectStates(session_t peer_id, const std::string &datas,
+		bool reliable)
+{
+	const std::string payload = compressPayload(datas,
+			m_clients.getMulticraftProtocolVersion(peer_id) > 4 ||
+			m_simple_singleplayer_mode);
+
+	NetworkPacket pkt(TOCLIENT_ACTIVE_OBJECT_STATES, payload.size(), peer_id);
+	pkt.putRawString(payload.c_str(), payload.size());
+
+	m_clients.send(pkt.getPeerId(),
+			reliable ? clientCommandFactoryTable[pkt.getCommand()].channel : 1,
+			&pkt, reliable);
+}
+
 void Server::SendCSMRestrictionFlags(session_t peer_id)
 {
 	NetworkPacket pkt(TOCLIENT_CSM_RESTRICTION_FLAGS,
@@ -2274,17 +2534,35 @@ void Server::fadeSound(s32 handle, float step, float gain)
 	}
 }
 
-void Server::sendRemoveNode(v3s16 p, std::unordered_set<u16> *far_players,
-		float far_d_nodes)
+void Server::sendNodeChange(const MapEditEvent &event,
+		std::unordered_set<u16> &far_players, float far_d_nodes)
 {
-	float maxd = far_d_nodes * BS;
-	v3f p_f = intToFloat(p, BS);
-	v3s16 block_pos = getNodeBlockPos(p);
+	const v3s16 p = event.p;
+	const float maxd = far_d_nodes * BS;
+	const v3f p_f = intToFloat(p, BS);
+	const v3s16 block_pos = getNodeBlockPos(p);
+	const bool remove = event.type == MEET_REMOVENODE;
+	const MapNode n = remove ? MapNode(CONTENT_AIR) : event.n;
+	const bool remove_metadata = event.type != MEET_SWAPNODE;
 
-	NetworkPacket pkt(TOCLIENT_REMOVENODE, 6);
+	NetworkPacket pkt(remove ? TOCLIENT_REMOVENODE : TOCLIENT_ADDNODE,
+			remove ? 6 : 6 + 2 + 1 + 1 + 1);
 	pkt << p;
+	if (!remove) {
+		pkt << n.param0 << n.param1 << n.param2
+				<< (u8) (remove_metadata ? 0 : 1);
+	}
+
+	// Only clients that have one of the blocks are affected by the change
+	std::vector<session_t> clients;
+	m_clients.getBlockSubscribers(block_pos, clients);
+	for (const v3s16 &modified_block : event.modified_blocks) {
+		if (modified_block != block_pos)
+			m_clients.getBlockSubscribers(modified_block, clients);
+	}
+	std::sort(clients.begin(), clients.end());
+	clients.erase(std::unique(clients.begin(), clients.end()), clients.end());
 
-	std::vector<session_t> clients = m_clients.getClientIDs();
 	m_clients.lock();
 
 	for (session_t client_id : clients) {
@@ -2298,10 +2576,19 @@ void Server::sendRemoveNode(v3s16 p, std::unordered_set<u16> *far_players,
 		// If player is far away, only set modified blocks not sent
 		if (!client->isBlockSent(block_pos) || (sao &&
 				sao->getBasePosition().getDistanceFrom(p_f) > maxd)) {
-			if (far_players)
-				far_players->emplace(client_id);
-			else
-				client->SetBlockNotSent(block_pos);
+			far_players.emplace(client_id);
+			continue;
+		}
+
+		if (m_clients.getMulticraftProtocolVersion(client_id) > 6 ||
+				m_simple_singleplayer_mode) {
+			// Sent together with the other changes of this step
+			auto it = client->m_node_changes.emplace(p,
+					std::make_pair(n, remove_metadata));
+			if (!it.second) {
+				it.first->second.first = n;
+				it.first->second.second |= remove_metadata;
+			}
 			continue;
 		}
 
@@ -2312,40 +2599,30 @@ void Server::sendRemoveNode(v3s16 p, std::unordered_set<u16> *far_players,
 	m_clients.unlock();
 }
 
-void Server::sendAddNode(v3s16 p, MapNode n, std::unordered_set<u16> *far_players,
-		float far_d_nodes, bool remove_metadata)
+void Server::SendNodeChanges()
 {
-	float maxd = far_d_nodes * BS;
-	v3f p_f = intToFloat(p, BS);
-	v3s16 block_pos = getNodeBlockPos(p);
-
-	NetworkPacket pkt(TOCLIENT_ADDNODE, 6 + 2 + 1 + 1 + 1);
-	pkt << p << n.param0 << n.param1 << n.param2
-			<< (u8) (remove_metadata ? 0 : 1);
-
-	std::vector<session_t> clients = m_clients.getClientIDs();
 	m_clients.lock();
 
-	for (session_t client_id : clients) {
-		RemoteClient *client = m_clients.lockedGetClientNoEx(client_id);
-		if (!client)
+	for (const auto &client_it : m_clients.getClientList()) {
+		RemoteClient *client = client_it.second;
+		if (client->m_node_changes.empty())
 			continue;
 
-		RemotePlayer *player = m_env->getPlayer(client_id);
-		PlayerSAO *sao = player ? player->getPlayerSAO() : nullptr;
-
-		// If player is far away, only set modified blocks not sent
-		if (!client->isBlockSent(block_pos) || (sao &&
-				sao->getBasePosition().getDistanceFrom(p_f) > maxd)) {
-			if (far_players)
-				far_players->emplace(client_id);
-			else
-				client->SetBlockNotSent(block_pos);
-			continue;
+		std::ostringstream os(std::ios::binary);
+		for (const auto &change : client->m_node_changes) {
+			const MapNode &n = change.second.first;
+			writeV3S16(os, change.first);
+			writeU16(os, n.param0);
+			writeU8(os, n.param1);
+			writeU8(os, n.param2);
+			writeU8(os, change.second.second ? 0 : 1);
 		}
+		client->m_node_changes.clear();
 
-		// Send as reliable
-		m_clients.send(client_id, 0, &pkt, true);
+		const std::string payload = compressPayload(os.str(), true);
+		NetworkPacket pkt(TOCLIENT_NODES_CHANGED, payload.size(), client->peer_id);
+		pkt.putRawString(payload.c_str(), payload.size());
+		m_clients.send(client->peer_id, 0, &pkt, true);
 	}
 
 	m_clients.unlock();
@@ -2354,12 +2631,23 @@ void Server::sendAddNode(v3s16 p, MapNode n, std::unordered_set<u16> *far_player
 void Server::sendMetadataChanged(const std::list<v3s16> &meta_updates, float far_d_nodes)
 {
 	float maxd = far_d_nodes * BS;
+
+	// Changed positions for each client that has their block
+	std::map<session_t, std::vector<v3s16>> client_updates;
+	std::vector<session_t> clients;
+	for (const v3s16 &pos : meta_updates) {
+		clients.clear();
+		m_clients.getBlockSubscribers(getNodeBlockPos(pos), clients);
+		for (session_t client_id : clients)
+			client_updates[client_id].push_back(pos);
+	}
+
 	NodeMetadataList meta_updates_list(false);
-	std::vector<session_t> clients = m_clients.getClientIDs();
 
 	m_clients.lock();
 
-	for (session_t i : clients) {
+	for (const auto &updates : client_updates) {
+		session_t i = updates.first;
 		RemoteClient *client = m_clients.lockedGetClientNoEx(i);
 		if (!client)
 			continue;
@@ -2367,7 +2655,7 @@ void Server::sendMetadataChanged(const std::list<v3s16> &meta_updates, float far
 		ServerActiveObject *player = m_env->getActiveObject(i);
 		v3f player_pos = player ? player->getBasePosition() : v3f();
 
-		for (const v3s16 &pos : meta_updates) {
+		for (const v3s16 &pos : updates.second) {
 			NodeMetadata *meta = m_env->getMap().getNodeMetadata(pos);
 
 			if (!meta)
@@ -2435,7 +2723,7 @@ void Server::SendBlocks(float dtime)
 	u32 total_sending = 0;
 
 	{
-		ScopeProfiler sp2(g_profiler, "Server::SendBlocks(): Collect list");
+		PROFILE_ZONE("Server::SendBlocks(): Collect list", SPT_ADD);
 
 		std::vector<session_t> clients = m_clients.getClientIDs();
 
@@ -2466,7 +2754,7 @@ void Server::SendBlocks(float dtime)
 	u32 max_blocks_to_send = m_env->getPlayerCount() *
 		g_settings->getU32("max_simultaneous_block_sends_per_client") + 1;
 
-	ScopeProfiler sp(g_profiler, "Server::SendBlocks(): Send to clients");
+	PROFILE_ZONE("Server::SendBlocks(): Send to clients", SPT_ADD);
 	Map &map = m_env->getMap();
 
 	for (const PrioritySortedBlockTransfer &block_to_send : queue) {
@@ -2559,7 +2847,15 @@ bool Server::addMediaFile(const std::string &filename,
 		*digest_to = sha1;
 
 	// Put in list
-	m_media[filename] = MediaInfo(filepath, sha1_base64);
+	MediaInfo &info = m_media[filename];
+	info = MediaInfo(filepath, sha1_base64);
+	info.size = filedata.size();
+	if (m_media_cache_size + filedata.size() <= m_media_cache_limit) {
+		info.data = std::make_shared<const std::string>(filedata);
+		m_media_cache_size += filedata.size();
+	}
+	if (m_media_server)
+		m_media_server->addFile(sha1, filepath, info.size, info.data);
 
 	if (filedata_to)
 		*filedata_to = std::move(filedata);
@@ -2570,6 +2866,9 @@ void Server::fillMediaCache()
 {
 	infostream << "Server: Calculating media file checksums" << std::endl;
 
+	m_media_cache_limit = (size_t)MYMAX(g_settings->getS32("media_cache_size"), 0)
+			* 1024 * 1024;
+
 	// Collect all media file paths
 	std::vector<std::string> paths;
 	// The paths are ordered in descending priority
@@ -2596,7 +2895,8 @@ void Server::fillMediaCache()
 		}
 	}
 
-	infostream << "Server: " << m_media.size() << " media files collected" << std::endl;
+	infostream << "Server: " << m_media.size() << " media files collected, "
+			<< m_media_cache_size / 1024 << " KiB kept in memory" << std::endl;
 }
 
 void Server::sendMediaAnnouncement(session_t peer_id, const std::string &lang_code)
@@ -2626,7 +2926,16 @@ void Server::sendMediaAnnouncement(session_t peer_id, const std::string &lang_co
 		pkt << i.first << i.second.sha1_digest;
 	}
 
-	pkt << g_settings->get("remote_media");
+	// The client puts in the address it is connected to for $server
+	std::string remote_media = g_settings->get("remote_media");
+	if (m_media_server) {
+		if (!trim(remote_media).empty())
+			remote_media.append(",");
+		remote_media.append("http://$server:" +
+				std::to_string(m_media_server->getPort()) + "/");
+	}
+
+	pkt << remote_media;
 	if (g_settings->getBool("disable_texture_packs"))
 		pkt << true;
 
@@ -2666,70 +2975,75 @@ void Server::sendRequestedMedia(session_t peer_id,
 	verbosestream<<"Server::sendRequestedMedia(): "
 			<<"Sending files to client"<<std::endl;
 
-	/* Read files */
+	/* Split files into bunches */
 
 	// Put 5kB in one bunch (this is not accurate)
 	u32 bytes_per_bunch = 5000;
 
-	std::vector< std::vector<SendableMedia> > file_bunches;
+	std::vector< std::vector<const std::string *> > file_bunches;
 	file_bunches.emplace_back();
 
 	u32 file_size_bunch_total = 0;
 
 	for (const std::string &name : tosend) {
-		if (m_media.find(name) == m_media.end()) {
+		auto it = m_media.find(name);
+		if (it == m_media.end()) {
 			errorstream<<"Server::sendRequestedMedia(): Client asked for "
 					<<"unknown file \""<<(name)<<"\""<<std::endl;
 			continue;
 		}
 
-		//TODO get path + name
-		std::string tpath = m_media[name].path;
-
-		// Read data
-		std::ifstream fis(tpath.c_str(), std::ios_base::binary);
-		if(!fis.good()){
-			errorstream<<"Server::sendRequestedMedia(): Could not open \""
-					<<tpath<<"\" for reading"<<std::endl;
-			continue;
-		}
-		std::ostringstream tmp_os(std::ios_base::binary);
-		bool bad = false;
-		for(;;) {
-			char buf[1024];
-			fis.read(buf, 1024);
-			std::streamsize len = fis.gcount();
-			tmp_os.write(buf, len);
-			file_size_bunch_total += len;
-			if(fis.eof())
-				break;
-			if(!fis.good()) {
-				bad = true;
-				break;
-			}
-		}
-		if (bad) {
-			errorstream<<"Server::sendRequestedMedia(): Failed to read \""
-					<<name<<"\""<<std::endl;
-			continue;
-		}
-		/*infostream<<"Server::sendRequestedMedia(): Loaded \""
-				<<tname<<"\""<<std::endl;*/
-		// Put in list
-		file_bunches[file_bunches.size()-1].emplace_back(name, tpath, tmp_os.str());
+		file_bunches.back().push_back(&it->first);
+		file_size_bunch_total += it->second.size;
 
 		// Start next bunch if got enough data
 		if(file_size_bunch_total >= bytes_per_bunch) {
 			file_bunches.emplace_back();
 			file_size_bunch_total = 0;
 		}
-
 	}
 
+	const bool compress = m_clients.getMulticraftProtocolVersion(peer_id) > 4 ||
+			m_simple_singleplayer_mode;
+
 	/* Create and send packets */
 
 	u16 num_bunches = file_bunches.size();
 	for (u16 i = 0; i < num_bunches; i++) {
+		std::string key = std::to_string(num_bunches) + "/" +
+				std::to_string(i) + (compress ? "z" : "");
+		for (const std::string *name : file_bunches[i])
+			key.append("\n").append(*name);
+
+		auto cached = m_media_bunches.find(key);
+		if (cached != m_media_bunches.end()) {
+			NetworkPacket pkt(TOCLIENT_MEDIA, cached->second.size(), peer_id);
+			pkt.putRawString(cached->second.c_str(), cached->second.size());
+			Send(&pkt);
+			continue;
+		}
+
+		/* Read files */
+
+		std::vector<SendableMedia> files;
+		bool complete = true;
+		for (const std::string *name : file_bunches[i]) {
+			const MediaInfo &info = m_media[*name];
+			if (info.data) {
+				files.emplace_back(*name, info.path, *info.data);
+				continue;
+			}
+
+			std::string data;
+			if (!fs::ReadFile(info.path, data)) {
+				errorstream<<"Server::sendRequestedMedia(): Failed to read \""
+						<<info.path<<"\""<<std::endl;
+				complete = false;
+				continue;
+			}
+			files.emplace_back(*name, info.path, std::move(data));
+		}
+
 		/*
 			u16 command
 			u16 total number of texture bunches
@@ -2744,18 +3058,36 @@ void Server::sendRequestedMedia(session_t peer_id,
 		*/
 
 		NetworkPacket pkt(TOCLIENT_MEDIA, 4 + 0, peer_id);
-		pkt << num_bunches << i << (u32) file_bunches[i].size();
+		pkt << num_bunches << i << (u32) files.size();
 
-		for (const SendableMedia &j : file_bunches[i]) {
+		for (const SendableMedia &j : files) {
 			pkt << j.name;
 			pkt.putLongString(j.data);
 		}
 
 		verbosestream << "Server::sendRequestedMedia(): bunch "
 				<< i << "/" << num_bunches
-				<< " files=" << file_bunches[i].size()
+				<< " files=" << files.size()
 				<< " size="  << pkt.getSize() << std::endl;
-		Send(&pkt);
+
+		// The client refuses to unpack more than 16 MiB, bigger bunches are
+		// sent as they are
+		std::string payload = compressPayload(std::string(pkt.getString(0), pkt.getSize()),
+				compress && pkt.getSize() < 16 * 1024 * 1024);
+
+		NetworkPacket packed(TOCLIENT_MEDIA, payload.size(), peer_id);
+		packed.putRawString(payload.c_str(), payload.size());
+		Send(&packed);
+
+		// Keep it for the next client, drop the old bunches when full
+		if (!complete || payload.size() > m_media_cache_limit)
+			continue;
+		if (m_media_bunches_size + payload.size() > m_media_cache_limit) {
+			m_media_bunches.clear();
+			m_media_bunches_size = 0;
+		}
+		m_media_bunches_size += payload.size();
+		m_media_bunches.emplace(std::move(key), std::move(payload));
 	}
 }
 
@@ -2776,30 +3108,79 @@ void Server::SendMinimapModes(session_t peer_id,
 	Send(&pkt);
 }
 
-void Server::sendDetachedInventory(Inventory *inventory, const std::string &name, session_t peer_id)
+void Server::sendDetachedInventory(Inventory *inventory, const std::string &name,
+		session_t peer_id, bool incremental)
 {
-	NetworkPacket pkt(TOCLIENT_DETACHED_INVENTORY, 0, peer_id);
-	pkt << name;
+	// Built on first use, clients get one of them. The deltas are indexed
+	// by whether they only contain the changed slots.
+	std::unique_ptr<NetworkPacket> delta_pkts[2], legacy_pkt;
 
-	if (!inventory) {
-		pkt << false; // Remove inventory
-	} else {
-		pkt << true; // Update inventory
+	auto send_to = [&] (session_t client_id, bool changes_only) {
+		if (m_clients.getMulticraftProtocolVersion(client_id) > 7 ||
+				m_simple_singleplayer_mode) {
+			std::unique_ptr<NetworkPacket> &delta_pkt = delta_pkts[changes_only];
+			if (!delta_pkt) {
+				std::ostringstream os(std::ios_base::binary);
+				writeU8(os, inventory ? 1 : 2); // Update or remove
+				os << serializeString16(name);
+				if (inventory)
+					inventory->serializeBinary(os, changes_only);
+
+				const std::string s = compressPayload(os.str(), true);
+				delta_pkt.reset(new NetworkPacket(TOCLIENT_INVENTORY_DELTA, s.size()));
+				delta_pkt->putRawString(s.c_str(), s.size());
+			}
+			Send(client_id, delta_pkt.get());
+			return;
+		}
 
-		// Serialization & NetworkPacket isn't a love story
-		std::ostringstream os(std::ios_base::binary);
-		inventory->serialize(os);
-		inventory->setModified(false);
+		if (!legacy_pkt) {
+			legacy_pkt.reset(new NetworkPacket(TOCLIENT_DETACHED_INVENTORY, 0));
+			*legacy_pkt << name;
+
+			if (!inventory) {
+				*legacy_pkt << false; // Remove inventory
+			} else {
+				*legacy_pkt << true; // Update inventory
 
-		const std::string &os_str = os.str();
-		pkt << static_cast<u16>(os_str.size()); // HACK: to keep compatibility with 5.0.0 clients
-		pkt.putRawString(os_str);
+				// Serialization & NetworkPacket isn't a love story
+				std::ostringstream os(std::ios_base::binary);
+				inventory->serialize(os);
+
+				const std::string &os_str = os.str();
+				*legacy_pkt << static_cast<u16>(os_str.size()); // HACK: to keep compatibility with 5.0.0 clients
+				legacy_pkt->putRawString(os_str);
+			}
+		}
+		Send(client_id, legacy_pkt.get());
+	};
+
+	if (peer_id != PEER_ID_INEXISTENT) {
+		// Others may still need the changes, keep them marked
+		send_to(peer_id, incremental);
+		return;
 	}
 
-	if (peer_id == PEER_ID_INEXISTENT)
-		m_clients.sendToAll(&pkt);
-	else
-		Send(&pkt);
+	// Deltas to others must not leak inventories of a player
+	InventoryLocation loc;
+	loc.setDetached(name);
+
+	m_clients.lock();
+	for (const auto &client_it : m_clients.getClientList()) {
+		RemoteClient *client = client_it.second;
+		if (client->net_proto_version == 0 ||
+				!m_inventory_mgr->checkDetachedInventoryAccess(loc, client->getName()))
+			continue;
+
+		// Clients that are still joining may lack the state that the
+		// changes are based on
+		send_to(client->peer_id, incremental &&
+				client->getState() >= CS_Active);
+	}
+	m_clients.unlock();
+
+	if (inventory)
+		inventory->setModified(false);
 }
 
 void Server::sendDetachedInventories(session_t peer_id, bool incremental)
@@ -2810,8 +3191,8 @@ void Server::sendDetachedInventories(session_t peer_id, bool incremental)
 		peer_name = getClient(peer_id, CS_Created)->getName();
 	}
 
-	auto send_cb = [this, peer_id](const std::string &name, Inventory *inv) {
-		sendDetachedInventory(inv, name, peer_id);
+	auto send_cb = [this, peer_id, incremental](const std::string &name, Inventory *inv) {
+		sendDetachedInventory(inv, name, peer_id, incremental);
 	};
 
 	m_inventory_mgr->sendDetachedInventories(peer_name, incremental, send_cb);
@@ -3888,11 +4269,130 @@ void Server::unregisterModStorage(const std::string &name)
 	std::unordered_map<std::string, ModMetadata *>::const_iterator it = m_mod_storages.find(name);
 	if (it != m_mod_storages.end()) {
 		// Save unconditionaly on unregistration
-		it->second->save(getModStoragePath());
+		m_mod_storage_database->beginSave();
+		it->second->save(m_mod_storage_database.get());
+		m_mod_storage_database->endSave();
 		m_mod_storages.erase(name);
 	}
 }
 
+ModMetadataDatabase *Server::openModStorageDatabase(const std::string &world_path)
+{
+	std::string world_mt_path = world_path + DIR_DELIM + "world.mt";
+	Settings world_mt;
+	if (!world_mt.readConfigFile(world_mt_path.c_str()))
+		throw BaseException("Cannot read world.mt!");
+
+	// mod_storage_backend is not set, assume it's the legacy file backend
+	std::string backend = "files";
+	if (world_mt.exists("mod_storage_backend")) {
+		backend = world_mt.get("mod_storage_backend");
+	} else {
+		world_mt.set("mod_storage_backend", backend);
+		if (!world_mt.updateConfigFile(world_mt_path.c_str())) {
+			errorstream << "Server::openModStorageDatabase(): "
+					<< "Failed to update world.mt!" << std::endl;
+		}
+	}
+
+#ifdef SERVER
+	if (backend == "files") {
+		warningstream << "/!\\ You are using old mod storage file backend. "
+				<< "This backend is deprecated and will be removed in a future release /!\\"
+				<< std::endl << "Switching to SQLite3 is advised, "
+				<< "use --migrate-mod-storage sqlite3." << std::endl;
+	}
+#endif
+
+	return openModStorageDatabase(backend, world_path, world_mt);
+}
+
+ModMetadataDatabase *Server::openModStorageDatabase(const std::string &backend,
+		const std::string &world_path, const Settings &world_mt)
+{
+#if USE_SQLITE
+	if (backend == "sqlite3")
+		return new ModMetadataDatabaseSQLite3(world_path);
+#endif
+
+#if USE_POSTGRESQL
+	if (backend == "postgresql") {
+		std::string connect_string;
+		world_mt.getNoEx("pgsql_mod_storage_connection", connect_string);
+		return new ModMetadataDatabasePostgreSQL(connect_string);
+	}
+#endif
+
+	if (backend == "files")
+		return new ModMetadataDatabaseFiles(world_path);
+
+	if (backend == "dummy")
+		return new Database_Dummy();
+
+	throw BaseException("Mod storage database backend " + backend + " not supported");
+}
+
+bool Server::migrateModStorageDatabase(const GameParams &game_params,
+		const Settings &cmd_args)
+{
+	std::string migrate_to = cmd_args.get("migrate-mod-storage");
+	Settings world_mt;
+	std::string world_mt_path = game_params.world_path + DIR_DELIM + "world.mt";
+	if (!world_mt.readConfigFile(world_mt_path.c_str())) {
+		errorstream << "Cannot read world.mt!" << std::endl;
+		return false;
+	}
+
+	std::string backend = "files";
+	if (world_mt.exists("mod_storage_backend"))
+		backend = world_mt.get("mod_storage_backend");
+	else
+		warningstream << "No mod_storage_backend found in world.mt, "
+				"assuming \"files\"." << std::endl;
+
+	if (backend == migrate_to) {
+		errorstream << "Cannot migrate: new backend is same"
+				<< " as the old one" << std::endl;
+		return false;
+	}
+
+	try {
+		const std::unique_ptr<ModMetadataDatabase> srcdb(openModStorageDatabase(
+				backend, game_params.world_path, world_mt));
+		const std::unique_ptr<ModMetadataDatabase> dstdb(openModStorageDatabase(
+				migrate_to, game_params.world_path, world_mt));
+
+		std::vector<std::string> mod_list;
+		srcdb->listMods(&mod_list);
+
+		dstdb->beginSave();
+		for (const std::string &modname : mod_list) {
+			actionstream << "Migrating mod storage of " << modname << std::endl;
+			StringMap meta;
+			bool success = srcdb->getModEntries(modname, &meta);
+			for (const auto &pair : meta)
+				success = success && dstdb->setModEntry(modname, pair.first, pair.second);
+			if (!success)
+				errorstream << "Failed to migrate " << modname << std::endl;
+		}
+		dstdb->endSave();
+
+		actionstream << "Successfully migrated the storage of " << mod_list.size()
+				<< " mods" << std::endl;
+		world_mt.set("mod_storage_backend", migrate_to);
+		if (!world_mt.updateConfigFile(world_mt_path.c_str()))
+			errorstream << "Failed to update world.mt!" << std::endl;
+		else
+			actionstream << "world.mt updated" << std::endl;
+
+	} catch (BaseException &e) {
+		errorstream << "An error occurred during migration: " << e.what()
+			    << std::endl;
+		return false;
+	}
+	return true;
+}
+
 void dedicated_server_loop(Server &server, bool &kill)
 {
 	verbosestream<<"dedicated_server_loop()"<<std::endl;
@@ -4019,6 +4519,10 @@ Translations *Server::getTranslationLanguage(const std::string &lang_code)
 	std::string suffix = "." + lang_code + ".tr";
 	for (const auto &i : m_media) {
 		if (str_ends_with(i.first, suffix)) {
+			if (i.second.data) {
+				translations->loadTranslation(*i.second.data);
+				continue;
+			}
 			std::string data;
 			if (fs::ReadFile(i.second.path, data)) {
 				translations->loadTranslation(data);
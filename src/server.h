@@ -73,6 +73,9 @@ struct StarParams;
 class ServerThread;
 class ServerModManager;
 class ServerInventoryManager;
+class ModMetadataDatabase;
+class MediaHTTPServer;
+class PathfinderService;
 
 enum ClientDeletionReason {
 	CDR_LEAVE,
@@ -84,6 +87,9 @@ struct MediaInfo
 {
 	std::string path;
 	std::string sha1_digest;
+	u32 size = 0;
+	// File contents, null if the file did not fit into the media cache
+	std::shared_ptr<const std::string> data;
 
 	MediaInfo(const std::string &path_="",
 	          const std::string &sha1_digest_=""):
@@ -265,7 +271,8 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 			std::string *filedata = nullptr, std::string *digest = nullptr);
 
 	ServerInventoryManager *getInventoryMgr() const { return m_inventory_mgr.get(); }
-	void sendDetachedInventory(Inventory *inventory, const std::string &name, session_t peer_id);
+	void sendDetachedInventory(Inventory *inventory, const std::string &name,
+			session_t peer_id, bool incremental = false);
 
 	// Envlock and conlock should be locked when using scriptapi
 	ServerScripting *getScriptIface(){ return m_script; }
@@ -285,6 +292,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	virtual u16 allocateUnknownNodeId(const std::string &name);
 	IRollbackManager *getRollbackManager() { return m_rollback; }
 	virtual EmergeManager *getEmergeManager() { return m_emerge; }
+	PathfinderService *getPathfinder() { return m_pathfinder.get(); }
 
 	IWritableItemDefManager* getWritableItemDefManager();
 	NodeDefManager* getWritableNodeDefManager();
@@ -293,9 +301,11 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	virtual const std::vector<ModSpec> &getMods() const;
 	virtual const ModSpec* getModSpec(const std::string &modname) const;
 	void getModNames(std::vector<std::string> &modlist);
-	std::string getBuiltinLuaPath();
+	static std::string getBuiltinLuaPath();
 	virtual std::string getWorldPath() const { return m_path_world; }
 	virtual std::string getModStoragePath() const;
+	virtual ModMetadataDatabase *getModStorageDatabase()
+	{ return m_mod_storage_database.get(); }
 
 	inline bool isSingleplayer()
 			{ return m_simple_singleplayer_mode; }
@@ -362,6 +372,14 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	virtual bool registerModStorage(ModMetadata *storage);
 	virtual void unregisterModStorage(const std::string &name);
 
+	static ModMetadataDatabase *openModStorageDatabase(const std::string &world_path);
+
+	static ModMetadataDatabase *openModStorageDatabase(const std::string &backend,
+			const std::string &world_path, const Settings &world_mt);
+
+	static bool migrateModStorageDatabase(const GameParams &game_params,
+			const Settings &cmd_args);
+
 	bool joinModChannel(const std::string &channel);
 	bool leaveModChannel(const std::string &channel);
 	bool sendModChannelMessage(const std::string &channel, const std::string &message, bool force = false);
@@ -383,6 +401,12 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// Environment mutex (envlock)
 	std::mutex m_env_mutex;
 
+	// Lua files registered for init of async env, pair of modname + path
+	std::vector<std::pair<std::string, std::string>> m_async_init_files;
+
+	// Lua files registered for init of the mapgen env, pair of modname + path
+	std::vector<std::pair<std::string, std::string>> m_mapgen_init_files;
+
 private:
 	friend class EmergeThread;
 	friend class RemoteClient;
@@ -454,11 +478,13 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 		far_d_nodes are ignored and their peer_ids are added to far_players
 	*/
 	// Envlock and conlock should be locked when calling these
-	void sendRemoveNode(v3s16 p, std::unordered_set<u16> *far_players = nullptr,
-			float far_d_nodes = 100);
-	void sendAddNode(v3s16 p, MapNode n,
-			std::unordered_set<u16> *far_players = nullptr,
-			float far_d_nodes = 100, bool remove_metadata = true);
+	// Sends an added, swapped or removed node to the clients that have one of
+	// the modified blocks and are closer than far_d_nodes, the others are
+	// added to far_players
+	void sendNodeChange(const MapEditEvent &event,
+			std::unordered_set<u16> &far_players, float far_d_nodes = 100);
+	// Sends the node changes collected by sendNodeChange() this step
+	void SendNodeChanges();
 
 	void sendMetadataChanged(const std::list<v3s16> &meta_updates,
 			float far_d_nodes = 100);
@@ -487,6 +513,8 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void SendActiveObjectRemoveAdd(RemoteClient *client, PlayerSAO *playersao);
 	void SendActiveObjectMessages(session_t peer_id, const std::string &datas,
 		bool reliable = true);
+	void SendActiveObjectStates(session_t peer_id, const std::string &datas,
+		bool reliable);
 	void SendCSMRestrictionFlags(session_t peer_id);
 
 	/*
@@ -525,6 +553,9 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 
 	void handlePeerChanges();
 
+	// Feeds the per-mod Lua usage to the metrics and the periodic summary
+	void reportModUsage(float dtime);
+
 	/*
 		Variables
 	*/
@@ -658,6 +689,22 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 
 	// media files known to server
 	std::unordered_map<std::string, MediaInfo> m_media;
+	/*
+		Payloads of TOCLIENT_MEDIA packets that were sent already. Clients
+		joining with an empty cache request the same files and get the
+		same bunches.
+		Key: bunch count, index, compression and the file names.
+	*/
+	std::unordered_map<std::string, std::string> m_media_bunches;
+	// Bytes held by the media cache, files and bunches are limited separately
+	size_t m_media_cache_limit = 0;
+	size_t m_media_cache_size = 0;
+	size_t m_media_bunches_size = 0;
+	// Serves the media over HTTP, if enabled
+	std::unique_ptr<MediaHTTPServer> m_media_server;
+
+	// Runs minetest.find_path_async searches
+	std::unique_ptr<PathfinderService> m_pathfinder;
 
 	/*
 		Sounds
@@ -667,6 +714,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	s32 nextSoundId();
 
 	std::unordered_map<std::string, ModMetadata *> m_mod_storages;
+	std::unique_ptr<ModMetadataDatabase> m_mod_storage_database;
 	float m_mod_storage_save_timer = 10.0f;
 
 	// CSM restrictions byteflag
@@ -691,6 +739,24 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	MetricCounterPtr m_aom_buffer_counter;
 	MetricCounterPtr m_packet_recv_counter;
 	MetricCounterPtr m_packet_recv_processed_counter;
+
+	// Per-mod Lua usage, totals as of the last report and the last summary
+	struct ModUsageReport {
+		MetricCounterPtr time_counter;
+		MetricCounterPtr calls_counter;
+		MetricCounterPtr alloc_counter;
+		u64 time_us = 0;
+		u64 calls = 0;
+		u64 alloc_bytes = 0;
+		u64 summary_time_us = 0;
+		u64 summary_calls = 0;
+		u64 summary_alloc_bytes = 0;
+	};
+	std::unordered_map<std::string, ModUsageReport> m_mod_usage;
+	float m_mod_usage_timer = 0.0f;
+	float m_mod_usage_summary_timer = 0.0f;
+	// Seconds between the summaries in the log, 0 for none
+	float m_mod_usage_summary_interval = 0.0f;
 };
 
 /*
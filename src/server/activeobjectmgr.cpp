@@ -21,10 +21,46 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapblock.h"
 #include "profiler.h"
 #include "activeobjectmgr.h"
+#include "util/thread.h"
 
 namespace server
 {
 
+// Objects are handed out to the threads in chunks of this many
+#define MOVEMENT_CHUNK_SIZE 16
+
+class PhysicsThread : public Thread
+{
+public:
+	PhysicsThread(ActiveObjectMgr *mgr) :
+		Thread("Physics"), m_mgr(mgr) {}
+
+protected:
+	void *run();
+
+private:
+	ActiveObjectMgr *m_mgr;
+};
+
+void *PhysicsThread::run()
+{
+	while (!stopRequested()) {
+		if (!m_mgr->m_movement_start.wait(100))
+			continue;
+		m_mgr->runMovementChunks();
+		m_mgr->m_movement_done.post();
+	}
+
+	return nullptr;
+}
+
+ActiveObjectMgr::ActiveObjectMgr() = default;
+
+ActiveObjectMgr::~ActiveObjectMgr()
+{
+	stopPhysicsThreads();
+}
+
 void ActiveObjectMgr::clear(const std::function<bool(ServerActiveObject *, u16)> &cb)
 {
 	std::vector<u16> objects_to_remove;
@@ -50,6 +86,56 @@ void ActiveObjectMgr::step(
 	}
 }
 
+void ActiveObjectMgr::stepMovement(float dtime)
+{
+	PROFILE_ZONE("ActiveObjectMgr: step movement", SPT_AVG);
+
+	m_movement_objects.clear();
+	for (auto &ao_it : m_active_objects) {
+		if (!ao_it.second->isGone())
+			m_movement_objects.push_back(ao_it.second);
+	}
+	m_movement_dtime = dtime;
+	m_movement_next = 0;
+
+	// Not worth waking threads that would find nothing left to do
+	size_t num_threads = MYMIN(m_physics_threads.size(),
+			m_movement_objects.size() / MOVEMENT_CHUNK_SIZE);
+	if (num_threads > 0)
+		m_movement_start.post(num_threads);
+	runMovementChunks();
+	for (size_t i = 0; i < num_threads; i++)
+		m_movement_done.wait();
+}
+
+void ActiveObjectMgr::runMovementChunks()
+{
+	const size_t count = m_movement_objects.size();
+	size_t begin;
+	while ((begin = m_movement_next.fetch_add(MOVEMENT_CHUNK_SIZE)) < count) {
+		size_t end = MYMIN(begin + MOVEMENT_CHUNK_SIZE, count);
+		for (size_t i = begin; i < end; i++)
+			m_movement_objects[i]->stepMovement(m_movement_dtime);
+	}
+}
+
+void ActiveObjectMgr::startPhysicsThreads(unsigned int num_threads)
+{
+	for (unsigned int i = 0; i < num_threads; i++) {
+		m_physics_threads.emplace_back(new PhysicsThread(this));
+		m_physics_threads.back()->start();
+	}
+}
+
+void ActiveObjectMgr::stopPhysicsThreads()
+{
+	for (std::unique_ptr<PhysicsThread> &thread : m_physics_threads)
+		thread->stop();
+	for (std::unique_ptr<PhysicsThread> &thread : m_physics_threads)
+		thread->wait();
+	m_physics_threads.clear();
+}
+
 // clang-format off
 bool ActiveObjectMgr::registerObject(ServerActiveObject *obj)
 {
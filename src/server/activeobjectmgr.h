@@ -19,19 +19,39 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include "IrrCompileConfig.h"
+
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <vector>
 #include "../activeobjectmgr.h"
 #include "serveractiveobject.h"
+#ifdef _IRR_COMPILE_WITH_SDL_DEVICE_
+#include "threading/sdl_semaphore.h"
+#else
+#include "threading/semaphore.h"
+#endif
 
 namespace server
 {
+class PhysicsThread;
+
 class ActiveObjectMgr : public ::ActiveObjectMgr<ServerActiveObject>
 {
 public:
+	ActiveObjectMgr();
+	~ActiveObjectMgr();
+
 	void clear(const std::function<bool(ServerActiveObject *, u16)> &cb);
 	void step(float dtime,
 			const std::function<void(ServerActiveObject *)> &f) override;
+
+	// Runs ServerActiveObject::stepMovement of all objects, spread over the
+	// physics threads and the calling one
+	void stepMovement(float dtime);
+	void startPhysicsThreads(unsigned int num_threads);
+	void stopPhysicsThreads();
 	bool registerObject(ServerActiveObject *obj) override;
 	void removeObject(u16 id) override;
 
@@ -45,5 +65,20 @@ class ActiveObjectMgr : public ::ActiveObjectMgr<ServerActiveObject>
 	void getAddedActiveObjectsAroundPos(const v3f &player_pos, f32 radius,
 			f32 player_radius, std::set<u16> &current_objects,
 			std::queue<u16> &added_objects);
+
+private:
+	friend class PhysicsThread;
+
+	// Steps the movement of objects until none are left
+	void runMovementChunks();
+
+	std::vector<std::unique_ptr<PhysicsThread>> m_physics_threads;
+	Semaphore m_movement_start;
+	Semaphore m_movement_done;
+
+	// Objects of the current stepMovement call
+	std::vector<ServerActiveObject *> m_movement_objects;
+	std::atomic<size_t> m_movement_next{0};
+	float m_movement_dtime = 0.0f;
 };
 } // namespace server
@@ -156,23 +156,23 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 		m_acceleration = v3f(0,0,0);
 	} else {
 		if(m_prop.physical){
-			aabb3f box = m_prop.collisionbox;
-			box.MinEdge *= BS;
-			box.MaxEdge *= BS;
-			f32 pos_max_d = BS*0.25; // Distance per iteration
-			v3f p_pos = m_base_position;
-			v3f p_velocity = m_velocity;
-			v3f p_acceleration = m_acceleration;
-			moveresult = collisionMoveSimple(m_env, m_env->getGameDef(),
-					pos_max_d, box, m_prop.stepheight, dtime,
-					&p_pos, &p_velocity, p_acceleration,
-					this, m_prop.collideWithObjects);
+			PendingMovement &pending = m_pending_movement;
+			if (pending.valid && pending.dtime == dtime &&
+					pending.start_position == m_base_position &&
+					pending.start_velocity == m_velocity &&
+					pending.acceleration == m_acceleration &&
+					pending.collisionbox == m_prop.collisionbox &&
+					pending.stepheight == m_prop.stepheight &&
+					pending.collide_with_objects == m_prop.collideWithObjects &&
+					pending.map_generation ==
+						m_env->getMap().getCollisionCache().getGeneration()) {
+				m_base_position = pending.position;
+				m_velocity = pending.velocity;
+				moveresult = std::move(pending.result);
+			} else {
+				moveresult = move(dtime, m_base_position, m_velocity);
+			}
 			moveresult_p = &moveresult;
-
-			// Apply results
-			m_base_position = p_pos;
-			m_velocity = p_velocity;
-			m_acceleration = p_acceleration;
 		} else {
 			m_base_position += dtime * m_velocity + 0.5 * dtime
 					* dtime * m_acceleration;
@@ -197,6 +197,8 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 		}
 	}
 
+	m_pending_movement.valid = false;
+
 	if(m_registered) {
 		m_env->getScriptIface()->luaentity_Step(m_id, dtime, moveresult_p);
 	}
@@ -228,6 +230,41 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 	sendOutdatedData();
 }
 
+void LuaEntitySAO::stepMovement(float dtime)
+{
+	// Attached objects follow their parent, which may not have moved yet
+	m_pending_movement.valid = false;
+	if (!m_prop.physical || m_attachment_parent_id)
+		return;
+
+	PendingMovement &pending = m_pending_movement;
+	pending.dtime = dtime;
+	pending.start_position = m_base_position;
+	pending.start_velocity = m_velocity;
+	pending.acceleration = m_acceleration;
+	pending.collisionbox = m_prop.collisionbox;
+	pending.stepheight = m_prop.stepheight;
+	pending.collide_with_objects = m_prop.collideWithObjects;
+	pending.map_generation = m_env->getMap().getCollisionCache().getGeneration();
+
+	pending.position = m_base_position;
+	pending.velocity = m_velocity;
+	pending.result = move(dtime, pending.position, pending.velocity);
+	pending.valid = true;
+}
+
+collisionMoveResult LuaEntitySAO::move(float dtime, v3f &pos, v3f &velocity)
+{
+	aabb3f box = m_prop.collisionbox;
+	box.MinEdge *= BS;
+	box.MaxEdge *= BS;
+	f32 pos_max_d = BS*0.25; // Distance per iteration
+	return collisionMoveSimple(m_env, m_env->getGameDef(),
+			pos_max_d, box, m_prop.stepheight, dtime,
+			&pos, &velocity, m_acceleration,
+			this, m_prop.collideWithObjects);
+}
+
 std::string LuaEntitySAO::getClientInitializationData(u16 protocol_version)
 {
 	std::ostringstream os(std::ios::binary);
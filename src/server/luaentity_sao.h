@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include "collision.h"
 #include "unit_sao.h"
 
 class LuaEntitySAO : public UnitSAO
@@ -40,6 +41,7 @@ class LuaEntitySAO : public UnitSAO
 	ActiveObjectType getSendType() const { return ACTIVEOBJECT_TYPE_GENERIC; }
 	virtual void addedToEnvironment(u32 dtime_s);
 	void step(float dtime, bool send_recommended);
+	void stepMovement(float dtime);
 	std::string getClientInitializationData(u16 protocol_version);
 	bool isStaticAllowed() const { return m_prop.static_save; }
 	bool shouldUnload() const { return true; }
@@ -78,6 +80,7 @@ class LuaEntitySAO : public UnitSAO
 
 private:
 	std::string getPropertyPacket();
+	collisionMoveResult move(float dtime, v3f &pos, v3f &velocity);
 	void sendPosition(bool do_interpolate, bool is_movement_end);
 	std::string generateSetTextureModCommand() const;
 	static std::string generateSetSpriteCommand(v2s16 p, u16 num_frames,
@@ -90,6 +93,25 @@ class LuaEntitySAO : public UnitSAO
 	v3f m_velocity;
 	v3f m_acceleration;
 
+	// Result of stepMovement, dropped by step() if anything it was
+	// based on changed in the meantime
+	struct PendingMovement
+	{
+		bool valid = false;
+		float dtime;
+		v3f start_position;
+		v3f start_velocity;
+		v3f acceleration;
+		aabb3f collisionbox;
+		f32 stepheight;
+		bool collide_with_objects;
+		u32 map_generation;
+
+		v3f position;
+		v3f velocity;
+		collisionMoveResult result;
+	} m_pending_movement;
+
 	v3f m_last_sent_position;
 	v3f m_last_sent_velocity;
 	v3f m_last_sent_rotation;
@@ -113,6 +113,13 @@ class ServerActiveObject : public ActiveObject
 	*/
 	virtual void step(float dtime, bool send_recommended){}
 
+	/*
+		Called for all objects before any of them is stepped, possibly on
+		several threads at once. It may only read the map and other
+		objects; results are kept by the object until step() uses them.
+	*/
+	virtual void stepMovement(float dtime){}
+
 	/*
 		The return value of this is passed to the client-side object
 		when it is created
@@ -469,10 +469,15 @@ ServerEnvironment::ServerEnvironment(ServerMap *map,
 
 	m_player_database = openPlayerDatabase(player_backend_name, path_world, conf);
 	m_auth_database = openAuthDatabase(auth_backend_name, path_world, conf);
+
+	m_ao_manager.startPhysicsThreads(
+			MYMIN(g_settings->getU16("num_physics_threads"), 16));
 }
 
 ServerEnvironment::~ServerEnvironment()
 {
+	m_ao_manager.stopPhysicsThreads();
+
 	// Clear active block list.
 	// This makes the next one delete all active objects.
 	m_active_blocks.clear();
@@ -756,6 +761,13 @@ struct ActiveABM
 	bool check_required_neighbors; // false if required_neighbors is known to be empty
 	s16 min_y;
 	s16 max_y;
+	int batch = -1; // index into ABMHandler::m_batches, -1 if not batched
+};
+
+struct ABMBatch
+{
+	ActiveBlockModifier *abm;
+	std::vector<std::pair<v3s16, MapNode>> nodes;
 };
 
 class ABMHandler
@@ -763,6 +775,7 @@ class ABMHandler
 private:
 	ServerEnvironment *m_env;
 	std::vector<std::vector<ActiveABM> *> m_aabms;
+	std::vector<ABMBatch> m_batches;
 public:
 	ABMHandler(std::vector<ABMWithState> &abms,
 		float dtime_s, ServerEnvironment *env,
@@ -812,6 +825,11 @@ class ABMHandler
 			}
 			aabm.check_required_neighbors = !required_neighbors_s.empty();
 
+			if (abm->getBatched()) {
+				aabm.batch = m_batches.size();
+				m_batches.push_back({abm, {}});
+			}
+
 			// Trigger contents
 			const std::vector<std::string> &contents_s = abm->getTriggerContents();
 			for (const std::string &content_s : contents_s) {
@@ -950,6 +968,11 @@ class ABMHandler
 				neighbor_found:
 
 				abms_run++;
+				// Batched ABMs are run once the whole block was scanned
+				if (aabm.batch >= 0) {
+					m_batches[aabm.batch].nodes.emplace_back(p, n);
+					continue;
+				}
 				// Call all the trigger variations
 				aabm.abm->trigger(m_env, p, n);
 				aabm.abm->trigger(m_env, p, n,
@@ -962,6 +985,21 @@ class ABMHandler
 				}
 			}
 		}
+
+		for (ABMBatch &batch : m_batches) {
+			if (batch.nodes.empty())
+				continue;
+
+			batch.abm->triggerBatch(m_env, batch.nodes,
+				active_object_count, active_object_count_wider);
+			batch.nodes.clear();
+
+			// Count surrounding objects again if the abms added any
+			if(m_env->m_added_objects > 0) {
+				active_object_count = countObjects(block, map, active_object_count_wider);
+				m_env->m_added_objects = 0;
+			}
+		}
 		block->contents_cached = !block->do_not_cache_contents;
 	}
 };
@@ -1314,7 +1352,7 @@ void ServerEnvironment::clearObjects(ClearObjectsMode mode)
 
 void ServerEnvironment::step(float dtime)
 {
-	ScopeProfiler sp2(g_profiler, "ServerEnv::step()", SPT_AVG);
+	PROFILE_ZONE("ServerEnv::step()", SPT_AVG);
 	/* Step time of day */
 	stepTimeOfDay(dtime);
 
@@ -1339,7 +1377,7 @@ void ServerEnvironment::step(float dtime)
 		Handle players
 	*/
 	{
-		ScopeProfiler sp(g_profiler, "ServerEnv: move players", SPT_AVG);
+		PROFILE_ZONE("ServerEnv: move players", SPT_AVG);
 		for (RemotePlayer *player : m_players) {
 			// Ignore disconnected players
 			if (player->getPeerId() == PEER_ID_INEXISTENT)
@@ -1354,7 +1392,7 @@ void ServerEnvironment::step(float dtime)
 		Manage active block list
 	*/
 	if (m_active_blocks_management_interval.step(dtime, m_cache_active_block_mgmt_interval)) {
-		ScopeProfiler sp(g_profiler, "ServerEnv: update active blocks", SPT_AVG);
+		PROFILE_ZONE("ServerEnv: update active blocks", SPT_AVG);
 		/*
 			Get player block positions
 		*/
@@ -1398,6 +1436,9 @@ void ServerEnvironment::step(float dtime)
 
 			// Set current time as timestamp (and let it set ChangedFlag)
 			block->setTimestamp(m_game_time);
+
+			// Node timers stand still until the block is activated again
+			block->m_node_timers.detach();
 		}
 
 		/*
@@ -1420,7 +1461,7 @@ void ServerEnvironment::step(float dtime)
 		Mess around in active blocks
 	*/
 	if (m_active_blocks_nodemetadata_interval.step(dtime, m_cache_nodetimer_interval)) {
-		ScopeProfiler sp(g_profiler, "ServerEnv: Run node timers", SPT_AVG);
+		PROFILE_ZONE("ServerEnv: Run node timers", SPT_AVG);
 
 		float dtime = m_cache_nodetimer_interval;
 
@@ -1440,25 +1481,32 @@ void ServerEnvironment::step(float dtime)
 				block->raiseModified(MOD_STATE_WRITE_AT_UNLOAD,
 					MOD_REASON_BLOCK_EXPIRED);
 
-			// Run node timers
-			std::vector<NodeTimer> elapsed_timers = block->m_node_timers.step(dtime);
-			if (!elapsed_timers.empty()) {
-				MapNode n;
-				v3s16 p2;
-				for (const NodeTimer &elapsed_timer: elapsed_timers) {
-					n = block->getNodeNoEx(elapsed_timer.position);
-					p2 = elapsed_timer.position + block->getPosRelative();
-					if (m_script->node_on_timer(p2, n, elapsed_timer.elapsed)) {
-						block->setNodeTimer(NodeTimer(
-							elapsed_timer.timeout, 0, elapsed_timer.position));
-					}
-				}
+			// Blocks that just became active hand their timers to the wheel
+			if (!block->m_node_timers.isAttached())
+				block->m_node_timers.attach(&m_node_timer_wheel, p);
+		}
+
+		// Run node timers
+		std::vector<NodeTimerWheel::Expired> expired;
+		m_node_timer_wheel.advance(dtime, expired);
+		for (const NodeTimerWheel::Expired &e : expired) {
+			MapBlock *block = m_map->getBlockNoCreateNoEx(e.blockpos);
+			NodeTimer elapsed_timer;
+			if (!block || !block->m_node_timers.takeExpired(e.index, e.id,
+					elapsed_timer))
+				continue;
+
+			MapNode n = block->getNodeNoEx(elapsed_timer.position);
+			v3s16 p2 = elapsed_timer.position + block->getPosRelative();
+			if (m_script->node_on_timer(p2, n, elapsed_timer.elapsed)) {
+				block->setNodeTimer(NodeTimer(
+					elapsed_timer.timeout, 0, elapsed_timer.position));
 			}
 		}
 	}
 
 	if (m_active_block_modifier_interval.step(dtime, m_cache_abm_interval)) {
-		ScopeProfiler sp(g_profiler, "SEnv: modify in blocks avg per interval", SPT_AVG);
+		PROFILE_ZONE("SEnv: modify in blocks avg per interval", SPT_AVG);
 		TimeTaker timer("modify in active blocks per interval");
 
 		// Initialize handling of ActiveBlockModifiers
@@ -1517,7 +1565,10 @@ void ServerEnvironment::step(float dtime)
 		Step active objects
 	*/
 	{
-		ScopeProfiler sp(g_profiler, "ServerEnv: Run SAO::step()", SPT_AVG);
+		PROFILE_ZONE("ServerEnv: Run SAO::step()", SPT_AVG);
+
+		m_map->getCollisionCache().step();
+		m_ao_manager.stepMovement(dtime);
 
 		// This helps the objects to send data at the same time
 		bool send_recommended = false;
@@ -1810,7 +1861,7 @@ u16 ServerEnvironment::addActiveObjectRaw(ServerActiveObject *object,
 */
 void ServerEnvironment::removeRemovedObjects()
 {
-	ScopeProfiler sp(g_profiler, "ServerEnvironment::removeRemovedObjects()", SPT_AVG);
+	PROFILE_ZONE("ServerEnvironment::removeRemovedObjects()", SPT_AVG);
 
 	auto clear_cb = [this] (ServerActiveObject *obj, u16 id) {
 		// This shouldn't happen but check it
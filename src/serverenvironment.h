@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "activeobject.h"
 #include "environment.h"
 #include "mapnode.h"
+#include "nodetimer.h"
 #include "settings.h"
 #include "server/activeobjectmgr.h"
 #include "util/numeric.h"
@@ -76,6 +77,13 @@ class ActiveBlockModifier
 	virtual void trigger(ServerEnvironment *env, v3s16 p, MapNode n){};
 	virtual void trigger(ServerEnvironment *env, v3s16 p, MapNode n,
 		u32 active_object_count, u32 active_object_count_wider){};
+	// Whether to call triggerBatch() instead of trigger()
+	virtual bool getBatched() { return false; }
+	// This is called once per block with all nodes that would have been
+	// passed to trigger()
+	virtual void triggerBatch(ServerEnvironment *env,
+		const std::vector<std::pair<v3s16, MapNode>> &nodes,
+		u32 active_object_count, u32 active_object_count_wider){};
 };
 
 struct ABMWithState
@@ -472,6 +480,8 @@ class ServerEnvironment : public Environment
 	IntervalLimiter m_active_blocks_management_interval;
 	IntervalLimiter m_active_block_modifier_interval;
 	IntervalLimiter m_active_blocks_nodemetadata_interval;
+	// Node timers of the active blocks
+	NodeTimerWheel m_node_timer_wheel;
 	// Whether the variables below have been read from file yet
 	bool m_meta_loaded = false;
 	// Time from the beginning of the game in seconds.
@@ -490,6 +490,10 @@ fake_function() {
 	gettext("Enable to disallow old clients from connecting.\nOlder clients are compatible in the sense that they will not crash when connecting\nto new servers, but they may not support all new features that you are expecting.");
 	gettext("Remote media");
 	gettext("Specifies URL from which client fetches media instead of using UDP.\n$filename should be accessible from $remote_media$filename via cURL\n(obviously, remote_media should end with a slash).\nFiles that are not present will be fetched the usual way.");
+	gettext("Media cache size");
+	gettext("Memory in MiB for keeping media files sent to clients, so they don't\nhave to be read from disk for every client that joins.\nAs much again is used for packets prepared for sending them.\n0 disables the cache.");
+	gettext("Media server port");
+	gettext("Port on which the server offers its media over HTTP, in addition to UDP.\nClients download it from there like from a remote_media server, which\nis much faster. The TCP port has to be reachable from outside.\n0 disables the built-in media server.");
 	gettext("IPv6 server");
 	gettext("Enable/disable running an IPv6 server.\nIgnored if bind_address is set.\nNeeds enable_ipv6 to be enabled.");
 	gettext("Advanced");
@@ -499,6 +503,8 @@ fake_function() {
 	gettext("To reduce lag, block transfers are slowed down when a player is building something.\nThis determines how long they are slowed down after placing or removing a node.");
 	gettext("Max. packets per iteration");
 	gettext("Maximum number of packets sent per send step, if you have a slow connection\ntry reducing it, but don't reduce it to a number below double of targeted\nclient number.");
+	gettext("Congestion control");
+	gettext("How the number of unacknowledged reliable packets is adjusted.\nbbr: follow the measured bandwidth and round trip time (like TCP BBR),\nrandom loss does not slow it down.\ncubic: cut on loss, then probe back along a cubic curve (like TCP CUBIC).\nclassic: grow or shrink once a second depending on the loss ratio.");
 	gettext("Map Compression Level for Network Transfer");
 	gettext("ZLib compression level to use when sending mapblocks to the client.\n-1 - Zlib's default compression level\n0 - no compresson, fastest\n9 - best compression, slowest\n(levels 1-3 use Zlib's \"fast\" method, 4-9 use the normal method)");
 	gettext("Game");
@@ -600,6 +606,12 @@ fake_function() {
 	gettext("Advanced");
 	gettext("Deprecated Lua API handling");
 	gettext("Handling for deprecated Lua API calls:\n-    none: Do not log deprecated calls\n-    log: mimic and log backtrace of deprecated call (default).\n-    error: abort on usage of deprecated call (suggested for mod developers).");
+	gettext("Number of async threads");
+	gettext("Number of threads used to run jobs queued by mods with core.handle_async.\nValue 0:\n-    Automatic selection. The number of async threads will be\n-    'number of processors - 2', with a lower limit of 1.\nAny other value:\n-    Specifies the number of async threads, with a lower limit of 1.");
+	gettext("Number of pathfinder threads");
+	gettext("Number of threads searching paths for core.find_path_async.");
+	gettext("Number of physics threads");
+	gettext("Number of threads moving physical entities, besides the server thread.\nValue 0 moves them on the server thread only.");
 	gettext("Max. clearobjects extra blocks");
 	gettext("Number of extra blocks that can be loaded by /clearobjects at once.\nThis is a trade-off between sqlite transaction overhead and\nmemory consumption (4096=100MB, as a rule of thumb).");
 	gettext("Unload unused server data");
@@ -651,6 +663,10 @@ fake_function() {
 	gettext("The default format in which profiles are being saved,\nwhen calling `/profiler save [format]` without format.");
 	gettext("Report path");
 	gettext("The file path relative to your worldpath in which profiles will be saved to.");
+	gettext("Per-mod accounting");
+	gettext("Attribute the time spent in Lua, the callbacks run and the memory\nallocated by Lua to the mods. Shown by the /modusage command and exported\nas metrics. Cheap enough to leave enabled.");
+	gettext("Per-mod accounting log interval");
+	gettext("Log a summary of the mods that took the most time in Lua in regular\nintervals (in seconds). 0 = disable.");
 	gettext("Instrumentation");
 	gettext("Entity methods");
 	gettext("Instrument the methods of entities on registration.");
@@ -693,6 +709,8 @@ fake_function() {
 	gettext("Replaces the default main menu with a custom one.");
 	gettext("Engine profiling data print interval");
 	gettext("Print the engine's profiling data in regular intervals (in seconds).\n0 = disable. Useful for developers.");
+	gettext("Engine profiler trace file");
+	gettext("Record the times of the engine's profiler zones to this file, in the\nChrome trace format (open with chrome://tracing or ui.perfetto.dev).\nEmpty = disable. Useful for developers.");
 	gettext("Mapgen");
 	gettext("Mapgen name");
 	gettext("Name of map generator to be used when creating a new world.\nCreating a world in the main menu will override this.\nCurrent mapgens in a highly unstable state:\n-    The optional floatlands of v7 (disabled by default).");
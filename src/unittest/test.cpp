@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "gamedef.h"
 #include "modchannels.h"
 #include "content/mods.h"
+#include "database/database-dummy.h"
 #include "util/numeric.h"
 #include "porting.h"
 
@@ -69,6 +70,7 @@ class TestGameDef : public IGameDef {
 	}
 	virtual const ModSpec* getModSpec(const std::string &modname) const { return NULL; }
 	virtual std::string getModStoragePath() const { return "."; }
+	virtual ModMetadataDatabase *getModStorageDatabase() { return &m_mod_storage_database; }
 	virtual bool registerModStorage(ModMetadata *meta) { return true; }
 	virtual void unregisterModStorage(const std::string &name) {}
 	bool joinModChannel(const std::string &channel);
@@ -90,6 +92,7 @@ class TestGameDef : public IGameDef {
 	IRollbackManager *m_rollbackmgr = nullptr;
 	EmergeManager *m_emergemgr = nullptr;
 	std::unique_ptr<ModChannelMgr> m_modchannel_mgr;
+	Database_Dummy m_mod_storage_database;
 };
 
 
@@ -20,6 +20,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include "activeobject.h"
+#include "activeobjectstate.h"
+#include <sstream>
 
 class TestActiveObject : public TestBase
 {
@@ -30,6 +32,8 @@ class TestActiveObject : public TestBase
 	void runTests(IGameDef *gamedef);
 
 	void testAOAttributes();
+	void testObjectState();
+	void testObjectStateBaseline();
 };
 
 static TestActiveObject g_test_instance;
@@ -37,6 +41,8 @@ static TestActiveObject g_test_instance;
 void TestActiveObject::runTests(IGameDef *gamedef)
 {
 	TEST(testAOAttributes);
+	TEST(testObjectState);
+	TEST(testObjectStateBaseline);
 }
 
 class TestAO : public ActiveObject
@@ -58,3 +64,107 @@ void TestActiveObject::testAOAttributes()
 	ao.setId(558);
 	UASSERT(ao.getId() == 558);
 }
+
+static ObjectPosition make_position(v3f position)
+{
+	ObjectPosition pos;
+	pos.position = position;
+	pos.velocity = v3f(1.0f, -2.0f, 0.5f) * BS;
+	pos.rotation = v3f(0.0f, 90.0f, 0.0f);
+	pos.do_interpolate = true;
+	pos.update_interval = 0.2f;
+	return pos;
+}
+
+void TestActiveObject::testObjectState()
+{
+	ObjectPosition pos = make_position(v3f(100.0f, 20.0f, -3000.0f) * BS);
+
+	// AO_CMD_UPDATE_POSITION roundtrip
+	ObjectPosition cmd;
+	UASSERT(cmd.deSerializeCommand(pos.serializeCommand()));
+	UASSERT(cmd.position == pos.position && cmd.update_interval == pos.update_interval);
+
+	ObjectSyncState server;
+	std::unordered_map<u16, ObjectSyncState> client;
+	std::string reliable, unreliable;
+	u16 id;
+	ObjectPosition result;
+
+	// The first update is a baseline
+	server.write(7, pos, reliable, unreliable);
+	UASSERT(unreliable.empty());
+	std::istringstream is(reliable, std::ios::binary);
+	UASSERT(readObjectState(is, client, id, result));
+	UASSERT(id == 7 && result.position == pos.position);
+	UASSERT(result.rotation == pos.rotation && result.do_interpolate);
+
+	// A small move is a delta that leaves out the unchanged fields
+	ObjectPosition moved = pos;
+	moved.position += v3f(0.3f, 0.0f, -1.7f) * BS;
+	reliable.clear();
+	server.write(7, moved, reliable, unreliable);
+	UASSERT(reliable.empty());
+	UASSERTEQ(size_t, unreliable.size(), 4 + 6 + 1);
+
+	is.str(unreliable);
+	is.clear();
+	UASSERT(readObjectState(is, client, id, result));
+	UASSERT(id == 7);
+	UASSERT(result.position.getDistanceFrom(moved.position) <= AOS_POSITION_STEP);
+	UASSERT(result.velocity == pos.velocity);
+	UASSERT(std::fabs(result.update_interval - 0.2f) < 0.001f);
+	UASSERT(is.peek() == EOF);
+
+	// Changed rotation is sent
+	moved.rotation.Y = 180.0f;
+	unreliable.clear();
+	server.write(7, moved, reliable, unreliable);
+	is.str(unreliable);
+	is.clear();
+	UASSERT(readObjectState(is, client, id, result));
+	UASSERT(std::fabs(result.rotation.Y - 180.0f) < 0.01f);
+
+	// Unknown objects are skipped
+	client.clear();
+	is.str(unreliable + unreliable);
+	is.clear();
+	UASSERT(!readObjectState(is, client, id, result) && !is.fail());
+	UASSERT(!readObjectState(is, client, id, result) && !is.fail());
+	UASSERT(is.peek() == EOF);
+}
+
+void TestActiveObject::testObjectStateBaseline()
+{
+	ObjectPosition pos = make_position(v3f(0.0f, 0.0f, 0.0f));
+	ObjectSyncState server;
+	std::unordered_map<u16, ObjectSyncState> client;
+	std::string reliable, unreliable, old_delta;
+	u16 id;
+	ObjectPosition result;
+
+	server.write(3, pos, reliable, unreliable);
+	std::istringstream is(reliable, std::ios::binary);
+	UASSERT(readObjectState(is, client, id, result));
+
+	pos.position.X += BS;
+	server.write(3, pos, reliable, old_delta);
+
+	// Too far away for an offset
+	pos.position.X += 1000.0f * BS;
+	reliable.clear();
+	server.write(3, pos, reliable, unreliable);
+	UASSERT(!reliable.empty());
+
+	// A delta to the old baseline arriving after the new one is dropped
+	is.str(reliable + old_delta);
+	is.clear();
+	UASSERT(readObjectState(is, client, id, result));
+	UASSERT(result.position == pos.position);
+	UASSERT(!readObjectState(is, client, id, result) && !is.fail());
+
+	// Truncated entries are reported
+	is.str(reliable.substr(0, 10));
+	is.clear();
+	UASSERT(!readObjectState(is, client, id, result) && is.fail());
+}
@@ -20,6 +20,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include "util/areastore.h"
+#include "filesys.h"
+#include "porting.h"
+#include <algorithm>
+#include <fstream>
 
 class TestAreaStore : public TestBase {
 public:
@@ -31,7 +35,10 @@ class TestAreaStore : public TestBase {
 	void genericStoreTest(AreaStore *store);
 	void testVectorStore();
 	void testSpatialStore();
+	void testRTreeStore();
 	void testSerialization();
+	void testLargeSerialization();
+	void testBenchmark();
 };
 
 static TestAreaStore g_test_instance;
@@ -42,7 +49,10 @@ void TestAreaStore::runTests(IGameDef *gamedef)
 #if USE_SPATIAL
 	TEST(testSpatialStore);
 #endif
+	TEST(testRTreeStore);
 	TEST(testSerialization);
+	TEST(testLargeSerialization);
+	TEST(testBenchmark);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -61,6 +71,12 @@ void TestAreaStore::testSpatialStore()
 #endif
 }
 
+void TestAreaStore::testRTreeStore()
+{
+	RTreeAreaStore store;
+	genericStoreTest(&store);
+}
+
 void TestAreaStore::genericStoreTest(AreaStore *store)
 {
 	Area a(v3s16(-10, -3, 5), v3s16(0, 29, 7));
@@ -171,3 +187,144 @@ void TestAreaStore::testSerialization()
 	UASSERTEQ(u32, c.id, 2);
 }
 
+
+// Random areas of up to 64 nodes per side in a 4000 nodes wide world
+static void insert_random_areas(AreaStore *store, u32 count, u32 seed)
+{
+	PcgRandom pr(seed);
+	for (u32 i = 0; i < count; i++) {
+		v3s16 minedge(pr.range(-2000, 2000), pr.range(-100, 100),
+			pr.range(-2000, 2000));
+		v3s16 size(pr.range(0, 63), pr.range(0, 63), pr.range(0, 63));
+		Area a(minedge, minedge + size);
+		a.data = std::to_string(i);
+		store->insertArea(&a);
+	}
+}
+
+static std::vector<u32> sorted_ids(const std::vector<Area *> &areas)
+{
+	std::vector<u32> ids;
+	for (const Area *a : areas)
+		ids.push_back(a->id);
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+void TestAreaStore::testLargeSerialization()
+{
+	const u32 count = 70000;
+	RTreeAreaStore store;
+	insert_random_areas(&store, count, 42);
+
+	std::ostringstream os(std::ios::binary);
+	store.serialize(os);
+	std::string str = os.str();
+	UASSERTEQ(u8, str[0], 5);
+
+	RTreeAreaStore loaded;
+	std::istringstream is(str, std::ios::binary);
+	loaded.deserialize(is);
+	UASSERTEQ(size_t, loaded.size(), count);
+	for (u32 id : {0U, 1U, count / 2, count - 1}) {
+		const Area *saved = store.getArea(id);
+		const Area *area = loaded.getArea(id);
+		UASSERT(saved && area);
+		UASSERT(saved->minedge == area->minedge && saved->maxedge == area->maxedge);
+		UASSERTEQ(const std::string &, saved->data, area->data);
+	}
+
+	std::string path = getTestTempFile();
+	UASSERT(fs::safeWriteToFile(path, str));
+	RTreeAreaStore mapped;
+	mapped.deserializeFile(path);
+	UASSERTEQ(size_t, mapped.size(), count);
+	UASSERTEQ(const std::string &, mapped.getArea(count - 1)->data,
+			store.getArea(count - 1)->data);
+
+	// Truncated data is an error, not a partial store
+	UASSERT(fs::safeWriteToFile(path, str.substr(0, str.size() - 1)));
+	RTreeAreaStore truncated;
+	try {
+		truncated.deserializeFile(path);
+		UASSERT(false);
+	} catch (SerializationError &e) {
+	}
+	fs::DeleteSingleFileOrEmptyDirectory(path);
+}
+
+void TestAreaStore::testBenchmark()
+{
+	const u32 count = 20000;
+	const u32 queries = 5000;
+	VectorAreaStore vector_store;
+	RTreeAreaStore rtree_store;
+	vector_store.setCacheParams(false, 0, 0);
+	rtree_store.setCacheParams(false, 0, 0);
+
+	u64 t0 = porting::getTimeUs();
+	insert_random_areas(&rtree_store, count, 1234);
+	std::vector<Area *> res;
+	rtree_store.getAreasForPos(&res, v3s16(0, 0, 0)); // Builds the tree
+	u64 t_build = porting::getTimeUs() - t0;
+	insert_random_areas(&vector_store, count, 1234);
+
+	// Both stores find the same areas
+	PcgRandom pr(99);
+	std::vector<v3s16> points;
+	for (u32 i = 0; i < queries; i++)
+		points.emplace_back(pr.range(-2000, 2000), pr.range(-100, 100),
+			pr.range(-2000, 2000));
+	for (u32 i = 0; i < 200; i++) {
+		std::vector<Area *> vector_res, rtree_res;
+		vector_store.getAreasForPos(&vector_res, points[i]);
+		rtree_store.getAreasForPos(&rtree_res, points[i]);
+		UASSERT(sorted_ids(vector_res) == sorted_ids(rtree_res));
+
+		vector_res.clear();
+		rtree_res.clear();
+		v3s16 maxedge = points[i] + v3s16(100, 100, 100);
+		vector_store.getAreasInArea(&vector_res, points[i], maxedge, i % 2);
+		rtree_store.getAreasInArea(&rtree_res, points[i], maxedge, i % 2);
+		UASSERT(sorted_ids(vector_res) == sorted_ids(rtree_res));
+	}
+
+	// Removed and newly inserted areas before the next rebuild
+	for (u32 id = 0; id < count; id += 3) {
+		vector_store.removeArea(id);
+		rtree_store.removeArea(id);
+	}
+	Area extra(v3s16(-2000, -100, -2000), v3s16(2000, 100, 2000));
+	vector_store.insertArea(&extra);
+	extra.id = U32_MAX;
+	rtree_store.insertArea(&extra);
+	for (u32 i = 0; i < 200; i++) {
+		std::vector<Area *> vector_res, rtree_res;
+		vector_store.getAreasForPos(&vector_res, points[i]);
+		rtree_store.getAreasForPos(&rtree_res, points[i]);
+		UASSERT(sorted_ids(vector_res) == sorted_ids(rtree_res));
+	}
+
+	u32 found = 0;
+	t0 = porting::getTimeUs();
+	for (const v3s16 &p : points) {
+		res.clear();
+		vector_store.getAreasForPos(&res, p);
+		found += res.size();
+	}
+	u64 t_vector = porting::getTimeUs() - t0;
+
+	t0 = porting::getTimeUs();
+	for (const v3s16 &p : points) {
+		res.clear();
+		rtree_store.getAreasForPos(&res, p);
+		found -= res.size();
+	}
+	u64 t_rtree = porting::getTimeUs() - t0;
+	UASSERTEQ(u32, found, 0);
+
+	rawstream << "AreaStore: " << count << " areas, " << queries
+		<< " getAreasForPos() calls: VectorAreaStore " << t_vector
+		<< "us, RTreeAreaStore " << t_rtree << "us (built in "
+		<< t_build << "us)" << std::endl;
+}
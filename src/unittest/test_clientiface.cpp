@@ -0,0 +1,108 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "clientiface.h"
+
+class TestClientIface : public TestBase
+{
+public:
+	TestClientIface() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestClientIface"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testBlockSubscribers();
+	void testChangeWhileSending();
+};
+
+static TestClientIface g_test_instance;
+
+void TestClientIface::runTests(IGameDef *gamedef)
+{
+	TEST(testBlockSubscribers);
+	TEST(testChangeWhileSending);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::vector<session_t> get_subscribers(BlockSubscribers &subscribers,
+	v3s16 blockpos)
+{
+	std::vector<session_t> result;
+	subscribers.get(blockpos, result);
+	return result;
+}
+
+void TestClientIface::testBlockSubscribers()
+{
+	BlockSubscribers subscribers;
+	const v3s16 p(1, -2, 3);
+	{
+		RemoteClient client(&subscribers);
+		client.peer_id = 7;
+
+		client.SentBlock(p);
+		UASSERTEQ(size_t, get_subscribers(subscribers, p).size(), 1);
+		client.GotBlock(p);
+		UASSERT(client.isBlockSent(p));
+		UASSERTEQ(size_t, get_subscribers(subscribers, p).size(), 1);
+		UASSERTEQ(session_t, get_subscribers(subscribers, p)[0], 7);
+
+		client.SetBlockNotSent(p);
+		UASSERT(get_subscribers(subscribers, p).empty());
+
+		// Blocks still on the wire are dropped with the client
+		client.SentBlock(p);
+		UASSERTEQ(size_t, get_subscribers(subscribers, p).size(), 1);
+	}
+	UASSERT(get_subscribers(subscribers, p).empty());
+}
+
+void TestClientIface::testChangeWhileSending()
+{
+	BlockSubscribers subscribers;
+	RemoteClient client(&subscribers);
+	client.peer_id = 7;
+	const v3s16 p(0, 0, 0);
+
+	client.SentBlock(p);
+
+	// A node of the block changes before the client acknowledges it.
+	// Server::sendNodeChange finds the client and, as the block isn't
+	// sent yet, has it sent again.
+	std::vector<session_t> found = get_subscribers(subscribers, p);
+	UASSERTEQ(size_t, found.size(), 1);
+	UASSERT(!client.isBlockSent(p));
+	std::map<v3s16, MapBlock *> modified;
+	modified[p] = nullptr;
+	client.SetBlocksNotSent(modified);
+
+	// The acknowledgement of the outdated copy doesn't count
+	client.GotBlock(p);
+	UASSERT(!client.isBlockSent(p));
+	UASSERT(get_subscribers(subscribers, p).empty());
+
+	// The new copy does
+	client.SentBlock(p);
+	client.GotBlock(p);
+	UASSERT(client.isBlockSent(p));
+	UASSERTEQ(size_t, get_subscribers(subscribers, p).size(), 1);
+}
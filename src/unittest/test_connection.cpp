@@ -22,7 +22,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "log.h"
 #include "porting.h"
 #include "settings.h"
+#include "util/basic_macros.h"
 #include "util/serialize.h"
+#include "network/congestioncontrol.h"
 #include "network/mt_connection.h"
 #include "network/networkpacket.h"
 #include "network/socket.h"
@@ -41,6 +43,15 @@ class TestConnection : public TestBase {
 
 	void testNetworkPacketSerialize();
 	void testHelpers();
+	void testReliableBufferWrapAround();
+	void testReliableBufferWindow();
+	void testReliableBufferTimeouts();
+	void testSplitBufferWrapAround();
+	void testSplitBufferCollision();
+	void testAckPacket();
+	void testReliableBufferSelectiveAck();
+	void testCubicCongestionControl();
+	void testLossSimulation();
 	void testConnectSendReceive();
 };
 
@@ -50,6 +61,15 @@ void TestConnection::runTests(IGameDef *gamedef)
 {
 	TEST(testNetworkPacketSerialize);
 	TEST(testHelpers);
+	TEST(testReliableBufferWrapAround);
+	TEST(testReliableBufferWindow);
+	TEST(testReliableBufferTimeouts);
+	TEST(testSplitBufferWrapAround);
+	TEST(testSplitBufferCollision);
+	TEST(testAckPacket);
+	TEST(testReliableBufferSelectiveAck);
+	TEST(testCubicCongestionControl);
+	TEST(testLossSimulation);
 	TEST(testConnectSendReceive);
 }
 
@@ -156,6 +176,571 @@ void TestConnection::testHelpers()
 	UASSERT(readU8(&p2[3]) == data1[0]);
 }
 
+static con::BufferedPacket makeReliable(u16 seqnum, u32 size = 1)
+{
+	SharedBuffer<u8> data(size);
+	memset(*data, seqnum & 0xff, size);
+	Address a(127, 0, 0, 1, 10);
+	return con::makePacket(a, con::makeReliablePacket(data, seqnum),
+			0x12345678, 123, 0);
+}
+
+static u16 reliableSeqnum(const con::BufferedPacket &p)
+{
+	return readU16(&p.data[BASE_HEADER_SIZE + 1]);
+}
+
+void TestConnection::testReliableBufferWrapAround()
+{
+	// Out of order incoming packets around the seqnum wrap-around
+	con::ReliablePacketBuffer buf;
+	const u16 next_expected = 65530;
+	const u16 order[] = {65535, 3, 65532, 0, 1};
+	for (u16 seqnum : order)
+		buf.insert(makeReliable(seqnum), next_expected);
+	UASSERTEQ(u32, buf.size(), 5);
+
+	// Resent copies are ignored, different ones are corruption
+	buf.insert(makeReliable(0), next_expected);
+	UASSERTEQ(u32, buf.size(), 5);
+	EXCEPTION_CHECK(con::IncomingDataCorruption,
+		buf.insert(makeReliable(0, 2), next_expected));
+	// Outside of the window
+	buf.insert(makeReliable(next_expected - 1), next_expected);
+	UASSERTEQ(u32, buf.size(), 5);
+
+	u16 first = 0;
+	UASSERT(buf.getFirstSeqnum(first));
+	UASSERTEQ(u16, first, 65532);
+
+	const u16 expected[] = {65532, 65535, 0, 1, 3};
+	for (u16 seqnum : expected) {
+		UASSERT(buf.getFirstSeqnum(first));
+		UASSERTEQ(u16, first, seqnum);
+		con::BufferedPacket p = buf.popFirst();
+		UASSERTEQ(u16, reliableSeqnum(p), seqnum);
+		UASSERT(p.data[BASE_HEADER_SIZE + RELIABLE_HEADER_SIZE] == (seqnum & 0xff));
+	}
+	UASSERT(buf.empty());
+	UASSERT(!buf.getFirstSeqnum(first));
+	EXCEPTION_CHECK(con::NotFoundException, buf.popFirst());
+}
+
+void TestConnection::testReliableBufferWindow()
+{
+	// A sliding send window across the wrap-around, acked out of order
+	con::ReliablePacketBuffer buf;
+	const u32 window = 500;
+	u16 next_seqnum = 65000;
+	u16 next_ack = next_seqnum;
+	u32 state = 1;
+
+	for (u32 sent = 0; sent < 3000; sent++) {
+		buf.insert(makeReliable(next_seqnum), next_seqnum - 1000);
+		next_seqnum++;
+
+		while (buf.size() >= window) {
+			// Ack one of the 8 oldest
+			state = state * 1103515245 + 12345;
+			u16 seqnum = next_ack + (state >> 16) % 8;
+			try {
+				con::BufferedPacket p = buf.popSeqnum(seqnum);
+				UASSERTEQ(u16, reliableSeqnum(p), seqnum);
+			} catch (con::NotFoundException &e) {
+				// Acked before
+			}
+			u16 first;
+			UASSERT(buf.getFirstSeqnum(first));
+			next_ack = first;
+		}
+	}
+	UASSERTEQ(u32, buf.size(), window - 1);
+	// The ring only covers the window
+	UASSERT(buf.capacity() <= 1024);
+
+	// Newest first, which moves the end of the ring back
+	while (!buf.empty()) {
+		next_seqnum--;
+		try {
+			buf.popSeqnum(next_seqnum);
+		} catch (con::NotFoundException &e) {
+		}
+	}
+	EXCEPTION_CHECK(con::NotFoundException, buf.popSeqnum(next_seqnum));
+}
+
+void TestConnection::testReliableBufferTimeouts()
+{
+	con::ReliablePacketBuffer buf;
+	for (u16 seqnum = 65534; seqnum != 2; seqnum++)
+		buf.insert(makeReliable(seqnum), 65000);
+
+	buf.incrementTimeouts(0.5f);
+	UASSERT(buf.getTimedOuts(1.0f, 100).empty());
+
+	buf.incrementTimeouts(0.6f);
+	std::list<con::BufferedPacket> timed_outs = buf.getTimedOuts(1.0f, 3);
+	UASSERTEQ(size_t, timed_outs.size(), 3);
+	for (const con::BufferedPacket &p : timed_outs)
+		UASSERTEQ(unsigned int, p.resend_count, 1);
+	UASSERTEQ(size_t, buf.getTimedOuts(1.0f, 100).size(), 1);
+
+	// Resent packets wait longer
+	buf.incrementTimeouts(1.2f);
+	UASSERT(buf.getTimedOuts(1.0f, 100).empty());
+
+	buf.popSeqnum(65535);
+	buf.incrementTimeouts(0.4f);
+	timed_outs = buf.getTimedOuts(1.0f, 100);
+	UASSERTEQ(size_t, timed_outs.size(), 3);
+	UASSERTEQ(u16, reliableSeqnum(timed_outs.front()), 65534);
+	UASSERTEQ(unsigned int, timed_outs.front().resend_count, 2);
+
+	con::BufferedPacket p = buf.popSeqnum(0);
+	UASSERT(std::fabs(p.totaltime - 2.7f) < 0.001f);
+	UASSERT(p.time < 0.001f);
+}
+
+void TestConnection::testSplitBufferWrapAround()
+{
+	con::IncomingSplitBuffer buf;
+	Address a(127, 0, 0, 1, 10);
+
+	auto make_chunks = [&] (u16 seqnum, u8 fill) {
+		SharedBuffer<u8> data(100);
+		memset(*data, fill, data.getSize());
+		std::list<SharedBuffer<u8>> chunks;
+		u16 split_seqnum = seqnum;
+		con::makeAutoSplitPacket(data, 40, split_seqnum, &chunks);
+		UASSERTEQ(u16, split_seqnum, (u16)(seqnum + 1));
+		std::vector<con::BufferedPacket> packets;
+		for (const SharedBuffer<u8> &chunk : chunks)
+			packets.push_back(con::makePacket(a, chunk, 0x12345678, 123, 0));
+		return packets;
+	};
+
+	// Interleaved across the wrap-around
+	std::vector<con::BufferedPacket> p1 = make_chunks(65535, 1);
+	std::vector<con::BufferedPacket> p2 = make_chunks(0, 2);
+	UASSERT(p1.size() == 4 && p2.size() == 4);
+	for (size_t i = 0; i < 3; i++) {
+		UASSERTEQ(u32, buf.insert(p1[i], false).getSize(), 0);
+		UASSERTEQ(u32, buf.insert(p2[i], true).getSize(), 0);
+	}
+	UASSERTEQ(u32, buf.size(), 2);
+
+	SharedBuffer<u8> full = buf.insert(p2[3], true);
+	UASSERTEQ(u32, full.getSize(), 100);
+	UASSERT(full[0] == 2 && full[99] == 2);
+	full = buf.insert(p1[3], false);
+	UASSERTEQ(u32, full.getSize(), 100);
+	UASSERT(full[0] == 1 && full[99] == 1);
+	UASSERTEQ(u32, buf.size(), 0);
+
+	// A seqnum that comes around again doesn't replace the packet in its slot
+	std::vector<con::BufferedPacket> stale = make_chunks(5, 3);
+	std::vector<con::BufferedPacket> fresh = make_chunks(5 + SPLIT_BUFFER_SLOTS, 4);
+	buf.insert(stale[0], false);
+	for (size_t i = 0; i < 3; i++)
+		buf.insert(fresh[i], false);
+	UASSERTEQ(u32, buf.insert(stale[1], false).getSize(), 0);
+	UASSERTEQ(u32, buf.size(), 2);
+	full = buf.insert(fresh[3], false);
+	UASSERTEQ(u32, full.getSize(), 100);
+	UASSERT(full[0] == 4 && full[99] == 4);
+	UASSERTEQ(u32, buf.size(), 1);
+
+	// Unreliable ones time out
+	buf.insert(fresh[0], false);
+	buf.removeUnreliableTimedOuts(1.0f, 30.0f);
+	UASSERTEQ(u32, buf.size(), 2);
+	buf.removeUnreliableTimedOuts(30.0f, 30.0f);
+	UASSERTEQ(u32, buf.size(), 0);
+}
+
+void TestConnection::testSplitBufferCollision()
+{
+	con::IncomingSplitBuffer buf;
+	Address a(127, 0, 0, 1, 10);
+
+	auto make_chunks = [&] (u16 seqnum, u32 size, u8 fill) {
+		SharedBuffer<u8> data(size);
+		memset(*data, fill, data.getSize());
+		std::list<SharedBuffer<u8>> chunks;
+		con::makeAutoSplitPacket(data, 40, seqnum, &chunks);
+		std::vector<con::BufferedPacket> packets;
+		for (const SharedBuffer<u8> &chunk : chunks)
+			packets.push_back(con::makePacket(a, chunk, 0x12345678, 123, 0));
+		return packets;
+	};
+
+	// A long reliable transfer with unreliable split packets in between,
+	// which use the following seqnums of the channel
+	std::vector<con::BufferedPacket> reliable = make_chunks(10, 1000, 1);
+	const size_t half = reliable.size() / 2;
+	for (size_t i = 0; i < half; i++)
+		UASSERTEQ(u32, buf.insert(reliable[i], true).getSize(), 0);
+
+	for (u16 seqnum = 11; seqnum < 11 + 2 * SPLIT_BUFFER_SLOTS; seqnum++) {
+		std::vector<con::BufferedPacket> unreliable =
+				make_chunks(seqnum, 100, 2);
+		// Every other one loses a chunk
+		size_t count = seqnum % 2 ? unreliable.size() : 1;
+		for (size_t i = 0; i < count; i++)
+			buf.insert(unreliable[i], false);
+	}
+	UASSERTEQ(u32, buf.size(), 1 + SPLIT_BUFFER_SLOTS);
+
+	// The reliable packet still completes
+	SharedBuffer<u8> full;
+	for (size_t i = half; i < reliable.size(); i++)
+		full = buf.insert(reliable[i], true);
+	UASSERTEQ(u32, full.getSize(), 1000);
+	UASSERT(full[0] == 1 && full[999] == 1);
+
+	buf.removeUnreliableTimedOuts(30.0f, 30.0f);
+	UASSERTEQ(u32, buf.size(), 0);
+}
+
+void TestConnection::testAckPacket()
+{
+	// Plain ACKs are what older peers send
+	con::ReliableAck ack;
+	ack.seqnum = 65535;
+	SharedBuffer<u8> data = con::makeAckPacket(ack);
+	UASSERTEQ(u32, data.getSize(), 4);
+	UASSERT(readU8(&data[0]) == con::PACKET_TYPE_CONTROL);
+	UASSERT(readU8(&data[1]) == CONTROLTYPE_ACK);
+	UASSERTEQ(u16, readU16(&data[2]), 65535);
+	con::ReliableAck read = con::readAckPacket(data);
+	UASSERT(!read.extended && read.seqnum == 65535);
+	UASSERT(read.covers(65535) && !read.covers(65534));
+
+	// Selective ACK across the wrap-around, the seqnum stays in front
+	ack.extended = true;
+	ack.seqnum = 4;
+	ack.next_expected = 65534;
+	ack.ranges = {{0, 1}, {4, 4}};
+	data = con::makeAckPacket(ack);
+	UASSERTEQ(u32, data.getSize(), 15);
+	UASSERTEQ(u16, readU16(&data[2]), 4);
+	read = con::readAckPacket(data);
+	UASSERT(read.extended);
+	UASSERTEQ(u16, read.next_expected, 65534);
+	UASSERT(read.ranges == ack.ranges);
+	UASSERT(read.covers(65533) && read.covers(0) && read.covers(1) && read.covers(4));
+	UASSERT(!read.covers(65534) && !read.covers(65535) && !read.covers(2));
+
+	EXCEPTION_CHECK(con::InvalidIncomingDataException,
+		con::readAckPacket(SharedBuffer<u8>(*data, 3)));
+	// Truncated ranges
+	EXCEPTION_CHECK(con::InvalidIncomingDataException,
+		con::readAckPacket(SharedBuffer<u8>(*data, 13)));
+}
+
+void TestConnection::testReliableBufferSelectiveAck()
+{
+	// Incoming packets with holes, as the ranges of a selective ACK
+	con::ReliablePacketBuffer received;
+	for (u16 seqnum : {65534, 65535, 2, 3, 4, 7})
+		received.insert(makeReliable(seqnum), 65530);
+	std::vector<std::pair<u16, u16>> ranges;
+	received.getRanges(ranges, ACK_MAX_RANGES);
+	UASSERT(ranges == (std::vector<std::pair<u16, u16>>{{65534, 0xffff}, {2, 4}, {7, 7}}));
+	ranges.clear();
+	received.getRanges(ranges, 2);
+	UASSERTEQ(size_t, ranges.size(), 2);
+
+	// The sent packets these cover are removed
+	con::ReliablePacketBuffer sent;
+	for (u16 seqnum = 65528; seqnum != 9; seqnum++)
+		sent.insert(makeReliable(seqnum, 10), 65000);
+	con::ReliableAck ack;
+	ack.extended = true;
+	ack.seqnum = 7;
+	ack.next_expected = 65530;
+	received.getRanges(ack.ranges, ACK_MAX_RANGES);
+	u32 bytes = 0;
+	UASSERTEQ(u32, sent.popAcked(ack, bytes), 7);
+	UASSERTEQ(u32, bytes, 7 * (BASE_HEADER_SIZE + RELIABLE_HEADER_SIZE + 10));
+	// Except for the seqnum
+	UASSERTEQ(u16, reliableSeqnum(sent.popSeqnum(7)), 7);
+	u16 first = 0;
+	UASSERT(sent.getFirstSeqnum(first));
+	UASSERTEQ(u16, first, 65530);
+	UASSERTEQ(u32, sent.size(), 9);
+	// Nothing new
+	UASSERTEQ(u32, sent.popAcked(ack, bytes), 0);
+
+	// 65530..65533, 0 and 1 were sent at least 3 packets before 7,
+	// 5, 6 and 8 were not
+	UASSERT(sent.getTimedOuts(1.0f, 100).empty());
+	UASSERTEQ(u32, sent.markLost(3), 6);
+	UASSERTEQ(u32, sent.markLost(3), 0);
+	std::list<con::BufferedPacket> lost = sent.getTimedOuts(1.0f, 100);
+	UASSERTEQ(size_t, lost.size(), 6);
+	UASSERTEQ(u16, reliableSeqnum(lost.front()), 65530);
+	UASSERTEQ(unsigned int, lost.front().resend_count, 1);
+	// Resent ones are not lost again until something sent later is acked
+	UASSERTEQ(u32, sent.markLost(3), 0);
+	UASSERT(sent.getTimedOuts(1.0f, 100).empty());
+	sent.popSeqnum(65530);
+	UASSERTEQ(u32, sent.markLost(3), 2);
+}
+
+void TestConnection::testCubicCongestionControl()
+{
+	con::CubicCongestionControl cc;
+	UASSERTEQ(u32, cc.getWindowSize(), START_RELIABLE_WINDOW_SIZE);
+
+	// An unused window doesn't grow
+	cc.onAcked(1, 100, 0, 0.1f);
+	UASSERTEQ(u32, cc.getWindowSize(), START_RELIABLE_WINDOW_SIZE);
+
+	// Slow start doubles every round trip
+	for (u32 i = 0; i < START_RELIABLE_WINDOW_SIZE; i++)
+		cc.onAcked(1, 100, START_RELIABLE_WINDOW_SIZE, 0.1f);
+	UASSERTEQ(u32, cc.getWindowSize(), 2 * START_RELIABLE_WINDOW_SIZE);
+
+	// Multiplicative decrease, once per round trip
+	cc.onLost(1);
+	UASSERTEQ(u32, cc.getWindowSize(), 89);
+	cc.step(0.05f);
+	cc.onLost(5);
+	UASSERTEQ(u32, cc.getWindowSize(), 89);
+
+	// Back to the old window along the curve, then probe beyond
+	u32 previous = cc.getWindowSize();
+	float reached = -1.0f;
+	for (float t = 0.0f; t < 10.0f; t += 0.1f) {
+		cc.step(0.1f);
+		for (u32 i = 0; i < cc.getWindowSize(); i++)
+			cc.onAcked(1, 100, cc.getWindowSize(), 0.1f);
+		UASSERT(cc.getWindowSize() >= previous);
+		previous = cc.getWindowSize();
+		if (reached < 0.0f && previous >= 2 * START_RELIABLE_WINDOW_SIZE - 1)
+			reached = t;
+	}
+	// K = cbrt(128 * 0.3 / 0.4) seconds, minus the round trip looked ahead
+	// The curve is a packet below the old window cbrt(1 / C) seconds before
+	// K = cbrt(128 * 0.3 / C), it looks ahead one round trip
+	UASSERT(reached > 2.9f && reached < 3.5f);
+	UASSERT(previous > 2 * START_RELIABLE_WINDOW_SIZE);
+	UASSERT(previous <= MAX_RELIABLE_WINDOW_SIZE_SEND);
+
+	// Never below the minimum
+	for (u32 i = 0; i < 20; i++) {
+		cc.step(1.0f);
+		cc.onLost(1);
+	}
+	UASSERTEQ(u32, cc.getWindowSize(), MIN_RELIABLE_WINDOW_SIZE);
+
+	UASSERT(std::string(con::createCongestionControl("classic")->getName()) == "classic");
+	UASSERT(std::string(con::createCongestionControl("cubic")->getName()) == "cubic");
+	UASSERT(std::string(con::createCongestionControl("bbr")->getName()) == "bbr");
+}
+
+/*
+	A one-way transfer of reliable packets over a simulated link, done the
+	way the connection threads do it: the same buffers, ACKs and congestion
+	control, but with a fixed time step instead of threads and sockets.
+*/
+
+template <typename T>
+struct SimulatedLink
+{
+	float latency;
+	u32 loss_percent;
+	// Packets per step through the bottleneck, 0 for no limit
+	u32 rate;
+	// Packets queued at the bottleneck before it drops them
+	u32 queue_limit;
+	u32 &random;
+
+	std::deque<T> queue;
+	std::deque<std::pair<float, T>> wire;
+
+	SimulatedLink(float latency, u32 loss_percent, u32 rate, u32 queue_limit,
+			u32 &random) :
+		latency(latency), loss_percent(loss_percent), rate(rate),
+		queue_limit(queue_limit), random(random)
+	{}
+
+	void send(const T &packet)
+	{
+		random = random * 1103515245 + 12345;
+		if ((random >> 16) % 100 < loss_percent)
+			return;
+		if (rate != 0 && queue.size() >= queue_limit)
+			return;
+		queue.push_back(packet);
+	}
+
+	void step(float now, std::vector<T> &arrived)
+	{
+		for (u32 i = 0; !queue.empty() && (rate == 0 || i < rate); i++) {
+			wire.emplace_back(now + latency, queue.front());
+			queue.pop_front();
+		}
+		while (!wire.empty() && wire.front().first <= now) {
+			arrived.push_back(wire.front().second);
+			wire.pop_front();
+		}
+	}
+};
+
+struct TransferStats
+{
+	bool complete = false;
+	float duration = 0.0f;
+	u32 resent = 0;
+	// Packets that arrived more than once
+	u32 duplicates = 0;
+};
+
+static TransferStats simulateTransfer(u32 count, float latency, u32 loss_percent,
+		const std::string &congestion_control, bool selective_acks)
+{
+	const float dtime = 0.01f;
+	u32 random = 1;
+	// 2000 packets/s bottleneck
+	SimulatedLink<con::BufferedPacket> data_link(latency, loss_percent, 20, 200, random);
+	SimulatedLink<SharedBuffer<u8>> ack_link(latency, loss_percent, 0, 0, random);
+	std::unique_ptr<con::CongestionControl> cc =
+			con::createCongestionControl(congestion_control);
+	const float resend_timeout = MYMAX(4.0f * latency, 0.1f);
+
+	con::ReliablePacketBuffer sent, received;
+	u16 next_seqnum = 65000, next_expected = 65000;
+	u32 remaining = count, delivered = 0;
+	std::vector<u16> pending_acks;
+	TransferStats stats;
+
+	for (float now = 0.0f; now < 300.0f; now += dtime) {
+		// Sender
+		sent.incrementTimeouts(dtime);
+		std::list<con::BufferedPacket> timed_outs = sent.getTimedOuts(resend_timeout, 1000);
+		cc->onLost(timed_outs.size());
+		stats.resent += timed_outs.size();
+		for (const con::BufferedPacket &p : timed_outs)
+			data_link.send(p);
+		while (remaining > 0 && sent.size() < cc->getWindowSize()) {
+			con::BufferedPacket p = makeReliable(next_seqnum, 500);
+			sent.insert(p, next_seqnum - 1000);
+			data_link.send(p);
+			next_seqnum++;
+			remaining--;
+		}
+		cc->step(dtime);
+
+		// Receiver
+		std::vector<con::BufferedPacket> arrived;
+		data_link.step(now, arrived);
+		for (const con::BufferedPacket &p : arrived) {
+			u16 seqnum = reliableSeqnum(p);
+			pending_acks.push_back(seqnum);
+			if (seqnum == next_expected) {
+				delivered++;
+				next_expected++;
+				u16 first;
+				while (received.getFirstSeqnum(first) && first == next_expected) {
+					received.popFirst();
+					delivered++;
+					next_expected++;
+				}
+			} else if (con::seqnum_higher(seqnum, next_expected)) {
+				u32 size = received.size();
+				received.insert(p, next_expected);
+				if (received.size() == size)
+					stats.duplicates++;
+			} else {
+				stats.duplicates++;
+			}
+		}
+		if (delivered == count) {
+			stats.complete = true;
+			stats.duration = now;
+			break;
+		}
+
+		if (!pending_acks.empty()) {
+			con::ReliableAck ack;
+			ack.extended = selective_acks;
+			ack.next_expected = next_expected;
+			received.getRanges(ack.ranges, ACK_MAX_RANGES);
+			ack.seqnum = pending_acks.back();
+			for (size_t i = 0; i + 1 < pending_acks.size(); i++) {
+				if (ack.covers(pending_acks[i]))
+					continue;
+				con::ReliableAck single = ack;
+				single.seqnum = pending_acks[i];
+				ack_link.send(con::makeAckPacket(single));
+			}
+			ack_link.send(con::makeAckPacket(ack));
+			pending_acks.clear();
+		}
+
+		// Sender receiving ACKs
+		std::vector<SharedBuffer<u8>> acks;
+		ack_link.step(now, acks);
+		for (const SharedBuffer<u8> &data : acks) {
+			con::ReliableAck ack = con::readAckPacket(data);
+			u32 in_flight = sent.size();
+			try {
+				con::BufferedPacket p = sent.popSeqnum(ack.seqnum);
+				cc->onAcked(1, p.data.getSize(), in_flight,
+						p.resend_count == 0 ? p.time : -1.0f);
+			} catch (con::NotFoundException &e) {
+				if (!ack.extended)
+					cc->onTooLate();
+			}
+			if (ack.extended) {
+				u32 bytes = 0;
+				u32 packets = sent.popAcked(ack, bytes);
+				if (packets != 0)
+					cc->onAcked(packets, bytes, in_flight, -1.0f);
+				sent.markLost(3);
+			}
+		}
+	}
+	return stats;
+}
+
+void TestConnection::testLossSimulation()
+{
+	const u32 count = 6000;
+	const struct {
+		const char *name;
+		float latency;
+		u32 loss_percent;
+	} links[] = {
+		{"lan", 0.005f, 0},
+		{"mobile", 0.15f, 2},
+		{"lossy", 0.05f, 15},
+	};
+
+	for (const auto &link : links) {
+		// What peers without selective ACKs do
+		TransferStats classic = simulateTransfer(count, link.latency,
+				link.loss_percent, "classic", false);
+		TransferStats cubic = simulateTransfer(count, link.latency,
+				link.loss_percent, "cubic", true);
+		TransferStats bbr = simulateTransfer(count, link.latency,
+				link.loss_percent, "bbr", true);
+		UASSERT(classic.complete && cubic.complete && bbr.complete);
+
+		rawstream << "    " << link.name << " link:";
+		const char *names[] = {"classic", "cubic", "bbr"};
+		const TransferStats *results[] = {&classic, &cubic, &bbr};
+		for (size_t i = 0; i < ARRLEN(results); i++) {
+			rawstream << (i == 0 ? " " : ", ") << names[i] << " " << results[i]->duration << "s/"
+				<< results[i]->resent << " resent";
+		}
+		rawstream << std::endl;
+
+		UASSERT(bbr.duration <= classic.duration);
+	}
+}
 
 void TestConnection::testConnectSendReceive()
 {
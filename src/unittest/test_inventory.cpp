@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "gamedef.h"
 #include "inventory.h"
+#include "itemdef.h"
 
 class TestInventory : public TestBase {
 public:
@@ -32,6 +33,8 @@ class TestInventory : public TestBase {
 	void runTests(IGameDef *gamedef);
 
 	void testSerializeDeserialize(IItemDefManager *idef);
+	void testBinaryDelta(IItemDefManager *idef);
+	void testItemNames();
 
 	static const char *serialized_inventory_in;
 	static const char *serialized_inventory_out;
@@ -43,10 +46,59 @@ static TestInventory g_test_instance;
 void TestInventory::runTests(IGameDef *gamedef)
 {
 	TEST(testSerializeDeserialize, gamedef->getItemDefManager());
+	TEST(testBinaryDelta, gamedef->getItemDefManager());
+	TEST(testItemNames);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void TestInventory::testItemNames()
+{
+	ItemName name_a(std::string("test:a")), name_b(std::string("test:b"));
+	UASSERT(name_a == ItemName(std::string("test:a")));
+	UASSERT(name_a != name_b);
+	UASSERT(name_a.getId() != name_b.getId());
+	UASSERT(name_a == "test:a" && "test:b" == name_b);
+	UASSERT(ItemName(std::string("")) == ItemName());
+	UASSERTEQ(u32, ItemName().getId(), 0);
+	UASSERTEQ(std::string, "[" + name_a + "]", "[test:a]");
+
+	IWritableItemDefManager *idef = createItemDefManager();
+	ItemDefinition def;
+	def.name = "test:a";
+	def.stack_max = 42;
+	idef->registerItem(def);
+	idef->registerAlias("test:old_a", "test:a");
+	ItemName name_old_a(std::string("test:old_a"));
+
+	UASSERT(idef->isKnown(name_a));
+	UASSERT(idef->isKnown(name_old_a));
+	UASSERT(!idef->isKnown(name_b));
+	UASSERT(&idef->get(name_a) == &idef->get("test:a"));
+	UASSERT(&idef->get(name_old_a) == &idef->get("test:a"));
+	UASSERT(&idef->get(name_b) == &idef->get("unknown"));
+	UASSERT(idef->get(ItemName()).tool_capabilities);
+
+	ItemStack stack("test:old_a", 10, 0, idef);
+	UASSERT(stack.name == name_a);
+	UASSERTEQ(u16, stack.getStackMax(idef), 42);
+
+	// Registering an item replaces the alias
+	def.name = "test:old_a";
+	def.stack_max = 7;
+	idef->registerItem(def);
+	UASSERTEQ(u16, idef->get(name_old_a).stack_max, 7);
+
+	idef->unregisterItem("test:a");
+	UASSERT(!idef->isKnown(name_a));
+	UASSERT(&idef->get(name_a) == &idef->get("unknown"));
+
+	idef->clear();
+	UASSERT(!idef->isKnown(name_old_a));
+	UASSERT(idef->isKnown(ItemName(std::string("air"))));
+	delete idef;
+}
+
 void TestInventory::testSerializeDeserialize(IItemDefManager *idef)
 {
 	Inventory inv(idef);
@@ -80,6 +132,79 @@ void TestInventory::testSerializeDeserialize(IItemDefManager *idef)
 	UASSERT(leftover == wanted);
 }
 
+static std::string serialize_binary(Inventory &inv, bool incremental)
+{
+	std::ostringstream os(std::ios::binary);
+	inv.serializeBinary(os, incremental);
+	inv.setModified(false);
+	return os.str();
+}
+
+static void deserialize_binary(Inventory &inv, const std::string &data)
+{
+	std::istringstream is(data, std::ios::binary);
+	inv.deSerializeBinary(is);
+}
+
+void TestInventory::testBinaryDelta(IItemDefManager *idef)
+{
+	Inventory server_inv(idef);
+	std::istringstream is(serialized_inventory_in, std::ios::binary);
+	server_inv.deSerialize(is);
+
+	Inventory client_inv(idef);
+	const std::string full = serialize_binary(server_inv, true);
+	deserialize_binary(client_inv, full);
+	UASSERT(client_inv == server_inv);
+	UASSERTEQ(u32, client_inv.getList("0")->getWidth(), 3);
+
+	// Nothing changed
+	const std::string keep = serialize_binary(server_inv, true);
+	UASSERT(keep.size() < full.size());
+	deserialize_binary(client_inv, keep);
+	UASSERT(client_inv == server_inv);
+
+	// Only the changed slots are sent
+	InventoryList *list = server_inv.getList("0");
+	list->takeItem(7, 9);
+	ItemStack tool("default:cobble", 1, 500, idef);
+	tool.metadata.setString("description", "Worn cobble");
+	list->changeItem(3, tool);
+	std::ostringstream full_os(std::ios::binary);
+	server_inv.serializeBinary(full_os, false);
+	const std::string delta = serialize_binary(server_inv, true);
+	UASSERT(delta.size() < full_os.str().size());
+	UASSERT(client_inv != server_inv);
+	deserialize_binary(client_inv, delta);
+	UASSERT(client_inv == server_inv);
+	UASSERTEQ(u16, client_inv.getList("0")->getItem(7).count, 90);
+	UASSERTEQ(u16, client_inv.getList("0")->getItem(3).wear, 500);
+
+	// Resized lists are sent whole, removed lists are dropped
+	list->setSize(4);
+	server_inv.deleteList("abc");
+	deserialize_binary(client_inv, serialize_binary(server_inv, true));
+	UASSERT(client_inv == server_inv);
+	UASSERT(!client_inv.getList("abc"));
+
+	// Changing most of the slots sends the whole list
+	list->deleteItem(0);
+	list->deleteItem(1);
+	list->deleteItem(2);
+	deserialize_binary(client_inv, serialize_binary(server_inv, true));
+	UASSERT(client_inv == server_inv);
+
+	// Changes to lists a client doesn't have yet are skipped
+	Inventory joined_inv(idef);
+	list->changeItem(5, ItemStack("default:stick", 2, 0, idef));
+	deserialize_binary(joined_inv, serialize_binary(server_inv, true));
+	UASSERT(!joined_inv.getList("0"));
+
+	// A client without the list needs the whole inventory
+	deserialize_binary(joined_inv, serialize_binary(server_inv, false));
+	UASSERT(joined_inv == server_inv);
+}
+
 const char *TestInventory::serialized_inventory_in =
 	"List 0 10\n"
 	"Width 3\n"
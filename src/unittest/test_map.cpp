@@ -0,0 +1,282 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "gamedef.h"
+#include "map.h"
+#include "mapblock.h"
+#include "mapsector.h"
+#include "porting.h"
+
+class TestMap : public TestBase {
+public:
+	TestMap() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestMap"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testBlockIndex();
+	void testBlockLookup(IGameDef *gamedef);
+	void testGetNodeThroughput(IGameDef *gamedef);
+	void testUnloadTimeout(IGameDef *gamedef);
+	void testUnloadLimit(IGameDef *gamedef);
+	void testUnloadBounded(IGameDef *gamedef);
+};
+
+static TestMap g_test_instance;
+
+void TestMap::runTests(IGameDef *gamedef)
+{
+	TEST(testBlockIndex);
+	TEST(testBlockLookup, gamedef);
+	TEST(testGetNodeThroughput, gamedef);
+	TEST(testUnloadTimeout, gamedef);
+	TEST(testUnloadLimit, gamedef);
+	TEST(testUnloadBounded, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Bare Map that can create sectors on its own, like ServerMap does
+class SectorMap : public Map {
+public:
+	SectorMap(IGameDef *gamedef) : Map(gamedef) {}
+
+	MapSector *emergeSector(v2s16 p2d)
+	{
+		MapSector *sector = getSectorNoGenerate(p2d);
+		if (!sector) {
+			sector = new MapSector(this, p2d, m_gamedef);
+			m_sectors[p2d] = sector;
+		}
+		return sector;
+	}
+
+	MapBlock *createBlock(v3s16 p)
+	{
+		return emergeSector(v2s16(p.X, p.Z))->createBlankBlock(p.Y);
+	}
+};
+
+// Fake, never dereferenced
+static MapBlock *indexTestBlock(s32 i)
+{
+	return reinterpret_cast<MapBlock *>((uintptr_t)(i + 1) * 64);
+}
+
+static v3s16 indexTestPos(s32 i)
+{
+	// Spread positions over all octants, including the map edges
+	return v3s16(
+		(i * 37) % 4097 - 2048,
+		(i * 11) % 257 - 128,
+		-(i * 53) % 4097 + 2048);
+}
+
+void TestMap::testBlockIndex()
+{
+	const s32 count = 5000;
+	MapBlockIndex index;
+
+	for (s32 i = 0; i < count; i++)
+		index.insert(indexTestPos(i), indexTestBlock(i));
+	UASSERTEQ(size_t, index.size(), count);
+	UASSERT(index.capacity() >= 2 * index.size());
+
+	for (s32 i = 0; i < count; i++)
+		UASSERT(index.get(indexTestPos(i)) == indexTestBlock(i));
+	UASSERT(index.get(v3s16(0, 4000, 0)) == nullptr);
+
+	// Erasing must keep every other probe run intact
+	for (s32 i = 0; i < count; i += 2)
+		index.erase(indexTestPos(i));
+	UASSERTEQ(size_t, index.size(), count / 2);
+	for (s32 i = 0; i < count; i++) {
+		MapBlock *expected = (i % 2) ? indexTestBlock(i) : nullptr;
+		UASSERT(index.get(indexTestPos(i)) == expected);
+	}
+
+	// Erasing a missing position is a no-op
+	index.erase(indexTestPos(0));
+	UASSERTEQ(size_t, index.size(), count / 2);
+
+	index.clear();
+	UASSERTEQ(size_t, index.size(), 0);
+	UASSERT(index.get(indexTestPos(1)) == nullptr);
+}
+
+void TestMap::testBlockLookup(IGameDef *gamedef)
+{
+	SectorMap map(gamedef);
+
+	MapBlock *a = map.createBlock(v3s16(1, 2, 3));
+	MapBlock *b = map.createBlock(v3s16(1, -2, 3));
+	UASSERT(map.getBlockNoCreateNoEx(v3s16(1, 2, 3)) == a);
+	UASSERT(map.getBlockNoCreateNoEx(v3s16(1, -2, 3)) == b);
+	UASSERT(map.getBlockNoCreateNoEx(v3s16(1, 0, 3)) == nullptr);
+
+	// A cached lookup must not survive the deletion of the block
+	MapSector *sector = map.getSectorNoGenerate(v2s16(1, 3));
+	sector->deleteBlock(a);
+	UASSERT(map.getBlockNoCreateNoEx(v3s16(1, 2, 3)) == nullptr);
+	UASSERT(map.getBlockNoCreateNoEx(v3s16(1, -2, 3)) == b);
+
+	// Misses are not cached either
+	MapBlock *c = map.createBlock(v3s16(1, 0, 3));
+	UASSERT(map.getBlockNoCreateNoEx(v3s16(1, 0, 3)) == c);
+
+	// Lookups are per map
+	SectorMap other(gamedef);
+	UASSERT(other.getBlockNoCreateNoEx(v3s16(1, -2, 3)) == nullptr);
+	UASSERT(map.getBlockNoCreateNoEx(v3s16(1, -2, 3)) == b);
+
+	sector->deleteBlocks();
+	UASSERT(map.getBlockNoCreateNoEx(v3s16(1, -2, 3)) == nullptr);
+	UASSERT(map.getBlockNoCreateNoEx(v3s16(1, 0, 3)) == nullptr);
+}
+
+void TestMap::testGetNodeThroughput(IGameDef *gamedef)
+{
+	SectorMap map(gamedef);
+	const s16 size = 8;
+	const MapNode stone(t_CONTENT_STONE);
+
+	for (s16 z = -size / 2; z < size / 2; z++)
+	for (s16 y = -size / 2; y < size / 2; y++)
+	for (s16 x = -size / 2; x < size / 2; x++) {
+		MapBlock *block = map.createBlock(v3s16(x, y, z));
+		MapNode *data = block->getData();
+		for (u32 i = 0; i < MapBlock::nodecount; i++)
+			data[i] = stone;
+	}
+
+	const s16 extent = size / 2 * MAP_BLOCKSIZE;
+	const u32 reads = 1 << 21;
+	u32 found = 0;
+
+	// Scattered reads, every one of them in a different block than the last
+	u64 t0 = porting::getTimeUs();
+	u32 r = 12345;
+	for (u32 i = 0; i < reads; i++) {
+		r = r * 1103515245 + 12345;
+		v3s16 p((s16)((r >> 4) % (2 * extent)) - extent,
+			(s16)((r >> 12) % (2 * extent)) - extent,
+			(s16)((r >> 20) % (2 * extent)) - extent);
+		found += map.getNode(p).getContent() == t_CONTENT_STONE;
+	}
+	u64 t_scattered = porting::getTimeUs() - t0;
+
+	// Sequential reads along X, which mostly hit the MRU cache
+	t0 = porting::getTimeUs();
+	for (u32 i = 0; i < reads; i++) {
+		v3s16 p((s16)(i % (2 * extent)) - extent,
+			(s16)((i / (2 * extent)) % (2 * extent)) - extent, 0);
+		found += map.getNode(p).getContent() == t_CONTENT_STONE;
+	}
+	u64 t_sequential = porting::getTimeUs() - t0;
+
+	UASSERTEQ(u32, found, 2 * reads);
+
+	rawstream << "Map::getNode(): " << reads << " scattered reads in "
+		<< t_scattered << "us, " << reads << " sequential reads in "
+		<< t_sequential << "us" << std::endl;
+}
+
+void TestMap::testUnloadTimeout(IGameDef *gamedef)
+{
+	SectorMap map(gamedef);
+	const float timeout = 10.0f;
+
+	MapBlock *idle = map.createBlock(v3s16(0, 0, 0));
+	MapBlock *used = map.createBlock(v3s16(0, 1, 0));
+	MapBlock *grabbed = map.createBlock(v3s16(5, 0, 5));
+	grabbed->refGrab();
+	(void)idle;
+
+	std::vector<v3s16> unloaded;
+	for (int i = 0; i < 4; i++) {
+		map.timerUpdate(2.0f, timeout, U32_MAX, &unloaded);
+		used->resetUsageTimer();
+	}
+	UASSERT(unloaded.empty());
+	UASSERTEQ(float, used->getUsageTimer(), 0.0f);
+
+	for (int i = 0; i < 4; i++) {
+		map.timerUpdate(2.0f, timeout, U32_MAX, &unloaded);
+		used->resetUsageTimer();
+	}
+	UASSERTEQ(size_t, unloaded.size(), 1);
+	UASSERT(unloaded[0] == v3s16(0, 0, 0));
+	UASSERT(!map.getBlockNoCreateNoEx(v3s16(0, 0, 0)));
+	// The sector still holds the used block
+	UASSERT(map.getSectorNoGenerate(v2s16(0, 0)));
+
+	// Once dropped, the block goes after the next timeout at the latest
+	grabbed->refDrop();
+	unloaded.clear();
+	for (int i = 0; i < 12; i++)
+		map.timerUpdate(2.0f, timeout, U32_MAX, &unloaded);
+	UASSERT(!map.getBlockNoCreateNoEx(v3s16(5, 0, 5)));
+	UASSERT(!map.getSectorNoGenerate(v2s16(5, 5)));
+	UASSERT(!map.getBlockNoCreateNoEx(v3s16(0, 1, 0)));
+	UASSERTEQ(size_t, unloaded.size(), 2);
+}
+
+void TestMap::testUnloadLimit(IGameDef *gamedef)
+{
+	SectorMap map(gamedef);
+
+	for (s16 i = 0; i < 100; i++) {
+		map.createBlock(v3s16(i, 0, 0));
+		map.timerUpdate(0.5f, 1000.0f, U32_MAX);
+	}
+
+	// The least recently used blocks go first
+	std::vector<v3s16> unloaded;
+	map.timerUpdate(0.5f, 1000.0f, 60, &unloaded);
+	UASSERTEQ(size_t, unloaded.size(), 40);
+	for (s16 i = 0; i < 100; i++) {
+		// Filed with a granularity of a second, allow the boundary to blur
+		if (i < 38) {
+			UASSERT(!map.getBlockNoCreateNoEx(v3s16(i, 0, 0)));
+		} else if (i > 42) {
+			UASSERT(map.getBlockNoCreateNoEx(v3s16(i, 0, 0)));
+		}
+	}
+}
+
+void TestMap::testUnloadBounded(IGameDef *gamedef)
+{
+	SectorMap map(gamedef);
+	const u32 count = 2500;
+
+	for (u32 i = 0; i < count; i++)
+		map.createBlock(v3s16(i % 50, i / 50, 0));
+
+	// The work is spread over several calls
+	std::vector<v3s16> unloaded;
+	map.timerUpdate(100.0f, 10.0f, U32_MAX, &unloaded);
+	UASSERT(!unloaded.empty() && unloaded.size() < count);
+
+	for (int i = 0; i < 10 && unloaded.size() < count; i++)
+		map.timerUpdate(1.0f, 10.0f, U32_MAX, &unloaded);
+	UASSERTEQ(size_t, unloaded.size(), count);
+	UASSERT(!map.getSectorNoGenerate(v2s16(0, 0)));
+}
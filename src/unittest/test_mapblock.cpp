@@ -0,0 +1,222 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <sstream>
+#include "gamedef.h"
+#include "mapblock.h"
+#include "serialization.h"
+#include "voxel.h"
+
+class TestMapBlock : public TestBase {
+public:
+	TestMapBlock() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestMapBlock"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testCompressUniform(IGameDef *gamedef);
+	void testCompressPalette(IGameDef *gamedef);
+	void testCompressTooManyNodes(IGameDef *gamedef);
+	void testCompressedVoxelManipulator(IGameDef *gamedef);
+	void testCompressedSerialize(IGameDef *gamedef);
+	void testEmptiness(IGameDef *gamedef);
+
+private:
+	static MapNode patternNode(u32 i, u32 distinct);
+	static void fillPattern(MapBlock &block, u32 distinct);
+};
+
+static TestMapBlock g_test_instance;
+
+void TestMapBlock::runTests(IGameDef *gamedef)
+{
+	TEST(testCompressUniform, gamedef);
+	TEST(testCompressPalette, gamedef);
+	TEST(testCompressTooManyNodes, gamedef);
+	TEST(testCompressedVoxelManipulator, gamedef);
+	TEST(testCompressedSerialize, gamedef);
+	TEST(testEmptiness, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MapNode TestMapBlock::patternNode(u32 i, u32 distinct)
+{
+	const content_t contents[] = {
+		t_CONTENT_STONE, t_CONTENT_GRASS, t_CONTENT_WATER, t_CONTENT_BRICK
+	};
+	u32 k = (i * 7 + i / 16) % distinct;
+	return MapNode(contents[k % 4], k / 4, (k * 3) % 5);
+}
+
+void TestMapBlock::fillPattern(MapBlock &block, u32 distinct)
+{
+	MapNode *data = block.getData();
+	for (u32 i = 0; i < MapBlock::nodecount; i++)
+		data[i] = patternNode(i, distinct);
+}
+
+void TestMapBlock::testCompressUniform(IGameDef *gamedef)
+{
+	MapBlock block(nullptr, v3s16(0, 0, 0), gamedef);
+	MapNode n(t_CONTENT_STONE, 0, 0);
+	MapNode *data = block.getData();
+	for (u32 i = 0; i < MapBlock::nodecount; i++)
+		data[i] = n;
+
+	UASSERT(block.compressNodes());
+	UASSERT(block.isCompressed());
+	UASSERT(!block.isDummy());
+	UASSERT(block.getNodeStorageSize() < 16);
+	UASSERT(block.getNodeNoEx(v3s16(5, 6, 7)) == n);
+
+	// Writing expands the block again
+	MapNode brick(t_CONTENT_BRICK);
+	block.setNode(v3s16(1, 2, 3), brick);
+	UASSERT(!block.isCompressed());
+	UASSERT(!block.isCompressionChecked());
+	UASSERT(block.getNodeNoEx(v3s16(1, 2, 3)) == brick);
+	UASSERT(block.getNodeNoEx(v3s16(3, 2, 1)) == n);
+}
+
+void TestMapBlock::testCompressPalette(IGameDef *gamedef)
+{
+	const u32 distinct_counts[] = {2, 3, 4, 13, 16, 17, 200, 256};
+	for (u32 distinct : distinct_counts) {
+		MapBlock block(nullptr, v3s16(0, 0, 0), gamedef);
+		fillPattern(block, distinct);
+
+		UASSERT(block.compressNodes());
+		UASSERT(block.isCompressed());
+		UASSERT(block.getNodeStorageSize() <=
+				MapBlock::nodecount * sizeof(MapNode) / 4 + 256 * sizeof(MapNode));
+
+		for (u32 i = 0; i < MapBlock::nodecount; i++) {
+			v3s16 p(i % MAP_BLOCKSIZE, (i / MAP_BLOCKSIZE) % MAP_BLOCKSIZE,
+				i / (MAP_BLOCKSIZE * MAP_BLOCKSIZE));
+			UASSERT(block.getNodeNoEx(p) == patternNode(i, distinct));
+		}
+
+		// getData() users see the same nodes
+		MapNode *data = block.getData();
+		UASSERT(!block.isCompressed());
+		for (u32 i = 0; i < MapBlock::nodecount; i++)
+			UASSERT(data[i] == patternNode(i, distinct));
+	}
+}
+
+void TestMapBlock::testCompressTooManyNodes(IGameDef *gamedef)
+{
+	MapBlock block(nullptr, v3s16(0, 0, 0), gamedef);
+	fillPattern(block, 257);
+
+	UASSERT(!block.compressNodes());
+	UASSERT(!block.isCompressed());
+	UASSERT(block.isCompressionChecked());
+	UASSERTEQ(u32, block.getNodeStorageSize(),
+			MapBlock::nodecount * sizeof(MapNode));
+}
+
+void TestMapBlock::testCompressedVoxelManipulator(IGameDef *gamedef)
+{
+	MapBlock block(nullptr, v3s16(1, -1, 2), gamedef);
+	fillPattern(block, 5);
+	UASSERT(block.compressNodes());
+
+	VoxelManipulator v;
+	v3s16 p0 = block.getPosRelative();
+	v.addArea(VoxelArea(p0, p0 + v3s16(MAP_BLOCKSIZE - 1,
+		MAP_BLOCKSIZE - 1, MAP_BLOCKSIZE - 1)));
+	block.copyTo(v);
+	UASSERT(block.isCompressed());
+
+	u32 i = 0;
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++, i++)
+		UASSERT(v.getNodeNoExNoEmerge(p0 + v3s16(x, y, z)) == patternNode(i, 5));
+
+	// CONTENT_IGNORE in the VoxelManipulator keeps the existing node
+	MapNode brick(t_CONTENT_BRICK);
+	v.setNodeNoEmerge(p0 + v3s16(4, 5, 6), brick);
+	v.setNodeNoEmerge(p0 + v3s16(7, 8, 9), MapNode(CONTENT_IGNORE));
+	block.copyFrom(v);
+	UASSERT(!block.isCompressed());
+	UASSERT(block.getNodeNoEx(v3s16(4, 5, 6)) == brick);
+	u32 kept = 9 * MAP_BLOCKSIZE * MAP_BLOCKSIZE + 8 * MAP_BLOCKSIZE + 7;
+	UASSERT(block.getNodeNoEx(v3s16(7, 8, 9)) == patternNode(kept, 5));
+}
+
+void TestMapBlock::testCompressedSerialize(IGameDef *gamedef)
+{
+	MapBlock flat(nullptr, v3s16(0, 0, 0), gamedef);
+	MapBlock compressed(nullptr, v3s16(0, 0, 0), gamedef);
+	fillPattern(flat, 9);
+	fillPattern(compressed, 9);
+	UASSERT(compressed.compressNodes());
+
+	std::ostringstream os_flat(std::ios_base::binary);
+	std::ostringstream os_compressed(std::ios_base::binary);
+	flat.serialize(os_flat, SER_FMT_VER_HIGHEST_WRITE, true, -1);
+	compressed.serialize(os_compressed, SER_FMT_VER_HIGHEST_WRITE, true, -1);
+	UASSERT(os_flat.str() == os_compressed.str());
+
+	// Deserializing into a compressed block replaces its nodes
+	MapBlock loaded(nullptr, v3s16(0, 0, 0), gamedef);
+	fillPattern(loaded, 2);
+	UASSERT(loaded.compressNodes());
+	std::istringstream is(os_flat.str(), std::ios_base::binary);
+	loaded.deSerialize(is, SER_FMT_VER_HIGHEST_WRITE, true);
+	UASSERT(!loaded.isCompressed());
+	for (u32 i = 0; i < MapBlock::nodecount; i++)
+		UASSERT(loaded.getData()[i] == patternNode(i, 9));
+}
+
+void TestMapBlock::testEmptiness(IGameDef *gamedef)
+{
+	const u8 all = BLOCK_EMPTY_AIR | BLOCK_EMPTY_POINTABLE |
+			BLOCK_EMPTY_LIQUIDS_POINTABLE;
+	MapBlock block(nullptr, v3s16(0, 0, 0), gamedef);
+
+	// Fresh blocks are ignore, which is neither air nor pointable
+	UASSERTEQ(u8, block.getEmptiness(),
+		BLOCK_EMPTY_POINTABLE | BLOCK_EMPTY_LIQUIDS_POINTABLE);
+
+	MapNode air(CONTENT_AIR);
+	MapNode *data = block.getData();
+	for (u32 i = 0; i < MapBlock::nodecount; i++)
+		data[i] = air;
+	block.raiseModified(MOD_STATE_WRITE_NEEDED);
+	UASSERTEQ(u8, block.getEmptiness(), all);
+
+	// Writes expire the flags
+	MapNode stone(t_CONTENT_STONE);
+	block.setNode(v3s16(15, 15, 15), stone);
+	UASSERTEQ(u8, block.getEmptiness(), 0);
+
+	block.setNode(v3s16(15, 15, 15), air);
+	UASSERTEQ(u8, block.getEmptiness(), all);
+
+	// Compressed blocks look at their palette
+	block.setNode(v3s16(3, 0, 7), stone);
+	UASSERT(block.compressNodes());
+	UASSERTEQ(u8, block.getEmptiness(), 0);
+}
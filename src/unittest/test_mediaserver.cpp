@@ -0,0 +1,213 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "filesys.h"
+#include "network/mediaserver.h"
+#include "network/socket.h"
+#include "util/hashing.h"
+#include "util/hex.h"
+#include "util/serialize.h"
+#include "util/string.h"
+#include <sstream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+class TestMediaServer : public TestBase {
+public:
+	TestMediaServer() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestMediaServer"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testGet();
+	void testRange();
+	void testHashSet();
+	void testBulkDownload();
+
+private:
+	std::string request(const std::string &request);
+	std::string body(const std::string &response);
+
+	std::unique_ptr<MediaHTTPServer> m_server;
+	std::string m_memory_sha1, m_disk_sha1;
+	const std::string m_memory_data = "media kept in memory";
+	const std::string m_disk_data = "media that is read from the disk";
+};
+
+static TestMediaServer g_test_instance;
+
+void TestMediaServer::runTests(IGameDef *gamedef)
+{
+	m_server.reset(new MediaHTTPServer());
+	try {
+		m_server->listen(Address(127, 0, 0, 1, 0));
+	} catch (SocketException &e) {
+		dstream << "WARNING: media server could not listen (unit test)"
+			<< std::endl;
+		return;
+	}
+
+	std::string path = getTestTempFile();
+	UASSERT(fs::safeWriteToFile(path, m_disk_data));
+
+	m_memory_sha1 = hashing::sha1(m_memory_data);
+	m_disk_sha1 = hashing::sha1(m_disk_data);
+	m_server->addFile(m_memory_sha1, "", m_memory_data.size(),
+			std::make_shared<const std::string>(m_memory_data));
+	m_server->addFile(m_disk_sha1, path, m_disk_data.size(), nullptr);
+	m_server->start();
+
+	TEST(testGet);
+	TEST(testRange);
+	TEST(testHashSet);
+	TEST(testBulkDownload);
+
+	m_server.reset();
+	fs::DeleteSingleFileOrEmptyDirectory(path);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string TestMediaServer::request(const std::string &request)
+{
+	Address addr(127, 0, 0, 1, m_server->getPort());
+	struct sockaddr_in address = addr.getAddress();
+	address.sin_family = AF_INET;
+	address.sin_port = htons(addr.getPort());
+
+	int handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	UASSERT(handle >= 0);
+	UASSERT(connect(handle, (const struct sockaddr *)&address, sizeof(address)) == 0);
+	UASSERT(send(handle, request.c_str(), request.size(), 0) == (int)request.size());
+
+	// The server closes the connection after the response
+	std::string response;
+	char buf[1024];
+	int len;
+	while ((len = recv(handle, buf, sizeof(buf), 0)) > 0)
+		response.append(buf, len);
+
+#ifdef _WIN32
+	closesocket(handle);
+#else
+	close(handle);
+#endif
+	return response;
+}
+
+std::string TestMediaServer::body(const std::string &response)
+{
+	size_t pos = response.find("\r\n\r\n");
+	UASSERT(pos != std::string::npos);
+	return response.substr(pos + 4);
+}
+
+void TestMediaServer::testGet()
+{
+	std::string response = request("GET /" + hex_encode(m_memory_sha1) +
+			" HTTP/1.1\r\nConnection: close\r\n\r\n");
+	UASSERT(str_starts_with(response, "HTTP/1.1 200 OK\r\n"));
+	UASSERTEQ(std::string, body(response), m_memory_data);
+
+	response = request("GET /" + hex_encode(m_disk_sha1) + " HTTP/1.0\r\n\r\n");
+	UASSERT(str_starts_with(response, "HTTP/1.1 200 OK\r\n"));
+	UASSERTEQ(std::string, body(response), m_disk_data);
+
+	response = request("HEAD /" + hex_encode(m_disk_sha1) + " HTTP/1.0\r\n\r\n");
+	UASSERT(response.find("Content-Length: " +
+			std::to_string(m_disk_data.size()) + "\r\n") != std::string::npos);
+	UASSERTEQ(std::string, body(response), "");
+
+	response = request("GET /" + hex_encode(hashing::sha1("unknown")) +
+			" HTTP/1.0\r\n\r\n");
+	UASSERT(str_starts_with(response, "HTTP/1.1 404 Not Found\r\n"));
+
+	// Several requests on one connection
+	response = request("GET /" + hex_encode(m_memory_sha1) + " HTTP/1.1\r\n\r\n"
+			"GET /" + hex_encode(m_disk_sha1) + " HTTP/1.1\r\n"
+			"Connection: close\r\n\r\n");
+	size_t second = response.find("HTTP/1.1 200 OK", 1);
+	UASSERT(second != std::string::npos);
+	UASSERTEQ(std::string, body(response.substr(0, second)), m_memory_data);
+	UASSERTEQ(std::string, body(response.substr(second)), m_disk_data);
+}
+
+void TestMediaServer::testRange()
+{
+	const std::string memory = "/" + hex_encode(m_memory_sha1) + " HTTP/1.0\r\n";
+	const std::string disk = "/" + hex_encode(m_disk_sha1) + " HTTP/1.0\r\n";
+
+	std::string response = request("GET " + memory + "Range: bytes=6-9\r\n\r\n");
+	UASSERT(str_starts_with(response, "HTTP/1.1 206 Partial Content\r\n"));
+	UASSERT(response.find("Content-Range: bytes 6-9/" +
+			std::to_string(m_memory_data.size()) + "\r\n") != std::string::npos);
+	UASSERTEQ(std::string, body(response), m_memory_data.substr(6, 4));
+
+	response = request("GET " + disk + "Range: bytes=5-\r\n\r\n");
+	UASSERTEQ(std::string, body(response), m_disk_data.substr(5));
+
+	response = request("GET " + disk + "Range: bytes=-4\r\n\r\n");
+	UASSERTEQ(std::string, body(response), m_disk_data.substr(m_disk_data.size() - 4));
+
+	response = request("GET " + disk + "Range: bytes=1000-\r\n\r\n");
+	UASSERT(str_starts_with(response, "HTTP/1.1 416 Range Not Satisfiable\r\n"));
+
+	// Multiple ranges are not supported, the whole file is sent
+	response = request("GET " + disk + "Range: bytes=0-1,4-5\r\n\r\n");
+	UASSERT(str_starts_with(response, "HTTP/1.1 200 OK\r\n"));
+	UASSERTEQ(std::string, body(response), m_disk_data);
+}
+
+void TestMediaServer::testHashSet()
+{
+	std::string set("MTHS\0\1", 6);
+	set += m_disk_sha1 + hashing::sha1("unknown") + m_memory_sha1;
+
+	std::string response = request("POST /index.mth HTTP/1.0\r\n"
+			"Content-Length: " + std::to_string(set.size()) + "\r\n\r\n" + set);
+	UASSERT(str_starts_with(response, "HTTP/1.1 200 OK\r\n"));
+	UASSERTEQ(std::string, body(response),
+			std::string("MTHS\0\2", 6) + m_disk_sha1 + m_memory_sha1);
+
+	response = request("POST /index.mth HTTP/1.0\r\n"
+			"Content-Length: 4\r\n\r\nMTHS");
+	UASSERT(str_starts_with(response, "HTTP/1.1 400 Bad Request\r\n"));
+}
+
+void TestMediaServer::testBulkDownload()
+{
+	std::string hashes = m_disk_sha1 + m_memory_sha1;
+	std::string response = request("POST /bulk-download HTTP/1.0\r\n"
+			"Content-Length: " + std::to_string(hashes.size()) + "\r\n\r\n" + hashes);
+	UASSERT(str_starts_with(response, "HTTP/1.1 200 OK\r\n"));
+
+	std::istringstream is(body(response), std::ios::binary);
+	UASSERTEQ(std::string, deSerializeString32(is), m_disk_data);
+	UASSERTEQ(std::string, deSerializeString32(is), m_memory_data);
+	UASSERT(is.peek() == EOF);
+
+	hashes += hashing::sha1("unknown");
+	response = request("POST /bulk-download HTTP/1.0\r\n"
+			"Content-Length: " + std::to_string(hashes.size()) + "\r\n\r\n" + hashes);
+	UASSERT(str_starts_with(response, "HTTP/1.1 404 Not Found\r\n"));
+}
@@ -0,0 +1,139 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "script/cpp_api/s_accounting.h"
+#include "script/cpp_api/s_base.h"
+#include <chrono>
+#include <thread>
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+class TestModAccounting : public TestBase
+{
+public:
+	TestModAccounting() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestModAccounting"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testTime();
+	void testNesting();
+	void testAllocations();
+};
+
+static TestModAccounting g_test_instance;
+
+void TestModAccounting::runTests(IGameDef *gamedef)
+{
+	TEST(testTime);
+	TEST(testNesting);
+	TEST(testAllocations);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static ModUsage get_usage(const ModAccounting &accounting, const std::string &mod)
+{
+	std::vector<ModUsage> usage;
+	accounting.getUsage(usage);
+	for (const ModUsage &it : usage) {
+		if (it.mod == mod)
+			return it;
+	}
+	return ModUsage();
+}
+
+void TestModAccounting::testTime()
+{
+	ModAccounting accounting;
+	{
+		ModAccountingScope scope(&accounting);
+		accounting.setMod("a");
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		accounting.setMod("b");
+		accounting.setMod("a");
+	}
+	UASSERT(get_usage(accounting, "a").time_us >= 20000);
+	UASSERTEQ(u64, get_usage(accounting, "a").calls, 2);
+	UASSERTEQ(u64, get_usage(accounting, "b").calls, 1);
+
+	// Nothing is charged outside of a scope
+	u64 time_a = get_usage(accounting, "a").time_us;
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	{
+		ModAccountingScope scope(&accounting);
+	}
+	UASSERTEQ(u64, get_usage(accounting, "a").time_us, time_a);
+	UASSERT(get_usage(accounting, BUILTIN_MOD_NAME).time_us < 20000);
+
+	// Disabled accounting
+	ModAccountingScope scope(nullptr);
+}
+
+void TestModAccounting::testNesting()
+{
+	ModAccounting accounting;
+	{
+		ModAccountingScope scope(&accounting);
+		accounting.setMod("a");
+		{
+			// Time in a nested scope goes to the caller until a mod runs
+			ModAccountingScope nested(&accounting);
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			accounting.setMod("b");
+		}
+		UASSERT(get_usage(accounting, "a").time_us >= 20000);
+		UASSERT(get_usage(accounting, "b").time_us < 20000);
+
+		// Back to a after the nested scope
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+	UASSERT(get_usage(accounting, "a").time_us >= 40000);
+	UASSERT(get_usage(accounting, BUILTIN_MOD_NAME).time_us < 20000);
+
+	{
+		ModAccountingScope scope(&accounting, "c");
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+	UASSERT(get_usage(accounting, "c").time_us >= 20000);
+}
+
+void TestModAccounting::testAllocations()
+{
+	lua_State *L = luaL_newstate();
+	ModAccounting accounting;
+	accounting.hookAllocator(L);
+	{
+		ModAccountingScope scope(&accounting, "a");
+		lua_createtable(L, 100000, 0);
+		lua_pop(L, 1);
+		accounting.setMod("b");
+		lua_pushstring(L, "a string allocated by b");
+		lua_pop(L, 1);
+	}
+	lua_close(L);
+
+	UASSERT(get_usage(accounting, "a").alloc_bytes >= 100000 * sizeof(lua_Number));
+	UASSERT(get_usage(accounting, "b").alloc_bytes > 0);
+	UASSERT(get_usage(accounting, "b").alloc_bytes < 1000);
+}
@@ -0,0 +1,379 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <algorithm>
+#include "content/mods.h"
+#include "database/database-dummy.h"
+#include "database/database-files.h"
+#include "database/database-sqlite3.h"
+#include "filesys.h"
+
+namespace
+{
+// Anonymous namespace to create classes that are only
+// visible to this file
+//
+// These are helpers that return a *ModMetadataDatabase and
+// allow us to run the same tests on different databases and
+// database acquisition strategies.
+
+class ModMetadataDatabaseProvider
+{
+public:
+	virtual ~ModMetadataDatabaseProvider() = default;
+	virtual ModMetadataDatabase *getModMetadataDatabase() = 0;
+};
+
+class FixedProvider : public ModMetadataDatabaseProvider
+{
+public:
+	FixedProvider(ModMetadataDatabase *mod_meta_db) : mod_meta_db(mod_meta_db){};
+	virtual ~FixedProvider(){};
+	virtual ModMetadataDatabase *getModMetadataDatabase() { return mod_meta_db; };
+
+private:
+	ModMetadataDatabase *mod_meta_db;
+};
+
+class FilesProvider : public ModMetadataDatabaseProvider
+{
+public:
+	FilesProvider(const std::string &dir) : dir(dir){};
+	virtual ~FilesProvider() { delete mod_meta_db; };
+	virtual ModMetadataDatabase *getModMetadataDatabase()
+	{
+		delete mod_meta_db;
+		mod_meta_db = new ModMetadataDatabaseFiles(dir);
+		return mod_meta_db;
+	};
+
+private:
+	std::string dir;
+	ModMetadataDatabase *mod_meta_db = nullptr;
+};
+
+class SQLite3Provider : public ModMetadataDatabaseProvider
+{
+public:
+	SQLite3Provider(const std::string &dir) : dir(dir){};
+	virtual ~SQLite3Provider() { delete mod_meta_db; };
+	virtual ModMetadataDatabase *getModMetadataDatabase()
+	{
+		delete mod_meta_db;
+		mod_meta_db = new ModMetadataDatabaseSQLite3(dir);
+		return mod_meta_db;
+	};
+
+private:
+	std::string dir;
+	ModMetadataDatabase *mod_meta_db = nullptr;
+};
+
+// Fails to remove all entries of a mod until told otherwise
+class FailingRemoveDatabase : public Database_Dummy
+{
+public:
+	bool removeModEntries(const std::string &modname)
+	{
+		return !fail_remove && Database_Dummy::removeModEntries(modname);
+	}
+
+	bool fail_remove = true;
+};
+}
+
+class TestModMetadataDatabase : public TestBase
+{
+public:
+	TestModMetadataDatabase() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestModMetadataDatabase"; }
+
+	void runTests(IGameDef *gamedef);
+	void runTestsForCurrentDB();
+
+	void testRecallFail();
+	void testCreate();
+	void testRecall();
+	void testChange();
+	void testRecallChanged();
+	void testBinaryData();
+	void testListMods();
+	void testRemove();
+	void testModMetadata();
+	void testModMetadataClear();
+	void testModMetadataClearFailure();
+
+private:
+	ModMetadataDatabaseProvider *mod_meta_provider;
+};
+
+static TestModMetadataDatabase g_test_instance;
+
+void TestModMetadataDatabase::runTests(IGameDef *gamedef)
+{
+	// fixed directory, for persistence
+	thread_local const std::string test_dir = getTestTempDirectory();
+
+	// Each set of tests is run twice for each database type:
+	// one where we reuse the same ModMetadataDatabase object (to test local caching),
+	// and one where we create a new ModMetadataDatabase object for each call
+	// (to test actual persistence).
+
+	rawstream << "-------- Files database (same object)" << std::endl;
+
+	ModMetadataDatabase *mod_meta_db = new ModMetadataDatabaseFiles(test_dir);
+	mod_meta_provider = new FixedProvider(mod_meta_db);
+
+	runTestsForCurrentDB();
+
+	delete mod_meta_db;
+	delete mod_meta_provider;
+
+	// reset database
+	fs::RecursiveDelete(test_dir + DIR_DELIM + "mod_storage");
+
+	rawstream << "-------- Files database (new objects)" << std::endl;
+
+	mod_meta_provider = new FilesProvider(test_dir);
+
+	runTestsForCurrentDB();
+
+	delete mod_meta_provider;
+
+	rawstream << "-------- SQLite3 database (same object)" << std::endl;
+
+	mod_meta_db = new ModMetadataDatabaseSQLite3(test_dir);
+	mod_meta_provider = new FixedProvider(mod_meta_db);
+
+	runTestsForCurrentDB();
+
+	delete mod_meta_db;
+	delete mod_meta_provider;
+
+	// reset database
+	fs::DeleteSingleFileOrEmptyDirectory(test_dir + DIR_DELIM + "mod_storage.sqlite");
+
+	rawstream << "-------- SQLite3 database (new objects)" << std::endl;
+
+	mod_meta_provider = new SQLite3Provider(test_dir);
+
+	runTestsForCurrentDB();
+
+	delete mod_meta_provider;
+
+	rawstream << "-------- Dummy database" << std::endl;
+
+	mod_meta_db = new Database_Dummy();
+	mod_meta_provider = new FixedProvider(mod_meta_db);
+
+	runTestsForCurrentDB();
+
+	delete mod_meta_db;
+	delete mod_meta_provider;
+
+	TEST(testModMetadataClearFailure);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestModMetadataDatabase::runTestsForCurrentDB()
+{
+	TEST(testRecallFail);
+	TEST(testCreate);
+	TEST(testRecall);
+	TEST(testChange);
+	TEST(testRecallChanged);
+	TEST(testBinaryData);
+	TEST(testListMods);
+	TEST(testRemove);
+	TEST(testRecallFail);
+	TEST(testModMetadata);
+	TEST(testModMetadataClear);
+}
+
+void TestModMetadataDatabase::testRecallFail()
+{
+	ModMetadataDatabase *mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	StringMap recalled;
+	mod_meta_db->getModEntries("mod1", &recalled);
+	UASSERT(recalled.empty());
+}
+
+void TestModMetadataDatabase::testCreate()
+{
+	ModMetadataDatabase *mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	mod_meta_db->beginSave();
+	UASSERT(mod_meta_db->setModEntry("mod1", "key1", "value1"));
+	UASSERT(mod_meta_db->setModEntry("mod1", "key2", "value2"));
+	mod_meta_db->endSave();
+}
+
+void TestModMetadataDatabase::testRecall()
+{
+	ModMetadataDatabase *mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	StringMap recalled;
+	UASSERT(mod_meta_db->getModEntries("mod1", &recalled));
+	UASSERTEQ(size_t, recalled.size(), 2);
+	UASSERTEQ(std::string, recalled["key1"], "value1");
+	UASSERTEQ(std::string, recalled["key2"], "value2");
+}
+
+void TestModMetadataDatabase::testChange()
+{
+	ModMetadataDatabase *mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	mod_meta_db->beginSave();
+	UASSERT(mod_meta_db->setModEntry("mod1", "key1", "value3"));
+	mod_meta_db->endSave();
+}
+
+void TestModMetadataDatabase::testRecallChanged()
+{
+	ModMetadataDatabase *mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	StringMap recalled;
+	UASSERT(mod_meta_db->getModEntries("mod1", &recalled));
+	UASSERTEQ(size_t, recalled.size(), 2);
+	UASSERTEQ(std::string, recalled["key1"], "value3");
+	UASSERTEQ(std::string, recalled["key2"], "value2");
+}
+
+void TestModMetadataDatabase::testBinaryData()
+{
+	const std::string value("a\0b", 3);
+
+	ModMetadataDatabase *mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	mod_meta_db->beginSave();
+	UASSERT(mod_meta_db->setModEntry("mod2", "bin", value));
+	mod_meta_db->endSave();
+
+	mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	StringMap recalled;
+	UASSERT(mod_meta_db->getModEntries("mod2", &recalled));
+	UASSERTEQ(size_t, recalled.size(), 1);
+	UASSERT(recalled["bin"] == value);
+}
+
+void TestModMetadataDatabase::testListMods()
+{
+	ModMetadataDatabase *mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	std::vector<std::string> mod_list;
+	mod_meta_db->listMods(&mod_list);
+	// not necessarily sorted, so sort before comparing
+	std::sort(mod_list.begin(), mod_list.end());
+	UASSERTEQ(std::string, str_join(mod_list, ","), "mod1,mod2");
+}
+
+void TestModMetadataDatabase::testRemove()
+{
+	ModMetadataDatabase *mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	mod_meta_db->beginSave();
+	UASSERT(mod_meta_db->removeModEntry("mod1", "key1"));
+	UASSERT(mod_meta_db->removeModEntry("mod1", "no_such_key"));
+	mod_meta_db->endSave();
+
+	mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	StringMap recalled;
+	UASSERT(mod_meta_db->getModEntries("mod1", &recalled));
+	UASSERTEQ(size_t, recalled.size(), 1);
+	UASSERTEQ(std::string, recalled["key2"], "value2");
+
+	mod_meta_db->beginSave();
+	UASSERT(mod_meta_db->removeModEntries("mod1"));
+	UASSERT(mod_meta_db->removeModEntries("mod2"));
+	mod_meta_db->endSave();
+}
+
+void TestModMetadataDatabase::testModMetadata()
+{
+	ModMetadataDatabase *mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	ModMetadata meta("mod3");
+	UASSERT(meta.load(mod_meta_db));
+	UASSERT(!meta.isModified());
+
+	meta.setString("a", "1");
+	meta.setString("b", "2");
+	UASSERT(meta.isModified());
+	mod_meta_db->beginSave();
+	UASSERT(meta.save(mod_meta_db));
+	mod_meta_db->endSave();
+	UASSERT(!meta.isModified());
+
+	// Setting an unchanged value must not mark the storage as modified
+	meta.setString("a", "1");
+	UASSERT(!meta.isModified());
+
+	meta.setString("b", "");
+	UASSERT(meta.isModified());
+	mod_meta_db->beginSave();
+	UASSERT(meta.save(mod_meta_db));
+	mod_meta_db->endSave();
+
+	mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	ModMetadata recalled("mod3");
+	UASSERT(recalled.load(mod_meta_db));
+	UASSERTEQ(size_t, recalled.size(), 1);
+	UASSERTEQ(std::string, recalled.getString("a"), "1");
+}
+
+void TestModMetadataDatabase::testModMetadataClear()
+{
+	ModMetadataDatabase *mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	ModMetadata meta("mod3");
+	UASSERT(meta.load(mod_meta_db));
+
+	// Replace the whole content, like StorageRef:from_table() does
+	meta.clear();
+	meta.setString("c", "3");
+	mod_meta_db->beginSave();
+	UASSERT(meta.save(mod_meta_db));
+	mod_meta_db->endSave();
+
+	mod_meta_db = mod_meta_provider->getModMetadataDatabase();
+	StringMap recalled;
+	UASSERT(mod_meta_db->getModEntries("mod3", &recalled));
+	UASSERTEQ(size_t, recalled.size(), 1);
+	UASSERTEQ(std::string, recalled["c"], "3");
+
+	mod_meta_db->beginSave();
+	UASSERT(mod_meta_db->removeModEntries("mod3"));
+	mod_meta_db->endSave();
+}
+
+void TestModMetadataDatabase::testModMetadataClearFailure()
+{
+	FailingRemoveDatabase db;
+	db.setModEntry("mod4", "a", "1");
+	db.setModEntry("mod4", "b", "2");
+
+	ModMetadata meta("mod4");
+	UASSERT(meta.load(&db));
+	meta.clear();
+	meta.setString("c", "3");
+	UASSERT(!meta.save(&db));
+	UASSERT(meta.isModified());
+
+	// The next save still removes the old entries
+	db.fail_remove = false;
+	UASSERT(meta.save(&db));
+	StringMap recalled;
+	UASSERT(db.getModEntries("mod4", &recalled));
+	UASSERTEQ(size_t, recalled.size(), 1);
+	UASSERTEQ(std::string, recalled["c"], "3");
+}
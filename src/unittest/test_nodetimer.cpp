@@ -0,0 +1,213 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <sstream>
+#include "nodetimer.h"
+#include "util/basic_macros.h"
+
+class TestNodeTimer : public TestBase {
+public:
+	TestNodeTimer() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestNodeTimer"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testListStep();
+	void testListSerialize();
+	void testWheel();
+	void testWheelFarFuture();
+	void testAttached();
+};
+
+static TestNodeTimer g_test_instance;
+
+void TestNodeTimer::runTests(IGameDef *gamedef)
+{
+	TEST(testListStep);
+	TEST(testListSerialize);
+	TEST(testWheel);
+	TEST(testWheelFarFuture);
+	TEST(testAttached);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestNodeTimer::testListStep()
+{
+	NodeTimerList list;
+	list.set(NodeTimer(3.0f, 0.0f, v3s16(1, 2, 3)));
+	list.set(NodeTimer(1.0f, 0.0f, v3s16(15, 15, 15)));
+	list.set(NodeTimer(5.0f, 0.0f, v3s16(0, 0, 0)));
+	list.remove(v3s16(0, 0, 0));
+	UASSERTEQ(size_t, list.size(), 2);
+
+	UASSERT(list.step(0.5f).empty());
+	NodeTimer t = list.get(v3s16(1, 2, 3));
+	UASSERT(t.timeout == 3.0f && t.elapsed == 0.5f);
+
+	// Ordered by trigger time
+	std::vector<NodeTimer> elapsed = list.step(3.0f);
+	UASSERTEQ(size_t, elapsed.size(), 2);
+	UASSERT(elapsed[0].position == v3s16(15, 15, 15));
+	UASSERT(elapsed[0].elapsed == 3.5f);
+	UASSERT(elapsed[1].position == v3s16(1, 2, 3));
+	UASSERT(elapsed[1].elapsed == 3.5f);
+	UASSERTEQ(size_t, list.size(), 0);
+	UASSERT(list.get(v3s16(1, 2, 3)).timeout == 0.0f);
+}
+
+void TestNodeTimer::testListSerialize()
+{
+	NodeTimerList list;
+	list.set(NodeTimer(10.0f, 2.0f, v3s16(4, 5, 6)));
+	list.set(NodeTimer(1.5f, 0.0f, v3s16(0, 15, 0)));
+	list.step(1.0f);
+
+	std::ostringstream os(std::ios::binary);
+	list.serialize(os, 28);
+
+	NodeTimerList list2;
+	std::istringstream is(os.str(), std::ios::binary);
+	list2.deSerialize(is, 28);
+
+	UASSERTEQ(size_t, list2.size(), 2);
+	NodeTimer t = list2.get(v3s16(4, 5, 6));
+	UASSERT(t.timeout == 10.0f && t.elapsed == 3.0f);
+	t = list2.get(v3s16(0, 15, 0));
+	UASSERT(t.timeout == 1.5f && t.elapsed == 1.0f);
+}
+
+void TestNodeTimer::testWheel()
+{
+	NodeTimerWheel wheel(0.05f);
+	std::vector<NodeTimerWheel::Expired> expired;
+
+	u32 late = wheel.schedule(7.0, v3s16(1, 0, 0), 1);
+	u32 early = wheel.schedule(0.3, v3s16(2, 0, 0), 2);
+	u32 middle = wheel.schedule(4.0, v3s16(3, 0, 0), 3);
+	// Already due ones come up on the next step
+	u32 due = wheel.schedule(-1.0, v3s16(4, 0, 0), 4);
+
+	wheel.advance(0.2f, expired);
+	UASSERTEQ(size_t, expired.size(), 1);
+	UASSERTEQ(u32, expired[0].id, due);
+
+	// Never early
+	expired.clear();
+	wheel.advance(0.09f, expired);
+	UASSERT(expired.empty());
+	wheel.advance(0.02f, expired);
+	UASSERTEQ(size_t, expired.size(), 1);
+	UASSERTEQ(u32, expired[0].id, early);
+	UASSERT(expired[0].blockpos == v3s16(2, 0, 0));
+	UASSERTEQ(u16, expired[0].index, 2);
+
+	// Several in one step come ordered by trigger time
+	expired.clear();
+	for (int i = 0; i < 50; i++)
+		wheel.advance(0.2f, expired);
+	UASSERTEQ(size_t, expired.size(), 2);
+	UASSERTEQ(u32, expired[0].id, middle);
+	UASSERTEQ(u32, expired[1].id, late);
+	UASSERTEQ(size_t, wheel.size(), 0);
+}
+
+void TestNodeTimer::testWheelFarFuture()
+{
+	// Small resolution so that the steps below cross all levels
+	NodeTimerWheel wheel(1.0f);
+	std::vector<NodeTimerWheel::Expired> expired;
+
+	const double triggers[] = {63, 64, 65, 4095, 4097, 262143, 262145,
+		16777215, 16777217, 40000000};
+	for (double trigger : triggers)
+		wheel.schedule(trigger, v3s16(0, 0, 0), 0);
+
+	double time = 0;
+	size_t n = 0;
+	while (n < ARRLEN(triggers)) {
+		// One tick at first, so that the cascading of single slots is
+		// covered as well
+		f32 dtime = time < 300 ? 1.0f : 1000.0f;
+		wheel.advance(dtime, expired);
+		time += dtime;
+		for (; n < expired.size(); n++) {
+			UASSERT(expired[n].trigger_time == triggers[n]);
+			UASSERT(expired[n].trigger_time <= time);
+			UASSERT(expired[n].trigger_time > time - dtime);
+		}
+		UASSERT(time < 40001000);
+	}
+}
+
+void TestNodeTimer::testAttached()
+{
+	NodeTimerWheel wheel(0.05f);
+	std::vector<NodeTimerWheel::Expired> expired;
+	const v3s16 blockpos(7, -3, 2);
+	NodeTimerList list;
+
+	list.set(NodeTimer(1.0f, 0.0f, v3s16(1, 1, 1)));
+	list.set(NodeTimer(2.0f, 0.0f, v3s16(2, 2, 2)));
+
+	// Time passed in the wheel before doesn't count for the list
+	wheel.advance(10.0f, expired);
+	list.attach(&wheel, blockpos);
+	UASSERT(list.isAttached());
+
+	// Replacing and removing leave stale entries behind that are skipped
+	list.set(NodeTimer(3.0f, 0.0f, v3s16(2, 2, 2)));
+	list.set(NodeTimer(0.5f, 0.0f, v3s16(3, 3, 3)));
+	list.remove(v3s16(3, 3, 3));
+	UASSERTEQ(size_t, wheel.size(), 4);
+
+	std::vector<NodeTimer> fired;
+	for (int i = 0; i < 20; i++) {
+		expired.clear();
+		wheel.advance(0.2f, expired);
+		for (const NodeTimerWheel::Expired &e : expired) {
+			UASSERT(e.blockpos == blockpos);
+			NodeTimer t;
+			if (list.takeExpired(e.index, e.id, t))
+				fired.push_back(t);
+		}
+		if (i == 4) {
+			NodeTimer t = list.get(v3s16(2, 2, 2));
+			UASSERT(std::fabs(t.elapsed - 1.0f) < 0.001f);
+		}
+	}
+	UASSERTEQ(size_t, fired.size(), 2);
+	UASSERT(fired[0].position == v3s16(1, 1, 1));
+	UASSERT(fired[0].elapsed >= 1.0f && fired[0].elapsed < 1.25f);
+	UASSERT(fired[1].position == v3s16(2, 2, 2));
+	UASSERT(fired[1].timeout == 3.0f);
+
+	// A detached list keeps its timers while its clock stands still
+	list.set(NodeTimer(1.0f, 0.0f, v3s16(1, 1, 1)));
+	list.detach();
+	expired.clear();
+	wheel.advance(5.0f, expired);
+	NodeTimer t;
+	for (const NodeTimerWheel::Expired &e : expired)
+		UASSERT(!list.takeExpired(e.index, e.id, t));
+	UASSERT(list.get(v3s16(1, 1, 1)).elapsed == 0.0f);
+	UASSERTEQ(size_t, list.step(1.0f).size(), 1);
+}
@@ -0,0 +1,154 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "gamedef.h"
+#include "pathfinder.h"
+
+class TestPathfinder : public TestBase
+{
+public:
+	TestPathfinder() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestPathfinder"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testClassify(const NodeDefManager *ndef);
+	void testSnapshotPathNodeSource();
+	void testFindCorridor();
+};
+
+static TestPathfinder g_test_instance;
+
+void TestPathfinder::runTests(IGameDef *gamedef)
+{
+	TEST(testClassify, gamedef->getNodeDefManager());
+	TEST(testSnapshotPathNodeSource);
+	TEST(testFindCorridor);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define NODES_PER_BLOCK (MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE)
+
+static std::shared_ptr<PathBlock> make_block(PathNodeType type)
+{
+	std::shared_ptr<PathBlock> block = std::make_shared<PathBlock>();
+	for (PathNodeType &node : block->nodes)
+		node = type;
+	block->passable = type == PATH_NODE_OPEN;
+	return block;
+}
+
+void TestPathfinder::testClassify(const NodeDefManager *ndef)
+{
+	PathBlock block;
+	block.contents.reset(new content_t[NODES_PER_BLOCK]);
+	for (u32 i = 0; i < NODES_PER_BLOCK; i++)
+		block.contents[i] = t_CONTENT_STONE;
+	block.contents[0] = CONTENT_IGNORE;
+
+	block.classify(ndef);
+	UASSERT(!block.contents);
+	UASSERT(block.nodes[0] == PATH_NODE_IGNORE);
+	UASSERT(block.nodes[1] == PATH_NODE_WALKABLE);
+	UASSERT(!block.passable);
+
+	PathBlock air;
+	air.contents.reset(new content_t[NODES_PER_BLOCK]);
+	for (u32 i = 0; i < NODES_PER_BLOCK; i++)
+		air.contents[i] = i == 5 ? CONTENT_AIR : t_CONTENT_STONE;
+
+	air.classify(ndef);
+	UASSERT(air.nodes[5] == PATH_NODE_OPEN);
+	UASSERT(air.passable);
+
+	// Only the first call does something
+	air.nodes[5] = PATH_NODE_WALKABLE;
+	air.classify(ndef);
+	UASSERT(air.nodes[5] == PATH_NODE_WALKABLE);
+}
+
+void TestPathfinder::testSnapshotPathNodeSource()
+{
+	PathBlockMap blocks;
+	blocks[v3s16(0, 0, 0)] = make_block(PATH_NODE_OPEN);
+	blocks[v3s16(-1, 0, 0)] = make_block(PATH_NODE_WALKABLE);
+
+	// Nodes are stored in the order of MapBlock
+	const v3s16 rel(3, 5, 7);
+	blocks[v3s16(0, 0, 0)]->nodes[rel.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+			rel.Y * MAP_BLOCKSIZE + rel.X] = PATH_NODE_WALKABLE;
+
+	SnapshotPathNodeSource all_nodes(blocks, nullptr);
+	UASSERT(all_nodes.getNodeType(rel) == PATH_NODE_WALKABLE);
+	UASSERT(all_nodes.getNodeType(v3s16(3, 5, 8)) == PATH_NODE_OPEN);
+	UASSERT(all_nodes.getNodeType(v3s16(-1, 5, 7)) == PATH_NODE_WALKABLE);
+	UASSERT(all_nodes.getNodeType(v3s16(-16, 0, 15)) == PATH_NODE_WALKABLE);
+	// Not collected
+	UASSERT(all_nodes.getNodeType(v3s16(-17, 0, 0)) == PATH_NODE_IGNORE);
+	UASSERT(all_nodes.getNodeType(v3s16(0, 16, 0)) == PATH_NODE_IGNORE);
+	// Back in a block looked up before
+	UASSERT(all_nodes.getNodeType(v3s16(15, 15, 15)) == PATH_NODE_OPEN);
+
+	// Blocks outside of the corridor are ignored
+	std::set<v3s16> corridor;
+	corridor.insert(v3s16(0, 0, 0));
+	SnapshotPathNodeSource corridor_nodes(blocks, &corridor);
+	UASSERT(corridor_nodes.getNodeType(rel) == PATH_NODE_WALKABLE);
+	UASSERT(corridor_nodes.getNodeType(v3s16(-1, 5, 7)) == PATH_NODE_IGNORE);
+	UASSERT(corridor_nodes.getNodeType(v3s16(0, 5, 7)) == PATH_NODE_OPEN);
+}
+
+void TestPathfinder::testFindCorridor()
+{
+	// A row of open blocks along X, with a wall at X = 2
+	PathBlockMap blocks;
+	for (s16 x = 0; x <= 4; x++)
+		blocks[v3s16(x, 0, 0)] = make_block(PATH_NODE_OPEN);
+	blocks[v3s16(2, 0, 0)] = make_block(PATH_NODE_WALKABLE);
+
+	const v3s16 source(5, 5, 5);
+	const v3s16 destination(4 * MAP_BLOCKSIZE + 5, 5, 5);
+	std::set<v3s16> corridor;
+	UASSERT(!findCorridor(blocks, source, destination, corridor));
+
+	// Detour through Z = 1
+	for (s16 x = 1; x <= 3; x++)
+		blocks[v3s16(x, 0, 1)] = make_block(PATH_NODE_OPEN);
+	UASSERT(findCorridor(blocks, source, destination, corridor));
+
+	// The chain and its neighbours, but not the blocks away from it
+	UASSERT(corridor.count(v3s16(0, 0, 0)));
+	UASSERT(corridor.count(v3s16(2, 0, 1)));
+	UASSERT(corridor.count(v3s16(4, 0, 0)));
+	UASSERT(corridor.count(v3s16(2, -1, 0)));
+	UASSERT(corridor.count(v3s16(2, 1, 2)));
+	UASSERT(!corridor.count(v3s16(2, 0, 3)));
+	UASSERT(!corridor.count(v3s16(6, 0, 0)));
+	UASSERT(!corridor.count(v3s16(-2, 0, 0)));
+
+	// No chain from or to a block without any space
+	corridor.clear();
+	blocks[v3s16(4, 0, 0)] = make_block(PATH_NODE_WALKABLE);
+	UASSERT(!findCorridor(blocks, source, destination, corridor));
+	UASSERT(!findCorridor(blocks, source, v3s16(-20, 5, 5), corridor));
+	UASSERT(findCorridor(blocks, source, source, corridor));
+}
@@ -19,7 +19,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "test.h"
 
+#include "filesys.h"
 #include "profiler.h"
+#include "util/string.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
 
 class TestProfiler : public TestBase
 {
@@ -30,6 +35,8 @@ class TestProfiler : public TestBase
 	void runTests(IGameDef *gamedef);
 
 	void testProfilerAverage();
+	void testZones();
+	void testTrace();
 };
 
 static TestProfiler g_test_instance;
@@ -37,6 +44,8 @@ static TestProfiler g_test_instance;
 void TestProfiler::runTests(IGameDef *gamedef)
 {
 	TEST(testProfilerAverage);
+	TEST(testZones);
+	TEST(testTrace);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -71,3 +80,61 @@ void TestProfiler::testProfilerAverage()
 
 	UASSERT(p.getValue("Test2") == 123.57f);
 }
+
+void TestProfiler::testZones()
+{
+	Profiler p;
+	Profiler::GraphValues values;
+
+	// Take the times other tests left in the zones
+	p.getPage(values, 1, 1);
+	p.clear();
+
+	for (int i = 0; i < 3; i++) {
+		PROFILE_ZONE("TestProfiler: zone", SPT_AVG);
+	}
+	std::thread thread([] () {
+		PROFILE_ZONE("TestProfiler: zone", SPT_AVG);
+	});
+	thread.join();
+	{
+		PROFILE_ZONE("TestProfiler: added zone", SPT_ADD);
+	}
+
+	values.clear();
+	p.getPage(values, 1, 1);
+	UASSERT(values.count("TestProfiler: zone [ms]") == 1);
+	UASSERTEQ(int, p.getAvgCount("TestProfiler: zone [ms]"), 4);
+	UASSERT(values.count("TestProfiler: added zone [ms]") == 1);
+	UASSERTEQ(int, p.getAvgCount("TestProfiler: added zone [ms]"), 1);
+
+	// Nothing new since then
+	p.clear();
+	values.clear();
+	p.getPage(values, 1, 1);
+	UASSERT(values["TestProfiler: zone [ms]"] == 0.0f);
+}
+
+void TestProfiler::testTrace()
+{
+	std::string path = getTestTempFile();
+	UASSERT(g_profiler->startTrace(path));
+	// Only one at a time
+	UASSERT(!g_profiler->startTrace(path));
+	{
+		PROFILE_ZONE("TestProfiler: traced zone", SPT_AVG);
+	}
+	g_profiler->stopTrace();
+
+	std::ifstream is(path, std::ios::binary);
+	std::ostringstream os;
+	os << is.rdbuf();
+	std::string trace = os.str();
+	is.close();
+	fs::DeleteSingleFileOrEmptyDirectory(path);
+
+	UASSERT(str_starts_with(trace, "["));
+	UASSERT(trace.find("{\"name\":\"TestProfiler: traced zone [ms]\","
+			"\"ph\":\"X\"") != std::string::npos);
+	UASSERT(trace.substr(trace.size() - 3) == "\n]\n");
+}
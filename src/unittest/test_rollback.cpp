@@ -0,0 +1,144 @@
+/*
+Minetest
+Copyright (C) 2022 Minetest
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3.0 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "filesys.h"
+#include "rollback.h"
+#include <algorithm>
+#include <ctime>
+
+class TestRollback : public TestBase
+{
+public:
+	TestRollback() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestRollback"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testSuspect(IGameDef *gamedef);
+	void testNodeActors(IGameDef *gamedef);
+};
+
+static TestRollback g_test_instance;
+
+void TestRollback::runTests(IGameDef *gamedef)
+{
+	TEST(testSuspect, gamedef);
+	TEST(testNodeActors, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static RollbackAction make_action(const std::string &actor, v3s16 p,
+		time_t t = time(0))
+{
+	RollbackNode n_old, n_new;
+	n_old.name = "air";
+	n_new.name = "default:stone";
+
+	RollbackAction action;
+	action.setSetNode(p, n_old, n_new);
+	action.actor = actor;
+	action.unix_time = t;
+	return action;
+}
+
+static bool same_action(const RollbackAction &a1, const RollbackAction &a2)
+{
+	return a1.actor == a2.actor && a1.p == a2.p &&
+			a1.unix_time == a2.unix_time && a1.n_new.name == a2.n_new.name;
+}
+
+void TestRollback::testSuspect(IGameDef *gamedef)
+{
+	std::string world_path = getTestTempDirectory() + DIR_DELIM "suspect";
+	UASSERT(fs::CreateDir(world_path));
+	RollbackManager rollback(world_path, gamedef);
+
+	rollback.addAction(make_action("far", v3s16(100, 0, 0)));
+	rollback.addAction(make_action("near", v3s16(15, 0, 0)));
+	rollback.addAction(make_action("nearer", v3s16(16, 0, 1)));
+
+	// Across a block border
+	UASSERTEQ(std::string, rollback.getSuspect(v3s16(16, 0, 0), 83, 1), "nearer");
+	UASSERTEQ(std::string, rollback.getSuspect(v3s16(12, 0, 0), 100, 1), "near");
+	UASSERTEQ(std::string, rollback.getSuspect(v3s16(50, 0, 0), 83, 1), "");
+
+	// The newest one above the shortcut wins
+	rollback.addAction(make_action("newest", v3s16(16, 0, 2)));
+	UASSERTEQ(std::string, rollback.getSuspect(v3s16(16, 0, 1), 50, 1), "newest");
+	UASSERTEQ(std::string, rollback.getSuspect(v3s16(16, 0, 1), 100, 1), "nearer");
+
+	// Too old
+	rollback.addAction(make_action("old", v3s16(-100, 0, 0), time(0) - 200));
+	UASSERTEQ(std::string, rollback.getSuspect(v3s16(-100, 0, 0), 83, 1), "");
+
+	rollback.setActor("current", false);
+	UASSERTEQ(std::string, rollback.getSuspect(v3s16(16, 0, 0), 83, 1), "current");
+}
+
+void TestRollback::testNodeActors(IGameDef *gamedef)
+{
+	std::string world_path = getTestTempDirectory() + DIR_DELIM "node_actors";
+	UASSERT(fs::CreateDir(world_path));
+	time_t now = time(0);
+	{
+		RollbackManager rollback(world_path, gamedef);
+		for (s16 i = 0; i < 1000; i++)
+			rollback.addAction(make_action("digger", v3s16(i, 0, 0), now));
+		rollback.addAction(make_action("builder", v3s16(5, 0, 0), now));
+
+		// The database is new, so all of its actions are in memory too
+		rollback.m_recent_since = now - 100;
+
+		// From memory, newest first
+		std::list<RollbackAction> actions =
+				rollback.getNodeActors(v3s16(5, 0, 0), 1, 10, 10);
+		UASSERTEQ(size_t, actions.size(), 4);
+		UASSERTEQ(std::string, actions.front().actor, "builder");
+		UASSERT(actions.back().p == v3s16(4, 0, 0));
+		UASSERTEQ(size_t, rollback.getNodeActors(v3s16(5, 0, 0), 1, 10, 2).size(), 2);
+		std::list<RollbackAction> ranged =
+				rollback.getNodeActors(v3s16(500, 0, 0), 20, 10, 30);
+		UASSERTEQ(size_t, ranged.size(), 30);
+
+		// The database gives the same answers
+		rollback.m_recent_since = now + 100;
+		std::list<RollbackAction> db_actions =
+				rollback.getNodeActors(v3s16(5, 0, 0), 1, 10, 10);
+		std::list<RollbackAction> db_ranged =
+				rollback.getNodeActors(v3s16(500, 0, 0), 20, 10, 30);
+		UASSERT(db_actions.size() == actions.size() &&
+				std::equal(actions.begin(), actions.end(), db_actions.begin(),
+					same_action));
+		UASSERT(db_ranged.size() == ranged.size() &&
+				std::equal(ranged.begin(), ranged.end(), db_ranged.begin(),
+					same_action));
+	}
+
+	// From the database, written by the writer thread or on shutdown
+	RollbackManager rollback(world_path, gamedef);
+	std::list<RollbackAction> actions =
+			rollback.getNodeActors(v3s16(5, 0, 0), 1, 1000, 10);
+	UASSERTEQ(size_t, actions.size(), 4);
+	UASSERTEQ(std::string, actions.front().actor, "builder");
+	UASSERTEQ(std::string, actions.front().n_new.name, "default:stone");
+	UASSERTEQ(size_t, rollback.getRevertActions("digger", 1000).size(), 1000);
+}
@@ -31,6 +31,7 @@ class TestVoxelAlgorithms : public TestBase {
 	void runTests(IGameDef *gamedef);
 
 	void testVoxelLineIterator(const NodeDefManager *ndef);
+	void testVoxelLineIteratorSkip();
 };
 
 static TestVoxelAlgorithms g_test_instance;
@@ -40,6 +41,7 @@ void TestVoxelAlgorithms::runTests(IGameDef *gamedef)
 	const NodeDefManager *ndef = gamedef->getNodeDefManager();
 
 	TEST(testVoxelLineIterator, ndef);
+	TEST(testVoxelLineIteratorSkip);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -99,3 +101,45 @@ void TestVoxelAlgorithms::testVoxelLineIterator(const NodeDefManager *ndef)
 		UASSERTEQ(int, actual_nodecount, nodecount);
 	}
 }
+
+void TestVoxelAlgorithms::testVoxelLineIteratorSkip()
+{
+	// Same kind of lines as above, some of them parallel to an axis
+	std::vector<core::line3d<f32> > lines;
+	for (f32 x = -9.1; x < 9; x += 3.124) {
+	for (f32 y = -9.2; y < 9; y += 3.123) {
+	for (f32 z = -9.3; z < 9; z += 3.122) {
+		lines.emplace_back(-x, -y, -z, x, y, z);
+	}
+	}
+	}
+	lines.emplace_back(0.2, 0.1, -20.3, 0.2, 0.1, 20.3);
+	lines.emplace_back(-20.3, 0.1, 0.2, 20.3, 0.1, 0.2);
+
+	for (const core::line3d<f32> &l : lines) {
+		voxalgo::VoxelLineIterator stepped(l.start, l.getVector());
+		voxalgo::VoxelLineIterator skipped(l.start, l.getVector());
+		v3s16 start = stepped.m_current_node_pos;
+		core::aabbox3d<s16> box(start - v3s16(2, 3, 1), start + v3s16(4, 2, 5));
+
+		// Step while the next voxel is still inside the box
+		while (true) {
+			voxalgo::VoxelLineIterator ahead = stepped;
+			ahead.next();
+			if (!box.isPointInside(ahead.m_current_node_pos))
+				break;
+			stepped = ahead;
+		}
+		skipped.skipInside(box);
+		UASSERT(skipped.m_current_node_pos == stepped.m_current_node_pos);
+		UASSERTEQ(s16, skipped.m_current_index, stepped.m_current_index);
+
+		// Both go on along the same voxels
+		while (stepped.hasNext()) {
+			stepped.next();
+			skipped.next();
+			UASSERT(skipped.m_current_node_pos == stepped.m_current_node_pos);
+		}
+		UASSERTEQ(s16, skipped.m_current_index, stepped.m_current_index);
+	}
+}
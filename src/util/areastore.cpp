@@ -20,6 +20,17 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/areastore.h"
 #include "util/serialize.h"
 #include "util/container.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
 
 #if USE_SPATIAL
 	#include <spatialindex/SpatialIndex.h>
@@ -47,11 +58,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 AreaStore *AreaStore::getOptimalImplementation()
 {
-#if USE_SPATIAL
-	return new SpatialAreaStore();
-#else
-	return new VectorAreaStore();
-#endif
+	return new RTreeAreaStore();
 }
 
 const Area *AreaStore::getArea(u32 id) const
@@ -69,6 +76,23 @@ void AreaStore::serialize(std::ostream &os) const
 	// After 5.1.0-dev:  version >= 5 throws SerializationError
 	// Forwards-compatibility is assumed before version 5.
 
+	if (areas_map.size() > U16_MAX) {
+		writeU8(os, 5); // Serialisation version
+
+		// Fixed size records, then all data
+		writeU32(os, areas_map.size());
+		for (const auto &it : areas_map) {
+			const Area &a = it.second;
+			writeV3S16(os, a.minedge);
+			writeV3S16(os, a.maxedge);
+			writeU32(os, a.id);
+			writeU32(os, a.data.size());
+		}
+		for (const auto &it : areas_map)
+			os.write(it.second.data.data(), it.second.data.size());
+		return;
+	}
+
 	writeU8(os, 0); // Serialisation version
 
 	// TODO: Compression?
@@ -88,34 +112,123 @@ void AreaStore::serialize(std::ostream &os) const
 
 void AreaStore::deserialize(std::istream &is)
 {
-	u8 ver = readU8(is);
+	std::string data((std::istreambuf_iterator<char>(is)),
+			std::istreambuf_iterator<char>());
+	deserialize(data.data(), data.size());
+}
+
+// Bounds checked reads of a serialized AreaStore
+class AreaStoreReader {
+public:
+	AreaStoreReader(const char *data, size_t size) :
+		m_pos((const u8 *)data), m_end((const u8 *)data + size)
+	{}
+
+	bool atEnd() const { return m_pos == m_end; }
+
+	const u8 *take(size_t len)
+	{
+		if ((size_t)(m_end - m_pos) < len)
+			throw SerializationError("AreaStore: unexpected end of data");
+		const u8 *p = m_pos;
+		m_pos += len;
+		return p;
+	}
+
+	u8 getU8() { return readU8(take(1)); }
+	u16 getU16() { return readU16(take(2)); }
+	u32 getU32() { return readU32(take(4)); }
+	v3s16 getV3S16() { return readV3S16(take(6)); }
+
+private:
+	const u8 *m_pos;
+	const u8 *m_end;
+};
+
+void AreaStore::deserialize(const char *data, size_t size)
+{
+	AreaStoreReader reader(data, size);
+
+	u8 ver = reader.getU8();
+	if (ver == 5) {
+		u32 num_areas = reader.getU32();
+		// Records first, their data follows all of them
+		AreaStoreReader data_reader = reader;
+		data_reader.take((size_t)num_areas * 20);
+
+		reserve(areas_map.size() + num_areas);
+		Area a(U32_MAX);
+		for (u32 i = 0; i < num_areas; ++i) {
+			a.minedge = reader.getV3S16();
+			a.maxedge = reader.getV3S16();
+			a.id = reader.getU32();
+			u32 data_len = reader.getU32();
+			a.data.assign((const char *)data_reader.take(data_len), data_len);
+			insertArea(&a);
+		}
+		return;
+	}
+
 	// Assume forwards-compatibility before version 5
 	if (ver >= 5)
 		throw SerializationError("Unknown AreaStore "
 				"serialization version!");
 
-	u16 num_areas = readU16(is);
+	u16 num_areas = reader.getU16();
 	std::vector<Area> areas;
 	areas.reserve(num_areas);
 	for (u32 i = 0; i < num_areas; ++i) {
 		Area a(U32_MAX);
-		a.minedge = readV3S16(is);
-		a.maxedge = readV3S16(is);
-		u16 data_len = readU16(is);
-		a.data = std::string(data_len, '\0');
-		is.read(&a.data[0], data_len);
+		a.minedge = reader.getV3S16();
+		a.maxedge = reader.getV3S16();
+		u16 data_len = reader.getU16();
+		a.data.assign((const char *)reader.take(data_len), data_len);
 		areas.emplace_back(std::move(a));
 	}
 
-	bool read_ids = is.good(); // EOF for old formats
+	bool read_ids = !reader.atEnd(); // EOF for old formats
 
 	for (auto &area : areas) {
 		if (read_ids)
-			area.id = readU32(is);
+			area.id = reader.getU32();
 		insertArea(&area);
 	}
 }
 
+void AreaStore::deserializeFile(const std::string &path)
+{
+#ifndef _WIN32
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw SerializationError("AreaStore: could not open " + path);
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		throw SerializationError("AreaStore: could not read " + path);
+	}
+
+	size_t size = st.st_size;
+	void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		throw SerializationError("AreaStore: could not map " + path);
+
+	try {
+		deserialize((const char *)data, size);
+	} catch (...) {
+		munmap(data, size);
+		throw;
+	}
+	munmap(data, size);
+#else
+	std::ifstream is(path, std::ios::binary);
+	if (!is.good())
+		throw SerializationError("AreaStore: could not open " + path);
+	deserialize(is);
+#endif
+}
+
 void AreaStore::invalidateCache()
 {
 	if (m_cache_enabled) {
@@ -125,6 +238,10 @@ void AreaStore::invalidateCache()
 
 u32 AreaStore::getNextId() const
 {
+	// IDs 0 to size - 1 are all used, skip the search
+	if (!areas_map.empty() && areas_map.rbegin()->first == areas_map.size() - 1)
+		return areas_map.size();
+
 	u32 free_id = 0;
 	for (const auto &area : areas_map) {
 		if (area.first > free_id)
@@ -241,6 +358,209 @@ void VectorAreaStore::getAreasInArea(std::vector<Area *> *result,
 	}
 }
 
+////
+// RTreeAreaStore
+////
+
+// Children per node
+#define RTREE_NODE_CAPACITY 16
+// Inserted areas that are scanned linearly at most, see rebuildIfNeeded()
+#define RTREE_MIN_PENDING 32
+
+#define RTREE_CENTER(b, d) ((s32)(b).minedge.d + (b).maxedge.d)
+
+// Sort-Tile-Recursive: orders boxes so that runs of capacity of them are
+// close to each other. Sorts by X into slabs, slabs by Y into runs, runs by Z.
+template <typename T>
+static void str_sort(std::vector<T> &items)
+{
+	const size_t n = items.size();
+	const size_t leaves = (n + RTREE_NODE_CAPACITY - 1) / RTREE_NODE_CAPACITY;
+	const size_t slices = MYMAX((size_t)1, (size_t)std::ceil(std::cbrt((double)leaves)));
+	const size_t run = slices * RTREE_NODE_CAPACITY;
+	const size_t slab = slices * run;
+
+	std::sort(items.begin(), items.end(), [] (const T &a, const T &b) {
+		return RTREE_CENTER(a, X) < RTREE_CENTER(b, X);
+	});
+	for (size_t i = 0; i < n; i += slab) {
+		const size_t slab_end = MYMIN(i + slab, n);
+		std::sort(items.begin() + i, items.begin() + slab_end,
+				[] (const T &a, const T &b) {
+			return RTREE_CENTER(a, Y) < RTREE_CENTER(b, Y);
+		});
+		for (size_t j = i; j < slab_end; j += run) {
+			std::sort(items.begin() + j, items.begin() + MYMIN(j + run, n),
+					[] (const T &a, const T &b) {
+				return RTREE_CENTER(a, Z) < RTREE_CENTER(b, Z);
+			});
+		}
+	}
+}
+
+// Extends the box of a node to a child
+template <typename T>
+static inline void rtree_extend(v3s16 &minedge, v3s16 &maxedge, const T &b)
+{
+	minedge.X = MYMIN(minedge.X, b.minedge.X);
+	minedge.Y = MYMIN(minedge.Y, b.minedge.Y);
+	minedge.Z = MYMIN(minedge.Z, b.minedge.Z);
+	maxedge.X = MYMAX(maxedge.X, b.maxedge.X);
+	maxedge.Y = MYMAX(maxedge.Y, b.maxedge.Y);
+	maxedge.Z = MYMAX(maxedge.Z, b.maxedge.Z);
+}
+
+void RTreeAreaStore::rebuild()
+{
+	m_entries.clear();
+	m_entries.reserve(areas_map.size());
+	for (auto &it : areas_map) {
+		Area *a = &it.second;
+		m_entries.push_back({a->minedge, a->maxedge, a});
+	}
+	m_pending.clear();
+	m_removed = 0;
+	m_levels.clear();
+
+	str_sort(m_entries);
+
+	// Groups consecutive children into parents
+	auto pack = [] (const auto &children, std::vector<Node> &parents) {
+		parents.reserve((children.size() + RTREE_NODE_CAPACITY - 1) /
+				RTREE_NODE_CAPACITY);
+		for (size_t i = 0; i < children.size(); i += RTREE_NODE_CAPACITY) {
+			Node node;
+			node.minedge = children[i].minedge;
+			node.maxedge = children[i].maxedge;
+			node.first = i;
+			node.count = MYMIN(children.size() - i, (size_t)RTREE_NODE_CAPACITY);
+			for (u32 j = 1; j < node.count; j++)
+				rtree_extend(node.minedge, node.maxedge, children[i + j]);
+			parents.push_back(node);
+		}
+	};
+
+	if (m_entries.empty())
+		return;
+
+	m_levels.emplace_back();
+	pack(m_entries, m_levels.back());
+	while (m_levels.back().size() > 1) {
+		// Children keep their ranges, so they can be reordered
+		str_sort(m_levels.back());
+		std::vector<Node> parents;
+		pack(m_levels.back(), parents);
+		m_levels.push_back(std::move(parents));
+	}
+}
+
+void RTreeAreaStore::rebuildIfNeeded()
+{
+	const size_t max_pending = MYMAX((size_t)RTREE_MIN_PENDING,
+			(size_t)std::sqrt((double)m_entries.size()));
+	if (m_pending.size() > max_pending ||
+			m_removed > MYMAX((size_t)RTREE_MIN_PENDING, m_entries.size() / 4))
+		rebuild();
+}
+
+template <typename F>
+void RTreeAreaStore::query(v3s16 minedge, v3s16 maxedge, F visit)
+{
+	if (m_levels.empty())
+		return;
+
+	// Level and index of the nodes left to visit
+	std::vector<std::pair<size_t, u32>> stack;
+	stack.emplace_back(m_levels.size() - 1, 0);
+	while (!stack.empty()) {
+		size_t level = stack.back().first;
+		const Node &node = m_levels[level][stack.back().second];
+		stack.pop_back();
+		if (!AST_AREAS_OVERLAP(minedge, maxedge, &node))
+			continue;
+
+		if (level > 0) {
+			for (u32 i = node.first; i < node.first + node.count; i++)
+				stack.emplace_back(level - 1, i);
+			continue;
+		}
+
+		for (u32 i = node.first; i < node.first + node.count; i++) {
+			Entry &entry = m_entries[i];
+			if (entry.area && AST_AREAS_OVERLAP(minedge, maxedge, &entry))
+				visit(entry);
+		}
+	}
+}
+
+bool RTreeAreaStore::insertArea(Area *a)
+{
+	if (a->id == U32_MAX)
+		a->id = getNextId();
+	std::pair<AreaMap::iterator, bool> res =
+			areas_map.insert(std::make_pair(a->id, *a));
+	if (!res.second)
+		// ID is not unique
+		return false;
+	m_pending.push_back(&res.first->second);
+	invalidateCache();
+	return true;
+}
+
+bool RTreeAreaStore::removeArea(u32 id)
+{
+	AreaMap::iterator it = areas_map.find(id);
+	if (it == areas_map.end())
+		return false;
+	Area *a = &it->second;
+
+	auto pending_it = std::find(m_pending.begin(), m_pending.end(), a);
+	if (pending_it != m_pending.end()) {
+		m_pending.erase(pending_it);
+	} else {
+		query(a->minedge, a->maxedge, [&] (Entry &entry) {
+			if (entry.area == a) {
+				entry.area = nullptr;
+				m_removed++;
+			}
+		});
+	}
+
+	areas_map.erase(it);
+	invalidateCache();
+	return true;
+}
+
+void RTreeAreaStore::getAreasForPosImpl(std::vector<Area *> *result, v3s16 pos)
+{
+	rebuildIfNeeded();
+
+	query(pos, pos, [&] (Entry &entry) {
+		result->push_back(entry.area);
+	});
+	for (Area *area : m_pending) {
+		if (AST_CONTAINS_PT(area, pos))
+			result->push_back(area);
+	}
+}
+
+void RTreeAreaStore::getAreasInArea(std::vector<Area *> *result,
+		v3s16 minedge, v3s16 maxedge, bool accept_overlap)
+{
+	rebuildIfNeeded();
+
+	query(minedge, maxedge, [&] (Entry &entry) {
+		if (accept_overlap || AST_CONTAINS_AREA(minedge, maxedge, &entry))
+			result->push_back(entry.area);
+	});
+	for (Area *area : m_pending) {
+		if (accept_overlap ? AST_AREAS_OVERLAP(minedge, maxedge, area) :
+				AST_CONTAINS_AREA(minedge, maxedge, area)) {
+			result->push_back(area);
+		}
+	}
+}
+
 #if USE_SPATIAL
 
 static inline SpatialIndex::Region get_spatial_region(const v3s16 minedge,
@@ -91,6 +91,8 @@ class AreaStore {
 	const Area *getArea(u32 id) const;
 
 	/// Serializes the store's areas to a binary ostream.
+	/// Stores of more than 65535 areas use a format with fixed size
+	/// records that older versions refuse to load.
 	void serialize(std::ostream &is) const;
 
 	/// Deserializes the Areas from a binary istream.
@@ -99,6 +101,12 @@ class AreaStore {
 	/// AreaStores.
 	void deserialize(std::istream &is);
 
+	/// Like deserialize(), but reads from memory.
+	void deserialize(const char *data, size_t size);
+
+	/// Like deserialize(), but maps the file into memory where possible.
+	void deserializeFile(const std::string &path);
+
 protected:
 	/// Invalidates the getAreasForPos cache.
 	/// Call after adding or removing an area.
@@ -144,6 +152,51 @@ class VectorAreaStore : public AreaStore {
 };
 
 
+/// R-tree without dependencies, bulk loaded with Sort-Tile-Recursive.
+/// Inserted areas are scanned linearly until the next query finds enough
+/// of them to rebuild the tree, removed ones are skipped until then.
+class RTreeAreaStore : public AreaStore {
+public:
+	virtual void reserve(size_t count) { m_entries.reserve(count); }
+	virtual bool insertArea(Area *a);
+	virtual bool removeArea(u32 id);
+	virtual void getAreasInArea(std::vector<Area *> *result,
+		v3s16 minedge, v3s16 maxedge, bool accept_overlap);
+
+protected:
+	virtual void getAreasForPosImpl(std::vector<Area *> *result, v3s16 pos);
+
+private:
+	struct Entry {
+		v3s16 minedge, maxedge;
+		// nullptr once removed
+		Area *area;
+	};
+
+	struct Node {
+		v3s16 minedge, maxedge;
+		// Range of the children in the level below, or of m_entries
+		u32 first, count;
+	};
+
+	void rebuild();
+	void rebuildIfNeeded();
+
+	// Calls visit for every entry overlapping the box
+	template <typename F>
+	void query(v3s16 minedge, v3s16 maxedge, F visit);
+
+	// Areas of the tree, in leaf order
+	std::vector<Entry> m_entries;
+	// Leaves first, the last level is the root
+	std::vector<std::vector<Node>> m_levels;
+	// Areas inserted since the last rebuild
+	std::vector<Area *> m_pending;
+	// Removed entries still in the tree
+	size_t m_removed = 0;
+};
+
+
 #if USE_SPATIAL
 
 class SpatialAreaStore : public AreaStore {
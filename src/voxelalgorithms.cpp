@@ -1321,6 +1321,72 @@ void VoxelLineIterator::next()
 	}
 }
 
+/*
+	Number of crossings on one axis that come before the line leaves the
+	box at leave_multi, at most inside_steps of them.
+*/
+static inline s16 crossings_before(f32 next_multi, f32 multi_inc,
+	f32 leave_multi, s16 inside_steps)
+{
+	if (next_multi >= leave_multi)
+		return 0;
+	f32 count = ceilf((leave_multi - next_multi) / multi_inc);
+	return count < inside_steps ? (s16)count : inside_steps;
+}
+
+void VoxelLineIterator::skipInside(const core::aabbox3d<s16> &box)
+{
+	// Steps along each axis that stay inside the box
+	v3s16 inside_steps(
+		m_step_directions.X > 0 ? box.MaxEdge.X - m_current_node_pos.X
+			: m_current_node_pos.X - box.MinEdge.X,
+		m_step_directions.Y > 0 ? box.MaxEdge.Y - m_current_node_pos.Y
+			: m_current_node_pos.Y - box.MinEdge.Y,
+		m_step_directions.Z > 0 ? box.MaxEdge.Z - m_current_node_pos.Z
+			: m_current_node_pos.Z - box.MinEdge.Z);
+
+	// The line leaves the box at the first crossing after those steps.
+	// Axes along which the line doesn't move never leave it.
+	f32 leave_multi = -1.0f;
+	if (m_line_vector.X != 0)
+		leave_multi = m_next_intersection_multi.X
+			+ inside_steps.X * m_intersection_multi_inc.X;
+	if (m_line_vector.Y != 0) {
+		f32 t = m_next_intersection_multi.Y
+			+ inside_steps.Y * m_intersection_multi_inc.Y;
+		if (leave_multi < 0 || t < leave_multi)
+			leave_multi = t;
+	}
+	if (m_line_vector.Z != 0) {
+		f32 t = m_next_intersection_multi.Z
+			+ inside_steps.Z * m_intersection_multi_inc.Z;
+		if (leave_multi < 0 || t < leave_multi)
+			leave_multi = t;
+	}
+	if (leave_multi < 0)
+		return;
+
+	// Take every crossing before that point. Their order doesn't matter
+	// for the resulting voxel, and ties at the point itself are left to
+	// next() so its tie-breaking still applies.
+	v3s16 steps(0, 0, 0);
+	if (m_line_vector.X != 0)
+		steps.X = crossings_before(m_next_intersection_multi.X,
+			m_intersection_multi_inc.X, leave_multi, inside_steps.X);
+	if (m_line_vector.Y != 0)
+		steps.Y = crossings_before(m_next_intersection_multi.Y,
+			m_intersection_multi_inc.Y, leave_multi, inside_steps.Y);
+	if (m_line_vector.Z != 0)
+		steps.Z = crossings_before(m_next_intersection_multi.Z,
+			m_intersection_multi_inc.Z, leave_multi, inside_steps.Z);
+
+	m_next_intersection_multi.X += steps.X * m_intersection_multi_inc.X;
+	m_next_intersection_multi.Y += steps.Y * m_intersection_multi_inc.Y;
+	m_next_intersection_multi.Z += steps.Z * m_intersection_multi_inc.Z;
+	m_current_node_pos += steps * m_step_directions;
+	m_current_index += steps.X + steps.Y + steps.Z;
+}
+
 s16 VoxelLineIterator::getIndex(v3s16 voxel){
 	return
 		abs(voxel.X - m_start_node_pos.X) +
@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include "irr_aabb3d.h"
 #include "voxel.h"
 #include "mapnode.h"
 #include "util/container.h"
@@ -137,6 +138,14 @@ struct VoxelLineIterator
 	 */
 	void next();
 
+	/*!
+	 * Steps over the voxels of the line inside box at once, up to
+	 * the last one before the line leaves it. Other than next(),
+	 * this doesn't visit the voxels in between.
+	 * The current voxel must be inside the box.
+	 */
+	void skipInside(const core::aabbox3d<s16> &box);
+
 	/*!
 	 * Returns true if the next voxel intersects the given line.
 	 */